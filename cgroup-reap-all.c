@@ -17,10 +17,9 @@
  *     Ted Gould <ted.gould@canonical.com>
  */
 
-#include "helpers.h"
+#include <unistd.h>
 
-int kill (pid_t pid, int signal);
-pid_t getpgid (pid_t);
+#include "helpers.h"
 
 int
 main (int argc, char * argv[])
@@ -31,33 +30,7 @@ main (int argc, char * argv[])
 	GDBusConnection * cgmanager = cgroup_manager_connection();
 	g_return_val_if_fail(cgmanager != NULL, -1);
 
-	GPid selfpid = getpid();
-	GPid parentpid = getppid();
-
-	/* We're gonna try to kill things forever, literally. It's important
-	   enough that we can't consider failure an option. */
-	gboolean killed = TRUE;
-	while (killed) {
-		GList * pidlist = pids_from_cgroup(cgmanager, NULL, NULL);
-		GList * head;
-
-		killed = FALSE;
-
-		for (head = pidlist; head != NULL; head = g_list_next(head)) {
-			GPid pid = GPOINTER_TO_INT(head->data);
-
-			/* We don't want to kill ourselves, or if we're being executed by
-			   a script, that script, either. We also don't want things in our
-			   process group which we forked at the opening */
-			if (pid != selfpid && pid != parentpid && getpgid(pid) != selfpid) {
-				g_debug("Killing pid: %d", pid);
-				kill(pid, SIGKILL);
-				killed = TRUE;
-			}
-		}
-
-		g_list_free(pidlist);
-	}
+	cgroup_reap_all(cgmanager);
 
 	cgroup_manager_unref(cgmanager);
 
@@ -45,10 +45,14 @@ You should not modify them and expect any executing under Unity to change.
 #include <gio/gio.h>
 #include <glib/gstdio.h>
 #include <click.h>
+#include <dirent.h>
+#include <fcntl.h>
 #include <string.h>
 #include <errno.h>
+#include <sys/stat.h>
 
 #include "helpers.h"
+#include "libubuntu-app-launch/recoverable-problem.h"
 
 typedef struct _app_state_t app_state_t;
 struct _app_state_t {
@@ -57,6 +61,12 @@ struct _app_state_t {
 	gboolean has_desktop;
 	guint64 click_modified;
 	guint64 desktop_modified;
+	/* The click desktop file ours was built from, as far as we know */
+	gchar * source;
+	/* Hashes of the source and of what we made from it the last time
+	   we built it, if we remember */
+	gchar * source_hash;
+	gchar * output_hash;
 };
 
 /* Desktop Group */
@@ -71,55 +81,62 @@ struct _app_state_t {
 /* Other */
 #define OLD_KEY_PREFIX     "X-Ubuntu-Old-"
 
-/* Find an entry in the app array */
-app_state_t *
-find_app_entry (const gchar * name, GArray * app_array)
+/* The state file remembers when we last went through everything, which
+   click desktop file each of the desktop files came from and the hashes
+   of both. Entries that haven't changed since then, and whose source is
+   still there, don't need their desktop files read again. When a click
+   is updated and the hashes say nothing changed, the desktop file isn't
+   rewritten, which would wake up everything watching the directory. */
+#define STATE_FILE         "desktop-hook-state"
+/* Filesystem times can lag the clock a little, so anything from just
+   before we started gets looked at again next time */
+#define GENERATION_SLACK_NS G_GUINT64_CONSTANT(1000000000)
+#define STATE_HASH         G_CHECKSUM_SHA256
+
+static void
+app_state_free (gpointer data)
 {
-	int i;
-	for (i = 0; i < app_array->len; i++) {
-		app_state_t * state = &g_array_index(app_array, app_state_t, i);
+	app_state_t * state = (app_state_t *)data;
+	g_free(state->app_id);
+	g_free(state->source);
+	g_free(state->source_hash);
+	g_free(state->output_hash);
+	g_free(state);
+}
 
-		if (g_strcmp0(state->app_id, name) == 0) {
-			return state;
-		}
+/* Find an entry in the app table, adding it if it isn't there */
+app_state_t *
+find_app_entry (const gchar * name, GHashTable * app_table)
+{
+	app_state_t * state = g_hash_table_lookup(app_table, name);
+	if (state != NULL) {
+		return state;
 	}
 
-	app_state_t newstate;
-	newstate.has_click = FALSE;
-	newstate.has_desktop = FALSE;
-	newstate.click_modified = 0;
-	newstate.desktop_modified = 0;
-	newstate.app_id = g_strdup(name);
-
-	g_array_append_val(app_array, newstate);
+	state = g_new0(app_state_t, 1);
+	state->app_id = g_strdup(name);
 
-	/* Note: The pointer needs to be the entry in the array, not the
-	   one that we have on the stack.  Criticaly important. */
-	app_state_t * statepntr = &g_array_index(app_array, app_state_t, app_array->len - 1);
-	return statepntr;
+	/* The key is owned by the entry */
+	g_hash_table_insert(app_table, state->app_id, state);
+	return state;
 }
 
-/* Looks up the file creation time, which seems harder with GLib
-   than it should be */
+/* Looks up the modification time of a directory entry, without following
+   it if it's a symbolic link, in nanoseconds */
 guint64
-modified_time (const gchar * dir, const gchar * filename)
+modified_time (int dirfd, const gchar * filename)
 {
-	gchar * path = g_build_filename(dir, filename, NULL);
-	GFile * file = g_file_new_for_path(path);
-	GFileInfo * info = g_file_query_info(file, G_FILE_ATTRIBUTE_TIME_MODIFIED, G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS, NULL, NULL);
-
-	guint64 time = g_file_info_get_attribute_uint64(info, G_FILE_ATTRIBUTE_TIME_MODIFIED);
-
-	g_object_unref(info);
-	g_object_unref(file);
-	g_free(path);
+	struct stat info;
+	if (fstatat(dirfd, filename, &info, AT_SYMLINK_NOFOLLOW) != 0) {
+		return 0;
+	}
 
-	return time;
+	return (guint64)info.st_mtim.tv_sec * G_GUINT64_CONSTANT(1000000000) + info.st_mtim.tv_nsec;
 }
 
 /* Look at an click package entry */
 void
-add_click_package (const gchar * dir, const gchar * name, GArray * app_array)
+add_click_package (const gchar * dir, int dirfd, const gchar * name, GHashTable * app_table)
 {
 	if (!g_str_has_suffix(name, ".desktop")) {
 		return;
@@ -128,9 +145,9 @@ add_click_package (const gchar * dir, const gchar * name, GArray * app_array)
 	gchar * appid = g_strdup(name);
 	g_strstr_len(appid, -1, ".desktop")[0] = '\0';
 
-	app_state_t * state = find_app_entry(appid, app_array);
+	app_state_t * state = find_app_entry(appid, app_table);
 	state->has_click = TRUE;
-	state->click_modified = modified_time(dir, name);
+	state->click_modified = modified_time(dirfd, name);
 
 	g_free(appid);
 
@@ -138,9 +155,10 @@ add_click_package (const gchar * dir, const gchar * name, GArray * app_array)
 }
 
 /* Look at the desktop file and ensure that it was built by us, and if it
-   was that its source still exists */
+   was that its source still exists. The source is returned in @source
+   when there is one. */
 gboolean
-desktop_source_exists (const gchar * dir, const gchar * name)
+desktop_source_exists (const gchar * dir, const gchar * name, gchar ** source)
 {
 	gchar * desktopfile = g_build_filename(dir, name, NULL);
 
@@ -168,36 +186,39 @@ desktop_source_exists (const gchar * dir, const gchar * name)
 		found = FALSE;
 	}
 
-	g_free(originalfile);
+	if (found && source != NULL) {
+		*source = originalfile;
+	} else {
+		g_free(originalfile);
+	}
 	g_free(desktopfile);
 
 	return found;
 }
 
-/* Look at an desktop file entry */
+/* Look at an desktop file entry. Whether it is still good is checked
+   when the entries are processed, as most won't need to be. */
 void
-add_desktop_file (const gchar * dir, const gchar * name, GArray * app_array)
+add_desktop_file (const gchar * dir, int dirfd, const gchar * name, GHashTable * app_table)
 {
 	if (!g_str_has_suffix(name, ".desktop")) {
 		return;
 	}
 
-	if (!desktop_source_exists(dir, name)) {
-		return;
-	}
-
 	gchar * appid = g_strdup(name);
 	g_strstr_len(appid, -1, ".desktop")[0] = '\0';
 
 	/* We only want valid APP IDs as desktop files */
 	if (!app_id_to_triplet(appid, NULL, NULL, NULL)) {
+		/* Still clean up after ourselves if we made it */
+		desktop_source_exists(dir, name, NULL);
 		g_free(appid);
 		return;
 	}
 
-	app_state_t * state = find_app_entry(appid, app_array);
+	app_state_t * state = find_app_entry(appid, app_table);
 	state->has_desktop = TRUE;
-	state->desktop_modified = modified_time(dir, name);
+	state->desktop_modified = modified_time(dirfd, name);
 
 	g_free(appid);
 	return;
@@ -205,156 +226,147 @@ add_desktop_file (const gchar * dir, const gchar * name, GArray * app_array)
 
 /* Open a directory and look at all the entries */
 void
-dir_for_each (const gchar * dirname, void(*func)(const gchar * dir, const gchar * name, GArray * app_array), GArray * app_array)
+dir_for_each (const gchar * dirname, void(*func)(const gchar * dir, int dirfd, const gchar * name, GHashTable * app_table), GHashTable * app_table)
 {
-	GError * error = NULL;
-	GDir * directory = g_dir_open(dirname, 0, &error);
+	DIR * directory = opendir(dirname);
 
-	if (error != NULL) {
-		g_warning("Unable to read directory '%s': %s", dirname, error->message);
-		g_error_free(error);
+	if (directory == NULL) {
+		g_warning("Unable to read directory '%s': %s", dirname, g_strerror(errno));
 		return;
 	}
 
-	const gchar * filename = NULL;
-	while ((filename = g_dir_read_name(directory)) != NULL) {
-		func(dirname, filename, app_array);
+	struct dirent * entry;
+	while ((entry = readdir(directory)) != NULL) {
+		if (g_strcmp0(entry->d_name, ".") == 0 || g_strcmp0(entry->d_name, "..") == 0) {
+			continue;
+		}
+
+		func(dirname, dirfd(directory), entry->d_name, app_table);
 	}
 
-	g_dir_close(directory);
+	closedir(directory);
 	return;
 }
 
-/* Helpers to ensure we write nicely */
-static void 
-write_string (int          fd,
-              const gchar *string)
+/* Reads the state file into the app table, returning the generation it
+   was written with or zero if there isn't one we can use */
+static guint64
+state_read (const gchar * statefile, GHashTable * app_table)
 {
-	int res; 
-	do
-		res = write (fd, string, strlen (string));
-	while (G_UNLIKELY (res == -1 && errno == EINTR));
-}
+	gchar * contents = NULL;
+	if (!g_file_get_contents(statefile, &contents, NULL, NULL)) {
+		return 0;
+	}
 
-/* Make NULLs fast and fun! */
-static void 
-write_null (int fd)
-{
-	int res; 
-	do
-		res = write (fd, "", 1);
-	while (G_UNLIKELY (res == -1 && errno == EINTR));
-}
+	gchar ** lines = g_strsplit(contents, "\n", -1);
+	g_free(contents);
 
-/* Child watcher */
-static gboolean
-apport_child_watch (GPid pid, gint status, gpointer user_data)
-{
-	g_main_loop_quit((GMainLoop *)user_data);
-	return FALSE;
-}
+	gchar * end = NULL;
+	guint64 generation = lines[0] != NULL ? g_ascii_strtoull(lines[0], &end, 10) : 0;
+	if (end == NULL || *end != '\0') {
+		g_debug("State file '%s' isn't usable", statefile);
+		g_strfreev(lines);
+		return 0;
+	}
 
-static gboolean
-apport_child_timeout (gpointer user_data)
-{
-	g_warning("Recoverable Error Reporter Timeout");
-	g_main_loop_quit((GMainLoop *)user_data);
-	return FALSE;
-}
+	int i;
+	for (i = 1; lines[0] != NULL && lines[i] != NULL; i++) {
+		/* App ID, source, source hash, output hash */
+		gchar ** fields = g_strsplit(lines[i], "\t", 4);
+		if (g_strv_length(fields) != 4) {
+			g_strfreev(fields);
+			continue;
+		}
+
+		/* Only apps we've still got are interesting */
+		app_state_t * state = g_hash_table_lookup(app_table, fields[0]);
+		if (state != NULL && state->source == NULL) {
+			state->source = g_strdup(fields[1]);
+			state->source_hash = fields[2][0] != '\0' ? g_strdup(fields[2]) : NULL;
+			state->output_hash = fields[3][0] != '\0' ? g_strdup(fields[3]) : NULL;
+		}
 
+		g_strfreev(fields);
+	}
 
-/* Code to report an error, so we can start tracking how important this is */
+	g_strfreev(lines);
+	return generation;
+}
+
+/* Saves the generation, where each of the desktop files came from and
+   their hashes */
 static void
-report_recoverable_error (const gchar * app_id, const gchar * iconfield, const gchar * originalicon, const gchar * iconpath)
+state_write (const gchar * statefile, guint64 generation, GHashTable * app_table)
 {
-	GError * error = NULL;
-	gint error_stdin = 0;
-	GPid pid = 0;
-	gchar * argv[2] = {
-		"/usr/share/apport/recoverable_problem",
-		NULL
-	};
+	GString * contents = g_string_new(NULL);
+	g_string_append_printf(contents, "%" G_GUINT64_FORMAT "\n", generation);
+
+	GHashTableIter iter;
+	gpointer value;
+	g_hash_table_iter_init(&iter, app_table);
+	while (g_hash_table_iter_next(&iter, NULL, &value)) {
+		app_state_t * state = (app_state_t *)value;
+		if (!state->has_click || !state->has_desktop || state->source == NULL) {
+			continue;
+		}
+		/* We can't store these, they'll just get checked every time */
+		if (strpbrk(state->source, "\t\n") != NULL) {
+			continue;
+		}
 
-	g_spawn_async_with_pipes(NULL, /* cwd */
-		argv,
-		NULL, /* envp */
-		G_SPAWN_STDOUT_TO_DEV_NULL | G_SPAWN_STDERR_TO_DEV_NULL | G_SPAWN_DO_NOT_REAP_CHILD,
-		NULL, NULL, /* child setup func */
-		&pid,
-		&error_stdin,
-		NULL, /* stdout */
-		NULL, /* stderr */
-		&error);
+		g_string_append_printf(contents, "%s\t%s\t%s\t%s\n",
+			state->app_id,
+			state->source,
+			state->source_hash != NULL ? state->source_hash : "",
+			state->output_hash != NULL ? state->output_hash : "");
+	}
 
+	GError * error = NULL;
+	g_file_set_contents(statefile, contents->str, contents->len, &error);
 	if (error != NULL) {
-		g_warning("Unable to report a recoverable error: %s", error->message);
+		g_warning("Unable to write state file '%s': %s", statefile, error->message);
 		g_error_free(error);
 	}
 
-	if (error_stdin != 0) {
-		write_string(error_stdin, "IconValue");
-		write_null(error_stdin);
-		write_string(error_stdin, originalicon);
-		write_null(error_stdin);
-
-		write_string(error_stdin, "AppID");
-		write_null(error_stdin);
-		write_string(error_stdin, app_id);
-		write_null(error_stdin);
-
-		write_string(error_stdin, "IconPath");
-		write_null(error_stdin);
-		write_string(error_stdin, iconpath);
-		write_null(error_stdin);
-
-		write_string(error_stdin, "IconField");
-		write_null(error_stdin);
-		write_string(error_stdin, iconfield);
-		write_null(error_stdin);
-
-		write_string(error_stdin, "DuplicateSignature");
-		write_null(error_stdin);
-		write_string(error_stdin, "icon-path-unhandled");
-		/* write_null(error_stdin); -- No final NULL */
-
-		close(error_stdin);
-	}
-
-	if (pid != 0) {
-		GSource * child_source, * timeout_source;
-		GMainContext * context = g_main_context_new();
-		GMainLoop * loop = g_main_loop_new(context, FALSE);
-
-		child_source = g_child_watch_source_new(pid);
-		g_source_attach(child_source, context);
-		g_source_set_callback(child_source, (GSourceFunc)apport_child_watch, loop, NULL);
-
-		timeout_source = g_timeout_source_new_seconds(5);
-		g_source_attach(timeout_source, context);
-		g_source_set_callback(timeout_source, apport_child_timeout, loop, NULL);
-
-		g_main_loop_run(loop);
+	g_string_free(contents, TRUE);
+}
 
-		g_source_destroy(timeout_source);
-		g_source_destroy(child_source);
-		g_main_loop_unref(loop);
-		g_main_context_unref(context);
+/* Whether we can believe what we found out about an app last time */
+static gboolean
+app_unchanged (app_state_t * state, guint64 generation)
+{
+	return state->has_click && state->has_desktop &&
+		state->click_modified < generation && state->desktop_modified < generation &&
+		state->source != NULL && g_file_test(state->source, G_FILE_TEST_EXISTS);
+}
 
-		g_spawn_close_pid(pid);
-	}
+/* Code to report an error, so we can start tracking how important this is.
+   They're queued and all sent when we're done. */
+static void
+report_recoverable_error (const gchar * app_id, const gchar * iconfield, const gchar * originalicon, const gchar * iconpath)
+{
+	const gchar * properties[] = {
+		"IconValue", originalicon,
+		"AppID", app_id,
+		"IconPath", iconpath,
+		"IconField", iconfield,
+		NULL
+	};
 
-	return;
+	report_recoverable_problem("icon-path-unhandled", 0, properties);
 }
 
-/* Function to take the source Desktop file and build a new
-   one with similar, but not the same data in it */
-static void
-copy_desktop_file (const gchar * from, const gchar * to, const gchar * appdir, const gchar * app_id)
+/* Function to take the source Desktop file, already read in from
+   @from, and build a new one with similar, but not the same data in
+   it. Returns the new one, or NULL if it can't be built. */
+static gchar *
+transform_desktop_file (const gchar * from, const gchar * source, gsize sourcelen, const gchar * appdir, const gchar * app_id, gsize * outlen)
 {
 	GError * error = NULL;
 	GKeyFile * keyfile = g_key_file_new();
-	g_key_file_load_from_file(keyfile,
-		from,
+	g_key_file_load_from_data(keyfile,
+		source,
+		sourcelen,
 		G_KEY_FILE_KEEP_COMMENTS | G_KEY_FILE_KEEP_TRANSLATIONS,
 		&error);
 
@@ -362,7 +374,7 @@ copy_desktop_file (const gchar * from, const gchar * to, const gchar * appdir, c
 		g_warning("Unable to read the desktop file '%s' in the application directory: %s", from, error->message);
 		g_error_free(error);
 		g_key_file_unref(keyfile);
-		return;
+		return NULL;
 	}
 
 	/* Path Hanlding */
@@ -423,7 +435,7 @@ copy_desktop_file (const gchar * from, const gchar * to, const gchar * appdir, c
 	gchar * oldexec = desktop_to_exec(keyfile, from);
 	if (oldexec == NULL) {
 		g_key_file_unref(keyfile);
-		return;
+		return NULL;
 	}
 
 	gchar * newexec = g_strdup_printf("aa-exec-click -p %s -- %s", app_id, oldexec);
@@ -438,37 +450,50 @@ copy_desktop_file (const gchar * from, const gchar * to, const gchar * appdir, c
 	g_key_file_set_string(keyfile, DESKTOP_GROUP, SOURCE_FILE_KEY, from);
 
 	/* Output */
-	gsize datalen = 0;
-	gchar * data = g_key_file_to_data(keyfile, &datalen, &error);
+	gchar * data = g_key_file_to_data(keyfile, outlen, &error);
 	g_key_file_unref(keyfile);
 
 	if (error != NULL) {
 		g_warning("Unable serialize keyfile built from '%s': %s", from, error->message);
 		g_error_free(error);
-		return;
+		return NULL;
 	}
 
-	g_file_set_contents(to, data, datalen, &error);
-	g_free(data);
+	return data;
+}
+
+/* What all of the builds need to know, they run on a thread pool */
+typedef struct {
+	const gchar * desktopdir;
+	guint64 generation;
+} build_context_t;
 
-	if (error != NULL) {
-		g_warning("Unable to write out desktop file to '%s': %s", to, error->message);
-		g_error_free(error);
-		return;
+/* Whether the file at @path already has exactly @data in it */
+static gboolean
+file_has_contents (const gchar * path, const gchar * data, gsize datalen)
+{
+	gchar * current = NULL;
+	gsize currentlen = 0;
+	if (!g_file_get_contents(path, &current, &currentlen, NULL)) {
+		return FALSE;
 	}
 
-	return;
+	gboolean same = currentlen == datalen && memcmp(current, data, datalen) == 0;
+	g_free(current);
+	return same;
 }
 
-/* Build a desktop file in the user's home directory */
-static void
-build_desktop_file (app_state_t * state, const gchar * symlinkdir, const gchar * desktopdir)
+/* Build a desktop file in the user's home directory, leaving the one
+   that is there alone if it wouldn't change. Returns whether the
+   desktop file is there and up to date. */
+static gboolean
+build_desktop_file (app_state_t * state, const build_context_t * context)
 {
 	GError * error = NULL;
 	gchar * package = NULL;
 	/* 'Parse' the App ID */
 	if (!app_id_to_triplet(state->app_id, &package, NULL, NULL)) {
-		return;
+		return FALSE;
 	}
 
 	/* Read in the database */
@@ -479,7 +504,7 @@ build_desktop_file (app_state_t * state, const gchar * symlinkdir, const gchar *
 		g_error_free(error);
 		g_free(package);
 		g_object_unref(db);
-		return;
+		return FALSE;
 	}
 
 	/* Check click to find out where the files are */
@@ -489,7 +514,7 @@ build_desktop_file (app_state_t * state, const gchar * symlinkdir, const gchar *
 		g_warning("Unable to read Click database: %s", error->message);
 		g_error_free(error);
 		g_free(package);
-		return;
+		return FALSE;
 	}
 
 	gchar * pkgdir = click_user_get_path(user, package, &error);
@@ -497,7 +522,7 @@ build_desktop_file (app_state_t * state, const gchar * symlinkdir, const gchar *
 		g_warning("Unable to get the Click package directory for %s: %s", package, error->message);
 		g_error_free(error);
 		g_free(package);
-		return;
+		return FALSE;
 	}
 	g_object_unref(user);
 	g_free(package);
@@ -505,32 +530,95 @@ build_desktop_file (app_state_t * state, const gchar * symlinkdir, const gchar *
 	if (!g_file_test(pkgdir, G_FILE_TEST_EXISTS | G_FILE_TEST_IS_DIR)) {
 		g_warning("Directory returned by click '%s' couldn't be found", pkgdir);
 		g_free(pkgdir);
-		return;
+		return FALSE;
 	}
 
 	gchar * indesktop = manifest_to_desktop(pkgdir, state->app_id);
 	if (indesktop == NULL) {
 		g_free(pkgdir);
-		return;
+		return FALSE;
+	}
+
+	gchar * source = NULL;
+	gsize sourcelen = 0;
+	g_file_get_contents(indesktop, &source, &sourcelen, &error);
+	if (error != NULL) {
+		g_warning("Unable to read the desktop file '%s' in the application directory: %s", indesktop, error->message);
+		g_error_free(error);
+		g_free(indesktop);
+		g_free(pkgdir);
+		return FALSE;
 	}
 
 	/* Determine the desktop file name */
 	gchar * desktopfile = g_strdup_printf("%s.desktop", state->app_id);
-	gchar * desktoppath = g_build_filename(desktopdir, desktopfile, NULL);
+	gchar * desktoppath = g_build_filename(context->desktopdir, desktopfile, NULL);
 	g_free(desktopfile);
 
-	copy_desktop_file(indesktop, desktoppath, pkgdir, state->app_id);
+	gchar * sourcehash = g_compute_checksum_for_data(STATE_HASH, (const guchar *)source, sourcelen);
+	gchar * outputhash = NULL;
+	gboolean built = FALSE;
+
+	/* Nobody has touched the desktop file since we made it */
+	gboolean desktopours = state->has_desktop && state->output_hash != NULL && state->desktop_modified < context->generation;
+
+	if (desktopours && g_strcmp0(state->source, indesktop) == 0 && g_strcmp0(state->source_hash, sourcehash) == 0) {
+		g_debug("\tSource unchanged for: %s", state->app_id);
+		outputhash = g_strdup(state->output_hash);
+		built = TRUE;
+	} else {
+		gsize outputlen = 0;
+		gchar * output = transform_desktop_file(indesktop, source, sourcelen, pkgdir, state->app_id, &outputlen);
+
+		if (output != NULL) {
+			outputhash = g_compute_checksum_for_data(STATE_HASH, (const guchar *)output, outputlen);
+
+			if ((desktopours && g_strcmp0(state->output_hash, outputhash) == 0) ||
+					(state->has_desktop && file_has_contents(desktoppath, output, outputlen))) {
+				g_debug("\tDesktop file unchanged for: %s", state->app_id);
+				built = TRUE;
+			} else {
+				/* Written to a temporary file and renamed over the old one,
+				   so watchers see a single change */
+				g_file_set_contents(desktoppath, output, outputlen, &error);
+
+				if (error != NULL) {
+					g_warning("Unable to write out desktop file to '%s': %s", desktoppath, error->message);
+					g_error_free(error);
+				} else {
+					built = TRUE;
+				}
+			}
+
+			g_free(output);
+		}
+	}
+
+	if (built) {
+		state->has_desktop = TRUE;
+
+		g_free(state->source);
+		state->source = indesktop;
+		g_free(state->source_hash);
+		state->source_hash = sourcehash;
+		g_free(state->output_hash);
+		state->output_hash = outputhash;
+	} else {
+		g_free(indesktop);
+		g_free(sourcehash);
+		g_free(outputhash);
+	}
 
+	g_free(source);
 	g_free(desktoppath);
-	g_free(indesktop);
 	g_free(pkgdir);
 
-	return;
+	return built;
 }
 
-/* Remove the desktop file from the user's home directory */
+/* Check the desktop file in the user's home directory is one we made */
 static gboolean
-remove_desktop_file (app_state_t * state, const gchar * desktopdir)
+desktop_file_ours (app_state_t * state, const gchar * desktopdir)
 {
 	gchar * desktopfile = g_strdup_printf("%s.desktop", state->app_id);
 	gchar * desktoppath = g_build_filename(desktopdir, desktopfile, NULL);
@@ -542,13 +630,28 @@ remove_desktop_file (app_state_t * state, const gchar * desktopdir)
 		G_KEY_FILE_NONE,
 		NULL);
 
-	if (!g_key_file_has_key(keyfile, DESKTOP_GROUP, APP_ID_KEY, NULL)) {
+	gboolean ours = g_key_file_has_key(keyfile, DESKTOP_GROUP, APP_ID_KEY, NULL);
+	if (!ours) {
 		g_debug("Desktop file '%s' is not one created by us.", desktoppath);
-		g_key_file_unref(keyfile);
-		g_free(desktoppath);
-		return FALSE;
 	}
+
 	g_key_file_unref(keyfile);
+	g_free(desktoppath);
+
+	return ours;
+}
+
+/* Remove the desktop file from the user's home directory */
+static gboolean
+remove_desktop_file (app_state_t * state, const gchar * desktopdir)
+{
+	if (!desktop_file_ours(state, desktopdir)) {
+		return FALSE;
+	}
+
+	gchar * desktopfile = g_strdup_printf("%s.desktop", state->app_id);
+	gchar * desktoppath = g_build_filename(desktopdir, desktopfile, NULL);
+	g_free(desktopfile);
 
 	if (g_unlink(desktoppath) != 0) {
 		g_warning("Unable to delete desktop file: %s", desktoppath);
@@ -559,6 +662,27 @@ remove_desktop_file (app_state_t * state, const gchar * desktopdir)
 	return TRUE;
 }
 
+/* Runs on the thread pool, each app is independent of the others */
+static void
+build_desktop_file_thread (gpointer data, gpointer user_data)
+{
+	app_state_t * state = (app_state_t *)data;
+	const build_context_t * context = (const build_context_t *)user_data;
+
+	g_debug("Building desktop file: %s", state->app_id);
+	if (build_desktop_file(state, context)) {
+		return;
+	}
+
+	/* It was going to be replaced, and it can't be */
+	if (state->has_desktop) {
+		g_debug("Removing desktop file: %s", state->app_id);
+		remove_desktop_file(state, context->desktopdir);
+		state->has_desktop = FALSE;
+		g_clear_pointer(&state->source, g_free);
+	}
+}
+
 /* The main function */
 int
 main (int argc, char * argv[])
@@ -568,14 +692,16 @@ main (int argc, char * argv[])
 		return 1;
 	}
 
-	GArray * apparray = g_array_new(FALSE, FALSE, sizeof(app_state_t));
+	GHashTable * apptable = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, app_state_free);
+	/* Anything that changes from here on gets looked at next time */
+	guint64 nextgeneration = (guint64)g_get_real_time() * 1000 - GENERATION_SLACK_NS;
 
 	/* Find all the symlinks of desktop files */
 	gchar * symlinkdir = g_build_filename(g_get_user_cache_dir(), "ubuntu-app-launch", "desktop", NULL);
 	if (!g_file_test(symlinkdir, G_FILE_TEST_EXISTS | G_FILE_TEST_IS_DIR)) {
 		g_debug("No installed click packages");
 	} else {
-		dir_for_each(symlinkdir, add_click_package, apparray);
+		dir_for_each(symlinkdir, add_click_package, apptable);
 	}
 
 	/* Find all the click desktop files */
@@ -584,23 +710,49 @@ main (int argc, char * argv[])
 	if (!g_file_test(desktopdir, G_FILE_TEST_EXISTS | G_FILE_TEST_IS_DIR)) {
 		g_debug("No applications defined");
 	} else {
-		dir_for_each(desktopdir, add_desktop_file, apparray);
+		dir_for_each(desktopdir, add_desktop_file, apptable);
 		desktopdirexists = TRUE;
 	}
 
-	/* Process the merge */
-	int i;
-	for (i = 0; i < apparray->len; i++) {
-		app_state_t * state = &g_array_index(apparray, app_state_t, i);
+	/* What we knew last time */
+	gchar * statefile = g_build_filename(g_get_user_cache_dir(), "ubuntu-app-launch", STATE_FILE, NULL);
+	guint64 generation = state_read(statefile, apptable);
+
+	/* Process the merge, the builds are collected up to run together */
+	GPtrArray * builds = g_ptr_array_new();
+	GHashTableIter iter;
+	gpointer value;
+	g_hash_table_iter_init(&iter, apptable);
+	while (g_hash_table_iter_next(&iter, NULL, &value)) {
+		app_state_t * state = (app_state_t *)value;
 		g_debug("Processing App ID: %s", state->app_id);
 
+		if (app_unchanged(state, generation)) {
+			g_debug("\tUnchanged since last time");
+			continue;
+		}
+
+		if (state->has_desktop) {
+			gchar * desktopfile = g_strdup_printf("%s.desktop", state->app_id);
+			gchar * recorded = state->source;
+			state->source = NULL;
+			state->has_desktop = desktop_source_exists(desktopdir, desktopfile, &state->source);
+			g_free(desktopfile);
+
+			/* The hashes are only for the source they were made from */
+			if (g_strcmp0(recorded, state->source) != 0) {
+				g_clear_pointer(&state->source_hash, g_free);
+				g_clear_pointer(&state->output_hash, g_free);
+			}
+			g_free(recorded);
+		}
+
 		if (state->has_click && state->has_desktop) {
 			if (state->click_modified > state->desktop_modified) {
 				g_debug("\tClick updated more recently");
-				g_debug("\tRemoving desktop file");
-				if (remove_desktop_file(state, desktopdir)) {
-					g_debug("\tBuilding desktop file");
-					build_desktop_file(state, symlinkdir, desktopdir);
+				/* Replaced in place, not removed and made again */
+				if (desktop_file_ours(state, desktopdir)) {
+					g_ptr_array_add(builds, state);
 				}
 			} else {
 				g_debug("\tAlready synchronized");
@@ -615,20 +767,45 @@ main (int argc, char * argv[])
 				}
 			}
 			if (desktopdirexists) {
-				g_debug("\tBuilding desktop file");
-				build_desktop_file(state, symlinkdir, desktopdir);
+				g_ptr_array_add(builds, state);
 			}
 		} else if (state->has_desktop) {
 			g_debug("\tRemoving desktop file");
 			remove_desktop_file(state, desktopdir);
 		}
+	}
 
-		g_free(state->app_id);
+	/* Each app only touches its own files and state */
+	if (builds->len > 0) {
+		build_context_t context = {
+			.desktopdir = desktopdir,
+			.generation = generation,
+		};
+
+		GThreadPool * pool = g_thread_pool_new(build_desktop_file_thread, &context, g_get_num_processors(), FALSE, NULL);
+		guint i;
+		for (i = 0; i < builds->len; i++) {
+			g_thread_pool_push(pool, g_ptr_array_index(builds, i), NULL);
+		}
+		/* Waits for all of them to finish */
+		g_thread_pool_free(pool, FALSE, TRUE);
 	}
+	g_ptr_array_free(builds, TRUE);
 
-	g_array_free(apparray, TRUE);
+	/* Without the cache directory there's no link farm, so nothing to
+	   remember either */
+	if (g_file_test(symlinkdir, G_FILE_TEST_IS_DIR)) {
+		state_write(statefile, nextgeneration, apptable);
+	}
+
+	g_hash_table_destroy(apptable);
+	g_free(statefile);
 	g_free(desktopdir);
 	g_free(symlinkdir);
 
+	/* Whatever went wrong, in one reporter that we only wait on to
+	   take them */
+	recoverable_problem_flush();
+
 	return 0;
 }
@@ -17,16 +17,192 @@
  *     Ted Gould <ted.gould@canonical.com>
  */
 
+#define _GNU_SOURCE
+
 #include <unistd.h>
 #include <errno.h>
+#include <signal.h>
+#include <stdio.h>
 #include <string.h>
+#include <sys/wait.h>
 
 #include <glib.h>
 #include <glib/gstdio.h>
 
 #include "exec-line-exec-trace.h"
+#include "exec-plan.h"
 #include "helpers.h"
 #include "ual-tracepoint.h"
+#include "zygote.h"
+
+/* Set once the zygote has started the application so that signals
+   from Upstart can be passed on to it */
+static pid_t zygote_child = 0;
+
+static void
+zygote_forward_signal (int signal)
+{
+	if (zygote_child > 0)
+		kill(zygote_child, signal);
+}
+
+static void
+zygote_append_string (GByteArray * request, const gchar * string)
+{
+	g_byte_array_append(request, (const guint8 *)string, strlen(string) + 1);
+}
+
+/* Asks the zygote to start the application from its copy of the
+   toolkit libraries, which are already loaded. If it does, we wait for
+   the application to exit and then exit the same way, so to Upstart it
+   looks like we're the application. Returns if the zygote isn't running
+   or can't start it so that we can exec it like usual. */
+static void
+zygote_exec (const gchar * library, gchar ** nargv, const gchar * appdir, const gchar * app_id)
+{
+	int sock = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+	struct sockaddr_un address;
+	socklen_t addresslen = zygote_address(&address);
+	if (sock < 0 || connect(sock, (struct sockaddr *)&address, addresslen) != 0) {
+		g_debug("Zygote isn't available: %s", strerror(errno));
+		if (sock >= 0)
+			close(sock);
+		return;
+	}
+
+	/* Anyone can bind an abstract socket name, make sure it's our own
+	   zygote before we hand it our environment and file descriptors */
+	struct ucred cred;
+	socklen_t credsize = sizeof(cred);
+	if (getsockopt(sock, SOL_SOCKET, SO_PEERCRED, &cred, &credsize) != 0 || cred.uid != getuid()) {
+		g_warning("Zygote socket isn't owned by us, not using it");
+		close(sock);
+		return;
+	}
+
+	/* A confined application of ours could have taken the name before
+	   the zygote did, only the unconfined zygote gets to start it */
+	char * label = NULL;
+	if (zygote_peer_label(sock, cred.pid, &label) != 0 || (label != NULL && g_strcmp0(label, "unconfined") != 0)) {
+		g_warning("Zygote socket is held by '%s', not using it", label != NULL ? label : "unknown");
+		free(label);
+		close(sock);
+		return;
+	}
+	free(label);
+
+	gchar * libpath = NULL;
+	if (g_path_is_absolute(library) || appdir == NULL)
+		libpath = g_strdup(library);
+	else
+		libpath = g_build_filename(appdir, library, NULL);
+	gchar * cwd = g_get_current_dir();
+	gchar ** env = g_get_environ();
+
+	zygote_request_t header = {
+		.argc = g_strv_length(nargv),
+		.envc = g_strv_length(env)
+	};
+
+	GByteArray * request = g_byte_array_new();
+	g_byte_array_append(request, (const guint8 *)&header, sizeof(header));
+	zygote_append_string(request, libpath);
+	zygote_append_string(request, cwd);
+	guint i;
+	for (i = 0; i < header.argc; i++)
+		zygote_append_string(request, nargv[i]);
+	for (i = 0; i < header.envc; i++)
+		zygote_append_string(request, env[i]);
+
+	g_free(libpath);
+	g_free(cwd);
+	g_strfreev(env);
+
+	/* Our stdin, stdout and stderr so the application logs to the
+	   same place as we do */
+	int fds[3] = { 0, 1, 2 };
+	char control[CMSG_SPACE(sizeof(fds))];
+	memset(control, 0, sizeof(control));
+	struct iovec iov = { .iov_base = request->data, .iov_len = request->len };
+	struct msghdr message = {
+		.msg_iov = &iov,
+		.msg_iovlen = 1,
+		.msg_control = control,
+		.msg_controllen = sizeof(control)
+	};
+	struct cmsghdr * cmsg = CMSG_FIRSTHDR(&message);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+	memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+	ssize_t sent = sendmsg(sock, &message, MSG_NOSIGNAL);
+	g_byte_array_unref(request);
+
+	/* The zygote always answers before it runs any of the application,
+	   so either it started it or we can still start it ourselves */
+	zygote_reply_t reply = { 0 };
+	if (sent < 0 || recv(sock, &reply, sizeof(reply), 0) != sizeof(reply) || reply.type != ZYGOTE_STARTED) {
+		g_warning("Zygote was unable to start '%s': %s", app_id,
+			reply.type == ZYGOTE_FAILED ? strerror(reply.value) : strerror(errno));
+		close(sock);
+		return;
+	}
+
+	zygote_child = reply.value;
+	ual_tracepoint(exec_zygote_started, app_id);
+
+	struct sigaction forward = { 0 };
+	forward.sa_handler = zygote_forward_signal;
+	forward.sa_flags = SA_RESTART;
+	int forwarded[] = { SIGTERM, SIGINT, SIGHUP, SIGQUIT, SIGUSR1, SIGUSR2 };
+	for (i = 0; i < G_N_ELEMENTS(forwarded); i++)
+		sigaction(forwarded[i], &forward, NULL);
+
+	while (TRUE) {
+		ssize_t length = recv(sock, &reply, sizeof(reply), 0);
+		if (length < 0 && errno == EINTR)
+			continue;
+
+		if (length != sizeof(reply)) {
+			/* The application is still in our cgroup, it'll get
+			   cleaned up with the job */
+			g_warning("Lost the zygote while '%s' was running", app_id);
+			exit(1);
+		}
+
+		if (reply.type == ZYGOTE_EXITED)
+			break;
+	}
+
+	close(sock);
+
+	if (WIFSIGNALED(reply.value)) {
+		signal(WTERMSIG(reply.value), SIG_DFL);
+		raise(WTERMSIG(reply.value));
+	}
+
+	exit(WIFEXITED(reply.value) ? WEXITSTATUS(reply.value) : 1);
+}
+
+/* Puts the plan's directories around a path variable, leaving the
+   variable alone when the plan doesn't have any */
+static void
+plan_path_set (const gchar * name, const gchar * dirs, gboolean prepend)
+{
+	if (dirs[0] == '\0')
+		return;
+
+	const gchar * current = g_getenv(name);
+	if (current == NULL || current[0] == '\0') {
+		g_setenv(name, dirs, TRUE);
+		return;
+	}
+
+	gchar * joined = prepend ? g_strjoin(":", dirs, current, NULL) : g_strjoin(":", current, dirs, NULL);
+	g_setenv(name, joined, TRUE);
+	g_free(joined);
+}
 
 int
 main (int argc, char * argv[])
@@ -47,8 +223,29 @@ main (int argc, char * argv[])
 
 	ual_tracepoint(exec_start, app_id);
 
-	/* URIs */
+	/* The library has usually worked everything out for us already */
+	exec_plan_t plan = { 0 };
+	gboolean planned = FALSE;
+	const gchar * app_exec_plan = g_getenv("APP_EXEC_PLAN");
+	if (app_exec_plan != NULL && app_exec_plan[0] != '\0') {
+		planned = exec_plan_map(app_exec_plan, &plan) == 0;
+		if (!planned)
+			g_warning("Unable to read exec plan '%s', parsing exec line", app_exec_plan);
+		g_unlink(app_exec_plan);
+	}
+	g_unsetenv("APP_EXEC_PLAN");
+
+	/* URIs, big lists come in a file that we clean up once read so
+	   that it doesn't stick around for the life of the app */
 	const gchar * app_uris = g_getenv("APP_URIS");
+	gchar ** app_uri_list = NULL;
+	const gchar * app_uris_file = g_getenv("APP_URIS_FILE");
+	if (app_uris_file != NULL && app_uris_file[0] != '\0') {
+		if (!planned)
+			app_uri_list = uri_file_read(app_uris_file);
+		g_unlink(app_uris_file);
+	}
+	g_unsetenv("APP_URIS_FILE");
 
 	/* Look to see if we have a directory defined that we
 	   should be using for everything.  If so, change to it
@@ -61,8 +258,12 @@ main (int argc, char * argv[])
 		}
 	}
 
-	/* Protect against app directories that have ':' in them */
-	if (appdir != NULL && strchr(appdir, ':') == NULL) {
+	if (planned) {
+		plan_path_set("PATH", plan.path_prefix, TRUE);
+		plan_path_set("LD_LIBRARY_PATH", plan.lib_prefix, TRUE);
+		plan_path_set("QML2_IMPORT_PATH", plan.import_suffix, FALSE);
+	} else if (appdir != NULL && strchr(appdir, ':') == NULL) {
+		/* Protect against app directories that have ':' in them */
 		const gchar * path_path = g_getenv("PATH");
 		if (path_path != NULL && path_path[0] == '\0')
 			path_path = NULL;
@@ -132,11 +333,31 @@ main (int argc, char * argv[])
 		g_free(import_libpath);
 	}
 
-	/* Parse the execiness of it all */
-	GArray * newargv = desktop_exec_parse(app_exec, app_uris);
-	if (newargv == NULL) {
-		g_warning("Unable to parse exec line '%s'", app_exec);
-		return 1;
+	/* Parse the execiness of it all, the strings stay in the plan or the
+	   parsed arguments and we make room for XMir in front of them */
+	GArray * newargv = NULL;
+	if (planned) {
+		newargv = g_array_sized_new(TRUE, FALSE, sizeof(gchar *), plan.argc + 2);
+		g_array_append_vals(newargv, plan.argv, plan.argc);
+	} else {
+		gchar ** split_uris = NULL;
+		if (app_uri_list == NULL && app_uris != NULL && app_uris[0] != '\0') {
+			split_uris = desktop_exec_split(app_uris);
+			if (split_uris == NULL)
+				g_warning("Unable to parse URIs '%s'", app_uris);
+		}
+
+		gchar ** parsed = desktop_exec_argv(app_exec, app_uri_list != NULL ? app_uri_list : split_uris);
+		g_strfreev(app_uri_list);
+		g_free(split_uris);
+
+		if (parsed == NULL) {
+			g_warning("Unable to parse exec line '%s'", app_exec);
+			return 1;
+		}
+
+		newargv = g_array_sized_new(TRUE, FALSE, sizeof(gchar *), g_strv_length(parsed) + 2);
+		g_array_append_vals(newargv, parsed, g_strv_length(parsed));
 	}
 
 	ual_tracepoint(exec_parse_complete, app_id);
@@ -156,9 +377,40 @@ main (int argc, char * argv[])
 	/* Now exec */
 	gchar ** nargv = (gchar**)g_array_free(newargv, FALSE);
 
+	/* Applications that are pre-launched stay out of the way of what the
+	   user is doing until they're asked for, and are the first to go
+	   when memory runs out. Everything they start inherits this. */
+	gboolean standby = g_strcmp0(g_getenv("UBUNTU_APP_LAUNCH_STANDBY"), "1") == 0;
+	if (standby) {
+		g_debug("Starting in standby");
+		standby_priority_set(0, TRUE);
+
+		FILE * oomfile = fopen("/proc/self/oom_score_adj", "w");
+		if (oomfile != NULL) {
+			fprintf(oomfile, "%d", STANDBY_OOM_SCORE);
+			fclose(oomfile);
+		}
+
+		g_unsetenv("UBUNTU_APP_LAUNCH_STANDBY");
+	}
+
 	ual_tracepoint(exec_pre_exec, app_id);
 
-	int execret = execvp(nargv[0], nargv);
+	/* Applications that have a library for the zygote can skip loading
+	   the toolkit, unless they need to go through XMir. The zygote
+	   wouldn't start a standby application with our priorities. */
+	const gchar * zygote_library = g_getenv("APP_ZYGOTE_LIBRARY");
+	if (zygote_library != NULL && zygote_library[0] != '\0' && g_strcmp0(nargv[0], XMIR_HELPER) != 0 && !standby) {
+		zygote_exec(zygote_library, nargv, appdir, app_id);
+	}
+
+	/* The plan has already looked through the application's directories,
+	   only programs that are on the session's PATH need searching for */
+	int execret;
+	if (planned && nargv[0] == plan.argv[0] && strchr(plan.binary, '/') != NULL)
+		execret = execv(plan.binary, nargv);
+	else
+		execret = execvp(nargv[0], nargv);
 
 	if (execret != 0) {
 		gchar * execprint = g_strjoinv(" ", nargv);
@@ -0,0 +1,151 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Ted Gould <ted.gould@canonical.com>
+ */
+
+#ifndef EXEC_PLAN_H
+#define EXEC_PLAN_H
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* The exec plan is what exec-line-exec would work out from the
+   environment, worked out by the library when it launches the
+   application. It is an exec_plan_header_t followed by NUL terminated
+   strings: the binary to exec, what goes in front of PATH, what goes
+   in front of LD_LIBRARY_PATH, what goes after QML2_IMPORT_PATH and
+   then argc arguments. The binary is a bare name when it is to be
+   found on the PATH. Empty path strings mean to leave the variable
+   alone. */
+
+#define EXEC_PLAN_MAGIC 0x75616c31 /* "ual1" */
+
+/* Largest plan we'll map */
+#define EXEC_PLAN_MAX_SIZE (16 * 1024 * 1024)
+
+typedef struct {
+	uint32_t magic;
+	uint32_t argc;
+} exec_plan_header_t;
+
+typedef struct {
+	void * map;
+	size_t size;
+	const char * binary;
+	const char * path_prefix;
+	const char * lib_prefix;
+	const char * import_suffix;
+	uint32_t argc;
+	/* NULL terminated, pointing into the map */
+	char ** argv;
+} exec_plan_t;
+
+/* Gets the next string out of the plan, or NULL if it runs off the
+   end of it */
+static inline const char *
+exec_plan_next (const char ** cursor, const char * end)
+{
+	const char * string = *cursor;
+	const char * nul = (const char *)memchr(string, '\0', end - string);
+	if (nul == NULL)
+		return NULL;
+
+	*cursor = nul + 1;
+	return string;
+}
+
+static inline void
+exec_plan_unmap (exec_plan_t * plan)
+{
+	free(plan->argv);
+	if (plan->map != NULL)
+		munmap(plan->map, plan->size);
+	memset(plan, 0, sizeof(exec_plan_t));
+}
+
+/* Maps the plan at @path and points @plan into it, without copying any
+   of the strings. Returns 0 on success and -1 if the plan can't be
+   read or isn't valid. */
+static inline int
+exec_plan_map (const char * path, exec_plan_t * plan)
+{
+	memset(plan, 0, sizeof(exec_plan_t));
+
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return -1;
+
+	struct stat info;
+	if (fstat(fd, &info) != 0 || info.st_size < (off_t)sizeof(exec_plan_header_t) || info.st_size > EXEC_PLAN_MAX_SIZE) {
+		close(fd);
+		return -1;
+	}
+
+	plan->size = info.st_size;
+	plan->map = mmap(NULL, plan->size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (plan->map == MAP_FAILED) {
+		plan->map = NULL;
+		return -1;
+	}
+
+	exec_plan_header_t header;
+	memcpy(&header, plan->map, sizeof(header));
+	/* Every argument is at least its NUL */
+	if (header.magic != EXEC_PLAN_MAGIC || header.argc == 0 || header.argc > plan->size) {
+		exec_plan_unmap(plan);
+		return -1;
+	}
+
+	const char * cursor = (const char *)plan->map + sizeof(header);
+	const char * end = (const char *)plan->map + plan->size;
+
+	plan->binary = exec_plan_next(&cursor, end);
+	plan->path_prefix = exec_plan_next(&cursor, end);
+	plan->lib_prefix = exec_plan_next(&cursor, end);
+	plan->import_suffix = exec_plan_next(&cursor, end);
+	if (plan->import_suffix == NULL || plan->binary[0] == '\0') {
+		exec_plan_unmap(plan);
+		return -1;
+	}
+
+	plan->argv = (char **)calloc(header.argc + 1, sizeof(char *));
+	if (plan->argv == NULL) {
+		exec_plan_unmap(plan);
+		return -1;
+	}
+
+	uint32_t i;
+	for (i = 0; i < header.argc; i++) {
+		/* The map is read only, exec doesn't write to them */
+		plan->argv[i] = (char *)exec_plan_next(&cursor, end);
+		if (plan->argv[i] == NULL) {
+			exec_plan_unmap(plan);
+			return -1;
+		}
+	}
+	plan->argc = header.argc;
+
+	return 0;
+}
+
+#endif /* EXEC_PLAN_H */
@@ -17,9 +17,21 @@
  *     Ted Gould <ted.gould@canonical.com>
  */
 
+#define _GNU_SOURCE
+
 #include "helpers.h"
 #include <gio/gio.h>
 #include <cgmanager/cgmanager.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <glib/gstdio.h>
+#include <poll.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
 
 #include "ual-tracepoint.h"
 #include "libubuntu-app-launch/recoverable-problem.h"
@@ -294,6 +306,386 @@ pids_from_cgroup (GDBusConnection * cgmanager, const gchar * jobname, const gcha
 	return retval;
 }
 
+/* Older headers don't have these, the numbers are the same on every
+   architecture we build for */
+#ifndef __NR_pidfd_send_signal
+#define __NR_pidfd_send_signal 424
+#endif
+#ifndef __NR_pidfd_open
+#define __NR_pidfd_open 434
+#endif
+
+/* Longest we'll sleep between checks on processes we don't have a
+   pidfd for */
+#define REAP_MAX_CHECK_INTERVAL_MS 100
+/* How long we'll wait for killed processes to go, something stuck in
+   the kernel can take forever and we shouldn't go with it */
+#define REAP_WAIT_TIMEOUT_MS 5000
+
+typedef struct {
+	pid_t pid;
+	int pidfd; /* -1 if the kernel doesn't have them */
+} reap_task_t;
+
+static void
+reap_task_free (gpointer data)
+{
+	reap_task_t * task = (reap_task_t *)data;
+	if (task->pidfd >= 0)
+		close(task->pidfd);
+	g_free(task);
+}
+
+/* Signals through the pidfd when we have one, so that if the process is
+   gone and the PID reused we don't hit something else. Returns FALSE if
+   the process is already gone. */
+static gboolean
+reap_task_signal (reap_task_t * task, int signal)
+{
+	int ret;
+	if (task->pidfd >= 0)
+		ret = syscall(__NR_pidfd_send_signal, task->pidfd, signal, NULL, 0);
+	else
+		ret = kill(task->pid, signal);
+
+	return ret == 0 || errno != ESRCH;
+}
+
+/* Without a pidfd we look in /proc, where a process that has exited but
+   hasn't been reaped by its parent shows as a zombie */
+static gboolean
+reap_task_exited (reap_task_t * task)
+{
+	gchar path[64];
+	snprintf(path, sizeof(path), "/proc/%d/stat", task->pid);
+
+	gchar * stat = NULL;
+	if (!g_file_get_contents(path, &stat, NULL, NULL))
+		return TRUE;
+
+	/* The state is after the command name, which can have anything in it */
+	const gchar * state = strrchr(stat, ')');
+	gboolean exited = state == NULL || state[1] == '\0' || state[2] == 'Z' || state[2] == 'X';
+	g_free(stat);
+
+	return exited;
+}
+
+/* Stops the processes we already know about again, in case one was
+   continued since, then asks CGManager for the processes in our cgroup
+   and stops any that we haven't seen yet. Returns how many new ones
+   there were. */
+static guint
+stop_new_tasks (GDBusConnection * cgmanager, GHashTable * tasks)
+{
+	GPid selfpid = getpid();
+	GPid parentpid = getppid();
+	guint found = 0;
+
+	GHashTableIter iter;
+	gpointer value;
+	g_hash_table_iter_init(&iter, tasks);
+	while (g_hash_table_iter_next(&iter, NULL, &value)) {
+		if (!reap_task_signal((reap_task_t *)value, SIGSTOP))
+			g_hash_table_iter_remove(&iter);
+	}
+
+	GList * pidlist = pids_from_cgroup(cgmanager, NULL, NULL);
+	GList * head;
+
+	for (head = pidlist; head != NULL; head = g_list_next(head)) {
+		GPid pid = GPOINTER_TO_INT(head->data);
+
+		/* We don't want to kill ourselves, or if we're being executed by
+		   a script, that script, either. We also don't want things in our
+		   process group which we forked at the opening */
+		if (pid == selfpid || pid == parentpid || getpgid(pid) == selfpid)
+			continue;
+
+		if (g_hash_table_contains(tasks, GINT_TO_POINTER(pid)))
+			continue;
+
+		reap_task_t * task = g_new0(reap_task_t, 1);
+		task->pid = pid;
+		task->pidfd = syscall(__NR_pidfd_open, pid, 0);
+
+		/* A stopped process can't fork, so the group can only shrink
+		   from here on */
+		g_debug("Stopping pid: %d", pid);
+		if (reap_task_signal(task, SIGSTOP)) {
+			g_hash_table_insert(tasks, GINT_TO_POINTER(pid), task);
+			found++;
+		} else {
+			reap_task_free(task);
+		}
+	}
+
+	g_list_free(pidlist);
+
+	return found;
+}
+
+/* Waits for all of the processes to exit, or REAP_WAIT_TIMEOUT_MS. With
+   pidfds that's a poll() on them, otherwise we check on them with a
+   backoff. */
+static void
+wait_for_tasks (GHashTable * tasks)
+{
+	gint64 deadline = g_get_monotonic_time() + REAP_WAIT_TIMEOUT_MS * 1000;
+
+	GArray * pollfds = g_array_new(FALSE, FALSE, sizeof(struct pollfd));
+	GPtrArray * unpollable = g_ptr_array_new();
+
+	GHashTableIter iter;
+	gpointer value;
+	g_hash_table_iter_init(&iter, tasks);
+	while (g_hash_table_iter_next(&iter, NULL, &value)) {
+		reap_task_t * task = (reap_task_t *)value;
+		if (task->pidfd >= 0) {
+			struct pollfd pollfd = { .fd = task->pidfd, .events = POLLIN, .revents = 0 };
+			g_array_append_val(pollfds, pollfd);
+		} else {
+			g_ptr_array_add(unpollable, task);
+		}
+	}
+
+	while (pollfds->len > 0) {
+		gint64 remaining = deadline - g_get_monotonic_time();
+		if (remaining <= 0)
+			break;
+
+		if (poll((struct pollfd *)pollfds->data, pollfds->len, (remaining + 999) / 1000) < 0) {
+			if (errno == EINTR)
+				continue;
+			g_warning("Unable to wait on processes: %s", g_strerror(errno));
+			break;
+		}
+
+		guint i;
+		for (i = pollfds->len; i > 0; i--) {
+			if (g_array_index(pollfds, struct pollfd, i - 1).revents != 0)
+				g_array_remove_index_fast(pollfds, i - 1);
+		}
+	}
+
+	guint interval = 1;
+	while (unpollable->len > 0) {
+		guint i;
+		for (i = unpollable->len; i > 0; i--) {
+			if (reap_task_exited((reap_task_t *)g_ptr_array_index(unpollable, i - 1)))
+				g_ptr_array_remove_index_fast(unpollable, i - 1);
+		}
+
+		gint64 remaining = deadline - g_get_monotonic_time();
+		if (unpollable->len > 0 && remaining > 0) {
+			g_usleep(MIN(interval * 1000, remaining));
+			interval = MIN(interval * 2, REAP_MAX_CHECK_INTERVAL_MS);
+		} else {
+			break;
+		}
+	}
+
+	if (pollfds->len + unpollable->len > 0)
+		g_warning("Gave up waiting on %u processes that didn't exit after being killed", pollfds->len + unpollable->len);
+
+	g_array_free(pollfds, TRUE);
+	g_ptr_array_free(unpollable, TRUE);
+}
+
+/* Makes sure our cgroup isn't frozen. It's fine if it isn't, or if the
+   manager can't set values, we just try. */
+static void
+cgroup_thaw (GDBusConnection * cgmanager)
+{
+	GError * error = NULL;
+	const gchar * name = g_getenv("UBUNTU_APP_LAUNCH_CG_MANAGER_NAME");
+
+	GVariant * ret = g_dbus_connection_call_sync(cgmanager,
+		name, /* bus name for direct connection is NULL */
+		"/org/linuxcontainers/cgmanager",
+		"org.linuxcontainers.cgmanager0_0",
+		"SetValue",
+		g_variant_new("(ssss)", "freezer", "", "freezer.state", "THAWED"),
+		NULL,
+		G_DBUS_CALL_FLAGS_NONE,
+		-1, /* default timeout */
+		NULL, /* cancellable */
+		&error);
+
+	if (error != NULL) {
+		g_debug("Unable to thaw cgroup: %s", error->message);
+		g_error_free(error);
+	}
+
+	g_clear_pointer(&ret, g_variant_unref);
+}
+
+/* Kills everything in our cgroup and waits for it to be gone. The
+   caller should be in its own process group so that anything it has
+   forked is left alone.
+
+   We can't use the freezer on the cgroup as we're in it too, so we
+   stop each process instead. Anything that forked between asking and
+   stopping shows up the next time we ask, and since nothing that is
+   stopped can fork this ends after a couple of rounds, even with
+   something that is forking as fast as it can. */
+void
+cgroup_reap_all (GDBusConnection * cgmanager)
+{
+	g_return_if_fail(cgmanager != NULL);
+
+	/* If the application was paused when it was stopped the group is
+	   still frozen, and nothing in it would act on our signals */
+	cgroup_thaw(cgmanager);
+
+	GHashTable * tasks = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, reap_task_free);
+
+	while (stop_new_tasks(cgmanager, tasks) > 0);
+
+	/* Everything is stopped, so this is all there is. SIGKILL takes
+	   them out of being stopped too. */
+	GHashTableIter iter;
+	gpointer value;
+	g_hash_table_iter_init(&iter, tasks);
+	while (g_hash_table_iter_next(&iter, NULL, &value)) {
+		reap_task_t * task = (reap_task_t *)value;
+		g_debug("Killing pid: %d", task->pid);
+		if (!reap_task_signal(task, SIGKILL))
+			g_hash_table_iter_remove(&iter);
+	}
+
+	wait_for_tasks(tasks);
+
+	g_hash_table_destroy(tasks);
+}
+
+/* URI lists that are too big for the environment are passed in a file
+   of length prefixed strings. Each is a 32-bit length in host byte order
+   followed by that many bytes, without a NUL. The file is written in
+   @dir, which the application needs to be able to read, and the path is
+   returned. Free it with g_free(). */
+gchar *
+uri_file_write (const gchar * dir, gchar ** uris)
+{
+	g_return_val_if_fail(dir != NULL, NULL);
+	g_return_val_if_fail(uris != NULL, NULL);
+
+	GByteArray * data = g_byte_array_new();
+	int i;
+	for (i = 0; uris[i] != NULL; i++) {
+		guint32 len = strlen(uris[i]);
+		g_byte_array_append(data, (const guint8 *)&len, sizeof(len));
+		g_byte_array_append(data, (const guint8 *)uris[i], len);
+	}
+
+	gchar * path = g_build_filename(dir, "uris-XXXXXX", NULL);
+	int fd = g_mkstemp_full(path, O_WRONLY | O_CLOEXEC, 0600);
+	if (fd < 0) {
+		g_warning("Unable to create URI file in '%s': %s", dir, g_strerror(errno));
+		g_byte_array_unref(data);
+		g_free(path);
+		return NULL;
+	}
+
+	gsize total = data->len;
+	gsize written = 0;
+	while (written < total) {
+		ssize_t ret = write(fd, data->data + written, total - written);
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret <= 0)
+			break;
+		written += ret;
+	}
+
+	g_byte_array_unref(data);
+
+	if (close(fd) != 0 || written < total) {
+		g_warning("Unable to write URI file '%s': %s", path, g_strerror(errno));
+		g_unlink(path);
+		g_free(path);
+		return NULL;
+	}
+
+	return path;
+}
+
+/* Reads a file written by uri_file_write() back into a NULL terminated
+   array of the URIs. Returns NULL if it can't be read. */
+gchar **
+uri_file_read (const gchar * path)
+{
+	gchar * contents = NULL;
+	gsize length = 0;
+	GError * error = NULL;
+
+	if (!g_file_get_contents(path, &contents, &length, &error)) {
+		g_warning("Unable to read URI file '%s': %s", path, error->message);
+		g_error_free(error);
+		return NULL;
+	}
+
+	GPtrArray * uris = g_ptr_array_new();
+	gsize offset = 0;
+	while (offset + sizeof(guint32) <= length) {
+		guint32 len;
+		memcpy(&len, contents + offset, sizeof(len));
+		offset += sizeof(len);
+
+		if (len > length - offset) {
+			g_warning("URI file '%s' is truncated", path);
+			break;
+		}
+
+		g_ptr_array_add(uris, g_strndup(contents + offset, len));
+		offset += len;
+	}
+	g_ptr_array_add(uris, NULL);
+
+	g_free(contents);
+
+	return (gchar **)g_ptr_array_free(uris, FALSE);
+}
+
+/* glibc doesn't wrap ioprio_set(), these are from the kernel's ioprio.h */
+#define IOPRIO_CLASS_SHIFT 13
+#define IOPRIO_CLASS_NONE  0
+#define IOPRIO_CLASS_IDLE  3
+#define IOPRIO_WHO_PROCESS 1
+
+/* Sets the priorities of a thread for being a standby application, or
+   puts them back to the defaults. Both the IO class and SCHED_BATCH can
+   be undone by the same user without any privileges, which isn't true
+   of nice values or SCHED_IDLE. A TID of zero is the calling thread. */
+gboolean
+standby_priority_set (pid_t tid, gboolean standby)
+{
+	int ioprio = (standby ? IOPRIO_CLASS_IDLE : IOPRIO_CLASS_NONE) << IOPRIO_CLASS_SHIFT;
+	if (syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, tid, ioprio) != 0) {
+		g_debug("Unable to set IO priority of %d: %s", tid, g_strerror(errno));
+		return FALSE;
+	}
+
+	struct sched_param param = { .sched_priority = 0 };
+	if (sched_setscheduler(tid, standby ? SCHED_BATCH : SCHED_OTHER, &param) != 0) {
+		g_debug("Unable to set scheduler of %d: %s", tid, g_strerror(errno));
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+/* Quits the main loop in @user_data if the Zeitgeist report hasn't
+   finished by the time it fires */
+gboolean
+watchdog_timeout (gpointer user_data)
+{
+	g_warning("Watchdog triggered, took too long to submit into Zeitgeist Database!");
+	g_main_loop_quit((GMainLoop *)user_data);
+
+	return G_SOURCE_REMOVE;
+}
+
 /* Global markers for the ual_tracepoint macro */
 int _ual_tracepoints_env_checked = 0;
 int _ual_tracepoints_enabled = 0;
@@ -20,6 +20,7 @@
 #include <json-glib/json-glib.h>
 #include <click.h>
 #include <upstart.h>
+#include <string.h>
 #include "helpers.h"
 
 /* Take an app ID and validate it and then break it up
@@ -237,83 +238,225 @@ uri2file (const gchar * uri)
 	return retval;
 }
 
-/* Put the list of files into the argument array */
-static inline void
-file_list_handling (GArray * outarray, gchar ** list, gchar * (*dup_func) (const gchar * in))
+/* Where the tokenizer is in a line. Together these are the states of
+   GLib's tokenize_command_line() and g_shell_unquote(), so that the one
+   pass gives what g_shell_parse_argv() would. */
+typedef enum {
+	SHELL_NORMAL,
+	SHELL_ESCAPE,        /* after a backslash */
+	SHELL_SINGLE,        /* in single quotes */
+	SHELL_DOUBLE,        /* in double quotes */
+	SHELL_DOUBLE_ESCAPE, /* after a backslash in double quotes */
+	SHELL_COMMENT_START, /* right after a '#', GLib fails if it ends here */
+	SHELL_COMMENT
+} shell_state_t;
+
+#define SHELL_TOKEN_END   (-1)
+#define SHELL_TOKEN_ERROR (-2)
+
+/* Unquotes the argument at @cursor into @out and moves @cursor past it.
+   Returns the length of the argument, SHELL_TOKEN_END if there are no
+   more of them or SHELL_TOKEN_ERROR if the quoting is bad. An argument
+   is never longer than the text it came from, so @out needs as much
+   room as is left in @line. */
+static gssize
+shell_token_next (const gchar * line, const gchar ** cursor, gchar * out)
 {
-	/* No URLs, cool, this is a noop */
-	if (list == NULL || list[0] == NULL) {
-		return;
-	}
-
-	int i;
-	for (i = 0; list[i] != NULL; i++) {
-		gchar * entry = dup_func(list[i]);
-
-		/* No NULLs */
-		if (entry != NULL && entry[0] != '\0') {
-			g_array_append_val(outarray, entry);
-		} else {
-			g_free(entry);
+	const gchar * p = *cursor;
+	gchar * o = out;
+	gboolean token = FALSE;
+	shell_state_t state = SHELL_NORMAL;
+
+	for (; *p != '\0'; p++) {
+		switch (state) {
+		case SHELL_NORMAL:
+			switch (*p) {
+			case ' ':
+			case '\t':
+			case '\n':
+				if (token) {
+					*o = '\0';
+					*cursor = p + 1;
+					return o - out;
+				}
+				break;
+			case '\'':
+				token = TRUE;
+				state = SHELL_SINGLE;
+				break;
+			case '"':
+				token = TRUE;
+				state = SHELL_DOUBLE;
+				break;
+			case '\\':
+				state = SHELL_ESCAPE;
+				break;
+			case '#':
+				/* Only a comment at the start of a word, but GLib
+				   doesn't count tabs */
+				if (p == line || p[-1] == ' ' || p[-1] == '\n') {
+					state = SHELL_COMMENT_START;
+					break;
+				}
+				token = TRUE;
+				*o++ = *p;
+				break;
+			default:
+				token = TRUE;
+				*o++ = *p;
+				break;
+			}
+			break;
+		case SHELL_ESCAPE:
+			/* Escaped newlines disappear */
+			if (*p != '\n') {
+				token = TRUE;
+				*o++ = *p;
+			}
+			state = SHELL_NORMAL;
+			break;
+		case SHELL_SINGLE:
+			if (*p == '\'')
+				state = SHELL_NORMAL;
+			else
+				*o++ = *p;
+			break;
+		case SHELL_DOUBLE:
+			if (*p == '"')
+				state = SHELL_NORMAL;
+			else if (*p == '\\')
+				state = SHELL_DOUBLE_ESCAPE;
+			else
+				*o++ = *p;
+			break;
+		case SHELL_DOUBLE_ESCAPE:
+			if (*p != '"' && *p != '\\' && *p != '`' && *p != '$' && *p != '\n')
+				*o++ = '\\';
+			*o++ = *p;
+			state = SHELL_DOUBLE;
+			break;
+		case SHELL_COMMENT_START:
+		case SHELL_COMMENT:
+			/* The newline ends the comment without ending the word */
+			state = *p == '\n' ? SHELL_NORMAL : SHELL_COMMENT;
+			break;
 		}
 	}
+
+	*cursor = p;
+
+	if (state != SHELL_NORMAL && state != SHELL_COMMENT)
+		return SHELL_TOKEN_ERROR;
+	if (!token)
+		return SHELL_TOKEN_END;
+
+	*o = '\0';
+	return o - out;
 }
 
-/* Parse a desktop exec line and return the next string */
-static void
-desktop_exec_segment_parse (GArray * finalarray, const gchar * execsegment, gchar ** uri_list)
+/* Splits a line the way g_shell_parse_argv() does, but into a single
+   allocation with the array first and the strings after it. Returns
+   NULL if the quoting is bad or there's nothing in it. Free with
+   g_free(). */
+gchar **
+desktop_exec_split (const gchar * line)
 {
-	/* No NULL strings */
-	if (execsegment == NULL || execsegment[0] == '\0')
-		return;
+	g_return_val_if_fail(line != NULL, NULL);
 
-	/* Handle %F and %U as an argument on their own as per the spec */
-	if (g_strcmp0(execsegment, "%U") == 0) {
-		file_list_handling(finalarray, uri_list, g_strdup);
-		return;
+	/* Every argument but the last needs a character and a separator */
+	gsize len = strlen(line);
+	gsize maxargs = len / 2 + 1;
+
+	gchar ** argv = g_malloc((maxargs + 1) * sizeof(gchar *) + len + 1);
+	gchar * strings = (gchar *)(argv + maxargs + 1);
+	const gchar * cursor = line;
+	gsize argc = 0;
+	gssize tokenlen;
+
+	while ((tokenlen = shell_token_next(line, &cursor, strings)) >= 0) {
+		argv[argc++] = strings;
+		strings += tokenlen + 1;
 	}
-	if (g_strcmp0(execsegment, "%F") == 0) {
-		file_list_handling(finalarray, uri_list, uri2file);
-		return;
+
+	if (tokenlen == SHELL_TOKEN_ERROR || argc == 0) {
+		g_free(argv);
+		return NULL;
 	}
 
-	/* Start looking at individual codes */
-	gchar ** execsplit = g_strsplit(execsegment, "%", 0);
+	argv[argc] = NULL;
+	return argv;
+}
 
-	/* If we didn't have any codes, just exit here */
-	if (execsplit[1] == NULL) {
-		g_strfreev(execsplit);
-		gchar * dup = g_strdup(execsegment);
-		g_array_append_val(finalarray, dup);
-		return;
-	}
+/* Copies @in to @out and returns the end of it */
+static inline gchar *
+exec_append (gchar * out, const gchar * in)
+{
+	gsize len = strlen(in);
+	memcpy(out, in, len);
+	return out + len;
+}
 
+/* Puts the field codes of one argument of the Exec line in, adding the
+   arguments that come out of it to @argv with their strings at @out.
+   Returns where the next string goes. The file for %f is worked out the
+   first time it is needed and kept in @single_file. */
+static gchar *
+exec_field_codes (gchar ** argv, gsize * argc, gchar * out, const gchar * arg, gchar ** uri_list, gchar ** single_file)
+{
+	gboolean have_uris = uri_list != NULL && uri_list[0] != NULL;
 	int i;
 
-	gboolean previous_percent = FALSE;
-	GArray * outarray = g_array_new(TRUE, FALSE, sizeof(const gchar *));
-	g_array_append_val(outarray, execsplit[0]);
-	gchar * single_file = NULL;
+	/* No NULL strings */
+	if (arg[0] == '\0')
+		return out;
+
+	/* Handle %F and %U as an argument on their own as per the spec,
+	   they become an argument for each URI but not empty ones */
+	if (strcmp(arg, "%U") == 0) {
+		for (i = 0; have_uris && uri_list[i] != NULL; i++) {
+			if (uri_list[i][0] == '\0')
+				continue;
+			argv[(*argc)++] = out;
+			out = exec_append(out, uri_list[i]);
+			*out++ = '\0';
+		}
+		return out;
+	}
+	if (strcmp(arg, "%F") == 0) {
+		for (i = 0; have_uris && uri_list[i] != NULL; i++) {
+			gchar * file = uri2file(uri_list[i]);
+			if (file[0] != '\0') {
+				argv[(*argc)++] = out;
+				out = exec_append(out, file);
+				*out++ = '\0';
+			}
+			g_free(file);
+		}
+		return out;
+	}
 
 	/* The variables allowed in an exec line from the Freedesktop.org Desktop
 	   File specification: http://standards.freedesktop.org/desktop-entry-spec/desktop-entry-spec-latest.html#exec-variables */
-	for (i = 1; execsplit[i] != NULL; i++) {
-		const gchar * skipchar = &(execsplit[i][1]);
-
-		/* Handle the case of %%F printing "%F" */
-		if (previous_percent) {
-			g_array_append_val(outarray, execsplit[i]);
-			previous_percent = FALSE;
+	gchar * start = out;
+	const gchar * p = arg;
+	while (*p != '\0') {
+		if (*p != '%') {
+			*out++ = *p++;
 			continue;
 		}
 
-		switch (execsplit[i][0]) {
-		case '\0': {
-			const gchar * percent = "%";
-			g_array_append_val(outarray, percent); /* %% is the literal */
-			previous_percent = TRUE;
+		gchar code = p[1];
+		if (code == '\0') {
+			/* A trailing percent is kept */
+			*out++ = '%';
 			break;
 		}
+		p += 2;
+
+		switch (code) {
+		case '%':
+			*out++ = '%'; /* %% is the literal */
+			break;
 		case 'd':
 		case 'D':
 		case 'n':
@@ -321,104 +464,144 @@ desktop_exec_segment_parse (GArray * finalarray, const gchar * execsegment, gcha
 		case 'v':
 		case 'm':
 			/* Deprecated */
-			g_array_append_val(outarray, skipchar);
 			break;
 		case 'f':
-			if (uri_list != NULL && uri_list[0] != NULL) {
-				if (single_file == NULL)
-					single_file = uri2file(uri_list[0]);
-				g_array_append_val(outarray, single_file);
+			if (have_uris) {
+				if (*single_file == NULL)
+					*single_file = uri2file(uri_list[0]);
+				out = exec_append(out, *single_file);
 			}
-
-			g_array_append_val(outarray, skipchar);
 			break;
 		case 'F':
-			g_warning("Exec line segment has a '%%F' that isn't its own argument '%s', ignoring.", execsegment);
-			g_array_append_val(outarray, skipchar);
+			g_warning("Exec line segment has a '%%F' that isn't its own argument '%s', ignoring.", arg);
 			break;
 		case 'i':
 		case 'c':
 		case 'k':
 			/* Perhaps?  Not sure anyone uses these */
-			g_array_append_val(outarray, skipchar);
 			break;
 		case 'U':
-			g_warning("Exec line segment has a '%%U' that isn't its own argument '%s', ignoring.", execsegment);
-			g_array_append_val(outarray, skipchar);
+			g_warning("Exec line segment has a '%%U' that isn't its own argument '%s', ignoring.", arg);
 			break;
 		case 'u':
-			if (uri_list != NULL && uri_list[0] != NULL) {
-				g_array_append_val(outarray, uri_list[0]);
-			}
-
-			g_array_append_val(outarray, skipchar);
+			if (have_uris)
+				out = exec_append(out, uri_list[0]);
 			break;
 		default:
-			g_warning("Desktop Exec line code '%%%c' unknown, skipping.", execsplit[i][0]);
-			g_array_append_val(outarray, skipchar);
+			g_warning("Desktop Exec line code '%%%c' unknown, skipping.", code);
 			break;
 		}
 	}
 
-	gchar * output = g_strjoinv(NULL, (gchar **)outarray->data);
-	g_array_free(outarray, TRUE);
+	if (out != start) {
+		*out++ = '\0';
+		argv[(*argc)++] = start;
+	}
 
-	if (output != NULL && output[0] != '\0') {
-		g_array_append_val(finalarray, output);
-	} else {
-		g_free(output);
+	return out;
+}
+
+/* Take a full exec line, split it out, put the URIs in for the field
+   codes and return the arguments. This is one pass over the line into
+   a single allocation, which is sized for the worst case up front, with
+   the array first and the strings after it. The only other allocations
+   are for turning URIs into files. Free with g_free(). */
+gchar **
+desktop_exec_argv (const gchar * execline, gchar ** uri_list)
+{
+	g_return_val_if_fail(execline != NULL, NULL);
+
+	gsize len = 0;
+	gsize codes = 0;
+	const gchar * p;
+	for (p = execline; *p != '\0'; p++, len++) {
+		if (*p == '%')
+			codes++;
+	}
+
+	/* Files are never longer than their URIs, so each field code can
+	   add at most all of the URIs */
+	gsize urilen = 0;
+	gsize uricount = 0;
+	int i;
+	for (i = 0; uri_list != NULL && uri_list[i] != NULL; i++) {
+		urilen += strlen(uri_list[i]) + 1;
+		uricount++;
+	}
+
+	gsize maxargs = len / 2 + 1 + codes * uricount;
+	gsize maxbytes = len + 1 + codes * urilen;
+	gchar ** argv = g_malloc((maxargs + 1) * sizeof(gchar *) + maxbytes);
+	gchar * out = (gchar *)(argv + maxargs + 1);
+	gsize argc = 0;
+
+	/* Each argument is unquoted here before its field codes go in,
+	   most lines fit on the stack */
+	gchar stackscratch[512];
+	gchar * scratch = len < sizeof(stackscratch) ? stackscratch : g_malloc(len + 1);
+
+	gchar * single_file = NULL;
+	const gchar * cursor = execline;
+	gssize tokenlen;
+	gboolean empty = TRUE;
+	while ((tokenlen = shell_token_next(execline, &cursor, scratch)) >= 0) {
+		empty = FALSE;
+		out = exec_field_codes(argv, &argc, out, scratch, uri_list, &single_file);
 	}
 
 	g_free(single_file);
-	g_strfreev(execsplit);
+	if (scratch != stackscratch)
+		g_free(scratch);
+
+	if (tokenlen == SHELL_TOKEN_ERROR || empty) {
+		g_warning("Unable to parse exec line '%s'", execline);
+		g_free(argv);
+		return NULL;
+	}
+
+	argv[argc] = NULL;
+	return argv;
 }
 
 /* Take a full exec line, split it out, parse the segments and return
-   it to the caller */
+   it to the caller. For callers that want an array they can change,
+   each string is its own allocation. */
 GArray *
 desktop_exec_parse (const gchar * execline, const gchar * urilist)
 {
-	GError * error = NULL;
-	gchar ** splitexec = NULL;
 	gchar ** splituris = NULL;
-	gint execitems = 0;
-
-	/* This returns from desktop file style quoting to straight strings with
-	   the appropriate characters split by the spaces that were meant for
-	   splitting.  Trickier than it sounds.  But now we should be able to assume
-	   that each string in the array is expected to be its own parameter. */
-	g_shell_parse_argv(execline, &execitems, &splitexec, &error);
-
-	if (error != NULL) {
-		g_warning("Unable to parse exec line '%s': %s", execline, error->message);
-		g_error_free(error);
-		return NULL;
-	}
 
 	if (urilist != NULL && urilist[0] != '\0') {
-		g_shell_parse_argv(urilist, NULL, &splituris, &error);
+		splituris = desktop_exec_split(urilist);
 
-		if (error != NULL) {
-			g_warning("Unable to parse URIs '%s': %s", urilist, error->message);
-			g_error_free(error);
+		if (splituris == NULL) {
+			g_warning("Unable to parse URIs '%s'", urilist);
 			/* Continuing without URIs */
-			splituris = NULL;
 		}
 	}
 
+	GArray * newargv = desktop_exec_parse_list(execline, splituris);
+	g_free(splituris);
 
-	GArray * newargv = g_array_new(TRUE, FALSE, sizeof(gchar *));
-	int i;
-	for (i = 0; i < execitems; i++) {
-		desktop_exec_segment_parse(newargv, splitexec[i], splituris);
-	}
-	g_strfreev(splitexec);
+	return newargv;
+}
 
-	if (splituris != NULL) {
-		g_strfreev(splituris);
-	}
+/* Same as desktop_exec_parse() but with the URIs already split out, like
+   when they come from a URI file */
+GArray *
+desktop_exec_parse_list (const gchar * execline, gchar ** urilist)
+{
+	gchar ** argv = desktop_exec_argv(execline, urilist);
+	if (argv == NULL)
+		return NULL;
 
-	/* Each string here should be its own param */
+	GArray * newargv = g_array_sized_new(TRUE, FALSE, sizeof(gchar *), g_strv_length(argv));
+	int i;
+	for (i = 0; argv[i] != NULL; i++) {
+		gchar * dup = g_strdup(argv[i]);
+		g_array_append_val(newargv, dup);
+	}
+	g_free(argv);
 
 	return newargv;
 }
@@ -479,26 +662,66 @@ set_confined_envvars (EnvHandle * handle, const gchar * package, const gchar * a
 	return;
 }
 
-static void
-unity_signal_cb (GDBusConnection * con, const gchar * sender, const gchar * path, const gchar * interface, const gchar * signal, GVariant * params, gpointer user_data)
-{
-	GMainLoop * mainloop = (GMainLoop *)user_data;
-	g_main_loop_quit(mainloop);
-}
-
 struct _handshake_t {
 	GDBusConnection * con;
 	GMainLoop * mainloop;
 	guint signal_subscribe;
 	GSource * timeout;
+	gboolean finished;
+	handshake_done_t done;
+	gpointer done_data;
 };
 
+static void
+handshake_free (handshake_t * handshake)
+{
+	if (handshake->timeout != NULL) {
+		g_source_destroy(handshake->timeout);
+		g_source_unref(handshake->timeout);
+		handshake->timeout = NULL;
+	}
+	g_main_loop_unref(handshake->mainloop);
+	g_dbus_connection_signal_unsubscribe(handshake->con, handshake->signal_subscribe);
+	g_object_unref(handshake->con);
+
+	g_free(handshake);
+}
+
+/* Either Unity answered or we gave up on it, wake up whoever is waiting */
+static void
+handshake_finished (handshake_t * handshake)
+{
+	if (handshake->finished)
+		return;
+
+	handshake->finished = TRUE;
+
+	if (handshake->done != NULL) {
+		handshake_done_t done = handshake->done;
+		gpointer done_data = handshake->done_data;
+
+		handshake_free(handshake);
+		done(done_data);
+	} else {
+		g_main_loop_quit(handshake->mainloop);
+	}
+}
+
+static void
+unity_signal_cb (GDBusConnection * con, const gchar * sender, const gchar * path, const gchar * interface, const gchar * signal, GVariant * params, gpointer user_data)
+{
+	handshake_t * handshake = (handshake_t *)user_data;
+	handshake_finished(handshake);
+}
+
 static gboolean
 unity_too_slow_cb (gpointer user_data)
 {
 	handshake_t * handshake = (handshake_t *)user_data;
-	g_main_loop_quit(handshake->mainloop);
+	/* The context keeps its own reference while we're dispatched */
+	g_source_unref(handshake->timeout);
 	handshake->timeout = NULL;
+	handshake_finished(handshake);
 	return G_SOURCE_REMOVE;
 }
 
@@ -516,6 +739,7 @@ starting_handshake_start (const gchar *   app_id, int timeout_s)
 	if (error != NULL) {
 		g_critical("Unable to connect to session bus: %s", error->message);
 		g_error_free(error);
+		g_main_loop_unref(handshake->mainloop);
 		g_free(handshake);
 		return NULL;
 	}
@@ -528,7 +752,7 @@ starting_handshake_start (const gchar *   app_id, int timeout_s)
 		"/", /* path */
 		app_id, /* arg0 */
 		G_DBUS_SIGNAL_FLAGS_NONE,
-		unity_signal_cb, handshake->mainloop,
+		unity_signal_cb, handshake,
 		NULL); /* user data destroy */
 
 	/* Send unfreeze to to Unity */
@@ -554,18 +778,46 @@ starting_handshake_wait (handshake_t * handshake)
 	if (handshake == NULL)
 		return;
 
-	g_main_loop_run(handshake->mainloop);
+	if (!handshake->finished)
+		g_main_loop_run(handshake->mainloop);
 
-	if (handshake->timeout != NULL) {
-		g_source_destroy(handshake->timeout);
-		g_source_unref(handshake->timeout);
-		handshake->timeout = NULL;
+	handshake_free(handshake);
+}
+
+/* Instead of blocking in a main loop, call @done from the main context
+   the handshake was started in once Unity answers or the timeout passes.
+   The handshake is freed before @done is called, so it must not be used
+   after calling this. */
+void
+starting_handshake_notify (handshake_t * handshake, handshake_done_t done, gpointer user_data)
+{
+	g_return_if_fail(done != NULL);
+
+	if (handshake == NULL) {
+		done(user_data);
+		return;
 	}
-	g_main_loop_unref(handshake->mainloop);
-	g_dbus_connection_signal_unsubscribe(handshake->con, handshake->signal_subscribe);
-	g_object_unref(handshake->con);
 
-	g_free(handshake);
+	if (handshake->finished) {
+		handshake_free(handshake);
+		done(user_data);
+		return;
+	}
+
+	handshake->done = done;
+	handshake->done_data = user_data;
+}
+
+/* Stops waiting on Unity and calls the @done given to
+   starting_handshake_notify() right away, for when nothing is going to
+   be around to wait any longer. The handshake is freed. */
+void
+starting_handshake_finish (handshake_t * handshake)
+{
+	g_return_if_fail(handshake != NULL);
+	g_return_if_fail(handshake->done != NULL);
+
+	handshake_finished(handshake);
 }
 
 EnvHandle *
@@ -33,6 +33,11 @@ gchar *   desktop_to_exec        (GKeyFile *      desktop_file,
                                   const gchar *   from);
 GArray *  desktop_exec_parse     (const gchar *   execline,
                                   const gchar *   uri_list);
+GArray *  desktop_exec_parse_list (const gchar *  execline,
+                                  gchar **        uri_list);
+gchar **  desktop_exec_argv      (const gchar *   execline,
+                                  gchar **        uri_list);
+gchar **  desktop_exec_split     (const gchar *   line);
 GKeyFile * keyfile_for_appid     (const gchar *   appid,
                                   gchar * *       desktopfile);
 void      set_confined_envvars   (EnvHandle *     handle,
@@ -50,15 +55,32 @@ typedef struct _handshake_t handshake_t;
 handshake_t * starting_handshake_start   (const gchar *   app_id,
                                           int timeout_s);
 void      starting_handshake_wait        (handshake_t *   handshake);
+typedef void (*handshake_done_t) (gpointer user_data);
+void      starting_handshake_notify      (handshake_t *   handshake,
+                                          handshake_done_t done,
+                                          gpointer        user_data);
+void      starting_handshake_finish      (handshake_t *   handshake);
 
 GDBusConnection * cgroup_manager_connection (void);
 void              cgroup_manager_unref (GDBusConnection * cgroup_manager);
 GList *   pids_from_cgroup       (GDBusConnection * cgmanager,
                                   const gchar *   jobname,
                                   const gchar *   instancename);
+void      cgroup_reap_all        (GDBusConnection * cgmanager);
 
 gboolean   verify_keyfile        (GKeyFile *    inkeyfile,
                                   const gchar * desktop);
 
+gchar *    uri_file_write        (const gchar * dir,
+                                  gchar **      uris);
+gchar **   uri_file_read         (const gchar * path);
+
+/* OOM score of a standby application, the most likely to be killed */
+#define STANDBY_OOM_SCORE 1000
+gboolean   standby_priority_set  (pid_t         tid,
+                                  gboolean      standby);
+
+gboolean   watchdog_timeout      (gpointer      user_data);
+
 G_END_DECLS
 
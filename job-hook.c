@@ -0,0 +1,222 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Ted Gould <ted.gould@canonical.com>
+ */
+
+/* Everything the application jobs do when they've started and when
+   they've stopped, in one process instead of a script forking a helper
+   for each step. */
+
+#include <errno.h>
+#include <gio/gio.h>
+#include <glib/gstdio.h>
+#include <unistd.h>
+
+#include "helpers.h"
+#include "zg-report.h"
+
+/* How long we'll believe what we found out about developer mode. It
+   can be turned on while the session is running, but apps stopping
+   in a burst shouldn't each have to ask. */
+#define DEVELOPER_MODE_CACHE_S 60
+
+/* Asks the property service whether developer mode is on. Returns
+   FALSE if we can't find out, as the logs aren't kept then either. */
+static gboolean
+developer_mode_query (gboolean * answered)
+{
+	GError * error = NULL;
+	gboolean use_session_bus = g_getenv("UBUNTU_APP_LAUNCH_PROPERTY_SERVICE_SESSION_BUS") != NULL;
+
+	*answered = FALSE;
+
+	GDBusConnection * bus = g_bus_get_sync(use_session_bus ? G_BUS_TYPE_SESSION : G_BUS_TYPE_SYSTEM, NULL, &error);
+	if (error != NULL) {
+		g_warning("Unable to get bus for the property service: %s", error->message);
+		g_error_free(error);
+		return FALSE;
+	}
+
+	GVariant * retval = g_dbus_connection_call_sync(bus,
+		"com.canonical.PropertyService",
+		"/com/canonical/PropertyService",
+		"com.canonical.PropertyService",
+		"GetProperty",
+		g_variant_new("(s)", "adb"),
+		G_VARIANT_TYPE("(b)"),
+		G_DBUS_CALL_FLAGS_NONE,
+		ZG_REPORT_TIMEOUT_S * 1000,
+		NULL, /* cancellable */
+		&error);
+
+	g_object_unref(bus);
+
+	if (error != NULL) {
+		g_debug("Unable to get developer mode: %s", error->message);
+		g_error_free(error);
+		return FALSE;
+	}
+
+	gboolean enabled = FALSE;
+	g_variant_get(retval, "(b)", &enabled);
+	g_variant_unref(retval);
+
+	*answered = TRUE;
+	return enabled;
+}
+
+/* Developer mode, from the cache in the runtime directory when it is
+   fresh enough and from the property service otherwise */
+static gboolean
+developer_mode (void)
+{
+	gchar * cachefile = NULL;
+	const gchar * runtimedir = g_getenv("XDG_RUNTIME_DIR");
+	if (runtimedir != NULL && runtimedir[0] != '\0') {
+		cachefile = g_build_filename(runtimedir, "ubuntu-app-launch", "developer-mode", NULL);
+	}
+
+	if (cachefile != NULL) {
+		GStatBuf info;
+		gchar * cached = NULL;
+		if (g_stat(cachefile, &info) == 0 &&
+				ABS(g_get_real_time() / G_USEC_PER_SEC - (gint64)info.st_mtime) < DEVELOPER_MODE_CACHE_S &&
+				g_file_get_contents(cachefile, &cached, NULL, NULL)) {
+			gboolean enabled = g_strcmp0(cached, "true") == 0;
+			g_free(cached);
+			g_free(cachefile);
+			return enabled;
+		}
+	}
+
+	gboolean answered = FALSE;
+	gboolean enabled = developer_mode_query(&answered);
+
+	/* Only remember real answers, the next one to stop can try again */
+	if (cachefile != NULL && answered) {
+		gchar * cachedir = g_path_get_dirname(cachefile);
+		GError * error = NULL;
+
+		if (g_mkdir_with_parents(cachedir, 0700) != 0 ||
+				!g_file_set_contents(cachefile, enabled ? "true" : "false", -1, &error)) {
+			g_debug("Unable to cache developer mode in '%s': %s", cachefile, error != NULL ? error->message : g_strerror(errno));
+		}
+
+		g_clear_error(&error);
+		g_free(cachedir);
+	}
+
+	g_free(cachefile);
+	return enabled;
+}
+
+/* Upstart names the job's log after the job and instance, and rotates
+   it by adding to the end of the name */
+static void
+remove_logs (void)
+{
+	const gchar * job = g_getenv("UPSTART_JOB");
+	const gchar * instance = g_getenv("UPSTART_INSTANCE");
+	if (job == NULL || instance == NULL) {
+		g_debug("Not running under Upstart, no logs to remove");
+		return;
+	}
+
+	gchar * prefix = g_strdup_printf("%s-%s.log", job, instance);
+	/* Upstart can't have slashes in the file name */
+	g_strdelimit(prefix, "/", '_');
+
+	gchar * logdir = g_build_filename(g_get_user_cache_dir(), "upstart", NULL);
+	GDir * dir = g_dir_open(logdir, 0, NULL);
+	if (dir != NULL) {
+		const gchar * name;
+		while ((name = g_dir_read_name(dir)) != NULL) {
+			if (!g_str_has_prefix(name, prefix))
+				continue;
+
+			gchar * path = g_build_filename(logdir, name, NULL);
+			g_debug("Removing log: %s", path);
+			g_unlink(path);
+			g_free(path);
+		}
+		g_dir_close(dir);
+	}
+
+	g_free(logdir);
+	g_free(prefix);
+}
+
+/* The files the library passes in the environment are removed as
+   they're read, these are for when it never got that far */
+static void
+remove_launch_files (void)
+{
+	const gchar * files[] = { "APP_URIS_FILE", "APP_EXEC_PLAN", NULL };
+	int i;
+	for (i = 0; files[i] != NULL; i++) {
+		const gchar * path = g_getenv(files[i]);
+		if (path != NULL && path[0] != '\0')
+			g_unlink(path);
+	}
+}
+
+int
+main (int argc, char * argv[])
+{
+	if (argc != 2 || (g_strcmp0(argv[1], "post-start") != 0 && g_strcmp0(argv[1], "post-stop") != 0)) {
+		g_printerr("Usage: %s [post-start|post-stop]\n", argv[0]);
+		return 1;
+	}
+
+	const gchar * appid = g_getenv("APP_ID");
+	if (appid == NULL) {
+		g_printerr("No App ID defined");
+		return 1;
+	}
+
+	gboolean started = g_strcmp0(argv[1], "post-start") == 0;
+
+	/* Zeitgeist gets the event while we do the rest */
+	GMainLoop * main_loop = g_main_loop_new(NULL, FALSE);
+	gboolean reporting = zg_report_app(appid, started, main_loop);
+
+	if (!started) {
+		/* Break off a new process group */
+		setpgid(0, 0);
+
+		GDBusConnection * cgmanager = cgroup_manager_connection();
+		if (cgmanager != NULL) {
+			cgroup_reap_all(cgmanager);
+			cgroup_manager_unref(cgmanager);
+		}
+
+		remove_launch_files();
+
+		if (!developer_mode()) {
+			remove_logs();
+		}
+	}
+
+	if (reporting) {
+		g_timeout_add_seconds(ZG_REPORT_TIMEOUT_S, watchdog_timeout, main_loop);
+		g_main_loop_run(main_loop);
+	}
+
+	g_main_loop_unref(main_loop);
+
+	return 0;
+}
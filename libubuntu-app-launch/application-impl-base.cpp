@@ -19,14 +19,22 @@
 
 #include <algorithm>
 #include <cerrno>
+#include <chrono>
+#include <cstdlib>
 #include <cstring>
 #include <map>
-#include <numeric>
+#include <thread>
 
+#include <dirent.h>
+#include <fcntl.h>
+#include <glib/gstdio.h>
+#include <unistd.h>
 #include <upstart.h>
 
 #include "application-impl-base.h"
 #include "helpers.h"
+#include "launch-exec-plan.h"
+#include "launch-readahead.h"
 #include "registry-impl.h"
 #include "second-exec-core.h"
 
@@ -41,6 +49,16 @@ namespace app_launch
 namespace app_impls
 {
 
+namespace
+{
+/** How long an application launched in standby gets to start before it
+    is frozen */
+constexpr std::chrono::seconds STANDBY_SETTLE{3};
+/** Past this many bytes of URLs they're passed in a file instead of the
+    environment, which gets copied through Upstart more than once */
+constexpr size_t URI_FILE_THRESHOLD = 16 * 1024;
+}  // namespace
+
 Base::Base(const std::shared_ptr<Registry>& registry)
     : _registry(registry)
 {
@@ -54,19 +72,19 @@ bool Base::hasInstances()
 /** Function to create all the standard environment variables that we're
     building for everyone. Mostly stuff involving paths.
 
+    \param env Environment to add the variables to
     \param package Name of the package
     \param pkgdir Directory that the package lives in
 */
-std::list<std::pair<std::string, std::string>> Base::confinedEnv(const std::string& package, const std::string& pkgdir)
+void Base::confinedEnv(EnvBuilder& env, const std::string& package, const std::string& pkgdir)
 {
-    std::list<std::pair<std::string, std::string>> retval{{"UBUNTU_APPLICATION_ISOLATION", "1"}};
+    env.add("UBUNTU_APPLICATION_ISOLATION", "1");
 
     /* C Funcs can return null, which offends std::string */
-    auto cset = [&retval](const gchar* key, const gchar* value) {
+    auto cset = [&env](const gchar* key, const gchar* value) {
         if (value != nullptr)
         {
-            g_debug("Setting '%s' to '%s'", key, value);
-            retval.emplace_back(std::make_pair(key, value));
+            env.add(key, value);
         }
     };
 
@@ -93,8 +111,6 @@ std::list<std::pair<std::string, std::string>> Base::confinedEnv(const std::stri
     gchar* nv_shader_cachedir = g_strdup_printf("%s/%s", g_get_user_cache_dir(), package.c_str());
     cset("__GL_SHADER_DISK_CACHE_PATH", nv_shader_cachedir);
     g_free(nv_shader_cachedir);
-
-    return retval;
 }
 
 /** Checks to see if we have a primary PID for the instance */
@@ -269,8 +285,9 @@ std::vector<pid_t> UpstartInstance::pids(const std::shared_ptr<Registry>& reg,
     return pids;
 }
 
-/** Pauses this application by sending SIGSTOP to all the PIDs in the
-    cgroup and tells Zeitgeist that we've left the application. */
+/** Pauses this application by freezing its cgroup, or if that isn't
+    possible by sending SIGSTOP to all the PIDs in the cgroup, and tells
+    Zeitgeist that we've left the application. */
 void UpstartInstance::pause()
 {
     g_debug("Pausing application: %s", std::string(appId_).c_str());
@@ -280,12 +297,26 @@ void UpstartInstance::pause()
     auto jobpath = upstartJobPath();
 
     registry->impl->thread.executeOnThread([registry, appid, jobpath] {
-        auto pids = forAllPids(registry, appid, jobpath, [](pid_t pid) {
-            auto oomval = oom::paused();
-            g_debug("Pausing PID: %d (%d)", pid, int(oomval));
-            signalToPid(pid, SIGSTOP);
-            oomValueToPid(pid, oomval);
-        });
+        auto oomval = oom::paused();
+        std::vector<pid_t> pids;
+
+        if (registry->impl->setCgroupFrozen(jobpath, true))
+        {
+            /* Nothing in the group can fork while it is frozen, so a
+               single list has all of the PIDs */
+            pids = UpstartInstance::pids(registry, appid, jobpath);
+        }
+        else
+        {
+            pids = forAllPids(registry, appid, jobpath, [](pid_t pid) {
+                g_debug("Pausing PID: %d", pid);
+                signalToPid(pid, SIGSTOP);
+            });
+        }
+
+        /* Stopped processes can't fork, so setting the OOM values after
+           we have all of them doesn't miss any */
+        oomValueToPids(pids, oomval);
 
         pidListToDbus(registry, appid, pids, "ApplicationPaused");
     });
@@ -293,8 +324,9 @@ void UpstartInstance::pause()
     registry_->impl->zgSendEvent(appId_, ZEITGEIST_ZG_LEAVE_EVENT);
 }
 
-/** Resumes this application by sending SIGCONT to all the PIDs in the
-    cgroup and tells Zeitgeist that we're accessing the application. */
+/** Resumes this application by thawing its cgroup, or if that isn't
+    possible by sending SIGCONT to all the PIDs in the cgroup, and tells
+    Zeitgeist that we're accessing the application. */
 void UpstartInstance::resume()
 {
     g_debug("Resuming application: %s", std::string(appId_).c_str());
@@ -304,12 +336,35 @@ void UpstartInstance::resume()
     auto jobpath = upstartJobPath();
 
     registry->impl->thread.executeOnThread([registry, appid, jobpath] {
-        auto pids = forAllPids(registry, appid, jobpath, [](pid_t pid) {
-            auto oomval = oom::focused();
-            g_debug("Resuming PID: %d (%d)", pid, int(oomval));
+        auto oomval = oom::focused();
+
+        /* While the group is still frozen a single list has all of the
+           PIDs. We still send SIGCONT to them in case they were paused
+           with signals, it does nothing to ones that weren't. */
+        auto pids = UpstartInstance::pids(registry, appid, jobpath);
+        for (auto pid : pids)
+        {
+            g_debug("Resuming PID: %d", pid);
             signalToPid(pid, SIGCONT);
-            oomValueToPid(pid, oomval);
-        });
+        }
+        oomValueToPids(pids, oomval);
+
+        if (!registry->impl->setCgroupFrozen(jobpath, false))
+        {
+            std::set<pid_t> done(pids.begin(), pids.end());
+            std::vector<pid_t> added;
+
+            pids = forAllPids(registry, appid, jobpath, [&done, &added](pid_t pid) {
+                if (done.find(pid) == done.end())
+                {
+                    g_debug("Resuming PID: %d", pid);
+                    signalToPid(pid, SIGCONT);
+                    added.push_back(pid);
+                }
+            });
+
+            oomValueToPids(added, oomval);
+        }
 
         pidListToDbus(registry, appid, pids, "ApplicationResumed");
     });
@@ -318,7 +373,10 @@ void UpstartInstance::resume()
 }
 
 /** Stops this instance by asking Upstart to stop it. Upstart will then
-    send a SIGTERM and five seconds later start killing things. */
+    send a SIGTERM and five seconds later start killing things. If the
+    instance is paused its cgroup is thawed first, as signals aren't
+    delivered to frozen processes and the post-stop hook would freeze
+    itself joining the group. */
 void UpstartInstance::stop()
 {
     if (!registry_->impl->thread.executeOnThread<bool>([this]() {
@@ -326,6 +384,8 @@ void UpstartInstance::stop()
             g_debug("Stopping job %s app_id %s instance_id %s", job_.c_str(), std::string(appId_).c_str(),
                     instance_.c_str());
 
+            registry_->impl->setCgroupFrozen(upstartJobPath(), false);
+
             auto jobpath = registry_->impl->upstartJobPath(job_);
             if (jobpath.empty())
             {
@@ -386,7 +446,7 @@ void UpstartInstance::stop()
 */
 void UpstartInstance::setOomAdjustment(const oom::Score score)
 {
-    forAllPids(registry_, appId_, upstartJobPath(), [score](pid_t pid) { oomValueToPid(pid, score); });
+    oomValueToPids(forAllPids(registry_, appId_, upstartJobPath(), [](pid_t) {}), score);
 }
 
 /** Figures out the path to the primary PID of the application and
@@ -465,13 +525,9 @@ void UpstartInstance::signalToPid(pid_t pid, int signal)
     }
 }
 
-/** Get the path to the PID's OOM adjust path, with allowing for an
-    override for testing using the environment variable
-    UBUNTU_APP_LAUNCH_OOM_PROC_PATH
-
-    \param pid PID to build path for
-*/
-std::string UpstartInstance::pidToOomPath(pid_t pid)
+/** Get the path to proc, with allowing for an override for testing
+    using the environment variable UBUNTU_APP_LAUNCH_OOM_PROC_PATH */
+std::string UpstartInstance::oomProcPath()
 {
     static std::string procpath;
     if (G_UNLIKELY(procpath.empty()))
@@ -484,109 +540,166 @@ std::string UpstartInstance::pidToOomPath(pid_t pid)
             procpath = envvar;
     }
 
-    gchar* gpath = g_build_filename(procpath.c_str(), std::to_string(pid).c_str(), "oom_score_adj", nullptr);
+    return procpath;
+}
+
+/** Get the path to the PID's OOM adjust path
+
+    \param pid PID to build path for
+*/
+std::string UpstartInstance::pidToOomPath(pid_t pid)
+{
+    gchar* gpath = g_build_filename(oomProcPath().c_str(), std::to_string(pid).c_str(), "oom_score_adj", nullptr);
     std::string path = gpath;
     g_free(gpath);
     return path;
 }
 
-/** Writes an OOM value to proc, assuming we have a string
-    in the outer loop
+/** Writes an OOM value to proc for a set of PIDs. Proc is opened once
+    and each PID's file is opened relative to it. Any PIDs that we
+    aren't allowed to write are all handed to the helper together.
 
-    \param pid PID to change the OOM value of
+    \param pids PIDs to change the OOM value of
     \param oomvalue OOM value to set
 */
-void UpstartInstance::oomValueToPid(pid_t pid, const oom::Score oomvalue)
+void UpstartInstance::oomValueToPids(const std::vector<pid_t>& pids, const oom::Score oomvalue)
 {
+    if (pids.empty())
+    {
+        return;
+    }
+
     auto oomstr = std::to_string(static_cast<std::int32_t>(oomvalue));
-    auto path = pidToOomPath(pid);
-    FILE* adj = fopen(path.c_str(), "w");
-    int openerr = errno;
+    int procdir = open(oomProcPath().c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (procdir < 0)
+    {
+        g_warning("Unable to open '%s' to set OOM values: %s", oomProcPath().c_str(), std::strerror(errno));
+        return;
+    }
 
-    if (adj == nullptr)
+    std::vector<pid_t> helperpids;
+
+    for (auto pid : pids)
     {
-        switch (openerr)
+        auto path = std::to_string(pid) + "/oom_score_adj";
+        int adj = openat(procdir, path.c_str(), O_WRONLY | O_TRUNC | O_CLOEXEC);
+        int openerr = errno;
+
+        if (adj < 0)
         {
-            case ENOENT:
-                /* ENOENT happens a fair amount because of races, so it's not
-                   worth printing a warning about */
-                return;
-            case EACCES:
+            switch (openerr)
             {
-                /* We can get this error when trying to set the OOM value on
-                   Oxide renderers because they're started by the sandbox and
-                   don't have their adjustment value available for us to write.
-                   We have a helper to deal with this, but it's kinda expensive
-                   so we only use it when we have to. */
-                oomValueToPidHelper(pid, oomvalue);
-                return;
+                case ENOENT:
+                    /* ENOENT happens a fair amount because of races, so it's not
+                       worth printing a warning about */
+                    break;
+                case EACCES:
+                    /* We can get this error when trying to set the OOM value on
+                       Oxide renderers because they're started by the sandbox and
+                       don't have their adjustment value available for us to write.
+                       We have a helper to deal with this, but it's kinda expensive
+                       so we only use it when we have to. */
+                    helperpids.push_back(pid);
+                    break;
+                default:
+                    g_warning("Unable to set OOM value for '%d' to '%s': %s", int(pid), oomstr.c_str(),
+                              std::strerror(openerr));
+                    break;
             }
-            default:
-                g_warning("Unable to set OOM value for '%d' to '%s': %s", int(pid), oomstr.c_str(),
-                          std::strerror(openerr));
-                return;
+            continue;
         }
-    }
 
-    size_t writesize = fwrite(oomstr.c_str(), 1, oomstr.size(), adj);
-    int writeerr = errno;
-    fclose(adj);
+        auto writesize = write(adj, oomstr.c_str(), oomstr.size());
+        int writeerr = errno;
+        close(adj);
 
-    if (writesize == oomstr.size())
-        return;
+        if (writesize == ssize_t(oomstr.size()))
+            continue;
 
-    if (writeerr != 0)
-        g_warning("Unable to set OOM value for '%d' to '%s': %s", int(pid), oomstr.c_str(), strerror(writeerr));
-    else
-        /* No error, but yet, wrong size. Not sure, what could cause this. */
-        g_debug("Unable to set OOM value for '%d' to '%s': Wrote %d bytes", int(pid), oomstr.c_str(), int(writesize));
+        if (writesize < 0)
+            g_warning("Unable to set OOM value for '%d' to '%s': %s", int(pid), oomstr.c_str(),
+                      std::strerror(writeerr));
+        else
+            /* No error, but yet, wrong size. Not sure, what could cause this. */
+            g_debug("Unable to set OOM value for '%d' to '%s': Wrote %d bytes", int(pid), oomstr.c_str(),
+                    int(writesize));
+    }
+
+    close(procdir);
+
+    oomValueToPidsHelper(helperpids, oomvalue);
 }
 
 /** Use a setuid root helper for setting the oom value of
-    Chromium instances
+    Chromium instances. All the PIDs are written to a pipe that
+    becomes the helper's stdin, so it takes a single exec for any
+    number of them.
 
-    \param pid PID to change the OOM value of
+    \param pids PIDs to change the OOM value of
     \param oomvalue OOM value to set
 */
-void UpstartInstance::oomValueToPidHelper(pid_t pid, const oom::Score oomvalue)
+void UpstartInstance::oomValueToPidsHelper(const std::vector<pid_t>& pids, const oom::Score oomvalue)
 {
-    GError* error = nullptr;
     std::string oomstr = std::to_string(static_cast<std::int32_t>(oomvalue));
-    std::string pidstr = std::to_string(pid);
-    std::array<const char*, 4> args = {OOM_HELPER, pidstr.c_str(), oomstr.c_str(), nullptr};
-
-    g_debug("Excuting OOM Helper (pid: %d, score: %d): %s", int(pid), int(oomvalue),
-            std::accumulate(args.begin(), args.end(), std::string{},
-                            [](const std::string& instr, const char* output) -> std::string {
-                                if (instr.empty())
-                                {
-                                    return output;
-                                }
-                                else if (output != nullptr)
-                                {
-                                    return instr + " " + std::string(output);
-                                }
-                                else
-                                {
-                                    return instr;
-                                }
-                            })
-                .c_str());
-
-    g_spawn_async(nullptr,               /* working dir */
-                  (char**)(args.data()), /* args */
-                  nullptr,               /* env */
-                  G_SPAWN_DEFAULT,       /* flags */
-                  nullptr,               /* child setup */
-                  nullptr,               /* child setup userdata*/
-                  nullptr,               /* pid */
-                  &error);               /* error */
+    std::array<const char*, 3> args = {OOM_HELPER, "--stdin", nullptr};
+    size_t next = 0;
 
-    if (error != nullptr)
+    while (next < pids.size())
     {
-        g_warning("Unable to launch OOM helper '" OOM_HELPER "' on PID '%d': %s", pid, error->message);
-        g_error_free(error);
-        return;
+        int fds[2];
+        if (pipe2(fds, O_CLOEXEC | O_NONBLOCK) != 0)
+        {
+            g_warning("Unable to create pipe for OOM helper: %s", std::strerror(errno));
+            return;
+        }
+
+        /* The whole list goes into the pipe before the helper starts, so
+           we never block on it or get SIGPIPE if it dies. Lines are
+           shorter than PIPE_BUF so each write is all or nothing, if the
+           pipe fills up the rest go to another helper. */
+        size_t first = next;
+        for (; next < pids.size(); next++)
+        {
+            auto line = std::to_string(pids[next]) + " " + oomstr + "\n";
+            if (write(fds[1], line.c_str(), line.size()) != ssize_t(line.size()))
+            {
+                break;
+            }
+        }
+        close(fds[1]);
+        fcntl(fds[0], F_SETFL, 0);
+
+        if (next == first)
+        {
+            g_warning("Unable to write PIDs to OOM helper: %s", std::strerror(errno));
+            close(fds[0]);
+            return;
+        }
+
+        g_debug("Excuting OOM Helper (pids: %d, score: %d): " OOM_HELPER " --stdin", int(next - first),
+                int(oomvalue));
+
+        GError* error = nullptr;
+        g_spawn_async(nullptr,               /* working dir */
+                      (char**)(args.data()), /* args */
+                      nullptr,               /* env */
+                      G_SPAWN_DEFAULT,       /* flags */
+                      [](gpointer data) {    /* child setup */
+                          dup2(GPOINTER_TO_INT(data), STDIN_FILENO);
+                      },
+                      GINT_TO_POINTER(fds[0]), /* child setup userdata*/
+                      nullptr,                 /* pid */
+                      &error);                 /* error */
+
+        close(fds[0]);
+
+        if (error != nullptr)
+        {
+            g_warning("Unable to launch OOM helper '" OOM_HELPER "' on %d PIDs: %s", int(next - first),
+                      error->message);
+            g_error_free(error);
+            return;
+        }
     }
 }
 
@@ -697,15 +810,160 @@ std::shared_ptr<gchar*> UpstartInstance::urlsToStrv(const std::vector<Applicatio
     return std::shared_ptr<gchar*>((gchar**)g_array_free(array, FALSE), g_strfreev);
 }
 
-/** Small helper that we can new/delete to work better with C stuff */
+/** Directory for the files we pass to exec-line-exec, which removes them
+    once it has read them. It is the application's TMPDIR when it has one
+    so that a confined application can read them. Returns an empty string
+    if there isn't one.
+
+    \param env Environment the application is being launched with
+*/
+std::string UpstartInstance::launchFileDir(const EnvBuilder& env)
+{
+    auto dir = env.value("TMPDIR");
+    if (!dir.empty())
+    {
+        return dir;
+    }
+
+    gchar* cdir = g_build_filename(g_get_user_runtime_dir(), "ubuntu-app-launch", "launch", nullptr);
+    dir = cdir;
+    g_free(cdir);
+
+    if (g_mkdir_with_parents(dir.c_str(), 0700) != 0)
+    {
+        g_warning("Unable to create directory for launch files '%s': %s", dir.c_str(), g_strerror(errno));
+        return {};
+    }
+
+    return dir;
+}
+
+/** Writes the URLs to a file for exec-line-exec to read. Returns the
+    path, or an empty string if it couldn't be written.
+
+    \param dir Directory from launchFileDir()
+    \param urls URLs to write
+*/
+std::string UpstartInstance::writeUriFile(const std::string& dir, const std::vector<Application::URL>& urls)
+{
+    auto urlsv = urlsToStrv(urls);
+    gchar* cpath = uri_file_write(dir.c_str(), urlsv.get());
+    if (cpath == nullptr)
+    {
+        return {};
+    }
+
+    std::string path(cpath);
+    g_free(cpath);
+    return path;
+}
+
+/** State of a launch that is in flight. It is made once the environment
+    is built, waits for the handshake with Unity, and then for Upstart to
+    answer the Start call, after which it is freed. Many of these can be
+    waiting at once without blocking the registry thread. */
 struct StartCHelper
 {
+    /** Registry the launch is on. Waiting on Unity doesn't keep it
+        around, it finishes the handshakes that are left when it goes. */
+    Registry::Impl* impl;
+    std::weak_ptr<Registry> registry;
+    /** Instance handed back by the launch, and what's needed to make it
+        again if nobody kept it */
+    std::weak_ptr<UpstartInstance> weakInstance;
+    AppID appId;
+    std::string job;
+    std::string instance;
+    std::vector<Application::URL> urls;
+    /** Handshake being waited on, until it's done */
+    handshake_t* handshake;
+    /** Instance while Upstart is answering, which keeps the registry
+        around for the answer */
     std::shared_ptr<UpstartInstance> ptr;
+    /** How the instance is being launched */
+    UpstartInstance::launchMode mode;
+    /** Upstart job path to call Start on */
+    std::string jobpath;
+    /** Parameters for the Start call */
+    std::shared_ptr<GVariant> params;
+    /** File the URLs were written to, if they were too big for the
+        environment */
+    std::string urifile;
+    /** Exec plan for exec-line-exec, if there is one */
+    std::string planfile;
 };
 
-/** Callback from starting an application. It checks to see whether the
-    app is already running. If it is already running then we need to send
-    the URLs to it via DBus.
+/** Callback from the starting handshake, called once Unity has answered
+    or we've given up waiting on it. Sends the Start call to Upstart, the
+    answer comes to application_start_cb(). If the registry is going away
+    the call is made here, as nothing would be left to take the answer.
+
+    \param user_data A pointer to a StartCHelper structure
+*/
+void UpstartInstance::application_handshake_cb(gpointer user_data)
+{
+    auto data = static_cast<StartCHelper*>(user_data);
+    std::string appIdStr{data->appId};
+
+    data->impl->pendingHandshakes.erase(data->handshake);
+    data->handshake = nullptr;
+
+    tracepoint(ubuntu_app_launch, handshake_complete, appIdStr.c_str());
+
+    auto registry = data->registry.lock();
+    if (registry && !data->impl->shuttingDown)
+    {
+        data->ptr = data->weakInstance.lock();
+        if (!data->ptr)
+        {
+            data->ptr = std::make_shared<UpstartInstance>(data->appId, data->job, data->instance, data->urls, registry);
+        }
+    }
+
+    /* Call the job start function */
+    g_debug("Asking Upstart to start task for: %s", appIdStr.c_str());
+
+    if (!data->ptr)
+    {
+        GError* error{nullptr};
+        auto result = g_dbus_connection_call_sync(data->impl->_dbus.get(),    /* bus */
+                                                  DBUS_SERVICE_UPSTART,       /* service name */
+                                                  data->jobpath.c_str(),      /* Path */
+                                                  DBUS_INTERFACE_UPSTART_JOB, /* interface */
+                                                  "Start",                    /* method */
+                                                  data->params.get(),         /* params */
+                                                  nullptr,                    /* return */
+                                                  G_DBUS_CALL_FLAGS_NONE,     /* flags */
+                                                  -1,                         /* default timeout */
+                                                  nullptr,                    /* cancellable */
+                                                  &error);                    /* error */
+        g_clear_pointer(&result, g_variant_unref);
+
+        tracepoint(ubuntu_app_launch, libual_start_message_sent, appIdStr.c_str());
+
+        application_started(data, error);
+        return;
+    }
+
+    g_dbus_connection_call(data->impl->_dbus.get(),                   /* bus */
+                           DBUS_SERVICE_UPSTART,                      /* service name */
+                           data->jobpath.c_str(),                     /* Path */
+                           DBUS_INTERFACE_UPSTART_JOB,                /* interface */
+                           "Start",                                   /* method */
+                           data->params.get(),                        /* params */
+                           nullptr,                                   /* return */
+                           G_DBUS_CALL_FLAGS_NONE,                    /* flags */
+                           -1,                                        /* default timeout */
+                           data->impl->thread.getCancellable().get(), /* cancellable */
+                           application_start_cb,                      /* callback */
+                           data                                       /* object */
+                           );
+
+    tracepoint(ubuntu_app_launch, libual_start_message_sent, appIdStr.c_str());
+}
+
+/** Callback from starting an application, handing the answer to
+    application_started().
 
     \param obj The GDBusConnection object
     \param res Async result object
@@ -717,28 +975,50 @@ void UpstartInstance::application_start_cb(GObject* obj, GAsyncResult* res, gpoi
     GError* error{nullptr};
     GVariant* result{nullptr};
 
-    tracepoint(ubuntu_app_launch, libual_start_message_callback, std::string(data->ptr->appId_).c_str());
+    tracepoint(ubuntu_app_launch, libual_start_message_callback, std::string(data->appId).c_str());
 
-    g_debug("Started Message Callback: %s", std::string(data->ptr->appId_).c_str());
+    g_debug("Started Message Callback: %s", std::string(data->appId).c_str());
 
     result = g_dbus_connection_call_finish(G_DBUS_CONNECTION(obj), res, &error);
 
     g_clear_pointer(&result, g_variant_unref);
 
+    application_started(data, error);
+}
+
+/** Handles Upstart's answer to the Start call. It checks to see whether
+    the app is already running. If it is already running then we need to
+    send the URLs to it via DBus. Frees @data and @error.
+
+    \param data The launch that was started
+    \param error Error from the Start call, if any
+*/
+void UpstartInstance::application_started(StartCHelper* data, GError* error)
+{
+    std::string appIdStr{data->appId};
+
     if (error != nullptr)
     {
         if (g_dbus_error_is_remote_error(error))
         {
             gchar* remote_error = g_dbus_error_get_remote_error(error);
             g_debug("Remote error: %s", remote_error);
-            if (g_strcmp0(remote_error, "com.ubuntu.Upstart0_6.Error.AlreadyStarted") == 0)
+            if (g_strcmp0(remote_error, "com.ubuntu.Upstart0_6.Error.AlreadyStarted") == 0 &&
+                data->mode != launchMode::STANDBY)
             {
-                auto urls = urlsToStrv(data->ptr->urls_);
-                second_exec(data->ptr->registry_->impl->_dbus.get(),                   /* DBus */
-                            data->ptr->registry_->impl->thread.getCancellable().get(), /* cancellable */
-                            data->ptr->primaryPid(),                                   /* primary pid */
-                            std::string(data->ptr->appId_).c_str(),                    /* appid */
-                            urls.get());                                               /* urls */
+                if (data->ptr)
+                {
+                    auto urls = urlsToStrv(data->urls);
+                    second_exec(data->impl->_dbus.get(),                   /* DBus */
+                                data->impl->thread.getCancellable().get(), /* cancellable */
+                                data->ptr->primaryPid(),                   /* primary pid */
+                                appIdStr.c_str(),                          /* appid */
+                                urls.get());                               /* urls */
+                }
+                else
+                {
+                    g_warning("Unable to send URLs to '%s' as the registry is going away", appIdStr.c_str());
+                }
             }
 
             g_free(remote_error);
@@ -748,11 +1028,183 @@ void UpstartInstance::application_start_cb(GObject* obj, GAsyncResult* res, gpoi
             g_warning("Unable to emit event to start application: %s", error->message);
         }
         g_error_free(error);
+
+        if (data->mode == launchMode::STANDBY)
+        {
+            data->impl->standbySettling.erase(appIdStr);
+        }
+
+        /* Nothing is going to read them */
+        if (!data->urifile.empty())
+        {
+            g_unlink(data->urifile.c_str());
+        }
+        if (!data->planfile.empty())
+        {
+            g_unlink(data->planfile.c_str());
+        }
+    }
+    else if (data->mode == launchMode::STANDBY)
+    {
+        if (data->ptr)
+        {
+            /* Give it a moment to get itself off of the disk, which is
+               the slow part of starting, and then stop it where it is */
+            auto instance = data->ptr;
+            instance->registry_->impl->thread.timeoutSeconds(STANDBY_SETTLE,
+                                                             [instance]() { enterStandby(instance); });
+        }
+        else
+        {
+            /* Nothing is left to freeze it, so it stays running */
+            data->impl->standbySettling.erase(appIdStr);
+        }
     }
 
     delete data;
 }
 
+/** Where we keep track of an application that is in standby. The file
+    has the Upstart instance that is frozen.
+
+    \param appid Application ID
+*/
+std::string UpstartInstance::standbyPath(const AppID& appid)
+{
+    gchar* cpath =
+        g_build_filename(g_get_user_runtime_dir(), "ubuntu-app-launch", "standby", std::string(appid).c_str(), nullptr);
+    std::string path(cpath);
+    g_free(cpath);
+    return path;
+}
+
+/** Freezes an instance that was launched in standby and records it so
+    that the next launch of the application brings it back. The OOM
+    score from exec-line-exec gets set again in case the application
+    changed it. If the user launched the application while it was
+    settling it is left running.
+
+    \param instance Instance launched in standby
+*/
+void UpstartInstance::enterStandby(const std::shared_ptr<UpstartInstance>& instance)
+{
+    std::string appIdStr{instance->appId_};
+    if (instance->registry_->impl->standbySettling.erase(appIdStr) == 0)
+    {
+        /* It could have been before exec-line-exec lowered them */
+        g_debug("Application '%s' was launched before it settled, not going into standby", appIdStr.c_str());
+        standbyPriorityClear(instance->pids());
+        return;
+    }
+
+    auto jobpath = instance->upstartJobPath();
+
+    if (!instance->registry_->impl->setCgroupFrozen(jobpath, true))
+    {
+        g_warning("Unable to freeze '%s' for standby, leaving it running", appIdStr.c_str());
+        return;
+    }
+
+    oomValueToPids(pids(instance->registry_, instance->appId_, jobpath), static_cast<oom::Score>(STANDBY_OOM_SCORE));
+
+    auto path = standbyPath(instance->appId_);
+    auto dir = g_path_get_dirname(path.c_str());
+    g_mkdir_with_parents(dir, 0700);
+    g_free(dir);
+
+    GError* error = nullptr;
+    g_file_set_contents(path.c_str(), instance->instance_.c_str(), -1, &error);
+    if (error != nullptr)
+    {
+        g_warning("Unable to record standby of '%s': %s", appIdStr.c_str(), error->message);
+        g_error_free(error);
+        instance->registry_->impl->setCgroupFrozen(jobpath, false);
+        return;
+    }
+
+    tracepoint(ubuntu_app_launch, libual_standby_frozen, appIdStr.c_str());
+    g_debug("Application '%s' is in standby", appIdStr.c_str());
+}
+
+/** If the application is in standby, brings it back instead of starting
+    it again. The priorities from exec-line-exec are per thread so every
+    thread gets put back, then resuming thaws it and gives it a focused
+    OOM score, and the second exec sends the URLs and asks Unity to
+    focus it.
+
+    \param appId Application ID
+    \param job Upstart job name
+    \param urls URLs sent to the application
+    \param registry Registry of persistent connections to use
+    \return The instance that was in standby, or nullptr if there wasn't
+            one running
+*/
+std::shared_ptr<UpstartInstance> UpstartInstance::fromStandby(const AppID& appId,
+                                                              const std::string& job,
+                                                              const std::vector<Application::URL>& urls,
+                                                              const std::shared_ptr<Registry>& registry)
+{
+    auto path = standbyPath(appId);
+    gchar* cinstance = nullptr;
+    if (!g_file_get_contents(path.c_str(), &cinstance, nullptr, nullptr))
+    {
+        return {};
+    }
+
+    std::string instance(cinstance);
+    g_free(cinstance);
+    g_unlink(path.c_str());
+
+    auto retval = std::make_shared<UpstartInstance>(appId, job, instance, urls, registry);
+    if (!retval->isRunning())
+    {
+        g_debug("Application '%s' stopped while in standby", std::string(appId).c_str());
+        return {};
+    }
+
+    standbyPriorityClear(retval->pids());
+    retval->resume();
+
+    auto urlsv = urlsToStrv(urls);
+    second_exec(registry->impl->_dbus.get(),                   /* DBus */
+                registry->impl->thread.getCancellable().get(), /* cancellable */
+                retval->primaryPid(),                          /* primary pid */
+                std::string(appId).c_str(),                    /* appid */
+                urlsv.get());                                  /* urls */
+
+    tracepoint(ubuntu_app_launch, libual_standby_resumed, std::string(appId).c_str());
+
+    return retval;
+}
+
+/** Puts back the priorities that exec-line-exec lowered for standby.
+    They are per thread so every thread of each process gets them.
+
+    \param pids Processes of the application
+*/
+void UpstartInstance::standbyPriorityClear(const std::vector<pid_t>& pids)
+{
+    for (auto pid : pids)
+    {
+        auto taskpath = "/proc/" + std::to_string(pid) + "/task";
+        DIR* tasks = opendir(taskpath.c_str());
+        if (tasks == nullptr)
+        {
+            continue;
+        }
+
+        struct dirent* task;
+        while ((task = readdir(tasks)) != nullptr)
+        {
+            if (task->d_name[0] != '.')
+            {
+                standby_priority_set(std::atoi(task->d_name), FALSE);
+            }
+        }
+        closedir(tasks);
+    }
+}
+
 /** Launch an application and create a new UpstartInstance object to track
     its progress.
 
@@ -771,7 +1223,7 @@ std::shared_ptr<UpstartInstance> UpstartInstance::launch(
     const std::vector<Application::URL>& urls,
     const std::shared_ptr<Registry>& registry,
     launchMode mode,
-    std::function<std::list<std::pair<std::string, std::string>>(void)>& getenv)
+    std::function<EnvBuilder(void)>& getenv)
 {
     if (appId.empty())
         return {};
@@ -783,101 +1235,166 @@ std::shared_ptr<UpstartInstance> UpstartInstance::launch(
 
             tracepoint(ubuntu_app_launch, libual_start, appIdStr.c_str());
 
-            int timeout = 1;
-            if (ubuntu::app_launch::Registry::Impl::isWatchingAppStarting())
+            if (mode == launchMode::STANDARD)
             {
-                timeout = 0;
+                auto standby = fromStandby(appId, job, urls, registry);
+                if (standby)
+                {
+                    return standby;
+                }
+
+                /* Launched in standby and not frozen yet, so it stays
+                   running and the start below finds it there */
+                auto settling = registry->impl->standbySettling.find(appIdStr);
+                if (settling != registry->impl->standbySettling.end())
+                {
+                    g_debug("Application '%s' launched while settling into standby", appIdStr.c_str());
+                    UpstartInstance settlingInstance(appId, job, settling->second, urls, registry);
+                    standbyPriorityClear(settlingInstance.pids());
+                    registry->impl->standbySettling.erase(settling);
+                }
             }
 
-            auto handshake = starting_handshake_start(appIdStr.c_str(), timeout);
-            if (handshake == nullptr)
+            /* Nothing is waiting on a standby launch, so Unity doesn't
+               need to know about it until it is brought back */
+            handshake_t* handshake = nullptr;
+            if (mode != launchMode::STANDBY)
             {
-                g_warning("Unable to setup starting handshake");
+                int timeout = 1;
+                if (ubuntu::app_launch::Registry::Impl::isWatchingAppStarting())
+                {
+                    timeout = 0;
+                }
+
+                handshake = starting_handshake_start(appIdStr.c_str(), timeout);
+                if (handshake == nullptr)
+                {
+                    g_warning("Unable to setup starting handshake");
+                }
             }
 
             /* Figure out the DBus path for the job */
             auto jobpath = registry->impl->upstartJobPath(job);
+            tracepoint(ubuntu_app_launch, libual_job_path_determined, appIdStr.c_str(), jobpath.c_str());
 
-            /* Build up our environment */
+            /* Build up our environment while Unity is answering */
             auto env = getenv();
 
-            env.emplace_back(std::make_pair("APP_ID", appIdStr));                           /* Application ID */
-            env.emplace_back(std::make_pair("APP_LAUNCHER_PID", std::to_string(getpid()))); /* Who we are, for bugs */
+            env.add("APP_ID", appIdStr);                           /* Application ID */
+            env.add("APP_LAUNCHER_PID", std::to_string(getpid())); /* Who we are, for bugs */
 
+            auto filedir = launchFileDir(env);
+
+            std::string urifile;
             if (!urls.empty())
             {
-                auto accumfunc = [](const std::string& prev, Application::URL thisurl) -> std::string {
-                    gchar* gescaped = g_shell_quote(thisurl.value().c_str());
-                    std::string escaped;
-                    if (gescaped != nullptr)
-                    {
-                        escaped = gescaped;
-                        g_free(gescaped);
-                    }
-                    else
-                    {
-                        g_warning("Unable to escape URL: %s", thisurl.value().c_str());
-                        return prev;
-                    }
-
-                    if (prev.empty())
-                    {
-                        return escaped;
-                    }
-                    else
-                    {
-                        return prev + " " + escaped;
-                    }
-                };
-                auto urlstring = std::accumulate(urls.begin(), urls.end(), std::string{}, accumfunc);
-                env.emplace_back(std::make_pair("APP_URIS", urlstring));
+                size_t urlbytes = 0;
+                for (const auto& url : urls)
+                {
+                    urlbytes += url.value().size();
+                }
+
+                if (urlbytes > URI_FILE_THRESHOLD && !filedir.empty())
+                {
+                    urifile = writeUriFile(filedir, urls);
+                }
+
+                if (!urifile.empty())
+                {
+                    env.add("APP_URIS_FILE", urifile);
+                }
+                else
+                {
+                    env.addShellQuoted("APP_URIS", urls);
+                }
             }
 
             if (mode == launchMode::TEST)
             {
-                env.emplace_back(std::make_pair("QT_LOAD_TESTABILITY", "1"));
+                env.add("QT_LOAD_TESTABILITY", "1");
             }
 
-            /* Convert to GVariant */
-            GVariantBuilder builder;
-            g_variant_builder_init(&builder, G_VARIANT_TYPE_TUPLE);
+            if (mode == launchMode::STANDBY)
+            {
+                env.add("UBUNTU_APP_LAUNCH_STANDBY", "1");
+            }
 
-            g_variant_builder_open(&builder, G_VARIANT_TYPE_ARRAY);
+            /* Readahead only needs these, so it doesn't need a copy of
+               the environment */
+            auto exec = env.value("APP_EXEC");
+            auto appdir = env.value("APP_DIR");
+
+            /* Only the click job exports UBUNTU_APP_LAUNCH_ARCH for
+               exec-line-exec, the others never got the arch directories */
+            std::string arch = (job == "application-click") ? UBUNTU_APP_LAUNCH_ARCH : "";
 
-            for (const auto& envvar : env)
+            /* Do exec-line-exec's work while we're waiting on Unity
+               anyway, so that it can exec as soon as it starts */
+            std::string planfile;
+            if (!filedir.empty())
             {
-                g_variant_builder_add_value(&builder, g_variant_new_take_string(g_strdup_printf(
-                                                          "%s=%s", envvar.first.c_str(), envvar.second.c_str())));
+                auto plan = exec_plan::build(exec, appdir, arch, urls);
+                if (!plan.empty())
+                {
+                    planfile = exec_plan::write(filedir, plan);
+                }
+                if (!planfile.empty())
+                {
+                    env.add("APP_EXEC_PLAN", planfile);
+                }
             }
 
-            g_variant_builder_close(&builder);
-            g_variant_builder_add_value(&builder, g_variant_new_boolean(TRUE));
+            /* The environment's buffer is handed over to GVariant as it is */
+            auto params = g_variant_new("(@asb)", env.toVariant(), TRUE);
+
+            tracepoint(ubuntu_app_launch, libual_env_built, appIdStr.c_str());
+
+            /* Get the application coming off the disk while we wait on
+               Unity, so it is in the cache when exec-line-exec needs it.
+               Standby applications read themselves in at idle priority
+               instead. */
+            if (mode != launchMode::STANDBY)
+            {
+                std::thread([appIdStr, exec, appdir, arch]() {
+                    tracepoint(ubuntu_app_launch, libual_readahead_start, appIdStr.c_str());
+
+                    int count = 0;
+                    auto bytes = readahead::willNeed(readahead::files(exec, appdir, arch), count);
+
+                    tracepoint(ubuntu_app_launch, libual_readahead_complete, appIdStr.c_str(), count, bytes);
+                }).detach();
+            }
 
             auto retval = std::make_shared<UpstartInstance>(appId, job, instance, urls, registry);
-            auto chelper = new StartCHelper{};
-            chelper->ptr = retval;
+            if (mode == launchMode::STANDBY)
+            {
+                registry->impl->standbySettling[appIdStr] = instance;
+            }
 
+            auto chelper = new StartCHelper{};
+            chelper->impl = registry->impl.get();
+            chelper->registry = registry;
+            chelper->weakInstance = retval;
+            chelper->appId = appId;
+            chelper->job = job;
+            chelper->instance = instance;
+            chelper->urls = urls;
+            chelper->handshake = handshake;
+            chelper->mode = mode;
+            chelper->jobpath = jobpath;
+            chelper->params = std::shared_ptr<GVariant>(g_variant_ref_sink(params), g_variant_unref);
+            chelper->urifile = urifile;
+            chelper->planfile = planfile;
+
+            /* Rather than blocking the thread until Unity answers, the
+               rest of the launch happens in the callback so that other
+               launches can go on while we wait */
             tracepoint(ubuntu_app_launch, handshake_wait, appIdStr.c_str());
-            starting_handshake_wait(handshake);
-            tracepoint(ubuntu_app_launch, handshake_complete, appIdStr.c_str());
-
-            /* Call the job start function */
-            g_debug("Asking Upstart to start task for: %s", appIdStr.c_str());
-            g_dbus_connection_call(registry->impl->_dbus.get(),                   /* bus */
-                                   DBUS_SERVICE_UPSTART,                          /* service name */
-                                   jobpath.c_str(),                               /* Path */
-                                   DBUS_INTERFACE_UPSTART_JOB,                    /* interface */
-                                   "Start",                                       /* method */
-                                   g_variant_builder_end(&builder),               /* params */
-                                   nullptr,                                       /* return */
-                                   G_DBUS_CALL_FLAGS_NONE,                        /* flags */
-                                   -1,                                            /* default timeout */
-                                   registry->impl->thread.getCancellable().get(), /* cancellable */
-                                   application_start_cb,                          /* callback */
-                                   chelper                                        /* object */
-                                   );
-
-            tracepoint(ubuntu_app_launch, libual_start_message_sent, appIdStr.c_str());
+            if (handshake != nullptr)
+            {
+                registry->impl->pendingHandshakes.insert(handshake);
+            }
+            starting_handshake_notify(handshake, application_handshake_cb, chelper);
 
             return retval;
         });
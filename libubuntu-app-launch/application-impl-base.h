@@ -18,6 +18,7 @@
  */
 
 #include "application.h"
+#include "env-builder.h"
 
 extern "C" {
 #include "ubuntu-app-launch.h"
@@ -43,14 +44,18 @@ public:
 
     bool hasInstances() override;
 
+    /** Launch the application in standby, see Registry::prelaunch() */
+    virtual std::shared_ptr<Instance> launchStandby() = 0;
+
 protected:
     /** Pointer to the registry so we can ask it for things */
     std::shared_ptr<Registry> _registry;
 
-    static std::list<std::pair<std::string, std::string>> confinedEnv(const std::string& package,
-                                                                      const std::string& pkgdir);
+    static void confinedEnv(EnvBuilder& env, const std::string& package, const std::string& pkgdir);
 };
 
+struct StartCHelper;
+
 /** An object that represents an instance of a job on Upstart. This
     then implements everything needed by the instance interface. Most
     applications tie into this today and use it as the backend for
@@ -84,7 +89,8 @@ public:
     enum class launchMode
     {
         STANDARD, /**< Standard variable set */
-        TEST      /**< Include testing environment vars */
+        TEST,     /**< Include testing environment vars */
+        STANDBY   /**< Start in the background and freeze, for pre-launching */
     };
     static std::shared_ptr<UpstartInstance> launch(
         const AppID& appId,
@@ -93,7 +99,7 @@ public:
         const std::vector<Application::URL>& urls,
         const std::shared_ptr<Registry>& registry,
         launchMode mode,
-        std::function<std::list<std::pair<std::string, std::string>>(void)>& getenv);
+        std::function<EnvBuilder(void)>& getenv);
 
 private:
     /** Application ID */
@@ -122,11 +128,23 @@ private:
                               const std::vector<pid_t>& pids,
                               const std::string& signal);
     static void signalToPid(pid_t pid, int signal);
-    static void oomValueToPid(pid_t pid, const oom::Score oomvalue);
-    static void oomValueToPidHelper(pid_t pid, const oom::Score oomvalue);
+    static void oomValueToPids(const std::vector<pid_t>& pids, const oom::Score oomvalue);
+    static void oomValueToPidsHelper(const std::vector<pid_t>& pids, const oom::Score oomvalue);
+    static std::string oomProcPath();
     static std::string pidToOomPath(pid_t pid);
     static std::shared_ptr<gchar*> urlsToStrv(const std::vector<Application::URL>& urls);
+    static std::string launchFileDir(const EnvBuilder& env);
+    static std::string writeUriFile(const std::string& dir, const std::vector<Application::URL>& urls);
+    static std::string standbyPath(const AppID& appid);
+    static std::shared_ptr<UpstartInstance> fromStandby(const AppID& appId,
+                                                        const std::string& job,
+                                                        const std::vector<Application::URL>& urls,
+                                                        const std::shared_ptr<Registry>& registry);
+    static void enterStandby(const std::shared_ptr<UpstartInstance>& instance);
+    static void standbyPriorityClear(const std::vector<pid_t>& pids);
+    static void application_handshake_cb(gpointer user_data);
     static void application_start_cb(GObject* obj, GAsyncResult* res, gpointer user_data);
+    static void application_started(StartCHelper* data, GError* error);
 };
 
 }  // namespace app_impls
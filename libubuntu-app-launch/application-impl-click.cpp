@@ -342,36 +342,50 @@ std::vector<std::shared_ptr<Application::Instance>> Click::instances()
 
 /** Grabs all the environment variables for the application to
     launch in. It sets up the confinement ones and then adds in
-    the APP_EXEC line and whether to use XMir */
-std::list<std::pair<std::string, std::string>> Click::launchEnv()
+    the APP_EXEC line, whether to use XMir and whether the zygote
+    can start it */
+EnvBuilder Click::launchEnv()
 {
-    auto retval = confinedEnv(_appid.package, _clickDir);
+    EnvBuilder retval;
+    confinedEnv(retval, _appid.package, _clickDir);
 
-    retval.emplace_back(std::make_pair("APP_DIR", _clickDir));
-    retval.emplace_back(std::make_pair("APP_DESKTOP_FILE_PATH", desktopPath_));
+    retval.add("APP_DIR", _clickDir);
+    retval.add("APP_DESKTOP_FILE_PATH", desktopPath_);
 
     info();
 
-    retval.emplace_back(std::make_pair("APP_XMIR_ENABLE", _info->xMirEnable().value() ? "1" : "0"));
-    retval.emplace_back(std::make_pair("APP_EXEC", _info->execLine().value()));
+    retval.add("APP_XMIR_ENABLE", _info->xMirEnable().value() ? "1" : "0");
+    retval.add("APP_EXEC", _info->execLine().value());
+
+    if (!_info->zygoteLibrary().value().empty())
+    {
+        retval.add("APP_ZYGOTE_LIBRARY", _info->zygoteLibrary().value());
+    }
 
     return retval;
 }
 
 std::shared_ptr<Application::Instance> Click::launch(const std::vector<Application::URL>& urls)
 {
-    std::function<std::list<std::pair<std::string, std::string>>(void)> envfunc = [this]() { return launchEnv(); };
+    std::function<EnvBuilder(void)> envfunc = [this]() { return launchEnv(); };
     return UpstartInstance::launch(appId(), "application-click", {}, urls, _registry,
                                    UpstartInstance::launchMode::STANDARD, envfunc);
 }
 
 std::shared_ptr<Application::Instance> Click::launchTest(const std::vector<Application::URL>& urls)
 {
-    std::function<std::list<std::pair<std::string, std::string>>(void)> envfunc = [this]() { return launchEnv(); };
+    std::function<EnvBuilder(void)> envfunc = [this]() { return launchEnv(); };
     return UpstartInstance::launch(appId(), "application-click", {}, urls, _registry, UpstartInstance::launchMode::TEST,
                                    envfunc);
 }
 
+std::shared_ptr<Application::Instance> Click::launchStandby()
+{
+    std::function<EnvBuilder(void)> envfunc = [this]() { return launchEnv(); };
+    return UpstartInstance::launch(appId(), "application-click", {}, {}, _registry,
+                                   UpstartInstance::launchMode::STANDBY, envfunc);
+}
+
 }  // namespace app_impls
 }  // namespace app_launch
 }  // namespace ubuntu
@@ -62,6 +62,7 @@ public:
 
     std::shared_ptr<Instance> launch(const std::vector<Application::URL>& urls = {}) override;
     std::shared_ptr<Instance> launchTest(const std::vector<Application::URL>& urls = {}) override;
+    std::shared_ptr<Instance> launchStandby() override;
 
     static bool hasAppId(const AppID& appId, const std::shared_ptr<Registry>& registry);
 
@@ -87,7 +88,7 @@ private:
 
     std::shared_ptr<app_info::Desktop> _info;
 
-    std::list<std::pair<std::string, std::string>> launchEnv();
+    EnvBuilder launchEnv();
 };
 
 }  // namespace app_impls
@@ -314,15 +314,15 @@ std::vector<std::shared_ptr<Application::Instance>> Legacy::instances()
     the exec line and whether it needs XMir. Also we set the path if that
     is specified in the desktop file. We can also set an AppArmor profile
     if requested. */
-std::list<std::pair<std::string, std::string>> Legacy::launchEnv(const std::string& instance)
+EnvBuilder Legacy::launchEnv(const std::string& instance)
 {
-    std::list<std::pair<std::string, std::string>> retval;
+    EnvBuilder retval;
 
-    retval.emplace_back(std::make_pair("APP_DESKTOP_FILE_PATH", desktopPath_));
+    retval.add("APP_DESKTOP_FILE_PATH", desktopPath_);
 
     info();
 
-    retval.emplace_back(std::make_pair("APP_XMIR_ENABLE", appinfo_->xMirEnable().value() ? "1" : "0"));
+    retval.add("APP_XMIR_ENABLE", appinfo_->xMirEnable().value() ? "1" : "0");
     if (appinfo_->xMirEnable())
     {
         /* If we're setting up XMir we also need the other helpers
@@ -333,19 +333,18 @@ std::list<std::pair<std::string, std::string>> Legacy::launchEnv(const std::stri
             libertine_launch = LIBERTINE_LAUNCH;
         }
 
-        retval.emplace_back(
-            std::make_pair("APP_EXEC", std::string(libertine_launch) + " " + appinfo_->execLine().value()));
+        retval.add("APP_EXEC", std::string(libertine_launch) + " " + appinfo_->execLine().value());
     }
     else
     {
-        retval.emplace_back(std::make_pair("APP_EXEC", appinfo_->execLine().value()));
+        retval.add("APP_EXEC", appinfo_->execLine().value());
     }
 
     /* Honor the 'Path' key if it is in the desktop file */
     if (g_key_file_has_key(_keyfile.get(), "Desktop Entry", "Path", nullptr))
     {
         gchar* path = g_key_file_get_string(_keyfile.get(), "Desktop Entry", "Path", nullptr);
-        retval.emplace_back(std::make_pair("APP_DIR", path));
+        retval.add("APP_DIR", path);
         g_free(path);
     }
 
@@ -353,17 +352,17 @@ std::list<std::pair<std::string, std::string>> Legacy::launchEnv(const std::stri
     gchar* apparmor = g_key_file_get_string(_keyfile.get(), "Desktop Entry", "X-Ubuntu-AppArmor-Profile", nullptr);
     if (apparmor != nullptr)
     {
-        retval.emplace_back(std::make_pair("APP_EXEC_POLICY", apparmor));
+        retval.add("APP_EXEC_POLICY", apparmor);
         g_free(apparmor);
 
-        retval.splice(retval.end(), confinedEnv(_appname, "/usr/share"));
+        confinedEnv(retval, _appname, "/usr/share");
     }
     else
     {
-        retval.emplace_back(std::make_pair("APP_EXEC_POLICY", "unconfined"));
+        retval.add("APP_EXEC_POLICY", "unconfined");
     }
 
-    retval.emplace_back(std::make_pair("INSTANCE_ID", instance));
+    retval.add("INSTANCE_ID", instance);
 
     return retval;
 }
@@ -391,9 +390,7 @@ std::string Legacy::getInstance()
 std::shared_ptr<Application::Instance> Legacy::launch(const std::vector<Application::URL>& urls)
 {
     std::string instance = getInstance();
-    std::function<std::list<std::pair<std::string, std::string>>(void)> envfunc = [this, instance]() {
-        return launchEnv(instance);
-    };
+    std::function<EnvBuilder(void)> envfunc = [this, instance]() { return launchEnv(instance); };
     return UpstartInstance::launch(appId(), "application-legacy", instance, urls, _registry,
                                    UpstartInstance::launchMode::STANDARD, envfunc);
 }
@@ -406,13 +403,22 @@ std::shared_ptr<Application::Instance> Legacy::launch(const std::vector<Applicat
 std::shared_ptr<Application::Instance> Legacy::launchTest(const std::vector<Application::URL>& urls)
 {
     std::string instance = getInstance();
-    std::function<std::list<std::pair<std::string, std::string>>(void)> envfunc = [this, instance]() {
-        return launchEnv(instance);
-    };
+    std::function<EnvBuilder(void)> envfunc = [this, instance]() { return launchEnv(instance); };
     return UpstartInstance::launch(appId(), "application-legacy", instance, urls, _registry,
                                    UpstartInstance::launchMode::TEST, envfunc);
 }
 
+/** Create an UpstartInstance for this AppID using the UpstartInstance launch
+    function, starting it in standby.
+*/
+std::shared_ptr<Application::Instance> Legacy::launchStandby()
+{
+    std::string instance = getInstance();
+    std::function<EnvBuilder(void)> envfunc = [this, instance]() { return launchEnv(instance); };
+    return UpstartInstance::launch(appId(), "application-legacy", instance, {}, _registry,
+                                   UpstartInstance::launchMode::STANDBY, envfunc);
+}
+
 }  // namespace app_impls
 }  // namespace app_launch
 }  // namespace ubuntu
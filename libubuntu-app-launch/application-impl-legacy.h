@@ -63,6 +63,7 @@ public:
 
     std::shared_ptr<Instance> launch(const std::vector<Application::URL>& urls = {}) override;
     std::shared_ptr<Instance> launchTest(const std::vector<Application::URL>& urls = {}) override;
+    std::shared_ptr<Instance> launchStandby() override;
 
     static bool hasAppId(const AppID& appId, const std::shared_ptr<Registry>& registry);
 
@@ -85,7 +86,7 @@ private:
     std::string desktopPath_;
     std::regex instanceRegex_;
 
-    std::list<std::pair<std::string, std::string>> launchEnv(const std::string& instance);
+    EnvBuilder launchEnv(const std::string& instance);
     std::string getInstance();
 };
 
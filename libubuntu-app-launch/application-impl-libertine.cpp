@@ -31,35 +31,50 @@ namespace app_impls
 Libertine::Libertine(const AppID::Package& container,
                      const AppID::AppName& appname,
                      const std::shared_ptr<Registry>& registry)
+    : Libertine(container, appname, registry->impl->getLibertineCatalog()->container(container.value()), registry)
+{
+}
+
+/** Builds the application from what the catalog knows about the
+    container, so that listing all the applications doesn't need to
+    check the catalog again for each one.
+
+    \param container Container name
+    \param appname Application name
+    \param containerInfo Paths of the container from the catalog
+    \param registry persistent connections to use
+*/
+Libertine::Libertine(const AppID::Package& container,
+                     const AppID::AppName& appname,
+                     const std::shared_ptr<const LibertineCatalog::Container>& containerInfo,
+                     const std::shared_ptr<Registry>& registry)
     : Base(registry)
     , _container(container)
     , _appname(appname)
 {
-    auto gcontainer_path = libertine_container_path(container.value().c_str());
-    if (gcontainer_path != nullptr)
+    if (!containerInfo)
     {
-        _container_path = gcontainer_path;
-        g_free(gcontainer_path);
+        throw std::runtime_error{"Unable to find libertine container '" + container.value() + "'"};
     }
 
+    _container_path = containerInfo->path;
+
     if (!_keyfile)
     {
         auto system_app_path = g_build_filename(_container_path.c_str(), "usr", "share", nullptr);
         _basedir = system_app_path;
         g_free(system_app_path);
 
-        _keyfile = findDesktopFile(_basedir, "applications", appname.value() + ".desktop");
+        _keyfile = findDesktopFile(registry, _basedir, "applications", appname.value() + ".desktop");
     }
 
     if (!_keyfile)
     {
-        auto container_home_path = libertine_container_home_path(container.value().c_str());
-        auto local_app_path = g_build_filename(container_home_path, ".local", "share", nullptr);
+        auto local_app_path = g_build_filename(containerInfo->homePath.c_str(), ".local", "share", nullptr);
         _basedir = local_app_path;
         g_free(local_app_path);
-        g_free(container_home_path);
 
-        _keyfile = findDesktopFile(_basedir, "applications", appname.value() + ".desktop");
+        _keyfile = findDesktopFile(registry, _basedir, "applications", appname.value() + ".desktop");
     }
 
     if (!_keyfile)
@@ -88,53 +103,31 @@ std::shared_ptr<GKeyFile> Libertine::keyfileFromPath(const std::string& pathname
     return keyfile;
 }
 
-std::shared_ptr<GKeyFile> Libertine::findDesktopFile(const std::string& basepath,
+/** Finds a desktop file anywhere under a directory, using the index
+    of that directory that the registry keeps so that we don't walk the
+    tree for every application.
+
+    \param registry persistent connections to use
+    \param basepath Directory to look under
+    \param subpath Subdirectory of @basepath to look in
+    \param filename Name of the desktop file
+*/
+std::shared_ptr<GKeyFile> Libertine::findDesktopFile(const std::shared_ptr<Registry>& registry,
+                                                     const std::string& basepath,
                                                      const std::string& subpath,
                                                      const std::string& filename)
 {
-    auto fullpath = g_build_filename(basepath.c_str(), subpath.c_str(), filename.c_str(), nullptr);
-    std::string sfullpath(fullpath);
-    g_free(fullpath);
-
-    if (g_file_test(sfullpath.c_str(), G_FILE_TEST_IS_REGULAR))
-    {
-        return keyfileFromPath(sfullpath);
-    }
-
-    GError* error = nullptr;
     auto dirpath = g_build_filename(basepath.c_str(), subpath.c_str(), nullptr);
-    GDir* dir = g_dir_open(dirpath, 0, &error);
-    if (error != nullptr)
-    {
-        g_error_free(error);
-        g_free(dirpath);
-        return {};
-    }
+    auto index = registry->impl->getDesktopFileIndex(dirpath);
     g_free(dirpath);
 
-    const gchar* file;
-    while ((file = g_dir_read_name(dir)) != nullptr)
+    auto fullpath = index->find(filename);
+    if (fullpath.empty())
     {
-        auto new_subpath = g_build_filename(subpath.c_str(), file, nullptr);
-        auto new_fullpath = g_build_filename(basepath.c_str(), new_subpath, nullptr);
-        if (g_file_test(new_fullpath, G_FILE_TEST_IS_DIR))
-        {
-            auto desktop_file = findDesktopFile(basepath, new_subpath, filename);
-
-            if (desktop_file)
-            {
-                g_free(new_fullpath);
-                g_free(new_subpath);
-                g_dir_close(dir);
-                return desktop_file;
-            }
-        }
-        g_free(new_fullpath);
-        g_free(new_subpath);
+        return {};
     }
-    g_dir_close(dir);
 
-    return {};
+    return keyfileFromPath(fullpath);
 }
 
 /** Checks the AppID by making sure the version is "0.0" and then
@@ -160,30 +153,19 @@ bool Libertine::hasAppId(const AppID& appid, const std::shared_ptr<Registry>& re
     }
 }
 
-/** Verify a package name by getting the list of containers from
-    liblibertine and ensuring it is in that list.
+/** Verify a package name by checking the catalog of containers
+    that the registry keeps.
 
     \param package Container name
     \param registry persistent connections to use
 */
 bool Libertine::verifyPackage(const AppID::Package& package, const std::shared_ptr<Registry>& registry)
 {
-    auto containers = std::shared_ptr<gchar*>(libertine_list_containers(), g_strfreev);
-
-    for (int i = 0; containers.get()[i] != nullptr; i++)
-    {
-        auto container = containers.get()[i];
-        if (container == package.value())
-        {
-            return true;
-        }
-    }
-
-    return false;
+    return registry->impl->getLibertineCatalog()->hasContainer(package.value());
 }
 
-/** Gets the list of applications from the container using liblibertine
-    and see if @appname is in that list.
+/** Checks the catalog of containers that the registry keeps to see
+    if @appname is in the container.
 
     \param package Container name
     \param appname Application name to look for
@@ -193,18 +175,7 @@ bool Libertine::verifyAppname(const AppID::Package& package,
                               const AppID::AppName& appname,
                               const std::shared_ptr<Registry>& registry)
 {
-    auto apps = std::shared_ptr<gchar*>(libertine_list_apps_for_container(package.value().c_str()), g_strfreev);
-
-    for (int i = 0; apps.get()[i] != nullptr; i++)
-    {
-        auto appid = AppID::parse(apps.get()[i]);
-        if (appid.appname.value() == appname.value())
-        {
-            return true;
-        }
-    }
-
-    return false;
+    return registry->impl->getLibertineCatalog()->hasApp(package.value(), appname.value());
 }
 
 /** We don't really have a way to implement this for Libertine, any
@@ -238,24 +209,19 @@ std::list<std::shared_ptr<Application>> Libertine::list(const std::shared_ptr<Re
 {
     std::list<std::shared_ptr<Application>> applist;
 
-    auto containers = std::shared_ptr<gchar*>(libertine_list_containers(), g_strfreev);
-
-    for (int i = 0; containers.get()[i] != nullptr; i++)
+    for (const auto& container : registry->impl->getLibertineCatalog()->containers())
     {
-        auto container = containers.get()[i];
-        auto apps = std::shared_ptr<gchar*>(libertine_list_apps_for_container(container), g_strfreev);
-
-        for (int j = 0; apps.get()[j] != nullptr; j++)
+        for (const auto& appid : container->apps)
         {
             try
             {
-                auto appid = AppID::parse(apps.get()[j]);
-                auto sapp = std::make_shared<Libertine>(appid.package, appid.appname, registry);
+                auto sapp = std::make_shared<Libertine>(appid.package, appid.appname, container, registry);
                 applist.emplace_back(sapp);
             }
             catch (std::runtime_error& e)
             {
-                g_debug("Unable to create application for libertine appname '%s': %s", apps.get()[j], e.what());
+                g_debug("Unable to create application for libertine appname '%s': %s", std::string(appid).c_str(),
+                        e.what());
             }
         }
     }
@@ -297,16 +263,16 @@ std::vector<std::shared_ptr<Application::Instance>> Libertine::instances()
     can be overridden with the UBUNTU_APP_LAUNCH_LIBERTINE_LAUNCH
     environment variable.
 */
-std::list<std::pair<std::string, std::string>> Libertine::launchEnv()
+EnvBuilder Libertine::launchEnv()
 {
-    std::list<std::pair<std::string, std::string>> retval;
+    EnvBuilder retval;
 
     info();
 
-    retval.emplace_back(std::make_pair("APP_XMIR_ENABLE", appinfo_->xMirEnable().value() ? "1" : "0"));
+    retval.add("APP_XMIR_ENABLE", appinfo_->xMirEnable().value() ? "1" : "0");
 
     /* The container is our confinement */
-    retval.emplace_back(std::make_pair("APP_EXEC_POLICY", "unconfined"));
+    retval.add("APP_EXEC_POLICY", "unconfined");
 
     auto libertine_launch = g_getenv("UBUNTU_APP_LAUNCH_LIBERTINE_LAUNCH");
     if (libertine_launch == nullptr)
@@ -316,28 +282,35 @@ std::list<std::pair<std::string, std::string>> Libertine::launchEnv()
 
     auto desktopexec = appinfo_->execLine().value();
     auto execline = std::string(libertine_launch) + " \"--id=" + _container.value() + "\" " + desktopexec;
-    retval.emplace_back(std::make_pair("APP_EXEC", execline));
+    retval.add("APP_EXEC", execline);
 
     /* TODO: Go multi instance */
-    retval.emplace_back(std::make_pair("INSTANCE_ID", ""));
+    retval.add("INSTANCE_ID", "");
 
     return retval;
 }
 
 std::shared_ptr<Application::Instance> Libertine::launch(const std::vector<Application::URL>& urls)
 {
-    std::function<std::list<std::pair<std::string, std::string>>(void)> envfunc = [this]() { return launchEnv(); };
+    std::function<EnvBuilder(void)> envfunc = [this]() { return launchEnv(); };
     return UpstartInstance::launch(appId(), "application-legacy", {}, urls, _registry,
                                    UpstartInstance::launchMode::STANDARD, envfunc);
 }
 
 std::shared_ptr<Application::Instance> Libertine::launchTest(const std::vector<Application::URL>& urls)
 {
-    std::function<std::list<std::pair<std::string, std::string>>(void)> envfunc = [this]() { return launchEnv(); };
+    std::function<EnvBuilder(void)> envfunc = [this]() { return launchEnv(); };
     return UpstartInstance::launch(appId(), "application-legacy", {}, urls, _registry,
                                    UpstartInstance::launchMode::TEST, envfunc);
 }
 
+std::shared_ptr<Application::Instance> Libertine::launchStandby()
+{
+    std::function<EnvBuilder(void)> envfunc = [this]() { return launchEnv(); };
+    return UpstartInstance::launch(appId(), "application-legacy", {}, {}, _registry,
+                                   UpstartInstance::launchMode::STANDBY, envfunc);
+}
+
 }  // namespace app_impls
 }  // namespace app_launch
 }  // namespace ubuntu
@@ -19,6 +19,7 @@
 
 #include "application-impl-base.h"
 #include "application-info-desktop.h"
+#include "libertine-catalog.h"
 #include <gio/gdesktopappinfo.h>
 
 #pragma once
@@ -53,6 +54,10 @@ public:
     Libertine(const AppID::Package& container,
               const AppID::AppName& appname,
               const std::shared_ptr<Registry>& registry);
+    Libertine(const AppID::Package& container,
+              const AppID::AppName& appname,
+              const std::shared_ptr<const LibertineCatalog::Container>& containerInfo,
+              const std::shared_ptr<Registry>& registry);
 
     static std::list<std::shared_ptr<Application>> list(const std::shared_ptr<Registry>& registry);
 
@@ -67,6 +72,7 @@ public:
 
     std::shared_ptr<Instance> launch(const std::vector<Application::URL>& urls = {}) override;
     std::shared_ptr<Instance> launchTest(const std::vector<Application::URL>& urls = {}) override;
+    std::shared_ptr<Instance> launchStandby() override;
 
     static bool hasAppId(const AppID& appId, const std::shared_ptr<Registry>& registry);
 
@@ -89,9 +95,10 @@ private:
     std::string _basedir;
     std::shared_ptr<app_info::Desktop> appinfo_;
 
-    std::list<std::pair<std::string, std::string>> launchEnv();
+    EnvBuilder launchEnv();
     static std::shared_ptr<GKeyFile> keyfileFromPath(const std::string& pathname);
-    static std::shared_ptr<GKeyFile> findDesktopFile(const std::string& basepath,
+    static std::shared_ptr<GKeyFile> findDesktopFile(const std::shared_ptr<Registry>& registry,
+                                                     const std::string& basepath,
                                                      const std::string& subpath,
                                                      const std::string& filename);
 };
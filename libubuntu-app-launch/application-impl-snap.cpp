@@ -21,6 +21,7 @@
 
 #include "application-impl-snap.h"
 #include "application-info-desktop.h"
+#include "helpers.h"
 #include "registry-impl.h"
 
 namespace ubuntu
@@ -125,30 +126,25 @@ public:
     Exec execLine() override
     {
         std::string keyfile = _exec.value();
-        gchar** parsed = nullptr;
-        GError* error = nullptr;
+        gchar** parsed = desktop_exec_split(keyfile.c_str());
 
-        g_shell_parse_argv(keyfile.c_str(), nullptr, &parsed, &error);
-
-        if (error != nullptr)
+        if (parsed == nullptr)
         {
-            g_warning("Unable to parse exec line '%s': %s", keyfile.c_str(), error->message);
-            g_error_free(error);
+            g_warning("Unable to parse exec line '%s'", keyfile.c_str());
             return Exec::from_raw({});
         }
 
-        if (g_strv_length(parsed) == 0)
+        /* Skip the first entry */
+        std::string params;
+        for (gchar** param = &(parsed[1]); *param != nullptr; param++)
         {
-            g_warning("Parse resulted in a blank line");
-            g_strfreev(parsed);
-            return Exec::from_raw({});
+            if (param != &(parsed[1]))
+            {
+                params += " ";
+            }
+            params += *param;
         }
-
-        /* Skip the first entry */
-        gchar** parsedpp = &(parsed[1]);
-
-        gchar* params = g_strjoinv(" ", parsedpp);
-        g_strfreev(parsed);
+        g_free(parsed);
 
         std::string binname;
         if (appId_.package.value() == appId_.appname.value())
@@ -161,7 +157,6 @@ public:
         }
 
         binname = "/snap/bin/" + binname + " " + params;
-        g_free(params);
 
         return Exec::from_raw(binname);
     }
@@ -180,11 +175,27 @@ public:
     \param interface Primary interface that we found this snap for
 */
 Snap::Snap(const AppID& appid, const std::shared_ptr<Registry>& registry, const std::string& interface)
+    : Snap(appid, registry, interface, registry->impl->snapdInfo.pkgInfo(appid.package))
+{
+}
+
+/** Creates a Snap application object using package information that
+    we already have from snapd, so we don't need to ask for it again.
+
+    \param appid Application ID of the snap
+    \param registry Registry to use for persistent connections
+    \param interface Primary interface that we found this snap for
+    \param pkginfo Information on the package from snapd
+*/
+Snap::Snap(const AppID& appid,
+           const std::shared_ptr<Registry>& registry,
+           const std::string& interface,
+           const std::shared_ptr<snapd::Info::PkgInfo>& pkginfo)
     : Base(registry)
     , appid_(appid)
     , interface_(interface)
+    , pkgInfo_(pkginfo)
 {
-    pkgInfo_ = registry->impl->snapdInfo.pkgInfo(appid.package);
     if (!pkgInfo_)
     {
         throw std::runtime_error("Unable to get snap package info for AppID: " + std::string(appid));
@@ -210,7 +221,8 @@ Snap::Snap(const AppID& appid, const std::shared_ptr<Registry>& registry)
 }
 
 /** Lists all the Snappy apps that are using one of our supported interfaces.
-    Also makes sure they're valid.
+    Also makes sure they're valid. The package information comes along
+    with the interfaces so that the whole list is two requests to snapd.
 
     \param registry Registry to use for persistent connections
 */
@@ -218,19 +230,16 @@ std::list<std::shared_ptr<Application>> Snap::list(const std::shared_ptr<Registr
 {
     std::list<std::shared_ptr<Application>> apps;
 
-    for (const auto& interface : SUPPORTED_INTERFACES)
+    for (const auto& ifaceapp : registry->impl->snapdInfo.appsForInterfaces(SUPPORTED_INTERFACES))
     {
-        for (const auto& id : registry->impl->snapdInfo.appsForInterface(interface))
+        try
         {
-            try
-            {
-                auto app = std::make_shared<Snap>(id, registry, interface);
-                apps.emplace_back(app);
-            }
-            catch (std::runtime_error& e)
-            {
-                g_warning("Unable to make Snap object for '%s': %s", std::string(id).c_str(), e.what());
-            }
+            auto app = std::make_shared<Snap>(ifaceapp.appid, registry, ifaceapp.interface, ifaceapp.pkginfo);
+            apps.emplace_back(app);
+        }
+        catch (std::runtime_error& e)
+        {
+            g_warning("Unable to make Snap object for '%s': %s", std::string(ifaceapp.appid).c_str(), e.what());
         }
     }
 
@@ -414,12 +423,12 @@ std::vector<std::shared_ptr<Application::Instance>> Snap::instances()
 /** Return the launch environment for this snap. That includes whether
     or not it needs help from XMir (including Libertine helpers)
 */
-std::list<std::pair<std::string, std::string>> Snap::launchEnv()
+EnvBuilder Snap::launchEnv()
 {
     g_debug("Getting snap specific environment");
-    std::list<std::pair<std::string, std::string>> retval;
+    EnvBuilder retval;
 
-    retval.emplace_back(std::make_pair("APP_XMIR_ENABLE", info_->xMirEnable().value() ? "1" : "0"));
+    retval.add("APP_XMIR_ENABLE", info_->xMirEnable().value() ? "1" : "0");
     if (info_->xMirEnable())
     {
         /* If we're setting up XMir we also need the other helpers
@@ -430,12 +439,11 @@ std::list<std::pair<std::string, std::string>> Snap::launchEnv()
             libertine_launch = LIBERTINE_LAUNCH;
         }
 
-        retval.emplace_back(
-            std::make_pair("APP_EXEC", std::string(libertine_launch) + " " + info_->execLine().value()));
+        retval.add("APP_EXEC", std::string(libertine_launch) + " " + info_->execLine().value());
     }
     else
     {
-        retval.emplace_back(std::make_pair("APP_EXEC", info_->execLine().value()));
+        retval.add("APP_EXEC", info_->execLine().value());
     }
 
     return retval;
@@ -447,7 +455,7 @@ std::list<std::pair<std::string, std::string>> Snap::launchEnv()
 */
 std::shared_ptr<Application::Instance> Snap::launch(const std::vector<Application::URL>& urls)
 {
-    std::function<std::list<std::pair<std::string, std::string>>(void)> envfunc = [this]() { return launchEnv(); };
+    std::function<EnvBuilder(void)> envfunc = [this]() { return launchEnv(); };
     return UpstartInstance::launch(appid_, "application-snap", {}, urls, _registry,
                                    UpstartInstance::launchMode::STANDARD, envfunc);
 }
@@ -459,11 +467,19 @@ std::shared_ptr<Application::Instance> Snap::launch(const std::vector<Applicatio
 */
 std::shared_ptr<Application::Instance> Snap::launchTest(const std::vector<Application::URL>& urls)
 {
-    std::function<std::list<std::pair<std::string, std::string>>(void)> envfunc = [this]() { return launchEnv(); };
+    std::function<EnvBuilder(void)> envfunc = [this]() { return launchEnv(); };
     return UpstartInstance::launch(appid_, "application-snap", {}, urls, _registry, UpstartInstance::launchMode::TEST,
                                    envfunc);
 }
 
+/** Create a new instance of this Snap in standby */
+std::shared_ptr<Application::Instance> Snap::launchStandby()
+{
+    std::function<EnvBuilder(void)> envfunc = [this]() { return launchEnv(); };
+    return UpstartInstance::launch(appid_, "application-snap", {}, {}, _registry,
+                                   UpstartInstance::launchMode::STANDBY, envfunc);
+}
+
 }  // namespace app_impls
 }  // namespace app_launch
 }  // namespace ubuntu
@@ -50,6 +50,10 @@ class Snap : public Base
 public:
     Snap(const AppID& appid, const std::shared_ptr<Registry>& registry);
     Snap(const AppID& appid, const std::shared_ptr<Registry>& registry, const std::string& interface);
+    Snap(const AppID& appid,
+         const std::shared_ptr<Registry>& registry,
+         const std::string& interface,
+         const std::shared_ptr<snapd::Info::PkgInfo>& pkginfo);
 
     static std::list<std::shared_ptr<Application>> list(const std::shared_ptr<Registry>& registry);
 
@@ -61,6 +65,7 @@ public:
 
     std::shared_ptr<Instance> launch(const std::vector<Application::URL>& urls = {}) override;
     std::shared_ptr<Instance> launchTest(const std::vector<Application::URL>& urls = {}) override;
+    std::shared_ptr<Instance> launchStandby() override;
 
     static bool hasAppId(const AppID& appId, const std::shared_ptr<Registry>& registry);
 
@@ -88,7 +93,7 @@ private:
     /** Information that we get from Snapd on the package */
     std::shared_ptr<snapd::Info::PkgInfo> pkgInfo_;
 
-    std::list<std::pair<std::string, std::string>> launchEnv();
+    EnvBuilder launchEnv();
     static std::string findInterface(const AppID& appid, const std::shared_ptr<Registry>& registry);
     static bool checkPkgInfo(const std::shared_ptr<snapd::Info::PkgInfo>& pkginfo, const AppID& appid);
 };
@@ -351,6 +351,7 @@ Desktop::Desktop(const std::shared_ptr<GKeyFile>& keyfile,
     , _ubuntuLifecycle(boolFromKeyfile<Application::Info::UbuntuLifecycle>(keyfile, "X-Ubuntu-Touch", false))
     , _xMirEnable(
           boolFromKeyfile<XMirEnable>(keyfile, "X-Ubuntu-XMir-Enable", (flags & DesktopFlags::XMIR_DEFAULT).any()))
+    , _zygoteLibrary(stringFromKeyfile<ZygoteLibrary>(keyfile, "X-Ubuntu-Zygote-Library"))
     , _exec(stringFromKeyfile<Exec>(keyfile, "Exec"))
 {
 }
@@ -99,6 +99,16 @@ public:
         return _xMirEnable;
     }
 
+    struct ZygoteLibraryTag;
+    typedef TypeTagger<ZygoteLibraryTag, std::string> ZygoteLibrary;
+    /** Library with a main() in it that the zygote can run instead of
+        executing the Exec line, empty if the application doesn't have
+        one */
+    virtual ZygoteLibrary zygoteLibrary()
+    {
+        return _zygoteLibrary;
+    }
+
     struct ExecTag;
     typedef TypeTagger<ExecTag, std::string> Exec;
     virtual Exec execLine()
@@ -124,6 +134,7 @@ protected:
     Application::Info::UbuntuLifecycle _ubuntuLifecycle;
 
     XMirEnable _xMirEnable;
+    ZygoteLibrary _zygoteLibrary;
     Exec _exec;
 };
 
@@ -0,0 +1,176 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Ted Gould <ted.gould@canonical.com>
+ */
+
+#include "desktop-file-index.h"
+#include "modification-time.h"
+
+#include <dirent.h>
+#include <glib.h>
+#include <list>
+#include <set>
+#include <sys/stat.h>
+#include <utility>
+
+namespace ubuntu
+{
+namespace app_launch
+{
+
+namespace
+{
+constexpr const char* DESKTOP_EXTENSION = ".desktop";
+}
+
+DesktopFileIndex::DesktopFileIndex(const std::string& basePath)
+    : _basePath(basePath)
+{
+}
+
+std::string DesktopFileIndex::find(const std::string& filename)
+{
+    std::lock_guard<std::mutex> lock(_lock);
+
+    if (!_built || !isCurrent())
+    {
+        build();
+    }
+
+    auto file = _files.find(filename);
+    if (file == _files.end())
+    {
+        return {};
+    }
+
+    return file->second;
+}
+
+std::uint64_t DesktopFileIndex::generation()
+{
+    std::lock_guard<std::mutex> lock(_lock);
+
+    if (!_built || !isCurrent())
+    {
+        build();
+    }
+
+    return _generation;
+}
+
+/** Checks whether any of the directories that we walked have changed
+    since we walked them. */
+bool DesktopFileIndex::isCurrent()
+{
+    for (const auto& dir : _dirs)
+    {
+        if (dir.second == mtime::RACY)
+        {
+            return false;
+        }
+
+        if (mtime::get(dir.first) != dir.second)
+        {
+            g_debug("Directory '%s' changed, rebuilding desktop file index", dir.first.c_str());
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/** Walks the tree, one level at a time so that files nearer the top are
+    found first. Entry types come from the directory itself where the
+    file system gives them to us, so most entries don't need a stat(). */
+void DesktopFileIndex::build()
+{
+    _files.clear();
+    _dirs.clear();
+    _built = true;
+    _generation++;
+
+    /* Symlinks could make loops, so only go into each directory once */
+    std::set<std::pair<dev_t, ino_t>> visited;
+    std::list<std::string> queue{_basePath};
+
+    while (!queue.empty())
+    {
+        auto dirpath = queue.front();
+        queue.pop_front();
+
+        /* Get the time before reading so a change while we're reading
+           causes a rebuild next time instead of being missed */
+        _dirs[dirpath] = mtime::trusted(mtime::get(dirpath));
+
+        DIR* dir = opendir(dirpath.c_str());
+        if (dir == nullptr)
+        {
+            continue;
+        }
+
+        struct stat dirinfo;
+        if (fstat(dirfd(dir), &dirinfo) != 0 ||
+            !visited.insert(std::make_pair(dirinfo.st_dev, dirinfo.st_ino)).second)
+        {
+            closedir(dir);
+            continue;
+        }
+
+        struct dirent* entry;
+        while ((entry = readdir(dir)) != nullptr)
+        {
+            std::string name(entry->d_name);
+            if (name == "." || name == "..")
+            {
+                continue;
+            }
+
+            bool isdir = entry->d_type == DT_DIR;
+            bool isfile = entry->d_type == DT_REG;
+
+            if (entry->d_type == DT_LNK || entry->d_type == DT_UNKNOWN)
+            {
+                struct stat info;
+                if (fstatat(dirfd(dir), entry->d_name, &info, 0) != 0)
+                {
+                    continue;
+                }
+
+                isdir = S_ISDIR(info.st_mode);
+                isfile = S_ISREG(info.st_mode);
+            }
+
+            if (isdir)
+            {
+                queue.emplace_back(dirpath + "/" + name);
+            }
+            else if (isfile && g_str_has_suffix(name.c_str(), DESKTOP_EXTENSION) &&
+                     _files.find(name) == _files.end())
+            {
+                _files[name] = dirpath + "/" + name;
+            }
+        }
+
+        closedir(dir);
+    }
+
+    g_debug("Indexed %d desktop files in %d directories under '%s'", int(_files.size()), int(_dirs.size()),
+            _basePath.c_str());
+}
+
+}  // namespace app_launch
+}  // namespace ubuntu
@@ -0,0 +1,88 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Ted Gould <ted.gould@canonical.com>
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+
+namespace ubuntu
+{
+namespace app_launch
+{
+/** \brief Index of the desktop files in a directory tree by file name
+
+    Desktop files can be anywhere under an applications directory, so
+    finding one by name means walking the whole tree. This object walks it
+    once and remembers where each file is. It also remembers the
+    modification time of each directory it walked, and walks the tree again
+    on the next lookup if any of them have changed, which happens whenever
+    a file is added, removed or renamed in them.
+
+    If the same file name is in more than one directory, the one closest
+    to the top of the tree is used.
+*/
+class DesktopFileIndex
+{
+public:
+    /** Create a DesktopFileIndex, the tree isn't walked until the
+        first lookup.
+
+        \param basePath the applications directory to index
+    */
+    explicit DesktopFileIndex(const std::string& basePath);
+    virtual ~DesktopFileIndex() = default;
+
+    /** Find the full path of a desktop file, or an empty string if
+        there isn't one with that name.
+
+        \param filename name of the desktop file, including the extension
+    */
+    std::string find(const std::string& filename);
+
+    /** A number that changes each time the tree is walked again, so
+        things built from what is in the tree can tell when they're out
+        of date. Checks the tree for changes first.
+    */
+    std::uint64_t generation();
+
+private:
+    /** \private */
+    std::mutex _lock;
+    /** \private */
+    std::string _basePath;
+    /** \private Whether the tree has been walked yet */
+    bool _built = false;
+    /** \private Times the tree has been walked */
+    std::uint64_t _generation = 0;
+    /** \private Full path of each desktop file by file name */
+    std::map<std::string, std::string> _files;
+    /** \private Modification time of each directory when it was walked */
+    std::map<std::string, std::int64_t> _dirs;
+
+    /** \private */
+    bool isCurrent();
+    /** \private */
+    void build();
+};
+
+}  // namespace app_launch
+}  // namespace ubuntu
@@ -0,0 +1,198 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Ted Gould <ted.gould@canonical.com>
+ */
+
+#include "env-builder.h"
+
+#include <algorithm>
+#include <cstdint>
+
+namespace ubuntu
+{
+namespace app_launch
+{
+
+namespace
+{
+/** Space for the environment of a typical launch, a Click application
+    with its confinement variables is around two kilobytes */
+constexpr size_t INITIAL_BYTES = 4096;
+/** Variables in a typical launch */
+constexpr size_t INITIAL_ENTRIES = 24;
+
+/** Checks a string can go into a GVariant string, which also rules out
+    embedded NULs */
+bool validString(const std::string& str)
+{
+    return g_utf8_validate(str.data(), str.size(), nullptr);
+}
+}  // namespace
+
+EnvBuilder::EnvBuilder()
+{
+    _data.reserve(INITIAL_BYTES);
+    _ends.reserve(INITIAL_ENTRIES);
+}
+
+/** Adds a variable to the environment. Values that aren't valid UTF-8
+    can't be sent to Upstart, so they are dropped with a warning.
+
+    \param name Name of the variable
+    \param value Value of the variable
+*/
+void EnvBuilder::add(const std::string& name, const std::string& value)
+{
+    if (!validString(name) || !validString(value))
+    {
+        g_warning("Environment variable '%s' isn't valid UTF-8, not setting it", name.c_str());
+        return;
+    }
+
+    g_debug("Setting '%s' to '%s'", name.c_str(), value.c_str());
+
+    _data.append(name);
+    _data.push_back('=');
+    _data.append(value);
+    _data.push_back('\0');
+    _ends.push_back(_data.size());
+}
+
+/** Adds a variable that is a space separated list of the URLs, each one
+    quoted the way g_shell_quote() does. The size is worked out first so
+    the entry is written without growing the buffer more than once.
+
+    \param name Name of the variable
+    \param urls URLs to quote
+*/
+void EnvBuilder::addShellQuoted(const std::string& name, const std::vector<Application::URL>& urls)
+{
+    if (!validString(name))
+    {
+        g_warning("Environment variable '%s' isn't valid UTF-8, not setting it", name.c_str());
+        return;
+    }
+
+    /* Each URL becomes 'url' with any quote in it turned into '\'' */
+    size_t length = name.size() + 2;
+    for (const auto& url : urls)
+    {
+        length += url.value().size() + 3 + 3 * std::count(url.value().begin(), url.value().end(), '\'');
+    }
+    _data.reserve(_data.size() + length);
+
+    _data.append(name);
+    _data.push_back('=');
+
+    bool first = true;
+    for (const auto& url : urls)
+    {
+        if (!validString(url.value()))
+        {
+            g_warning("Unable to escape URL: %s", url.value().c_str());
+            continue;
+        }
+
+        if (!first)
+        {
+            _data.push_back(' ');
+        }
+        first = false;
+
+        _data.push_back('\'');
+        for (auto c : url.value())
+        {
+            if (c == '\'')
+            {
+                _data.append("'\\''");
+            }
+            else
+            {
+                _data.push_back(c);
+            }
+        }
+        _data.push_back('\'');
+    }
+
+    _data.push_back('\0');
+    _ends.push_back(_data.size());
+}
+
+/** Gets the value of a variable, the last one set if it was added more
+    than once, or an empty string if it wasn't set.
+
+    \param name Name of the variable
+*/
+std::string EnvBuilder::value(const std::string& name) const
+{
+    for (size_t i = _ends.size(); i > 0; i--)
+    {
+        size_t start = i > 1 ? _ends[i - 2] : 0;
+        size_t end = _ends[i - 1] - 1; /* before the NUL */
+
+        if (end - start > name.size() && _data.compare(start, name.size(), name) == 0 &&
+            _data[start + name.size()] == '=')
+        {
+            return _data.substr(start + name.size() + 1, end - start - name.size() - 1);
+        }
+    }
+
+    return {};
+}
+
+/** Turns the environment into a GVariant array of strings, which takes
+    over the buffer. The builder is empty afterwards.
+
+    The framing offsets are the ends of the entries, written little
+    endian after them. They are as narrow as they can be while still
+    being able to address the whole array, offsets included.
+
+    \return A floating reference to an "as" GVariant
+*/
+GVariant* EnvBuilder::toVariant()
+{
+    if (_ends.empty())
+    {
+        return g_variant_new_array(G_VARIANT_TYPE_STRING, nullptr, 0);
+    }
+
+    size_t width = 1;
+    while (width < 8 && std::uint64_t(_data.size() + _ends.size() * width) > (std::uint64_t(1) << (width * 8)) - 1)
+    {
+        width *= 2;
+    }
+
+    _data.reserve(_data.size() + _ends.size() * width);
+    for (auto end : _ends)
+    {
+        for (size_t i = 0; i < width; i++)
+        {
+            _data.push_back(char((std::uint64_t(end) >> (i * 8)) & 0xff));
+        }
+    }
+
+    auto data = new std::string(std::move(_data));
+    _data.clear();
+    _ends.clear();
+
+    /* Everything was checked as it was added, so GVariant can trust it */
+    return g_variant_new_from_data(G_VARIANT_TYPE("as"), data->data(), data->size(), TRUE,
+                                   [](gpointer user_data) { delete static_cast<std::string*>(user_data); }, data);
+}
+
+}  // namespace app_launch
+}  // namespace ubuntu
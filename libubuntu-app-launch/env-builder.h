@@ -0,0 +1,68 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Ted Gould <ted.gould@canonical.com>
+ */
+
+#pragma once
+
+#include <glib.h>
+#include <string>
+#include <vector>
+
+#include "application.h"
+
+namespace ubuntu
+{
+namespace app_launch
+{
+
+/** \brief Builds the environment that an application is launched with
+
+    Each variable is written as "KEY=VALUE" straight into a single
+    buffer, which is laid out the way GVariant serializes an array of
+    strings. The end of each entry is kept as it is added, and those are
+    the framing offsets GVariant puts at the end of the array, so
+    toVariant() only needs to add them and hand the buffer over. The
+    buffer starts out big enough for a typical launch so that building
+    the environment is usually a single allocation.
+*/
+class EnvBuilder
+{
+public:
+    EnvBuilder();
+
+    void add(const std::string& name, const std::string& value);
+    void addShellQuoted(const std::string& name, const std::vector<Application::URL>& urls);
+
+    std::string value(const std::string& name) const;
+    /** Number of variables that have been added */
+    size_t size() const
+    {
+        return _ends.size();
+    }
+
+    GVariant* toVariant();
+
+private:
+    /** Entries as "KEY=VALUE\0" one after another */
+    std::string _data;
+    /** Offset of the end of each entry in _data */
+    std::vector<size_t> _ends;
+};
+
+}  // namespace app_launch
+}  // namespace ubuntu
@@ -0,0 +1,211 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Ted Gould <ted.gould@canonical.com>
+ */
+
+#include "launch-exec-plan.h"
+
+#include <cerrno>
+#include <fcntl.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+extern "C" {
+#include "exec-plan.h"
+#include "helpers.h"
+}
+
+namespace ubuntu
+{
+namespace app_launch
+{
+namespace exec_plan
+{
+
+namespace
+{
+bool isExecutable(const std::string& path)
+{
+    struct stat info;
+    return stat(path.c_str(), &info) == 0 && S_ISREG(info.st_mode) && access(path.c_str(), X_OK) == 0;
+}
+
+/** exec-line-exec won't put paths with a ':' in them into a path */
+bool pathSafe(const std::string& dir)
+{
+    return !dir.empty() && dir.find(':') == std::string::npos;
+}
+
+void append(std::string& plan, const std::string& str)
+{
+    plan.append(str);
+    plan.push_back('\0');
+}
+}  // namespace
+
+std::vector<std::string> arguments(const std::string& exec, const std::vector<Application::URL>& urls)
+{
+    std::vector<gchar*> urlv;
+    urlv.reserve(urls.size() + 1);
+    for (const auto& url : urls)
+    {
+        urlv.push_back(const_cast<gchar*>(url.value().c_str()));
+    }
+    urlv.push_back(nullptr);
+
+    gchar** argv = desktop_exec_argv(exec.c_str(), urls.empty() ? nullptr : urlv.data());
+    if (argv == nullptr)
+    {
+        return {};
+    }
+
+    std::vector<std::string> args;
+    for (gchar** arg = argv; *arg != nullptr; arg++)
+    {
+        args.emplace_back(*arg);
+    }
+
+    g_free(argv);
+    return args;
+}
+
+std::string binary(const std::string& program, const std::string& appdir, const std::string& arch)
+{
+    if (g_path_is_absolute(program.c_str()) || !pathSafe(appdir))
+    {
+        return program;
+    }
+
+    /* Same order that exec-line-exec puts them in the PATH */
+    if (program.find('/') == std::string::npos)
+    {
+        if (pathSafe(arch))
+        {
+            auto archpath = appdir + "/lib/" + arch + "/bin/" + program;
+            if (isExecutable(archpath))
+            {
+                return archpath;
+            }
+        }
+    }
+
+    /* Also where a relative path ends up, as we change to the
+       application directory */
+    auto apppath = appdir + "/" + program;
+    if (isExecutable(apppath))
+    {
+        return apppath;
+    }
+
+    return program;
+}
+
+std::string build(const std::string& exec,
+                  const std::string& appdir,
+                  const std::string& arch,
+                  const std::vector<Application::URL>& urls)
+{
+    if (exec.empty())
+    {
+        return {};
+    }
+
+    auto args = arguments(exec, urls);
+    if (args.empty())
+    {
+        return {};
+    }
+
+    std::string pathPrefix;
+    std::string libPrefix;
+    std::string importSuffix;
+    if (pathSafe(appdir))
+    {
+        if (pathSafe(arch))
+        {
+            auto archlib = appdir + "/lib/" + arch;
+            pathPrefix = archlib + "/bin:" + appdir;
+            libPrefix = archlib + ":" + appdir + "/lib";
+            importSuffix = archlib;
+        }
+        else
+        {
+            pathPrefix = appdir;
+            libPrefix = appdir + "/lib";
+        }
+    }
+
+    exec_plan_header_t header{EXEC_PLAN_MAGIC, uint32_t(args.size())};
+
+    std::string plan;
+    plan.append(reinterpret_cast<const char*>(&header), sizeof(header));
+    append(plan, binary(args[0], appdir, arch));
+    append(plan, pathPrefix);
+    append(plan, libPrefix);
+    append(plan, importSuffix);
+    for (const auto& arg : args)
+    {
+        append(plan, arg);
+    }
+
+    return plan;
+}
+
+std::string write(const std::string& dir, const std::string& plan)
+{
+    gchar* cpath = g_build_filename(dir.c_str(), "exec-plan-XXXXXX", nullptr);
+    int fd = g_mkstemp_full(cpath, O_WRONLY | O_CLOEXEC, 0600);
+    if (fd < 0)
+    {
+        g_warning("Unable to create exec plan in '%s': %s", dir.c_str(), g_strerror(errno));
+        g_free(cpath);
+        return {};
+    }
+
+    std::string path(cpath);
+    g_free(cpath);
+
+    size_t written = 0;
+    while (written < plan.size())
+    {
+        auto ret = ::write(fd, plan.data() + written, plan.size() - written);
+        if (ret < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (ret <= 0)
+        {
+            break;
+        }
+        written += ret;
+    }
+
+    if (close(fd) != 0 || written < plan.size())
+    {
+        g_warning("Unable to write exec plan '%s': %s", path.c_str(), g_strerror(errno));
+        g_unlink(path.c_str());
+        return {};
+    }
+
+    return path;
+}
+
+}  // namespace exec_plan
+}  // namespace app_launch
+}  // namespace ubuntu
@@ -0,0 +1,86 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Ted Gould <ted.gould@canonical.com>
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "application.h"
+
+namespace ubuntu
+{
+namespace app_launch
+{
+/** \brief Works out how exec-line-exec is going to start an application
+
+    Everything exec-line-exec does before it can exec the application,
+    parsing the Exec line, putting in the URLs, finding the binary and
+    working out the paths, only depends on what we know when we launch
+    it. These do that work here and write it to a file, the format is in
+    exec-plan.h, so that exec-line-exec only has to map it and exec.
+*/
+namespace exec_plan
+{
+
+/** Parses an Exec line and puts the URLs into it with
+    desktop_exec_argv(). Returns an empty list if the line
+    can't be parsed.
+
+    \param exec Exec line from the desktop file
+    \param urls URLs the application is being launched with
+*/
+std::vector<std::string> arguments(const std::string& exec, const std::vector<Application::URL>& urls);
+
+/** Finds the binary the way exec-line-exec's paths would, where the
+    application's directories come before the PATH. Returns the program
+    as it is if it isn't in the application's directories, so that it
+    is looked up on the PATH that the job has.
+
+    \param program First argument
+    \param appdir Application directory, can be empty
+    \param arch Architecture directory, can be empty
+*/
+std::string binary(const std::string& program, const std::string& appdir, const std::string& arch);
+
+/** Builds the plan for an application. Returns an empty string if
+    there isn't a plan to make, in which case exec-line-exec works it out
+    from the environment like it always has.
+
+    \param exec Exec line from the desktop file
+    \param appdir Application directory, can be empty
+    \param arch Architecture directory, can be empty
+    \param urls URLs the application is being launched with
+*/
+std::string build(const std::string& exec,
+                  const std::string& appdir,
+                  const std::string& arch,
+                  const std::vector<Application::URL>& urls);
+
+/** Writes a plan to a new file that only we can read and returns the
+    path, or an empty string if it can't.
+
+    \param dir Directory that the application can read
+    \param plan Plan from build()
+*/
+std::string write(const std::string& dir, const std::string& plan);
+
+}  // namespace exec_plan
+}  // namespace app_launch
+}  // namespace ubuntu
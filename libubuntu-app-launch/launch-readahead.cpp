@@ -0,0 +1,178 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Ted Gould <ted.gould@canonical.com>
+ */
+
+#include "launch-readahead.h"
+#include "launch-exec-plan.h"
+
+#include <cstdint>
+#include <dirent.h>
+#include <fcntl.h>
+#include <glib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace ubuntu
+{
+namespace app_launch
+{
+namespace readahead
+{
+
+namespace
+{
+/** Most files we'll read ahead for one application, so that an
+    application with a huge lib directory doesn't push everything else
+    out of the cache */
+constexpr size_t MAX_FILES = 128;
+/** Most bytes we'll read ahead for one application */
+constexpr std::int64_t MAX_BYTES = 64 * 1024 * 1024;
+/** How far down the library directories we'll look */
+constexpr int MAX_DEPTH = 3;
+
+bool isRegularFile(const std::string& path)
+{
+    struct stat info;
+    return stat(path.c_str(), &info) == 0 && S_ISREG(info.st_mode);
+}
+
+/** Finds the program the way the exec plan does, falling back to our
+    own PATH for ones that aren't in the application's directories.
+
+    \param program First argument of the Exec line
+    \param appdir Application directory, can be empty
+    \param arch Architecture directory, can be empty
+*/
+std::string findProgram(const std::string& program, const std::string& appdir, const std::string& arch)
+{
+    auto binary = exec_plan::binary(program, appdir, arch);
+    if (g_path_is_absolute(binary.c_str()))
+    {
+        return isRegularFile(binary) ? binary : std::string{};
+    }
+
+    auto gpath = g_find_program_in_path(binary.c_str());
+    if (gpath == nullptr)
+    {
+        return {};
+    }
+
+    std::string path(gpath);
+    g_free(gpath);
+    return path;
+}
+
+/** Adds the shared libraries under a directory to the list */
+void findLibraries(const std::string& dirpath, int depth, std::list<std::string>& found)
+{
+    if (depth > MAX_DEPTH || found.size() >= MAX_FILES)
+    {
+        return;
+    }
+
+    DIR* dir = opendir(dirpath.c_str());
+    if (dir == nullptr)
+    {
+        return;
+    }
+
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != nullptr && found.size() < MAX_FILES)
+    {
+        std::string name(entry->d_name);
+        if (name == "." || name == "..")
+        {
+            continue;
+        }
+
+        auto path = dirpath + "/" + name;
+        if (entry->d_type == DT_DIR)
+        {
+            findLibraries(path, depth + 1, found);
+        }
+        else if ((entry->d_type == DT_REG || entry->d_type == DT_UNKNOWN) &&
+                 (g_str_has_suffix(name.c_str(), ".so") || name.find(".so.") != std::string::npos) &&
+                 isRegularFile(path))
+        {
+            found.emplace_back(path);
+        }
+    }
+
+    closedir(dir);
+}
+}  // namespace
+
+std::list<std::string> files(const std::string& exec, const std::string& appdir, const std::string& arch)
+{
+    std::list<std::string> found;
+
+    /* Parsed the same way as for the exec plan, no URLs are needed to
+       get the program */
+    if (!exec.empty())
+    {
+        auto args = exec_plan::arguments(exec, {});
+        if (!args.empty())
+        {
+            auto program = findProgram(args[0], appdir, arch);
+            if (!program.empty())
+            {
+                found.emplace_back(program);
+            }
+        }
+    }
+
+    if (!appdir.empty())
+    {
+        findLibraries(appdir + "/lib", 0, found);
+    }
+
+    return found;
+}
+
+std::int64_t willNeed(const std::list<std::string>& paths, int& count)
+{
+    std::int64_t bytes = 0;
+    count = 0;
+
+    for (const auto& path : paths)
+    {
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+        {
+            continue;
+        }
+
+        /* Skip the ones that would take us over, a smaller one later
+           could still fit */
+        struct stat info;
+        if (fstat(fd, &info) == 0 && bytes + info.st_size <= MAX_BYTES)
+        {
+            posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+            bytes += info.st_size;
+            count++;
+        }
+
+        close(fd);
+    }
+
+    return bytes;
+}
+
+}  // namespace readahead
+}  // namespace app_launch
+}  // namespace ubuntu
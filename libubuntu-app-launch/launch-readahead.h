@@ -0,0 +1,63 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Ted Gould <ted.gould@canonical.com>
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <string>
+
+namespace ubuntu
+{
+namespace app_launch
+{
+/** \brief Warms the page cache for an application that is being launched
+
+    While we wait for Unity to answer the starting handshake nothing is
+    reading the application off of the disk. These find the files that
+    exec-line-exec is going to need, which are the executable from the
+    Exec line and the shared libraries that came with the application,
+    and ask the kernel to start reading them in. They block on the disk
+    so they shouldn't be called on the registry thread.
+*/
+namespace readahead
+{
+
+/** Finds the files that an application is going to need when it
+    starts, the executable first.
+
+    \param exec Exec line the application is being launched with
+    \param appdir Application directory, can be empty
+    \param arch Architecture directory that exec-line-exec adds to the
+                paths, can be empty
+*/
+std::list<std::string> files(const std::string& exec, const std::string& appdir, const std::string& arch);
+
+/** Asks the kernel to start reading in the files without waiting for
+    it. Files are skipped once they'd take the total over 64 MiB.
+    Returns the number of bytes asked for.
+
+    \param paths Files to read in
+    \param count Set to the number of files asked for
+*/
+std::int64_t willNeed(const std::list<std::string>& paths, int& count);
+
+}  // namespace readahead
+}  // namespace app_launch
+}  // namespace ubuntu
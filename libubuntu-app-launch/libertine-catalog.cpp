@@ -0,0 +1,253 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Ted Gould <ted.gould@canonical.com>
+ */
+
+#include "libertine-catalog.h"
+#include "desktop-file-index.h"
+#include "libertine.h"
+#include "modification-time.h"
+#include "registry-impl.h"
+
+#include <future>
+#include <glib.h>
+
+namespace ubuntu
+{
+namespace app_launch
+{
+
+LibertineCatalog::LibertineCatalog(Registry::Impl& registry)
+    : _registry(registry)
+{
+    auto configpath = g_build_filename(g_get_user_data_dir(), "libertine", "ContainersConfig.json", nullptr);
+    _configPath = configpath;
+    g_free(configpath);
+}
+
+/** Checks whether a container exists
+
+    \param container Name of the container
+*/
+bool LibertineCatalog::hasContainer(const std::string& container)
+{
+    std::lock_guard<std::mutex> lock(_lock);
+    update();
+
+    return _containers.find(container) != _containers.end();
+}
+
+/** Checks whether a container has an application in it
+
+    \param container Name of the container
+    \param appname Name of the application
+*/
+bool LibertineCatalog::hasApp(const std::string& container, const std::string& appname)
+{
+    std::lock_guard<std::mutex> lock(_lock);
+    update();
+
+    auto found = _containers.find(container);
+    if (found == _containers.end())
+    {
+        return false;
+    }
+
+    return found->second->appnames.find(appname) != found->second->appnames.end();
+}
+
+/** Gets everything we know about a container, or nullptr if there
+    isn't a container with that name.
+
+    \param container Name of the container
+*/
+std::shared_ptr<const LibertineCatalog::Container> LibertineCatalog::container(const std::string& container)
+{
+    std::lock_guard<std::mutex> lock(_lock);
+    update();
+
+    auto found = _containers.find(container);
+    if (found == _containers.end())
+    {
+        return {};
+    }
+
+    return found->second;
+}
+
+/** Gets all of the containers in the order liblibertine lists them */
+std::list<std::shared_ptr<const LibertineCatalog::Container>> LibertineCatalog::containers()
+{
+    std::lock_guard<std::mutex> lock(_lock);
+    update();
+
+    std::list<std::shared_ptr<const Container>> containers;
+    for (const auto& name : _order)
+    {
+        containers.emplace_back(_containers[name]);
+    }
+
+    return containers;
+}
+
+/** Makes sure the catalog matches what is on disk. If the config file
+    changed we start over, otherwise only the containers whose
+    application directories changed are listed again. Needs to be called
+    with the lock held. */
+void LibertineCatalog::update()
+{
+    /* Get the time before reading so a change while we're reading causes
+       a rebuild next time instead of being missed */
+    auto configTime = mtime::get(_configPath);
+
+    if (!_built || _configTime == mtime::RACY || configTime != _configTime)
+    {
+        _built = true;
+        _configTime = mtime::trusted(configTime);
+        _order.clear();
+        _containers.clear();
+
+        auto containers = std::shared_ptr<gchar*>(libertine_list_containers(), g_strfreev);
+        for (int i = 0; containers && containers.get()[i] != nullptr; i++)
+        {
+            _order.emplace_back(containers.get()[i]);
+        }
+
+        fetch(_order);
+        return;
+    }
+
+    std::vector<std::string> changed;
+    for (const auto& container : _containers)
+    {
+        if (!containerCurrent(*container.second))
+        {
+            g_debug("Applications in libertine container '%s' changed", container.first.c_str());
+            changed.emplace_back(container.first);
+        }
+    }
+
+    if (!changed.empty())
+    {
+        fetch(changed);
+    }
+}
+
+/** Lists the applications in a set of containers, each container on its
+    own thread as each one needs to walk the directories of the
+    container.
+
+    \param names Names of the containers to list
+*/
+void LibertineCatalog::fetch(const std::vector<std::string>& names)
+{
+    std::vector<std::future<std::shared_ptr<const Container>>> futures;
+    for (const auto& name : names)
+    {
+        futures.emplace_back(std::async(std::launch::async, [this, name]() { return fetchContainer(name); }));
+    }
+
+    for (size_t i = 0; i < names.size(); i++)
+    {
+        _containers[names[i]] = futures[i].get();
+    }
+}
+
+/** Gets the paths and applications of a single container from
+    liblibertine. The desktop file indexes are checked before asking so
+    that a change while liblibertine is reading gets noticed next time.
+
+    \param name Name of the container
+*/
+std::shared_ptr<const LibertineCatalog::Container> LibertineCatalog::fetchContainer(const std::string& name)
+{
+    auto container = std::make_shared<Container>();
+    container->name = name;
+
+    auto gcontainer_path = libertine_container_path(name.c_str());
+    if (gcontainer_path != nullptr)
+    {
+        container->path = gcontainer_path;
+        g_free(gcontainer_path);
+    }
+
+    auto gcontainer_home_path = libertine_container_home_path(name.c_str());
+    if (gcontainer_home_path != nullptr)
+    {
+        container->homePath = gcontainer_home_path;
+        g_free(gcontainer_home_path);
+    }
+
+    container->systemGeneration = _registry.getDesktopFileIndex(systemAppsPath(container->path))->generation();
+    container->localGeneration = _registry.getDesktopFileIndex(localAppsPath(container->homePath))->generation();
+
+    auto apps = std::shared_ptr<gchar*>(libertine_list_apps_for_container(name.c_str()), g_strfreev);
+    for (int i = 0; apps && apps.get()[i] != nullptr; i++)
+    {
+        auto appid = AppID::parse(apps.get()[i]);
+        if (appid.appname.value().empty())
+        {
+            g_debug("Unable to parse libertine application ID '%s'", apps.get()[i]);
+            continue;
+        }
+
+        container->appnames.insert(appid.appname.value());
+        container->apps.emplace_back(appid);
+    }
+
+    return container;
+}
+
+/** Checks whether the application directories of a container are the
+    same as when we listed its applications.
+
+    \param container Container to check
+*/
+bool LibertineCatalog::containerCurrent(const Container& container)
+{
+    return _registry.getDesktopFileIndex(systemAppsPath(container.path))->generation() ==
+               container.systemGeneration &&
+           _registry.getDesktopFileIndex(localAppsPath(container.homePath))->generation() ==
+               container.localGeneration;
+}
+
+/** Path to the system applications directory in a container
+
+    \param containerPath Path to the root of the container
+*/
+std::string LibertineCatalog::systemAppsPath(const std::string& containerPath)
+{
+    auto path = g_build_filename(containerPath.c_str(), "usr", "share", "applications", nullptr);
+    std::string retval(path);
+    g_free(path);
+    return retval;
+}
+
+/** Path to the user applications directory in a container
+
+    \param homePath Path to the home directory in the container
+*/
+std::string LibertineCatalog::localAppsPath(const std::string& homePath)
+{
+    auto path = g_build_filename(homePath.c_str(), ".local", "share", "applications", nullptr);
+    std::string retval(path);
+    g_free(path);
+    return retval;
+}
+
+}  // namespace app_launch
+}  // namespace ubuntu
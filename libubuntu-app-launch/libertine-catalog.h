@@ -0,0 +1,116 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Ted Gould <ted.gould@canonical.com>
+ */
+
+#pragma once
+
+#include "appid.h"
+#include "registry.h"
+
+#include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace ubuntu
+{
+namespace app_launch
+{
+/** \brief The Libertine containers and the applications in each of them
+
+    Asking liblibertine for the containers reads the container config,
+    and asking it for the applications in a container walks the
+    application directories of that container. This object asks once and
+    keeps the answers, getting the applications for each container on its
+    own thread.
+
+    The containers are listed again when the container config file
+    changes. The applications in a container are listed again when one of
+    its application directories changes, which is found using the
+    desktop file indexes in the registry.
+*/
+class LibertineCatalog
+{
+public:
+    /** Everything we know about a single container */
+    struct Container
+    {
+        /** Name of the container */
+        std::string name;
+        /** Path to the root of the container */
+        std::string path;
+        /** Path to the home directory of the user in the container */
+        std::string homePath;
+        /** Applications in the order liblibertine listed them */
+        std::list<AppID> apps;
+        /** Names of the applications for quick lookups */
+        std::set<std::string> appnames;
+        /** Generation of the system applications index when listed */
+        std::uint64_t systemGeneration = 0;
+        /** Generation of the user applications index when listed */
+        std::uint64_t localGeneration = 0;
+    };
+
+    /** Create a LibertineCatalog, nothing is listed until the first lookup.
+
+        \param registry registry to get the desktop file indexes from
+    */
+    explicit LibertineCatalog(Registry::Impl& registry);
+    virtual ~LibertineCatalog() = default;
+
+    bool hasContainer(const std::string& container);
+    bool hasApp(const std::string& container, const std::string& appname);
+    std::shared_ptr<const Container> container(const std::string& container);
+    std::list<std::shared_ptr<const Container>> containers();
+
+private:
+    /** \private */
+    Registry::Impl& _registry;
+    /** \private */
+    std::mutex _lock;
+    /** \private Path to the container config file of liblibertine */
+    std::string _configPath;
+    /** \private Whether the containers have been listed yet */
+    bool _built = false;
+    /** \private Modification time of the config file when it was read */
+    std::int64_t _configTime = -1;
+    /** \private Container names in the order liblibertine listed them */
+    std::vector<std::string> _order;
+    /** \private Containers by name */
+    std::map<std::string, std::shared_ptr<const Container>> _containers;
+
+    /** \private */
+    void update();
+    /** \private */
+    void fetch(const std::vector<std::string>& names);
+    /** \private */
+    std::shared_ptr<const Container> fetchContainer(const std::string& name);
+    /** \private */
+    bool containerCurrent(const Container& container);
+    /** \private */
+    static std::string systemAppsPath(const std::string& containerPath);
+    /** \private */
+    static std::string localAppsPath(const std::string& homePath);
+};
+
+}  // namespace app_launch
+}  // namespace ubuntu
@@ -0,0 +1,82 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Ted Gould <ted.gould@canonical.com>
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <sys/stat.h>
+
+namespace ubuntu
+{
+namespace app_launch
+{
+namespace mtime
+{
+
+/** Stored in place of a modification time that changed too recently to
+    be trusted, it never matches a real one */
+constexpr std::int64_t RACY = -2;
+
+/** Gets the modification time of a path in nanoseconds, or -1 if it
+    doesn't exist.
+
+    \param path Path to check
+*/
+inline std::int64_t get(const std::string& path)
+{
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0)
+    {
+        return -1;
+    }
+
+    return std::int64_t(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+}
+
+/** Modification times come from a clock that only ticks every few
+    milliseconds, or every second on some file systems. If something
+    changed in the last second it could change again without its time
+    moving, so the time can't be trusted to tell us about the next change.
+
+    \param time Modification time from get()
+*/
+inline bool isRacy(std::int64_t time)
+{
+    auto now =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch())
+            .count();
+
+    return time >= 0 && time >= now - 1000000000;
+}
+
+/** Gets the time to remember for checking whether something changed,
+    which is RACY if it can't be trusted yet.
+
+    \param time Modification time from get()
+*/
+inline std::int64_t trusted(std::int64_t time)
+{
+    return isRacy(time) ? RACY : time;
+}
+
+}  // namespace mtime
+}  // namespace app_launch
+}  // namespace ubuntu
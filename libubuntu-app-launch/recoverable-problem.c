@@ -21,145 +21,149 @@
 #include <glib/gstdio.h>
 #include <string.h>
 #include <errno.h>
+#include <unistd.h>
 
-/* Helpers to ensure we write nicely */
-static void 
-write_string (int          fd,
-              const gchar *string)
+/* Helper to ensure we write nicely */
+static void
+write_data (int fd, const gchar * data, gsize len)
 {
-	int res; 
-	do
-		res = write (fd, string, strlen (string));
-	while (G_UNLIKELY (res == -1 && errno == EINTR));
-}
-
-/* Make NULLs fast and fun! */
-static void 
-write_null (int fd)
-{
-	int res; 
-	do
-		res = write (fd, "", 1);
-	while (G_UNLIKELY (res == -1 && errno == EINTR));
-}
+	while (len > 0) {
+		gssize res = write(fd, data, len);
+		if (res < 0) {
+			if (errno == EINTR)
+				continue;
+			g_warning("Unable to write to the recoverable problem reporter: %s", g_strerror(errno));
+			return;
+		}
 
-/* Child watcher */
-static gboolean
-apport_child_watch (GPid pid, gint status, gpointer user_data)
-{
-	g_main_loop_quit((GMainLoop *)user_data);
-	return FALSE;
+		data += res;
+		len -= res;
+	}
 }
 
-static gboolean
-apport_child_timeout (gpointer user_data)
-{
-	g_warning("Recoverable Error Reporter Timeout");
-	g_main_loop_quit((GMainLoop *)user_data);
-	return FALSE;
-}
+/* Reports waiting to be handed to the reporter, and the signatures
+   we've already seen so the same problem only goes once */
+G_LOCK_DEFINE_STATIC(report_queue);
+static GString * report_queue = NULL;
+static GHashTable * report_signatures = NULL;
 
-/* Code to report an error */
+/* Queues a report, reports with a signature we've already got are
+   dropped. Nothing is run until recoverable_problem_flush(). A PID of
+   zero is us, apport would otherwise blame the reporter. */
 void
-report_recoverable_problem (const gchar * signature, GPid report_pid, gboolean wait, const gchar * additional_properties[])
+report_recoverable_problem (const gchar * signature, GPid report_pid, const gchar * additional_properties[])
 {
-	GError * error = NULL;
-	gint error_stdin = 0;
-	GPid pid = 0;
-	gchar * pid_str = NULL;
-	gchar ** argv = NULL;
-	gchar * argv_nopid[2] = {
-		"/usr/share/apport/recoverable_problem",
-		NULL
-	};
-	gchar * argv_pid[4] = {
-		"/usr/share/apport/recoverable_problem",
-		"-p",
-		NULL, /* put pid_str when allocated here */
-		NULL
-	};
-
+	/* What recoverable_problem wants on stdin, NUL separated with no
+	   NUL on the end */
+	GString * payload = g_string_new(NULL);
+
+	if (signature != NULL) {
+		g_string_append(payload, "DuplicateSignature");
+		g_string_append_c(payload, '\0');
+		g_string_append(payload, signature);
+	}
 
-	argv = (gchar **)argv_nopid;
+	if (additional_properties != NULL) {
+		gint i;
+		for (i = 0; additional_properties[i] != NULL; i++) {
+			if (payload->len != 0 || i != 0) {
+				g_string_append_c(payload, '\0');
+			}
 
-	if (report_pid != 0) {
-		pid_str = g_strdup_printf("%d", report_pid);
-		argv_pid[2] = pid_str;
-		argv = (gchar**)argv_pid;
+			g_string_append(payload, additional_properties[i]);
+		}
 	}
 
-	GSpawnFlags flags = G_SPAWN_STDOUT_TO_DEV_NULL | G_SPAWN_STDERR_TO_DEV_NULL;
-	if (wait) {
-		flags |= G_SPAWN_DO_NOT_REAP_CHILD;
+	if (report_pid == 0) {
+		report_pid = getpid();
 	}
 
-	g_spawn_async_with_pipes(NULL, /* cwd */
-		argv,
-		NULL, /* envp */
-		flags,
-		NULL, NULL, /* child setup func */
-		&pid,
-		&error_stdin,
-		NULL, /* stdout */
-		NULL, /* stderr */
-		&error);
+	G_LOCK(report_queue);
 
-	if (error != NULL) {
-		g_warning("Unable to report a recoverable error: %s", error->message);
-		g_error_free(error);
+	if (report_signatures == NULL) {
+		report_signatures = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
 	}
 
-	gboolean first = TRUE;
+	if (signature != NULL && g_hash_table_contains(report_signatures, signature)) {
+		g_debug("Already reported recoverable problem: %s", signature);
+	} else {
+		if (signature != NULL) {
+			g_hash_table_add(report_signatures, g_strdup(signature));
+		}
 
-	if (error_stdin != 0 && signature != NULL) {
-		write_string(error_stdin, "DuplicateSignature");
-		write_null(error_stdin);
-		write_string(error_stdin, signature);
+		if (report_queue == NULL) {
+			report_queue = g_string_new(NULL);
+		}
 
-		first = FALSE;
+		/* The reporter reads the PID and size before each one */
+		g_string_append_printf(report_queue, "%d\n%" G_GSIZE_FORMAT "\n", report_pid, payload->len);
+		g_string_append_len(report_queue, payload->str, payload->len);
 	}
 
-	if (error_stdin != 0 && additional_properties != NULL) {
-		gint i;
-		for (i = 0; additional_properties[i] != NULL; i++) {
-			if (!first) {
-				write_null(error_stdin);
-			} else {
-				first = FALSE;
-			}
-
-			write_string(error_stdin, additional_properties[i]);
-		}
-	}
+	G_UNLOCK(report_queue);
 
-	if (error_stdin != 0) {
-		close(error_stdin);
-	}
+	g_string_free(payload, TRUE);
+}
 
-	if (wait && pid != 0) {
-		GSource * child_source, * timeout_source;
-		GMainContext * context = g_main_context_new();
-		GMainLoop * loop = g_main_loop_new(context, FALSE);
+/* Hands everything queued to one reporter process, which runs them in
+   the background. GLib reaps it, we only wait for it to have read the
+   queue so that apport can still find us if we exit right after. */
+void
+recoverable_problem_flush (void)
+{
+	G_LOCK(report_queue);
+	GString * queue = report_queue;
+	report_queue = NULL;
+	G_UNLOCK(report_queue);
 
-		child_source = g_child_watch_source_new(pid);
-		g_source_attach(child_source, context);
-		g_source_set_callback(child_source, (GSourceFunc)apport_child_watch, loop, NULL);
+	if (queue == NULL) {
+		return;
+	}
 
-		timeout_source = g_timeout_source_new_seconds(5);
-		g_source_attach(timeout_source, context);
-		g_source_set_callback(timeout_source, apport_child_timeout, loop, NULL);
+	GError * error = NULL;
+	gint reporter_stdin = 0;
+	gint reporter_stdout = 0;
+	const gchar * reporter = g_getenv("UBUNTU_APP_LAUNCH_RECOVERABLE_PROBLEM_REPORTER");
+	if (reporter == NULL) {
+		reporter = RECOVERABLE_PROBLEM_REPORTER;
+	}
+	gchar * argv[2] = {
+		(gchar *)reporter,
+		NULL
+	};
 
-		g_main_loop_run(loop);
+	g_spawn_async_with_pipes(NULL, /* cwd */
+		argv,
+		NULL, /* envp */
+		G_SPAWN_STDERR_TO_DEV_NULL,
+		NULL, NULL, /* child setup func */
+		NULL, /* pid */
+		&reporter_stdin,
+		&reporter_stdout,
+		NULL, /* stderr */
+		&error);
 
-		g_source_destroy(timeout_source);
-		g_source_destroy(child_source);
-		g_main_loop_unref(loop);
-		g_main_context_unref(context);
+	if (error != NULL) {
+		g_warning("Unable to report recoverable errors: %s", error->message);
+		g_error_free(error);
+	}
 
-		g_spawn_close_pid(pid);
+	/* It reads everything before starting on the reports, so this
+	   doesn't wait on them */
+	if (reporter_stdin != 0) {
+		write_data(reporter_stdin, queue->str, queue->len);
+		close(reporter_stdin);
 	}
 
-	g_free(pid_str);
+	/* It closes its stdout once it has the whole queue */
+	if (reporter_stdout != 0) {
+		gchar buffer[64];
+		gssize res;
+		do
+			res = read(reporter_stdout, buffer, sizeof(buffer));
+		while (res > 0 || (res < 0 && errno == EINTR));
+		close(reporter_stdout);
+	}
 
-	return;
+	g_string_free(queue, TRUE);
 }
@@ -21,6 +21,5 @@
 
 void    report_recoverable_problem    (const gchar *   signature,
                                        GPid            report_pid,
-                                       gboolean        wait,
                                        const gchar *   additional_properties[]);
-
+void    recoverable_problem_flush     (void);
@@ -19,7 +19,13 @@
 
 #include "registry-impl.h"
 #include "application-icon-finder.h"
+#include "desktop-file-index.h"
+#include "helpers.h"
+#include "libertine-catalog.h"
+#include "second-exec-core.h"
+#include <algorithm>
 #include <cgmanager/cgmanager.h>
+#include <future>
 #include <upstart.h>
 
 namespace ubuntu
@@ -27,6 +33,39 @@ namespace ubuntu
 namespace app_launch
 {
 
+namespace
+{
+/** How long Zeitgeist events wait for others to be sent with, unless
+    UBUNTU_APP_LAUNCH_ZG_BATCH_MS says otherwise */
+constexpr std::chrono::milliseconds ZG_BATCH_WINDOW{500};
+/** Most Zeitgeist events we'll hold, unless UBUNTU_APP_LAUNCH_ZG_BATCH_MAX
+    says otherwise */
+constexpr std::size_t ZG_BATCH_MAX{32};
+/** How long shutting down waits for the last events to get to Zeitgeist */
+constexpr std::chrono::seconds ZG_FLUSH_TIMEOUT{1};
+
+/** Reads a number out of the environment, or gives back the default
+    if it isn't set or isn't a number */
+guint64 envNumber(const gchar* name, guint64 defvalue)
+{
+    auto value = g_getenv(name);
+    if (value == nullptr || value[0] == '\0')
+    {
+        return defvalue;
+    }
+
+    gchar* end = nullptr;
+    auto number = g_ascii_strtoull(value, &end, 10);
+    if (end == nullptr || *end != '\0')
+    {
+        g_warning("Value of '%s' isn't a number: %s", name, value);
+        return defvalue;
+    }
+
+    return number;
+}
+}  // namespace
+
 Registry::Impl::Impl(Registry* registry)
     : thread([]() {},
              [this]() {
@@ -37,9 +76,14 @@ Registry::Impl::Impl(Registry* registry)
                  cgManager_.reset();
 
                  if (_dbus)
+                 {
+                     second_exec_cleanup(_dbus.get());
                      g_dbus_connection_flush_sync(_dbus.get(), nullptr, nullptr);
+                 }
                  _dbus.reset();
              })
+    , zgBatchWindow_(envNumber("UBUNTU_APP_LAUNCH_ZG_BATCH_MS", ZG_BATCH_WINDOW.count()))
+    , zgBatchMax_(std::max(guint64(1), envNumber("UBUNTU_APP_LAUNCH_ZG_BATCH_MAX", ZG_BATCH_MAX)))
     , _registry(registry)
     , _iconFinders()
 // _manager(nullptr)
@@ -51,49 +95,94 @@ Registry::Impl::Impl(Registry* registry)
     });
 }
 
-void Registry::Impl::initClick()
+Registry::Impl::~Impl()
 {
-    if (_clickDB && _clickUser)
+    /* Launches waiting on Unity would never get started once the
+       thread is gone */
+    try
     {
-        return;
+        thread.executeOnThread<bool>([this] {
+            finishHandshakes();
+            return true;
+        });
+    }
+    catch (std::runtime_error& e)
+    {
+        g_debug("Unable to start the launches waiting on Unity: %s", e.what());
     }
 
-    auto init = thread.executeOnThread<bool>([this]() {
-        GError* error = nullptr;
+    /* The events that are waiting for the rest of their batch would
+       be lost if we just stopped */
+    auto promise = std::make_shared<std::promise<void>>();
+    auto future = promise->get_future();
 
-        if (!_clickDB)
-        {
-            _clickDB = std::shared_ptr<ClickDB>(click_db_new(), [](ClickDB* db) { g_clear_object(&db); });
-            /* If TEST_CLICK_DB is unset, this reads the system database. */
-            click_db_read(_clickDB.get(), g_getenv("TEST_CLICK_DB"), &error);
+    try
+    {
+        thread.executeOnThread([this, promise] { zgFlush([promise] { promise->set_value(); }); });
 
-            if (error != nullptr)
-            {
-                auto perror = std::shared_ptr<GError>(error, [](GError* error) { g_error_free(error); });
-                throw std::runtime_error(perror->message);
-            }
+        if (future.wait_for(ZG_FLUSH_TIMEOUT) != std::future_status::ready)
+        {
+            g_warning("Zeitgeist took too long to take the last events");
         }
+    }
+    catch (std::runtime_error& e)
+    {
+        g_debug("Unable to send the last Zeitgeist events: %s", e.what());
+    }
+
+    thread.quit();
+}
+
+/** Stops waiting on Unity for the launches that are still waiting, so
+    that their Start calls go out before the thread quits. Each one takes
+    itself off the list when it's called. Only run on the registry thread. */
+void Registry::Impl::finishHandshakes()
+{
+    shuttingDown = true;
+
+    while (!pendingHandshakes.empty())
+    {
+        auto handshake = *pendingHandshakes.begin();
+        pendingHandshakes.erase(pendingHandshakes.begin());
+        starting_handshake_finish(handshake);
+    }
+}
+
+/** Sets up the Click database and user the first time they're needed.
+    Applications can be created on any thread, so this only runs on the
+    registry thread which is also where they're used and released. */
+void Registry::Impl::initClick()
+{
+    GError* error = nullptr;
+
+    if (!_clickDB)
+    {
+        _clickDB = std::shared_ptr<ClickDB>(click_db_new(), [](ClickDB* db) { g_clear_object(&db); });
+        /* If TEST_CLICK_DB is unset, this reads the system database. */
+        click_db_read(_clickDB.get(), g_getenv("TEST_CLICK_DB"), &error);
 
-        if (!_clickUser)
+        if (error != nullptr)
         {
-            _clickUser =
-                std::shared_ptr<ClickUser>(click_user_new_for_user(_clickDB.get(), g_getenv("TEST_CLICK_USER"), &error),
-                                           [](ClickUser* user) { g_clear_object(&user); });
+            _clickDB.reset();
+            auto perror = std::shared_ptr<GError>(error, [](GError* error) { g_error_free(error); });
+            throw std::runtime_error(perror->message);
+        }
+    }
 
-            if (error != nullptr)
-            {
-                auto perror = std::shared_ptr<GError>(error, [](GError* error) { g_error_free(error); });
-                throw std::runtime_error(perror->message);
-            }
+    if (!_clickUser)
+    {
+        _clickUser =
+            std::shared_ptr<ClickUser>(click_user_new_for_user(_clickDB.get(), g_getenv("TEST_CLICK_USER"), &error),
+                                       [](ClickUser* user) { g_clear_object(&user); });
+
+        if (error != nullptr)
+        {
+            _clickUser.reset();
+            auto perror = std::shared_ptr<GError>(error, [](GError* error) { g_error_free(error); });
+            throw std::runtime_error(perror->message);
         }
 
         g_debug("Initialized Click DB");
-        return true;
-    });
-
-    if (!init)
-    {
-        throw std::runtime_error("Unable to initialize the Click Database");
     }
 }
 
@@ -136,9 +225,9 @@ std::string Registry::Impl::printJson(std::shared_ptr<JsonNode> jsonnode)
 
 std::shared_ptr<JsonObject> Registry::Impl::getClickManifest(const std::string& package)
 {
-    initClick();
-
     auto retval = thread.executeOnThread<std::shared_ptr<JsonObject>>([this, package]() {
+        initClick();
+
         GError* error = nullptr;
         auto mani = click_user_get_manifest(_clickUser.get(), package.c_str(), &error);
 
@@ -167,9 +256,9 @@ std::shared_ptr<JsonObject> Registry::Impl::getClickManifest(const std::string&
 
 std::list<AppID::Package> Registry::Impl::getClickPackages()
 {
-    initClick();
-
     return thread.executeOnThread<std::list<AppID::Package>>([this]() {
+        initClick();
+
         GError* error = nullptr;
         GList* pkgs = click_user_get_package_names(_clickUser.get(), &error);
 
@@ -196,9 +285,9 @@ std::list<AppID::Package> Registry::Impl::getClickPackages()
 
 std::string Registry::Impl::getClickDir(const std::string& package)
 {
-    initClick();
-
     return thread.executeOnThread<std::string>([this, package]() {
+        initClick();
+
         GError* error = nullptr;
         auto dir = click_user_get_path(_clickUser.get(), package.c_str(), &error);
 
@@ -317,6 +406,62 @@ std::vector<pid_t> Registry::Impl::pidsFromCgroup(const std::string& jobpath)
     });
 }
 
+/** Freezes or thaws all of the processes in a job's cgroup by setting the
+    state of the freezer controller through CGManager. The kernel does this
+    for the whole group at once, so unlike signaling each PID there is no
+    race with processes that fork while we're working through the list.
+
+    Returns false if CGManager couldn't set the state, in which case the
+    caller needs to fall back to signals.
+
+    \param jobpath Upstart job path of the instance
+    \param frozen Whether the processes should be frozen or thawed
+*/
+bool Registry::Impl::setCgroupFrozen(const std::string& jobpath, bool frozen)
+{
+    initCGManager();
+    auto lmanager = cgManager_; /* Grab a local copy so we ensure it lasts through our lifetime */
+
+    if (jobpath.empty())
+    {
+        /* Freezing the root of our tree would freeze everything */
+        return false;
+    }
+
+    return thread.executeOnThread<bool>([&jobpath, frozen, lmanager]() {
+        GError* error = nullptr;
+        const gchar* name = g_getenv("UBUNTU_APP_LAUNCH_CG_MANAGER_NAME");
+        std::string groupname = "upstart/" + jobpath;
+        const gchar* state = frozen ? "FROZEN" : "THAWED";
+
+        g_debug("Setting cgroup '%s' to '%s'", groupname.c_str(), state);
+
+        GVariant* vret = g_dbus_connection_call_sync(
+            lmanager.get(),                                                                /* connection */
+            name,                                                                          /* bus name */
+            "/org/linuxcontainers/cgmanager",                                              /* object */
+            "org.linuxcontainers.cgmanager0_0",                                            /* interface */
+            "SetValue",                                                                    /* method */
+            g_variant_new("(ssss)", "freezer", groupname.c_str(), "freezer.state", state), /* params */
+            nullptr,                                                                       /* output */
+            G_DBUS_CALL_FLAGS_NONE,                                                        /* flags */
+            -1,                                                                            /* default timeout */
+            nullptr,                                                                       /* cancellable */
+            &error);                                                                       /* error */
+
+        g_clear_pointer(&vret, g_variant_unref);
+
+        if (error != nullptr)
+        {
+            g_debug("Unable to set freezer state of cgroup '%s': %s", groupname.c_str(), error->message);
+            g_error_free(error);
+            return false;
+        }
+
+        return true;
+    });
+}
+
 /** Looks to find the Upstart object path for a specific Upstart job. This first
     checks the cache, and otherwise does the lookup on DBus. */
 std::string Registry::Impl::upstartJobPath(const std::string& job)
@@ -458,11 +603,20 @@ std::list<std::string> Registry::Impl::upstartInstancesForJob(const std::string&
     });
 }
 
-/** Send an event to Zietgeist using the registry thread so that
-        the callback comes back in the right place. */
+/** Queue an event for Zeitgeist on the registry thread. Focus moves
+    between applications many times a minute, so the events wait a
+    little while for others and go together in one call. An application
+    that is left and then accessed again the same way it just was has
+    its pair merged with the one before it, as nothing new happened.
+
+    \param appid Application the event is about
+    \param eventtype Zeitgeist interpretation of the event
+*/
 void Registry::Impl::zgSendEvent(AppID appid, const std::string& eventtype)
 {
-    thread.executeOnThread([this, appid, eventtype] {
+    auto timestamp = g_get_real_time() / 1000;
+
+    thread.executeOnThread([this, appid, eventtype, timestamp] {
         std::string uri;
 
         if (appid.package.value().empty())
@@ -474,54 +628,219 @@ void Registry::Impl::zgSendEvent(AppID appid, const std::string& eventtype)
             uri = "application://" + appid.package.value() + "_" + appid.appname.value() + ".desktop";
         }
 
-        g_debug("Sending ZG event for '%s': %s", uri.c_str(), eventtype.c_str());
+        g_debug("Queuing ZG event for '%s': %s", uri.c_str(), eventtype.c_str());
 
-        if (!zgLog_)
+        /* Leave, access, leave, access of the same app is the same as
+           leave, access */
+        auto size = zgPending_.size();
+        if (size >= 3 && eventtype == ZEITGEIST_ZG_ACCESS_EVENT)
         {
-            zgLog_ =
-                std::shared_ptr<ZeitgeistLog>(zeitgeist_log_new(), /* create a new log for us */
-                                              [](ZeitgeistLog* log) { g_clear_object(&log); }); /* Free as a GObject */
+            const auto& leave = zgPending_[size - 3];
+            const auto& access = zgPending_[size - 2];
+            const auto& releave = zgPending_[size - 1];
+
+            if (leave.uri == uri && access.uri == uri && releave.uri == uri &&
+                leave.eventtype == ZEITGEIST_ZG_LEAVE_EVENT && access.eventtype == ZEITGEIST_ZG_ACCESS_EVENT &&
+                releave.eventtype == ZEITGEIST_ZG_LEAVE_EVENT)
+            {
+                g_debug("Merging ZG events for '%s'", uri.c_str());
+                zgPending_.pop_back();
+                return;
+            }
         }
 
+        zgPending_.emplace_back(ZgPendingEvent{uri, eventtype, timestamp});
+
+        if (zgPending_.size() >= zgBatchMax_ || zgBatchWindow_.count() == 0)
+        {
+            zgFlush([] {});
+        }
+        else if (!zgFlushQueued_)
+        {
+            zgFlushQueued_ = true;
+            thread.timeout(zgBatchWindow_, [this] {
+                zgFlushQueued_ = false;
+                zgFlush([] {});
+            });
+        }
+    });
+}
+
+/** Send the queued events to Zeitgeist in a single call. Must be
+    called on the registry thread.
+
+    \param done Called once Zeitgeist has them, or straight away if
+                there is nothing to send
+*/
+void Registry::Impl::zgFlush(std::function<void()> done)
+{
+    if (zgPending_.empty())
+    {
+        done();
+        return;
+    }
+
+    if (!zgLog_)
+    {
+        zgLog_ = std::shared_ptr<ZeitgeistLog>(zeitgeist_log_new(), /* create a new log for us */
+                                               [](ZeitgeistLog* log) { g_clear_object(&log); }); /* Free as a GObject */
+    }
+
+    g_debug("Sending %d ZG events", int(zgPending_.size()));
+
+    GPtrArray* events = g_ptr_array_new_with_free_func(g_object_unref);
+
+    for (const auto& pending : zgPending_)
+    {
         ZeitgeistEvent* event = zeitgeist_event_new();
         zeitgeist_event_set_actor(event, "application://ubuntu-app-launch.desktop");
-        zeitgeist_event_set_interpretation(event, eventtype.c_str());
+        zeitgeist_event_set_interpretation(event, pending.eventtype.c_str());
         zeitgeist_event_set_manifestation(event, ZEITGEIST_ZG_USER_ACTIVITY);
+        zeitgeist_event_set_timestamp(event, pending.timestamp);
 
         ZeitgeistSubject* subject = zeitgeist_subject_new();
         zeitgeist_subject_set_interpretation(subject, ZEITGEIST_NFO_SOFTWARE);
         zeitgeist_subject_set_manifestation(subject, ZEITGEIST_NFO_SOFTWARE_ITEM);
         zeitgeist_subject_set_mimetype(subject, "application/x-desktop");
-        zeitgeist_subject_set_uri(subject, uri.c_str());
+        zeitgeist_subject_set_uri(subject, pending.uri.c_str());
 
         zeitgeist_event_add_subject(event, subject);
+        g_object_unref(subject);
+
+        g_ptr_array_add(events, event);
+    }
 
-        zeitgeist_log_insert_event(zgLog_.get(), /* log */
-                                   event,        /* event */
-                                   nullptr,      /* cancellable */
-                                   [](GObject* obj, GAsyncResult* res, gpointer user_data) -> void {
-                                       GError* error = nullptr;
-                                       GArray* result = nullptr;
+    zgPending_.clear();
 
-                                       result = zeitgeist_log_insert_event_finish(ZEITGEIST_LOG(obj), res, &error);
+    zeitgeist_log_insert_events(zgLog_.get(), /* log */
+                                events,       /* events */
+                                nullptr,      /* cancellable */
+                                [](GObject* obj, GAsyncResult* res, gpointer user_data) -> void {
+                                    auto done = static_cast<std::function<void()>*>(user_data);
+                                    GError* error = nullptr;
+                                    GArray* result = nullptr;
 
-                                       if (error != nullptr)
-                                       {
-                                           g_warning("Unable to submit Zeitgeist Event: %s", error->message);
-                                           g_error_free(error);
-                                       }
+                                    result = zeitgeist_log_insert_events_finish(ZEITGEIST_LOG(obj), res, &error);
 
-                                       g_array_free(result, TRUE);
-                                   },        /* callback */
-                                   nullptr); /* userdata */
+                                    if (error != nullptr)
+                                    {
+                                        g_warning("Unable to submit Zeitgeist Events: %s", error->message);
+                                        g_error_free(error);
+                                    }
 
-        g_object_unref(event);
-        g_object_unref(subject);
+                                    if (result != nullptr)
+                                    {
+                                        g_array_free(result, TRUE);
+                                    }
+
+                                    (*done)();
+                                    delete done;
+                                },                                /* callback */
+                                new std::function<void()>(done)); /* userdata */
+
+    g_ptr_array_unref(events);
+}
+
+/** Ask Zeitgeist for the applications that we've reported being opened
+    the most over the last month, the most popular first. The names are
+    the ones zgSendEvent() uses, so they need AppID::find() to get the
+    version. Gives up after a couple of seconds if Zeitgeist doesn't
+    answer, as zg-report-app does.
+
+    \param count Most applications to return
+*/
+std::list<std::string> Registry::Impl::zgPopularApps(unsigned int count)
+{
+    auto promise = std::make_shared<std::promise<std::list<std::string>>>();
+    auto future = promise->get_future();
+
+    thread.executeOnThread([this, count, promise] {
+        if (!zgLog_)
+        {
+            zgLog_ =
+                std::shared_ptr<ZeitgeistLog>(zeitgeist_log_new(), /* create a new log for us */
+                                              [](ZeitgeistLog* log) { g_clear_object(&log); }); /* Free as a GObject */
+        }
+
+        ZeitgeistEvent* event = zeitgeist_event_new();
+        zeitgeist_event_set_actor(event, "application://ubuntu-app-launch.desktop");
+        zeitgeist_event_set_interpretation(event, ZEITGEIST_ZG_ACCESS_EVENT);
+
+        GPtrArray* templates = g_ptr_array_new_with_free_func(g_object_unref);
+        g_ptr_array_add(templates, event);
+
+        gint64 now = g_get_real_time() / 1000;
+        ZeitgeistTimeRange* range = zeitgeist_time_range_new(now - gint64(30) * 24 * 60 * 60 * 1000, now);
+
+        zeitgeist_log_find_events(
+            zgLog_.get(),                                /* log */
+            range,                                       /* time range */
+            templates,                                   /* event templates */
+            ZEITGEIST_STORAGE_STATE_ANY,                 /* storage state */
+            count,                                       /* number of events */
+            ZEITGEIST_RESULT_TYPE_MOST_POPULAR_SUBJECTS, /* result type */
+            nullptr,                                     /* cancellable */
+            [](GObject* obj, GAsyncResult* res, gpointer user_data) -> void {
+                auto promise = static_cast<std::shared_ptr<std::promise<std::list<std::string>>>*>(user_data);
+                std::list<std::string> apps;
+                GError* error = nullptr;
+
+                auto results = zeitgeist_log_find_events_finish(ZEITGEIST_LOG(obj), res, &error);
+
+                if (error != nullptr)
+                {
+                    g_warning("Unable to get popular applications from Zeitgeist: %s", error->message);
+                    g_error_free(error);
+                }
+
+                while (results != nullptr && zeitgeist_result_set_has_next(results))
+                {
+                    auto event = zeitgeist_result_set_next_value(results);
+                    if (event == nullptr)
+                    {
+                        break;
+                    }
+
+                    if (zeitgeist_event_num_subjects(event) > 0)
+                    {
+                        std::string uri{zeitgeist_subject_get_uri(zeitgeist_event_get_subject(event, 0))};
+                        std::string prefix{"application://"};
+                        std::string suffix{".desktop"};
+
+                        if (uri.size() > prefix.size() + suffix.size() && uri.compare(0, prefix.size(), prefix) == 0 &&
+                            uri.compare(uri.size() - suffix.size(), suffix.size(), suffix) == 0)
+                        {
+                            apps.emplace_back(uri.substr(prefix.size(), uri.size() - prefix.size() - suffix.size()));
+                        }
+                    }
+
+                    g_object_unref(event);
+                }
+
+                g_clear_object(&results);
+
+                (*promise)->set_value(apps);
+                delete promise;
+            },                                                                   /* callback */
+            new std::shared_ptr<std::promise<std::list<std::string>>>(promise)); /* userdata */
+
+        g_object_unref(range);
+        g_ptr_array_unref(templates);
     });
+
+    if (future.wait_for(std::chrono::seconds(2)) != std::future_status::ready)
+    {
+        g_warning("Zeitgeist took too long to list popular applications");
+        return {};
+    }
+
+    return future.get();
 }
 
 std::shared_ptr<IconFinder> Registry::Impl::getIconFinder(std::string basePath)
 {
+    std::lock_guard<std::mutex> lock(_iconFindersLock);
+
     if (_iconFinders.find(basePath) == _iconFinders.end())
     {
         _iconFinders[basePath] = std::make_shared<IconFinder>(basePath);
@@ -529,6 +848,40 @@ std::shared_ptr<IconFinder> Registry::Impl::getIconFinder(std::string basePath)
     return _iconFinders[basePath];
 }
 
+/** Get the index of the desktop files in a directory, making one if
+    this is the first time the directory has been asked for.
+
+    \param basePath Directory to look for desktop files in
+*/
+std::shared_ptr<DesktopFileIndex> Registry::Impl::getDesktopFileIndex(const std::string& basePath)
+{
+    std::lock_guard<std::mutex> lock(_desktopFileIndexesLock);
+
+    auto index = _desktopFileIndexes.find(basePath);
+    if (index != _desktopFileIndexes.end())
+    {
+        return index->second;
+    }
+
+    auto newindex = std::make_shared<DesktopFileIndex>(basePath);
+    _desktopFileIndexes[basePath] = newindex;
+    return newindex;
+}
+
+/** Get the catalog of Libertine containers and applications, it is
+    created the first time it is asked for. */
+std::shared_ptr<LibertineCatalog> Registry::Impl::getLibertineCatalog()
+{
+    std::lock_guard<std::mutex> lock(_libertineCatalogLock);
+
+    if (!_libertineCatalog)
+    {
+        _libertineCatalog = std::make_shared<LibertineCatalog>(*this);
+    }
+
+    return _libertineCatalog;
+}
+
 #if 0
 void
 Registry::Impl::setManager (Registry::Manager* manager)
@@ -20,21 +20,31 @@
 #include "glib-thread.h"
 #include "registry.h"
 #include "snapd-info.h"
+#include <chrono>
 #include <click.h>
+#include <functional>
 #include <gio/gio.h>
 #include <json-glib/json-glib.h>
 #include <map>
+#include <mutex>
+#include <set>
 #include <unordered_map>
+#include <vector>
 #include <zeitgeist.h>
 
 #pragma once
 
+/* From helpers.h */
+typedef struct _handshake_t handshake_t;
+
 namespace ubuntu
 {
 namespace app_launch
 {
 
 class IconFinder;
+class DesktopFileIndex;
+class LibertineCatalog;
 
 /** \private
     \brief Private implementation of the Registry object
@@ -44,10 +54,7 @@ class Registry::Impl
 {
 public:
     Impl(Registry* registry);
-    virtual ~Impl()
-    {
-        thread.quit();
-    }
+    virtual ~Impl();
 
     std::shared_ptr<JsonObject> getClickManifest(const std::string& package);
     std::list<AppID::Package> getClickPackages();
@@ -70,10 +77,26 @@ public:
 #endif
 
     std::shared_ptr<IconFinder> getIconFinder(std::string basePath);
+    std::shared_ptr<DesktopFileIndex> getDesktopFileIndex(const std::string& basePath);
+    std::shared_ptr<LibertineCatalog> getLibertineCatalog();
 
     void zgSendEvent(AppID appid, const std::string& eventtype);
+    std::list<std::string> zgPopularApps(unsigned int count);
 
     std::vector<pid_t> pidsFromCgroup(const std::string& jobpath);
+    bool setCgroupFrozen(const std::string& jobpath, bool frozen);
+
+    /** Applications launched in standby that haven't been frozen yet,
+        to the Upstart instance they're in. A standard launch takes
+        them out so that they're left running. Only used on the thread. */
+    std::map<std::string, std::string> standbySettling;
+
+    /** Launches waiting on the handshake with Unity to send their Start
+        call, only touched on the registry thread */
+    std::set<handshake_t*> pendingHandshakes;
+    /** Set once the registry is going away, the launches can't wait for
+        an answer from Upstart on the thread after this */
+    bool shuttingDown = false;
 
     /* Upstart Jobs */
     std::list<std::string> upstartInstancesForJob(const std::string& job);
@@ -94,6 +117,7 @@ private:
     Registry::Manager* _manager;
 #endif
 
+    /** Click database and user, only touched on the registry thread */
     std::shared_ptr<ClickDB> _clickDB;
     std::shared_ptr<ClickUser> _clickUser;
 
@@ -101,11 +125,50 @@ private:
 
     std::shared_ptr<ZeitgeistLog> zgLog_;
 
+    /** A Zeitgeist event waiting to go out with the next batch */
+    struct ZgPendingEvent
+    {
+        std::string uri;
+        std::string eventtype;
+        /** When it happened, in milliseconds since the epoch as
+            Zeitgeist wants it, as it is sent later */
+        gint64 timestamp;
+    };
+    /** Events waiting to be sent, only touched on the registry thread */
+    std::vector<ZgPendingEvent> zgPending_;
+    /** Whether there is a timeout waiting to send the batch */
+    bool zgFlushQueued_ = false;
+    /** How long events wait for others to go with them, zero sends
+        each one as it comes */
+    std::chrono::milliseconds zgBatchWindow_;
+    /** Most events we'll hold before sending them */
+    std::size_t zgBatchMax_;
+
+    void zgFlush(std::function<void()> done);
+
+    void finishHandshakes();
+
     std::shared_ptr<GDBusConnection> cgManager_;
 
     void initCGManager();
 
     std::unordered_map<std::string, std::shared_ptr<IconFinder>> _iconFinders;
+    /** Lock for the icon finders as applications can be created on
+        any thread */
+    std::mutex _iconFindersLock;
+
+    /** Desktop file indexes by the directory they index, they check
+        for changes themselves so they can be kept around */
+    std::unordered_map<std::string, std::shared_ptr<DesktopFileIndex>> _desktopFileIndexes;
+    /** Lock for the desktop file indexes as applications can be
+        created on any thread */
+    std::mutex _desktopFileIndexesLock;
+
+    /** Libertine containers and their applications, it checks for
+        changes itself so it can be kept around */
+    std::shared_ptr<LibertineCatalog> _libertineCatalog;
+    /** Lock for creating the Libertine catalog */
+    std::mutex _libertineCatalogLock;
 
     /** Getting the Upstart job path is relatively expensive in
         that it requires a DBus call. Worth keeping a cache of. */
@@ -18,6 +18,7 @@
  */
 
 #include <algorithm>
+#include <future>
 #include <numeric>
 #include <regex>
 
@@ -118,6 +119,111 @@ std::list<std::shared_ptr<Application>> Registry::installedApps(std::shared_ptr<
     return list;
 }
 
+std::vector<std::shared_ptr<Application::Instance>> Registry::launchMany(
+    const std::vector<std::pair<AppID, std::vector<Application::URL>>>& apps, std::shared_ptr<Registry> connection)
+{
+    /* Finding an application can mean reading manifests and desktop
+       files, so look them all up at the same time */
+    std::vector<std::future<std::shared_ptr<Application>>> futures;
+    for (const auto& app : apps)
+    {
+        auto appid = app.first;
+        futures.emplace_back(std::async(std::launch::async, [appid, connection]() -> std::shared_ptr<Application> {
+            try
+            {
+                return Application::create(appid, connection);
+            }
+            catch (std::runtime_error& e)
+            {
+                g_warning("Unable to find application '%s' to launch: %s", std::string(appid).c_str(), e.what());
+                return {};
+            }
+        }));
+    }
+
+    std::vector<std::shared_ptr<Application>> found;
+    for (auto& future : futures)
+    {
+        found.emplace_back(future.get());
+    }
+
+    /* Launching doesn't wait on the handshake, so doing them all in one
+       go on the thread gets every handshake started and every Start
+       request queued before any of the answers are handled */
+    return connection->impl->thread.executeOnThread<std::vector<std::shared_ptr<Application::Instance>>>(
+        [&apps, &found]() {
+            std::vector<std::shared_ptr<Application::Instance>> instances;
+            for (size_t i = 0; i < found.size(); i++)
+            {
+                if (!found[i])
+                {
+                    instances.emplace_back();
+                    continue;
+                }
+
+                try
+                {
+                    instances.emplace_back(found[i]->launch(apps[i].second));
+                }
+                catch (std::runtime_error& e)
+                {
+                    g_warning("Unable to launch application '%s': %s", std::string(apps[i].first).c_str(),
+                              e.what());
+                    instances.emplace_back();
+                }
+            }
+            return instances;
+        });
+}
+
+std::list<std::shared_ptr<Application::Instance>> Registry::prelaunch(unsigned int count,
+                                                                     std::shared_ptr<Registry> connection)
+{
+    std::list<std::shared_ptr<Application::Instance>> instances;
+    if (count == 0)
+    {
+        return instances;
+    }
+
+    /* Ask for extra as some will be running or no longer installed */
+    for (const auto& name : connection->impl->zgPopularApps(count * 2))
+    {
+        if (instances.size() >= count)
+        {
+            break;
+        }
+
+        auto appid = AppID::find(connection, name);
+        if (appid.empty())
+        {
+            g_debug("Unable to find popular application '%s' to pre-launch", name.c_str());
+            continue;
+        }
+
+        try
+        {
+            auto app = std::dynamic_pointer_cast<app_impls::Base>(Application::create(appid, connection));
+            if (!app || app->hasInstances())
+            {
+                continue;
+            }
+
+            g_debug("Pre-launching application: %s", std::string(appid).c_str());
+            auto instance = app->launchStandby();
+            if (instance)
+            {
+                instances.push_back(instance);
+            }
+        }
+        catch (std::runtime_error& e)
+        {
+            g_warning("Unable to pre-launch application '%s': %s", std::string(appid).c_str(), e.what());
+        }
+    }
+
+    return instances;
+}
+
 std::list<std::shared_ptr<Helper>> Registry::runningHelpers(Helper::Type type, std::shared_ptr<Registry> connection)
 {
     std::list<std::shared_ptr<Helper>> list;
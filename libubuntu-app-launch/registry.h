@@ -21,6 +21,8 @@
 #include <functional>
 #include <list>
 #include <memory>
+#include <utility>
+#include <vector>
 
 #include "application.h"
 #include "helper.h"
@@ -96,6 +98,36 @@ public:
     void clearManager ();
 #endif
 
+    /* Launching */
+    /** Launch a set of applications at once, like when restoring a
+        session. The applications are all looked up in parallel, and
+        then launched in the order given, so put the ones that should
+        come up first at the front. The launches don't wait on each
+        other, so the handshakes with Unity and the requests to Upstart
+        for all of them overlap instead of happening one after another.
+
+        \param apps Applications to launch with the URLs for each
+        \param registry Shared registry for the tracking
+        \return An instance for each application in the same order, or
+                nullptr for applications that couldn't be found
+    */
+    static std::vector<std::shared_ptr<Application::Instance>> launchMany(
+        const std::vector<std::pair<AppID, std::vector<Application::URL>>>& apps,
+        std::shared_ptr<Registry> registry = getDefault());
+    /** Start the applications that the user is most likely to want in
+        standby, going by how often Zeitgeist has seen them opened. They
+        start with idle IO priority, are frozen shortly after starting,
+        and are the first to be killed when memory runs low. Launching
+        one of them thaws and focuses it instead of starting it again.
+        Applications that are already running are skipped.
+
+        \param count Most applications to pre-launch
+        \param registry Shared registry for the tracking
+        \return Instances of the applications that were pre-launched
+    */
+    static std::list<std::shared_ptr<Application::Instance>> prelaunch(
+        unsigned int count, std::shared_ptr<Registry> registry = getDefault());
+
     /* Helper Lists */
     /** Get a list of all the helpers for a given helper type
 
@@ -232,64 +232,224 @@ contact_app (GDBusConnection * bus, const gchar * dbus_name, second_exec_t * dat
 	return;
 }
 
+/* Which PID each unique name on the bus belongs to. It is built once
+   per connection and then kept up to date from NameOwnerChanged, so
+   finding the app's connections doesn't need to ask about every client
+   on the bus each time we have URIs to send. */
+typedef struct {
+	GDBusConnection * bus;
+	guint signal;
+	/* Unique name -> PID */
+	GHashTable * names;
+	/* PID queries that haven't come back yet */
+	guint pending;
+	/* PID queries ever started, used to number them */
+	guint64 started;
+	/* name_waiter_t's for lookups that are waiting on queries */
+	GList * waiting;
+	/* No longer on the connection, free when the queries are done */
+	gboolean closed;
+} name_tracker_t;
+
 typedef struct {
 	gchar * name;
-	second_exec_t * data;
+	name_tracker_t * tracker;
+	/* Which query this is, from name_tracker_t::started */
+	guint64 seq;
 } get_pid_t;
 
-/* Gets the PID for a connection, and if it matches the one we're looking
-   for then it tries to send a message to that connection */
+/* A lookup that is waiting on the queries that were out when it
+   started. Ones started after it can't be the app, so it doesn't
+   wait on them, which keeps clients coming and going from holding
+   up the URIs. */
+typedef struct {
+	second_exec_t * data;
+	/* Queries numbered below this are the ones we wait on */
+	guint64 before;
+	/* How many of them haven't come back */
+	guint remaining;
+} name_waiter_t;
+
 static void
-get_pid_cb (GObject * object, GAsyncResult * res, gpointer user_data)
+name_tracker_free (gpointer user_data)
 {
-	get_pid_t * data = (get_pid_t *)user_data;
-	GError * error = NULL;
-	GVariant * vpid = NULL;
+	name_tracker_t * tracker = (name_tracker_t *)user_data;
+	/* The signal goes with the connection, and anything waiting has a
+	   reference to it, so there's nothing else to clean up */
+	g_list_free_full(tracker->waiting, g_free);
+	g_hash_table_destroy(tracker->names);
+	g_free(tracker);
+}
 
-	ual_tracepoint(second_exec_got_pid, data->data->appid, data->name);
+/* The signal is delivered on the thread that subscribed, so each
+   thread's main context gets its own */
+static gchar *
+name_tracker_key (void)
+{
+	return g_strdup_printf("ubuntu-app-launch-second-exec-names-%p", (gpointer)g_main_context_get_thread_default());
+}
 
-	vpid = g_dbus_connection_call_finish(G_DBUS_CONNECTION(object), res, &error);
+/* Sends the URIs to every connection the app has */
+static void
+contact_app_names (name_tracker_t * tracker, second_exec_t * data)
+{
+	ual_tracepoint(second_exec_got_dbus_names, data->appid);
+	g_debug("Primary PID: %d", data->app_pid);
+	ual_tracepoint(second_exec_got_primary_pid, data->appid);
 
-	if (error != NULL) {
-		g_warning("Unable to query PID for dbus name '%s': %s", data->name, error->message);
-		g_error_free(error);
+	GHashTableIter iter;
+	gpointer name, pid;
+	g_hash_table_iter_init(&iter, tracker->names);
+	while (g_hash_table_iter_next(&iter, &name, &pid)) {
+		if (GPOINTER_TO_UINT(pid) != (guint)data->app_pid) {
+			continue;
+		}
 
-		/* Lowering the connection count, this one is terminal, even if in error */
-		connection_count_dec(data->data);
+		data->connections_open++;
+		contact_app(tracker->bus, (const gchar *)name, data);
+	}
+}
 
-		g_free(data->name);
-		g_free(data);
+/* Query @seq is done, anyone that was only waiting on it and those
+   before it can go */
+static void
+name_tracker_pending_dec (name_tracker_t * tracker, guint64 seq)
+{
+	tracker->pending--;
 
-		return;
+	GList * item = tracker->waiting;
+	while (item != NULL) {
+		GList * next = g_list_next(item);
+		name_waiter_t * waiter = (name_waiter_t *)item->data;
+
+		if (seq < waiter->before) {
+			waiter->remaining--;
+		}
+
+		if (waiter->remaining == 0) {
+			tracker->waiting = g_list_delete_link(tracker->waiting, item);
+			contact_app_names(tracker, waiter->data);
+			/* Drop the count we took to wait */
+			connection_count_dec(waiter->data);
+			g_free(waiter);
+		}
+
+		item = next;
+	}
+
+	if (tracker->closed && tracker->pending == 0) {
+		name_tracker_free(tracker);
 	}
+}
+
+/* Gets the PID for a connection and remembers it */
+static void
+get_pid_cb (GObject * object, GAsyncResult * res, gpointer user_data)
+{
+	get_pid_t * data = (get_pid_t *)user_data;
+	GError * error = NULL;
+	GVariant * vpid = NULL;
 
-	guint pid = 0;
-	g_variant_get(vpid, "(u)", &pid);
-	g_variant_unref(vpid);
+	vpid = g_dbus_connection_call_finish(G_DBUS_CONNECTION(object), res, &error);
 
-	if (pid == data->data->app_pid) {
-		/* Trying to send a message to the connection */
-		contact_app(G_DBUS_CONNECTION(object), data->name, data->data);
+	if (error != NULL) {
+		/* Mostly names that went away before we asked */
+		g_debug("Unable to query PID for dbus name '%s': %s", data->name, error->message);
+		g_error_free(error);
 	} else {
-		/* See if we can quit now */
-		connection_count_dec(data->data);
+		guint pid = 0;
+		g_variant_get(vpid, "(u)", &pid);
+		g_variant_unref(vpid);
+
+		if (!data->tracker->closed) {
+			g_hash_table_insert(data->tracker->names, data->name, GUINT_TO_POINTER(pid));
+			data->name = NULL;
+		}
 	}
 
 	g_free(data->name);
+	name_tracker_pending_dec(data->tracker, data->seq);
 	g_free(data);
+	g_object_unref(object);
 
 	return;
 }
 
-/* Starts to look for the PID and the connections for that PID */
 static void
-find_appid_pid (GDBusConnection * session, second_exec_t * data)
+name_tracker_query (name_tracker_t * tracker, const gchar * name)
 {
-	GError * error = NULL;
+	get_pid_t * pid_data = g_new0(get_pid_t, 1);
+	pid_data->tracker = tracker;
+	pid_data->name = g_strdup(name);
+	pid_data->seq = tracker->started++;
 
-	/* List all the connections on dbus.  This sucks that we have to do
-	   this, but in the future we should add DBus API to do this lookup
-	   instead of having to do it with a bunch of requests */
+	tracker->pending++;
+
+	/* Keeps the connection, and so the tracker, around until it returns */
+	g_dbus_connection_call(g_object_ref(tracker->bus),
+		"org.freedesktop.DBus",
+		"/",
+		"org.freedesktop.DBus",
+		"GetConnectionUnixProcessID",
+		g_variant_new("(s)", name),
+		G_VARIANT_TYPE("(u)"),
+		G_DBUS_CALL_FLAGS_NONE,
+		-1,
+		NULL,
+		get_pid_cb, pid_data);
+}
+
+/* Clients coming and going from the bus */
+static void
+name_owner_changed_cb (GDBusConnection * connection, const gchar * sender, const gchar * path, const gchar * interface, const gchar * signal, GVariant * params, gpointer user_data)
+{
+	name_tracker_t * tracker = (name_tracker_t *)user_data;
+	const gchar * name = NULL;
+	const gchar * old_owner = NULL;
+	const gchar * new_owner = NULL;
+	g_variant_get(params, "(&s&s&s)", &name, &old_owner, &new_owner);
+
+	if (!g_dbus_is_unique_name(name)) {
+		return;
+	}
+
+	if (new_owner[0] == '\0') {
+		g_hash_table_remove(tracker->names, name);
+	} else {
+		name_tracker_query(tracker, name);
+	}
+}
+
+/* Gets the tracker for the connection, starting it the first time. This
+   first time is the only time we have to look at all the names. */
+static name_tracker_t *
+name_tracker_get (GDBusConnection * session)
+{
+	gchar * key = name_tracker_key();
+	name_tracker_t * tracker = g_object_get_data(G_OBJECT(session), key);
+	if (tracker != NULL) {
+		g_free(key);
+		return tracker;
+	}
+
+	tracker = g_new0(name_tracker_t, 1);
+	tracker->bus = session;
+	tracker->names = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	g_object_set_data_full(G_OBJECT(session), key, tracker, name_tracker_free);
+	g_free(key);
+
+	/* Listen first, so nothing that connects while we list is missed */
+	tracker->signal = g_dbus_connection_signal_subscribe(session,
+		"org.freedesktop.DBus", /* sender */
+		"org.freedesktop.DBus", /* interface */
+		"NameOwnerChanged", /* signal */
+		"/org/freedesktop/DBus", /* path */
+		NULL, /* arg0 */
+		G_DBUS_SIGNAL_FLAGS_NONE,
+		name_owner_changed_cb, tracker,
+		NULL); /* user data destroy */
+
+	GError * error = NULL;
 	GVariant * listnames = g_dbus_connection_call_sync(session,
 		"org.freedesktop.DBus",
 		"/",
@@ -305,52 +465,51 @@ find_appid_pid (GDBusConnection * session, second_exec_t * data)
 	if (error != NULL) {
 		g_warning("Unable to get list of names from DBus: %s", error->message);
 		g_error_free(error);
-		return;
+		return tracker;
 	}
 
 	g_debug("Got bus names");
-	ual_tracepoint(second_exec_got_dbus_names, data->appid);
-
-	g_debug("Primary PID: %d", data->app_pid);
-	ual_tracepoint(second_exec_got_primary_pid, data->appid);
 
-	/* Get the names */
 	GVariant * names = g_variant_get_child_value(listnames, 0);
 	GVariantIter iter;
 	g_variant_iter_init(&iter, names);
-	gchar * name = NULL;
+	const gchar * name = NULL;
 
-	while (g_variant_iter_loop(&iter, "s", &name)) {
+	while (g_variant_iter_loop(&iter, "&s", &name)) {
 		/* We only want to ask each connection once, this makes that so */
 		if (!g_dbus_is_unique_name(name)) {
 			continue;
 		}
-		
-		get_pid_t * pid_data = g_new0(get_pid_t, 1);
-		pid_data->data = data;
-		pid_data->name = g_strdup(name);
-
-		ual_tracepoint(second_exec_request_pid, data->appid, pid_data->name);
-
-		/* Get the PIDs */
-		g_dbus_connection_call(session,
-			"org.freedesktop.DBus",
-			"/",
-			"org.freedesktop.DBus",
-			"GetConnectionUnixProcessID",
-			g_variant_new("(s)", name),
-			G_VARIANT_TYPE("(u)"),
-			G_DBUS_CALL_FLAGS_NONE,
-			-1,
-			NULL,
-			get_pid_cb, pid_data);
 
-		data->connections_open++;
+		name_tracker_query(tracker, name);
 	}
 
 	g_variant_unref(names);
 	g_variant_unref(listnames);
 
+	return tracker;
+}
+
+/* Looks up the app's connections, waiting for the queries that are
+   still out as one of them could be the app */
+static void
+find_appid_pid (GDBusConnection * session, second_exec_t * data)
+{
+	name_tracker_t * tracker = name_tracker_get(session);
+
+	if (tracker->pending == 0) {
+		contact_app_names(tracker, data);
+	} else {
+		g_debug("Waiting on %u PID queries", tracker->pending);
+		data->connections_open++;
+
+		name_waiter_t * waiter = g_new0(name_waiter_t, 1);
+		waiter->data = data;
+		waiter->before = tracker->started;
+		waiter->remaining = tracker->pending;
+		tracker->waiting = g_list_append(tracker->waiting, waiter);
+	}
+
 	return;
 }
 
@@ -473,3 +632,26 @@ second_exec_complete (second_exec_t * data)
 
 	return;
 }
+
+/* Stops tracking the names on the bus. Called on the thread that
+   called second_exec() once its main loop is done, as the signal
+   wouldn't be delivered anymore. */
+void
+second_exec_cleanup (GDBusConnection * session)
+{
+	gchar * key = name_tracker_key();
+	name_tracker_t * tracker = g_object_steal_data(G_OBJECT(session), key);
+	g_free(key);
+
+	if (tracker == NULL) {
+		return;
+	}
+
+	g_dbus_connection_signal_unsubscribe(session, tracker->signal);
+
+	if (tracker->pending == 0) {
+		name_tracker_free(tracker);
+	} else {
+		tracker->closed = TRUE;
+	}
+}
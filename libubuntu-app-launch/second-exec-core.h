@@ -23,6 +23,7 @@
 G_BEGIN_DECLS
 
 gboolean second_exec (GDBusConnection * con, GCancellable * cancel, GPid pid, const gchar * app_id, gchar ** appuris);
+void second_exec_cleanup (GDBusConnection * con);
 
 G_END_DECLS
 
@@ -19,9 +19,15 @@
 
 #include "snapd-info.h"
 
+#include "modification-time.h"
 #include "registry-impl.h"
 
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
 #include <curl/curl.h>
+#include <mutex>
 #include <vector>
 
 namespace ubuntu
@@ -31,6 +37,312 @@ namespace app_launch
 namespace snapd
 {
 
+/** Holds the cURL handles that are used for all of the requests to snapd.
+    Easy handles are put back when a request is done and used again for
+    the next one, as each keeps its connections open, so the socket is
+    reused instead of being setup and torn down for each request. On
+    versions of cURL that can share the connection cache between handles
+    that is done as well, so requests in parallel don't each need their
+    own. cURL requires us to do the locking as the share handle can be
+    used from multiple threads. */
+class Info::Connection
+{
+public:
+    Connection(const std::string &socket)
+        : socketPath(socket)
+    {
+        share = curl_share_init();
+        if (share == nullptr)
+        {
+            throw std::runtime_error("Unable to create cURL share handle");
+        }
+
+        curl_share_setopt(share, CURLSHOPT_LOCKFUNC, lockFunc);
+        curl_share_setopt(share, CURLSHOPT_UNLOCKFUNC, unlockFunc);
+        curl_share_setopt(share, CURLSHOPT_USERDATA, this);
+        curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+#if LIBCURL_VERSION_NUM >= 0x073900
+        curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+#endif
+    }
+
+    ~Connection()
+    {
+        for (auto handle : idleHandles)
+        {
+            curl_easy_cleanup(handle);
+        }
+        curl_share_cleanup(share);
+    }
+
+    /** Get a cURL easy handle for a request to snapd, one that has been
+        used before and still has its connection open if there is one.
+        It goes back to be used again when the last reference is dropped.
+
+        \param endpoint End of the URL to pass to snapd
+        \param data Vector to store the response in, must outlive the handle
+    */
+    std::shared_ptr<CURL> request(const std::string &endpoint, std::vector<char> *data)
+    {
+        CURL *handle = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(idleHandlesLock);
+            if (!idleHandles.empty())
+            {
+                handle = idleHandles.back();
+                idleHandles.pop_back();
+            }
+        }
+
+        if (handle != nullptr)
+        {
+            /* Keeps the open connections, only clears the options */
+            curl_easy_reset(handle);
+        }
+        else
+        {
+            handle = curl_easy_init();
+        }
+
+        if (handle == nullptr)
+        {
+            throw std::runtime_error("Unable to create new cURL connection");
+        }
+
+        auto curl = std::shared_ptr<CURL>(handle, [this](CURL *handle) { release(handle); });
+
+        /* Configure the command */
+        // curl_easy_setopt(curl.get(), CURLOPT_VERBOSE, 1L);
+        curl_easy_setopt(curl.get(), CURLOPT_NOPROGRESS, 1L);
+        curl_easy_setopt(curl.get(), CURLOPT_URL, ("http://snapd" + endpoint).c_str());
+        curl_easy_setopt(curl.get(), CURLOPT_UNIX_SOCKET_PATH, socketPath.c_str());
+        curl_easy_setopt(curl.get(), CURLOPT_WRITEDATA, data);
+        curl_easy_setopt(curl.get(), CURLOPT_WRITEFUNCTION, writeFunc);
+        curl_easy_setopt(curl.get(), CURLOPT_SHARE, share);
+        curl_easy_setopt(curl.get(), CURLOPT_TCP_KEEPALIVE, 1L);
+
+        /* Overridable timeout */
+        if (g_getenv("UBUNTU_APP_LAUNCH_DISABLE_SNAPD_TIMEOUT") == nullptr)
+        {
+            curl_easy_setopt(curl.get(), CURLOPT_TIMEOUT_MS, 100L);
+        }
+
+        return curl;
+    }
+
+private:
+    /** Path to the snapd socket */
+    std::string socketPath;
+    /** cURL handle for the shared data */
+    CURLSH *share = nullptr;
+    /** A lock for each type of data cURL could share */
+    std::array<std::mutex, CURL_LOCK_DATA_LAST> locks;
+    /** Easy handles that aren't being used, with their connections */
+    std::vector<CURL *> idleHandles;
+    /** Lock for the idle handles as requests come from any thread */
+    std::mutex idleHandlesLock;
+
+    /** Most idle handles kept, which is the most requests that we
+        expect to make in parallel */
+    static constexpr std::size_t MAX_IDLE_HANDLES = 4;
+
+    /** Puts a handle back to be used again, or cleans it up if there
+        are already enough of them */
+    void release(CURL *handle)
+    {
+        {
+            std::lock_guard<std::mutex> lock(idleHandlesLock);
+            if (idleHandles.size() < MAX_IDLE_HANDLES)
+            {
+                idleHandles.push_back(handle);
+                return;
+            }
+        }
+
+        curl_easy_cleanup(handle);
+    }
+
+    static void lockFunc(CURL *handle, curl_lock_data data, curl_lock_access access, void *userptr)
+    {
+        auto obj = static_cast<Connection *>(userptr);
+        obj->locks[data].lock();
+    }
+
+    static void unlockFunc(CURL *handle, curl_lock_data data, void *userptr)
+    {
+        auto obj = static_cast<Connection *>(userptr);
+        obj->locks[data].unlock();
+    }
+
+    /** Function that acts as the return from cURL to add data to
+        our storage vector.
+
+        \param ptr incoming data
+        \param size block size
+        \param nmemb number of blocks
+        \param userdata our local vector to store things in
+    */
+    static size_t writeFunc(char *ptr, size_t size, size_t nmemb, void *userdata)
+    {
+        auto data = static_cast<std::vector<char> *>(userdata);
+        data->insert(data->end(), ptr, ptr + (size * nmemb));
+        return size * nmemb;
+    }
+};
+
+/** Error for when we weren't able to talk to snapd at all, as opposed
+    to snapd telling us something we can't use. These aren't cached
+    as package results, instead we back off from asking snapd again
+    for a while. */
+class UnavailableError : public std::runtime_error
+{
+public:
+    explicit UnavailableError(const std::string &what)
+        : std::runtime_error(what)
+    {
+    }
+};
+
+/** Error for when we didn't ask snapd as it failed recently. It's
+    expected until the backoff is over, so callers only note it instead
+    of warning about it again on each call. */
+class BackingOffError : public UnavailableError
+{
+public:
+    explicit BackingOffError(const std::string &what)
+        : UnavailableError(what)
+    {
+    }
+};
+
+/** Cache of the results that we've gotten from snapd. Everything in it is
+    thrown away when the modification time of the snap base directory or
+    the snapd state directory changes, as snapd changes one of those on
+    installs, removals, refreshes and interface connections. Failures to
+    talk to snapd are remembered too, and we back off from asking again
+    for a growing amount of time so that callers aren't each waiting on a
+    timeout. All functions expect the lock to be held by the caller. */
+class Info::Cache
+{
+public:
+    Cache(const std::vector<std::string> &dirs)
+        : watchDirs(dirs)
+    {
+    }
+
+    /** Lock protecting everything in the cache */
+    std::mutex lock;
+    /** Package info by package name. Null entries are packages that snapd
+        told us it couldn't give us information on. */
+    std::map<std::string, std::shared_ptr<PkgInfo>> pkgInfo;
+    /** Index of all the plugs, null if we don't have it yet */
+    std::shared_ptr<PlugIndex> plugs;
+    /** Statistics for the cache and snapd requests */
+    Metrics metrics;
+
+    /** Throws away everything in the cache if the directories have changed
+        since it was filled. */
+    void validate()
+    {
+        auto stamp = changeStamp();
+        if (stamp == lastStamp && !lastStampRacy)
+        {
+            return;
+        }
+
+        if (!lastStamp.empty() && stamp != lastStamp)
+        {
+            g_debug("Snap directories changed, dropping cached snapd results");
+        }
+
+        pkgInfo.clear();
+        plugs.reset();
+        lastStamp = stamp;
+        lastStampRacy = std::any_of(stamp.begin(), stamp.end(), mtime::isRacy);
+    }
+
+    /** Checks whether we're still backing off from a failure to talk
+        to snapd, counting the request we're not sending if we are. */
+    bool backingOff()
+    {
+        if (std::chrono::steady_clock::now() < retryAfter)
+        {
+            metrics.backedOff++;
+            return true;
+        }
+
+        return false;
+    }
+
+    /** Records a finished request to snapd in the metrics
+
+        \param start Time that the request was sent
+        \param success Whether we got a response from snapd
+    */
+    void requestDone(std::chrono::steady_clock::time_point start, bool success)
+    {
+        auto latency =
+            std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+
+        metrics.requests++;
+        metrics.totalLatency += latency;
+        metrics.maxLatency = std::max(metrics.maxLatency, latency);
+
+        if (!success)
+        {
+            metrics.failures++;
+        }
+    }
+
+    /** Starts, or increases, the backoff after failing to talk to snapd */
+    void failed()
+    {
+        backoff = std::min(std::max(backoff * 2, initialBackoff), maxBackoff);
+        retryAfter = std::chrono::steady_clock::now() + backoff;
+        g_debug("Backing off from snapd for %d ms", int(backoff.count()));
+    }
+
+    /** Clears the backoff as snapd is talking to us again */
+    void succeeded()
+    {
+        backoff = std::chrono::milliseconds{0};
+    }
+
+private:
+    /** How long to wait after the first failure */
+    static constexpr std::chrono::milliseconds initialBackoff{500};
+    /** Longest that we'll wait before trying snapd again */
+    static constexpr std::chrono::milliseconds maxBackoff{30000};
+
+    /** Directories whose changes invalidate the cache */
+    std::vector<std::string> watchDirs;
+    /** Modification times of the directories when the cache was filled */
+    std::vector<std::int64_t> lastStamp;
+    /** Whether a directory changed so recently that it could change again
+        without its modification time moving */
+    bool lastStampRacy = false;
+    /** Time before which we shouldn't ask snapd again */
+    std::chrono::steady_clock::time_point retryAfter;
+    /** Current backoff period */
+    std::chrono::milliseconds backoff{0};
+
+    /** Get the modification time of each of the watched directories */
+    std::vector<std::int64_t> changeStamp()
+    {
+        std::vector<std::int64_t> stamp;
+
+        for (const auto &dir : watchDirs)
+        {
+            stamp.push_back(mtime::get(dir));
+        }
+
+        return stamp;
+    }
+};
+
+constexpr std::chrono::milliseconds Info::Cache::initialBackoff;
+constexpr std::chrono::milliseconds Info::Cache::maxBackoff;
+
 /** Initializes the info object which mostly means checking what is overridden
     by environment variables (mostly for testing) and making sure there is a
     snapd socket available to us. */
@@ -56,373 +368,1087 @@ Info::Info()
         snapBasedir = "/snap";
     }
 
-    if (g_file_test(snapdSocket.c_str(), G_FILE_TEST_EXISTS))
+    auto snapdcStatedir = g_getenv("UBUNTU_APP_LAUNCH_SNAPD_STATEDIR");
+    if (G_UNLIKELY(snapdcStatedir != nullptr))
+    {
+        snapdStatedir = snapdcStatedir;
+    }
+    else
+    {
+        snapdStatedir = "/var/lib/snapd";
+    }
+
+    cache = std::make_shared<Cache>(std::vector<std::string>{snapBasedir, snapdStatedir});
+
+    if (g_file_test(snapdSocket.c_str(), G_FILE_TEST_EXISTS))
+    {
+        snapdExists = true;
+        snapdConnection = std::make_shared<Connection>(snapdSocket);
+    }
+}
+
+/** Prints out the metrics for debugging if we did anything */
+Info::~Info()
+{
+    auto stats = metrics();
+    if (stats.cacheHits + stats.cacheMisses == 0)
+    {
+        return;
+    }
+
+    g_debug("snapd cache: %lu hits, %lu misses. snapd: %lu requests, %lu failed, %lu backed off, %lld us average",
+            stats.cacheHits, stats.cacheMisses, stats.requests, stats.failures, stats.backedOff,
+            stats.requests == 0 ? 0ll : (long long)(stats.totalLatency.count() / stats.requests));
+}
+
+/** Gets the statistics on how the cache is being used and
+    how long we're waiting on snapd */
+Info::Metrics Info::metrics() const
+{
+    std::lock_guard<std::mutex> lock(cache->lock);
+    return cache->metrics;
+}
+
+/** Gets package information out of snapd by using the REST
+    interface and turning the JSON object into a C++ Struct
+
+    \param package Name of the package to look for
+*/
+std::shared_ptr<Info::PkgInfo> Info::pkgInfo(const AppID::Package &package) const
+{
+    if (package.value().empty())
+    {
+        return {};
+    }
+
+    auto pkginfos = pkgInfo(std::set<std::string>{package.value()});
+    auto pkginfo = pkginfos.find(package.value());
+    if (pkginfo == pkginfos.end())
+    {
+        return {};
+    }
+
+    return pkginfo->second;
+}
+
+/** Gets package information for a set of packages. Packages that we've
+    already asked about come from the cache. For the rest, rather than
+    asking about each package this gets the list of all the snaps from
+    snapd in a single request and picks out the ones we want. Packages
+    that snapd can't give us information about are not included in the
+    result.
+
+    \param packages Names of the packages to look for
+*/
+std::map<std::string, std::shared_ptr<Info::PkgInfo>> Info::pkgInfo(const std::set<std::string> &packages) const
+{
+    std::map<std::string, std::shared_ptr<PkgInfo>> pkginfos;
+    std::set<std::string> missing;
+
+    if (!snapdExists)
+    {
+        return pkginfos;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(cache->lock);
+        cache->validate();
+
+        for (const auto &package : packages)
+        {
+            if (package.empty())
+            {
+                continue;
+            }
+
+            auto cached = cache->pkgInfo.find(package);
+            if (cached != cache->pkgInfo.end())
+            {
+                cache->metrics.cacheHits++;
+                if (cached->second)
+                {
+                    pkginfos[package] = cached->second;
+                }
+            }
+            else
+            {
+                cache->metrics.cacheMisses++;
+                missing.insert(package);
+            }
+        }
+    }
+
+    if (missing.empty())
+    {
+        return pkginfos;
+    }
+
+    std::map<std::string, std::shared_ptr<PkgInfo>> fetched;
+
+    try
+    {
+        /* Asking about a single snap is cheaper than getting them all */
+        if (missing.size() == 1)
+        {
+            const auto &package = *missing.begin();
+
+            try
+            {
+                fetched[package] = pkgInfoFromJson(snapdJson("/v2/snaps/" + package), package);
+            }
+            catch (UnavailableError &)
+            {
+                throw;
+            }
+            catch (std::runtime_error &e)
+            {
+                g_warning("Unable to get snap information for '%s': %s", package.c_str(), e.what());
+            }
+        }
+        else
+        {
+            fetched = pkgInfoFromJson(snapdJson("/v2/snaps"), missing);
+        }
+    }
+    catch (BackingOffError &e)
+    {
+        g_debug("Unable to get snap information: %s", e.what());
+        return pkginfos;
+    }
+    catch (std::runtime_error &e)
+    {
+        /* We didn't get an answer we can use, so don't remember anything */
+        g_warning("Unable to get snap information: %s", e.what());
+        return pkginfos;
+    }
+
+    std::lock_guard<std::mutex> lock(cache->lock);
+    for (const auto &package : missing)
+    {
+        auto pkginfo = fetched.find(package);
+        if (pkginfo != fetched.end() && pkginfo->second)
+        {
+            cache->pkgInfo[package] = pkginfo->second;
+            pkginfos[package] = pkginfo->second;
+        }
+        else
+        {
+            /* Remember that snapd doesn't have it */
+            cache->pkgInfo[package] = nullptr;
+        }
+    }
+
+    return pkginfos;
+}
+
+/** The members of a snap object from snapd that we use. Everything is
+    read out of the object before any of it is checked, so that a bad snap
+    in a list doesn't stop us from reading the ones after it. */
+struct Info::SnapJson
+{
+    std::string name;               /**< Name of the snap */
+    std::string status;             /**< Install status of the snap */
+    std::string revision;           /**< Revision of the snap */
+    std::string type;               /**< Type of the snap */
+    std::string version;            /**< Version string of the snap */
+    std::set<std::string> appnames; /**< Names of the apps in the snap */
+    bool hasApps = false;           /**< Whether there was an 'apps' member */
+    std::string error;              /**< First problem found with the members */
+    std::set<std::string> missing;  /**< String members that weren't there */
+
+    /** Gets ready to read another snap, keeping the memory of the strings */
+    void clear()
+    {
+        for (auto str : {&name, &status, &revision, &type, &version, &error})
+        {
+            str->clear();
+        }
+        appnames.clear();
+        hasApps = false;
+        missing = {"name", "status", "revision", "type", "version"};
+    }
+};
+
+/** Reads the members of a snap object that we're interested in, skipping
+    over all the others.
+
+    \param reader Reader positioned at the snap object
+    \param snap Structure to put the members in
+*/
+void Info::readSnap(json::Reader &reader, SnapJson &snap)
+{
+    snap.clear();
+
+    std::string member;
+    reader.beginObject();
+    while (reader.nextMember(member))
+    {
+        std::string *value = nullptr;
+        if (member == "name")
+        {
+            value = &snap.name;
+        }
+        else if (member == "status")
+        {
+            value = &snap.status;
+        }
+        else if (member == "revision")
+        {
+            value = &snap.revision;
+        }
+        else if (member == "type")
+        {
+            value = &snap.type;
+        }
+        else if (member == "version")
+        {
+            value = &snap.version;
+        }
+        else if (member == "apps")
+        {
+            snap.hasApps = true;
+            if (reader.peek() != json::Reader::Type::ARRAY)
+            {
+                reader.skip();
+                continue;
+            }
+
+            std::string appmember;
+            reader.beginArray();
+            while (reader.nextElement())
+            {
+                if (reader.peek() != json::Reader::Type::OBJECT)
+                {
+                    reader.skip();
+                    continue;
+                }
+
+                reader.beginObject();
+                while (reader.nextMember(appmember))
+                {
+                    if (appmember == "name" && reader.peek() == json::Reader::Type::STRING)
+                    {
+                        snap.appnames.insert(reader.readString());
+                    }
+                    else
+                    {
+                        reader.skip();
+                    }
+                }
+            }
+            continue;
+        }
+
+        if (value == nullptr)
+        {
+            reader.skip();
+            continue;
+        }
+
+        auto type = reader.peek();
+        if (type == json::Reader::Type::STRING)
+        {
+            reader.readString(*value);
+            snap.missing.erase(member);
+            continue;
+        }
+
+        if (snap.error.empty())
+        {
+            if (type == json::Reader::Type::OBJECT || type == json::Reader::Type::ARRAY)
+            {
+                snap.error = "Snap JSON had a '" + member + "' but it's an object!";
+            }
+            else
+            {
+                snap.error = "Snap JSON had a '" + member + "' but it's not a string!";
+            }
+        }
+        snap.missing.erase(member);
+        reader.skip();
+    }
+}
+
+/** Turns the list of snaps that snapd returns into PkgInfo structures
+    for the packages that were asked for. The list is read straight out
+    of the response, and only the snaps that were asked for are kept.
+
+    \param snaps Response from snapd for all the snaps
+    \param packages Names of the packages we want
+*/
+std::map<std::string, std::shared_ptr<Info::PkgInfo>> Info::pkgInfoFromJson(const Response &snaps,
+                                                                            const std::set<std::string> &packages) const
+{
+    std::map<std::string, std::shared_ptr<PkgInfo>> pkginfos;
+
+    auto reader = snaps.result();
+    if (reader.peek() != json::Reader::Type::ARRAY)
+    {
+        throw std::runtime_error("Snaps result isn't an array");
+    }
+
+    SnapJson snap;
+    reader.beginArray();
+    while (reader.nextElement())
+    {
+        if (reader.peek() != json::Reader::Type::OBJECT)
+        {
+            reader.skip();
+            continue;
+        }
+
+        readSnap(reader, snap);
+        if (snap.missing.find("name") != snap.missing.end() || packages.find(snap.name) == packages.end())
+        {
+            continue;
+        }
+
+        try
+        {
+            pkginfos[snap.name] = pkgInfoFromSnap(snap, snap.name);
+        }
+        catch (std::runtime_error &e)
+        {
+            g_warning("Unable to get snap information for '%s': %s", snap.name.c_str(), e.what());
+        }
+    }
+    reader.end();
+
+    for (const auto &package : packages)
+    {
+        if (pkginfos.find(package) == pkginfos.end())
+        {
+            g_debug("No snap information for '%s'", package.c_str());
+        }
+    }
+
+    return pkginfos;
+}
+
+/** Turns the response that snapd gives for a single snap into a
+    PkgInfo structure.
+
+    \param snapresponse Response from snapd for the snap
+    \param package Name of the package we asked for
+*/
+std::shared_ptr<Info::PkgInfo> Info::pkgInfoFromJson(const Response &snapresponse, const std::string &package) const
+{
+    auto reader = snapresponse.result();
+    if (reader.peek() != json::Reader::Type::OBJECT)
+    {
+        throw std::runtime_error("Results returned by snapd were not a valid JSON object");
+    }
+
+    SnapJson snap;
+    readSnap(reader, snap);
+    reader.end();
+
+    return pkgInfoFromSnap(snap, package);
+}
+
+/** Turns the members that we read out of a snap object into a PkgInfo
+    structure after validating that it has everything we need.
+
+    \param snap Members of the snap object
+    \param package Name of the package we asked for
+*/
+std::shared_ptr<Info::PkgInfo> Info::pkgInfoFromSnap(const SnapJson &snap, const std::string &package) const
+{
+    /******************************************/
+    /* Validation of the object we got        */
+    /******************************************/
+    if (!snap.hasApps)
+    {
+        throw std::runtime_error("Snap JSON didn't have a 'apps'");
+    }
+
+    if (!snap.error.empty())
+    {
+        throw std::runtime_error(snap.error);
+    }
+
+    if (!snap.missing.empty())
+    {
+        throw std::runtime_error("Snap JSON didn't have a '" + *snap.missing.begin() + "'");
+    }
+
+    if (snap.name != package)
+    {
+        throw std::runtime_error("Snapd returned information for snap '" + snap.name + "' when we asked for '" +
+                                 package + "'");
+    }
+
+    if (snap.status != "active")
+    {
+        throw std::runtime_error("Snap is not in the 'active' state.");
+    }
+
+    if (snap.type != "app")
+    {
+        throw std::runtime_error("Specified snap is not an application, we only support applications");
+    }
+
+    /******************************************/
+    /* Validation complete — build the object */
+    /******************************************/
+
+    auto pkgstruct = std::make_shared<PkgInfo>();
+    pkgstruct->name = snap.name;
+    pkgstruct->version = snap.version;
+    pkgstruct->revision = snap.revision;
+    pkgstruct->appnames = snap.appnames;
+
+    /* TODO: Seems like snapd should give this to us */
+    auto gdir = g_build_filename(snapBasedir.c_str(), snap.name.c_str(), snap.revision.c_str(), nullptr);
+    pkgstruct->directory = gdir;
+    g_free(gdir);
+
+    return pkgstruct;
+}
+
+/** Asks the snapd process for some JSON. This function parses the basic
+    response JSON that snapd returns and will error if a return code error
+    is in the JSON. It then passes on the "result" part of the response
+    to the caller.
+
+    \param endpoint End of the URL to pass to snapd
+*/
+Info::Response Info::snapdJson(const std::string &endpoint) const
+{
+    {
+        std::lock_guard<std::mutex> lock(cache->lock);
+        if (cache->backingOff())
+        {
+            throw BackingOffError("Not asking snapd for '" + endpoint + "' as it failed recently");
+        }
+    }
+
+    std::vector<char> data;
+    auto curl = snapdConnection->request(endpoint, &data);
+
+    /* Run the actual request (blocking) */
+    auto start = std::chrono::steady_clock::now();
+    auto res = curl_easy_perform(curl.get());
+
+    {
+        std::lock_guard<std::mutex> lock(cache->lock);
+        cache->requestDone(start, res == CURLE_OK);
+        if (res == CURLE_OK)
+        {
+            cache->succeeded();
+        }
+        else
+        {
+            cache->failed();
+        }
+    }
+
+    if (res != CURLE_OK)
+    {
+        throw UnavailableError("snapd HTTP server returned an error: " + std::string(curl_easy_strerror(res)));
+    }
+    else
+    {
+        g_debug("Got %d bytes from snapd", int(data.size()));
+    }
+
+    return parseSnapdResponse(std::move(data));
+}
+
+/** Asks the snapd process for several endpoints at once. All of the
+    requests are put into a cURL multi handle so that they run at the
+    same time, which means we only wait for the slowest of them instead
+    of all of them in a row. Endpoints that fail are logged and left out
+    of the returned map. Throws BackingOffError, without asking, if snapd
+    failed recently.
+
+    \param endpoints Ends of the URLs to pass to snapd
+*/
+std::map<std::string, Info::Response> Info::snapdJson(const std::set<std::string> &endpoints) const
+{
+    std::map<std::string, Response> results;
+
+    if (endpoints.empty())
+    {
+        return results;
+    }
+
+    /* No reason to setup a multi for one request */
+    if (endpoints.size() == 1)
+    {
+        try
+        {
+            results[*endpoints.begin()] = snapdJson(*endpoints.begin());
+        }
+        catch (BackingOffError &)
+        {
+            throw;
+        }
+        catch (std::runtime_error &e)
+        {
+            g_warning("Unable to get '%s' from snapd: %s", endpoints.begin()->c_str(), e.what());
+        }
+        return results;
+    }
+
     {
-        snapdExists = true;
+        std::lock_guard<std::mutex> lock(cache->lock);
+        if (cache->backingOff())
+        {
+            throw BackingOffError("Not asking snapd for " + std::to_string(endpoints.size()) +
+                                  " endpoints as it failed recently");
+        }
     }
-}
 
-/** Gets package information out of snapd by using the REST
-    interface and turning the JSON object into a C++ Struct
-
-    \param package Name of the package to look for
-*/
-std::shared_ptr<Info::PkgInfo> Info::pkgInfo(const AppID::Package &package) const
-{
-    if (!snapdExists)
+    auto multi = std::shared_ptr<CURLM>(curl_multi_init(), curl_multi_cleanup);
+    if (!multi)
     {
-        return {};
+        throw std::runtime_error("Unable to create new cURL multi handle");
     }
 
-    if (package.value().empty())
+    struct Request
     {
-        return {};
+        std::string endpoint;
+        std::vector<char> data;
+        std::shared_ptr<CURL> curl;
+        CURLcode result;
+    };
+    std::list<Request> requests;
+
+    for (const auto &endpoint : endpoints)
+    {
+        requests.emplace_back(Request{endpoint, {}, {}, CURLE_OK});
+        auto &request = requests.back();
+        request.curl = snapdConnection->request(endpoint, &request.data);
+        curl_multi_add_handle(multi.get(), request.curl.get());
     }
 
-    try
+    /* Run them all until they're done (blocking) */
+    auto start = std::chrono::steady_clock::now();
+    int running = 0;
+    do
     {
-        auto snapnode = snapdJson("/v2/snaps/" + package.value());
-        auto snapobject = json_node_get_object(snapnode.get());
-        if (snapobject == nullptr)
+        auto mres = curl_multi_perform(multi.get(), &running);
+        if (mres != CURLM_OK)
         {
-            throw std::runtime_error("Results returned by snapd were not a valid JSON object");
+            g_warning("cURL multi error talking to snapd: %s", curl_multi_strerror(mres));
+            break;
         }
 
-        /******************************************/
-        /* Validation of the object we got        */
-        /******************************************/
-        for (const auto &member : {"apps"})
+        if (running > 0)
         {
-            if (!json_object_has_member(snapobject, member))
-            {
-                throw std::runtime_error("Snap JSON didn't have a '" + std::string(member) + "'");
-            }
+            curl_multi_wait(multi.get(), nullptr, 0, 100, nullptr);
         }
+    } while (running > 0);
 
-        for (const auto &member : {"name", "status", "revision", "type", "version"})
+    /* Grab the result codes for each of the requests */
+    CURLMsg *msg = nullptr;
+    int msgsleft = 0;
+    while ((msg = curl_multi_info_read(multi.get(), &msgsleft)) != nullptr)
+    {
+        if (msg->msg != CURLMSG_DONE)
         {
-            if (!json_object_has_member(snapobject, member))
-            {
-                throw std::runtime_error("Snap JSON didn't have a '" + std::string(member) + "'");
-            }
+            continue;
+        }
 
-            auto node = json_object_get_member(snapobject, member);
-            if (json_node_get_node_type(node) != JSON_NODE_VALUE)
+        for (auto &request : requests)
+        {
+            if (request.curl.get() == msg->easy_handle)
             {
-                throw std::runtime_error{"Snap JSON had a '" + std::string(member) + "' but it's an object!"};
+                request.result = msg->data.result;
             }
+        }
+    }
 
-            if (json_node_get_value_type(node) != G_TYPE_STRING)
-            {
-                throw std::runtime_error{"Snap JSON had a '" + std::string(member) + "' but it's not a string!"};
-            }
+    /* Record how they all went */
+    {
+        std::lock_guard<std::mutex> lock(cache->lock);
+        bool failure = false;
+
+        for (const auto &request : requests)
+        {
+            bool success = running == 0 && request.result == CURLE_OK;
+            cache->requestDone(start, success);
+            failure = failure || !success;
+        }
+
+        if (failure)
+        {
+            cache->failed();
+        }
+        else
+        {
+            cache->succeeded();
         }
+    }
+
+    for (auto &request : requests)
+    {
+        curl_multi_remove_handle(multi.get(), request.curl.get());
 
-        std::string namestr = json_object_get_string_member(snapobject, "name");
-        if (namestr != package.value())
+        if (running > 0)
         {
-            throw std::runtime_error("Snapd returned information for snap '" + namestr + "' when we asked for '" +
-                                     package.value() + "'");
+            g_warning("Request '%s' to snapd didn't complete", request.endpoint.c_str());
+            continue;
         }
 
-        std::string statusstr = json_object_get_string_member(snapobject, "status");
-        if (statusstr != "active")
+        if (request.result != CURLE_OK)
         {
-            throw std::runtime_error("Snap is not in the 'active' state.");
+            g_warning("Unable to get '%s' from snapd: snapd HTTP server returned an error: %s",
+                      request.endpoint.c_str(), curl_easy_strerror(request.result));
+            continue;
         }
 
-        std::string typestr = json_object_get_string_member(snapobject, "type");
-        if (typestr != "app")
+        g_debug("Got %d bytes from snapd for '%s'", int(request.data.size()), request.endpoint.c_str());
+
+        try
         {
-            throw std::runtime_error("Specified snap is not an application, we only support applications");
+            results[request.endpoint] = parseSnapdResponse(std::move(request.data));
         }
+        catch (std::runtime_error &e)
+        {
+            g_warning("Unable to get '%s' from snapd: %s", request.endpoint.c_str(), e.what());
+        }
+    }
 
-        /******************************************/
-        /* Validation complete — build the object */
-        /******************************************/
+    return results;
+}
+
+/** Checks the basic response JSON that snapd returns and will error if
+    a return code error is in the JSON. The response is read through
+    without building up a tree, and the location of the "result" part
+    is remembered so the caller can read it.
 
-        auto pkgstruct = std::make_shared<PkgInfo>();
-        pkgstruct->name = namestr;
-        pkgstruct->version = json_object_get_string_member(snapobject, "version");
-        std::string revisionstr = json_object_get_string_member(snapobject, "revision");
-        pkgstruct->revision = revisionstr;
+    \param data Body of the HTTP response from snapd
+*/
+Info::Response Info::parseSnapdResponse(std::vector<char> &&data)
+{
+    Response response;
+    response.data = std::move(data);
 
-        /* TODO: Seems like snapd should give this to us */
-        auto gdir = g_build_filename(snapBasedir.c_str(), namestr.c_str(), revisionstr.c_str(), nullptr);
-        pkgstruct->directory = gdir;
-        g_free(gdir);
+    bool hasStatusCode = false;
+    bool hasResult = false;
+    std::int64_t status = 0;
+    std::map<std::string, std::string> strings;
+    std::string problem;
 
-        auto appsarray = json_object_get_array_member(snapobject, "apps");
-        for (unsigned int i = 0; i < json_array_get_length(appsarray); i++)
+    try
+    {
+        json::Reader reader(response.data.data(), response.data.data() + response.data.size());
+        if (reader.peek() != json::Reader::Type::OBJECT)
+        {
+            problem = "Root of JSON result isn't an object";
+        }
+        else
         {
-            auto appobj = json_array_get_object_element(appsarray, i);
-            if (json_object_has_member(appobj, "name"))
+            std::string member;
+            reader.beginObject();
+            while (reader.nextMember(member))
             {
-                auto appname = json_object_get_string_member(appobj, "name");
-                if (appname)
+                auto type = reader.peek();
+                if (member == "status-code" && type == json::Reader::Type::NUMBER)
+                {
+                    hasStatusCode = true;
+                    status = reader.readInt();
+                }
+                else if (member == "status-code")
+                {
+                    hasStatusCode = true;
+                    reader.skip();
+                }
+                else if (member == "result")
                 {
-                    pkgstruct->appnames.insert(appname);
+                    hasResult = true;
+                    response.resultStart = reader.position() - response.data.data();
+                    reader.skip();
+                    response.resultEnd = reader.position() - response.data.data();
+                }
+                else if ((member == "status" || member == "type") && type == json::Reader::Type::STRING)
+                {
+                    strings[member] = reader.readString();
+                }
+                else if (member == "status" || member == "type")
+                {
+                    if (problem.empty() && (type == json::Reader::Type::OBJECT || type == json::Reader::Type::ARRAY))
+                    {
+                        problem = "Snap JSON had a '" + member + "' but it's an object!";
+                    }
+                    else if (problem.empty())
+                    {
+                        problem = "Snap JSON had a '" + member + "' but it's not a string!";
+                    }
+                    strings[member] = {};
+                    reader.skip();
+                }
+                else
+                {
+                    reader.skip();
                 }
             }
+            reader.end();
         }
-
-        return pkgstruct;
     }
     catch (std::runtime_error &e)
     {
-        g_warning("Unable to get snap information for '%s': %s", package.value().c_str(), e.what());
-        return {};
+        throw std::runtime_error{"Can not parse JSON: " + std::string(e.what())};
     }
-}
-
-/** Function that acts as the return from cURL to add data to
-    our storage vector.
-
-    \param ptr incoming data
-    \param size block size
-    \param nmemb number of blocks
-    \param userdata our local vector to store things in
-*/
-static size_t snapd_writefunc(char *ptr, size_t size, size_t nmemb, void *userdata)
-{
-    auto data = static_cast<std::vector<char> *>(userdata);
-    data->insert(data->end(), ptr, ptr + (size * nmemb));
-    return size * nmemb;
-}
-
-/** Asks the snapd process for some JSON. This function parses the basic
-    response JSON that snapd returns and will error if a return code error
-    is in the JSON. It then passes on the "result" part of the response
-    to the caller.
 
-    \param endpoint End of the URL to pass to snapd
-*/
-std::shared_ptr<JsonNode> Info::snapdJson(const std::string &endpoint) const
-{
-    /* Setup the CURL connection and suck some data */
-    CURL *curl = curl_easy_init();
-    if (curl == nullptr)
+    if (!problem.empty())
     {
-        throw std::runtime_error("Unable to create new cURL connection");
+        throw std::runtime_error{problem};
     }
 
-    std::vector<char> data;
-
-    /* Configure the command */
-    // curl_easy_setopt(curl, CURLOPT_VERBOSE, 1L);
-    curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 1L);
-    curl_easy_setopt(curl, CURLOPT_URL, ("http://snapd" + endpoint).c_str());
-    curl_easy_setopt(curl, CURLOPT_UNIX_SOCKET_PATH, snapdSocket.c_str());
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &data);
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, snapd_writefunc);
-
-    /* Overridable timeout */
-    if (g_getenv("UBUNTU_APP_LAUNCH_DISABLE_SNAPD_TIMEOUT") == nullptr)
+    /* Check members */
+    if (!hasStatusCode)
     {
-        curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, 100L);
+        throw std::runtime_error("Resulting JSON didn't have a 'status-code'");
     }
 
-    /* Run the actual request (blocking) */
-    auto res = curl_easy_perform(curl);
-
-    if (res != CURLE_OK)
+    if (!hasResult)
     {
-        curl_easy_cleanup(curl);
-        throw std::runtime_error("snapd HTTP server returned an error: " + std::string(curl_easy_strerror(res)));
+        throw std::runtime_error("Resulting JSON didn't have a 'result'");
     }
-    else
+
+    for (const auto &member : {"status", "type"})
     {
-        g_debug("Got %d bytes from snapd", int(data.size()));
+        if (strings.find(member) == strings.end())
+        {
+            throw std::runtime_error("Snap JSON didn't have a '" + std::string(member) + "'");
+        }
     }
 
-    curl_easy_cleanup(curl);
-
-    /* Cool, we have data */
-    auto parser = std::shared_ptr<JsonParser>(json_parser_new(), [](JsonParser *parser) { g_clear_object(&parser); });
-    GError *error = nullptr;
-    json_parser_load_from_data(parser.get(), /* parser */
-                               data.data(),  /* array */
-                               data.size(),  /* size */
-                               &error);      /* error */
-
-    if (error != nullptr)
+    if (status != 200)
     {
-        std::string message{"Can not parse JSON: " + std::string(error->message)};
-        g_error_free(error);
-        throw std::runtime_error{message};
+        throw std::runtime_error("Status code is: " + std::to_string(status));
     }
 
-    auto root = json_parser_get_root(parser.get());
-    auto rootobj = json_node_get_object(root);
+    if (strings["status"] != "OK")
+    {
+        throw std::runtime_error("Status string is: " + strings["status"]);
+    }
 
-    if (rootobj == nullptr)
+    if (strings["type"] != "sync")
     {
-        throw std::runtime_error("Root of JSON result isn't an object");
+        throw std::runtime_error("We only support 'sync' results right now, but we got a: " + strings["type"]);
     }
 
-    /* Check members */
-    for (const auto &member : {"status-code", "result"})
+    return response;
+}
+
+/** Builds the index of all the plugs out of an interfaces result from
+    snapd, reading them straight out of the response in a single pass.
+    Plugs that are missing anything we need are skipped.
+
+    \param interfaces Response from snapd with the interfaces
+*/
+std::shared_ptr<Info::PlugIndex> Info::plugIndexFromJson(const Response &interfaces) const
+{
+    auto index = std::make_shared<PlugIndex>();
+
+    auto reader = interfaces.result();
+    if (reader.peek() != json::Reader::Type::OBJECT)
     {
-        if (!json_object_has_member(rootobj, member))
-        {
-            throw std::runtime_error("Resulting JSON didn't have a '" + std::string(member) + "'");
-        }
+        throw std::runtime_error("Interfaces result isn't an object");
     }
 
-    for (const auto &member : {"status", "type"})
+    bool hasPlugs = false;
+    bool hasSlots = false;
+    std::string member;
+    std::string plugmember;
+    std::string snap;
+    std::string interface;
+    std::set<std::string> apps;
+
+    reader.beginObject();
+    while (reader.nextMember(member))
     {
-        if (!json_object_has_member(rootobj, member))
+        if (member == "slots")
         {
-            throw std::runtime_error("Snap JSON didn't have a '" + std::string(member) + "'");
+            hasSlots = true;
+            reader.skip();
+            continue;
         }
 
-        auto node = json_object_get_member(rootobj, member);
-        if (json_node_get_node_type(node) != JSON_NODE_VALUE)
+        if (member != "plugs" || reader.peek() != json::Reader::Type::ARRAY)
         {
-            throw std::runtime_error{"Snap JSON had a '" + std::string(member) + "' but it's an object!"};
+            reader.skip();
+            continue;
         }
 
-        if (json_node_get_value_type(node) != G_TYPE_STRING)
+        hasPlugs = true;
+        reader.beginArray();
+        while (reader.nextElement())
         {
-            throw std::runtime_error{"Snap JSON had a '" + std::string(member) + "' but it's not a string!"};
+            if (reader.peek() != json::Reader::Type::OBJECT)
+            {
+                reader.skip();
+                continue;
+            }
+
+            bool hasSnap = false;
+            bool hasInterface = false;
+            bool hasApps = false;
+            apps.clear();
+
+            reader.beginObject();
+            while (reader.nextMember(plugmember))
+            {
+                auto type = reader.peek();
+                if (plugmember == "snap" && type == json::Reader::Type::STRING)
+                {
+                    reader.readString(snap);
+                    hasSnap = true;
+                }
+                else if (plugmember == "interface" && type == json::Reader::Type::STRING)
+                {
+                    reader.readString(interface);
+                    hasInterface = true;
+                }
+                else if (plugmember == "apps" && type == json::Reader::Type::ARRAY)
+                {
+                    hasApps = true;
+                    reader.beginArray();
+                    while (reader.nextElement())
+                    {
+                        if (reader.peek() == json::Reader::Type::STRING)
+                        {
+                            apps.insert(reader.readString());
+                        }
+                        else
+                        {
+                            reader.skip();
+                        }
+                    }
+                }
+                else
+                {
+                    reader.skip();
+                }
+            }
+
+            /* We'll check the others even if one is bad */
+            if (!hasSnap || !hasInterface || !hasApps)
+            {
+                continue;
+            }
+
+            auto &appnames = index->interfaceApps[interface][snap];
+            for (const auto &app : apps)
+            {
+                appnames.insert(app);
+                index->appInterfaces[std::make_pair(snap, app)].insert(interface);
+            }
         }
     }
+    reader.end();
 
-    auto status = json_object_get_int_member(rootobj, "status-code");
-    if (status != 200)
+    if (!hasPlugs)
     {
-        throw std::runtime_error("Status code is: " + std::to_string(status));
+        throw std::runtime_error("Interface JSON didn't have a 'plugs'");
+    }
+
+    if (!hasSlots)
+    {
+        throw std::runtime_error("Interface JSON didn't have a 'slots'");
     }
 
-    std::string statusstr = json_object_get_string_member(rootobj, "status");
-    if (statusstr != "OK")
+    return index;
+}
+
+/** Gets the index of the plugs out of the cache, counting whether
+    it was there or not. Returns null if it isn't cached. */
+std::shared_ptr<Info::PlugIndex> Info::cachedPlugIndex() const
+{
+    std::lock_guard<std::mutex> lock(cache->lock);
+    cache->validate();
+
+    if (cache->plugs)
+    {
+        cache->metrics.cacheHits++;
+    }
+    else
     {
-        throw std::runtime_error("Status string is: " + statusstr);
+        cache->metrics.cacheMisses++;
     }
 
-    std::string typestr = json_object_get_string_member(rootobj, "type");
-    if (typestr != "sync")
+    return cache->plugs;
+}
+
+/** Gets the index of all the plugs, either from the cache or by asking
+    snapd for the interfaces. Throws if we can't get it. */
+std::shared_ptr<Info::PlugIndex> Info::plugIndex() const
+{
+    auto index = cachedPlugIndex();
+    if (index)
     {
-        throw std::runtime_error("We only support 'sync' results right now, but we got a: " + typestr);
+        return index;
     }
 
-    auto result = std::shared_ptr<JsonNode>(json_node_ref(json_object_get_member(rootobj, "result")), json_node_unref);
+    index = plugIndexFromJson(snapdJson("/v2/interfaces"));
 
-    return result;
+    std::lock_guard<std::mutex> lock(cache->lock);
+    cache->plugs = index;
+
+    return index;
 }
 
-/** Looks through all the plugs in the interfaces and runs a function
-    based on them. Avoids pulling objects out of the parsed JSON structure
-    from Snappy and making sure they have the same lifecycle as the parser
-    object which seems to destroy them when it dies.
+/** Gets all the apps that are plugged into any of a set of interfaces.
+    If we don't have anything cached, the interfaces and the list of snaps
+    are requested from snapd at the same time, and then the plugs are split
+    up by interface in a single pass. This means that no matter how many
+    snaps or interfaces there are, it is at most two requests to snapd.
 
-    \param plugfunc Function to execute on each plug
+    \param interfaces Which interfaces to get the apps for
 */
-void Info::forAllPlugs(std::function<void(JsonObject *plugobj)> plugfunc) const
+std::list<Info::InterfaceApp> Info::appsForInterfaces(const std::set<std::string> &interfaces) const
 {
-    if (!snapdExists)
-    {
-        return;
-    }
+    std::list<InterfaceApp> apps;
 
-    auto interfacesnode = snapdJson("/v2/interfaces");
-    auto interface = json_node_get_object(interfacesnode.get());
-    if (interface == nullptr)
+    if (!snapdExists)
     {
-        throw std::runtime_error("Interfaces result isn't an object: " + Registry::Impl::printJson(interfacesnode));
+        return apps;
     }
 
-    for (const auto &member : {"plugs", "slots"})
+    try
     {
-        if (!json_object_has_member(interface, member))
-        {
-            throw std::runtime_error("Interface JSON didn't have a '" + std::string(member) + "'");
-        }
-    }
+        auto index = cachedPlugIndex();
+        std::map<std::string, std::shared_ptr<PkgInfo>> pkginfos;
 
-    auto plugarray = json_object_get_array_member(interface, "plugs");
-    for (unsigned int i = 0; i < json_array_get_length(plugarray); i++)
-    {
-        auto ifaceobj = json_array_get_object_element(plugarray, i);
-        try
+        if (index)
         {
-            for (const auto &member : {"snap", "interface", "apps"})
+            std::set<std::string> snapnames;
+            for (const auto &interface : interfaces)
             {
-                if (!json_object_has_member(ifaceobj, member))
+                auto iplugs = index->interfaceApps.find(interface);
+                if (iplugs == index->interfaceApps.end())
                 {
-                    throw std::runtime_error("Interface JSON didn't have a '" + std::string(member) + "'");
+                    continue;
+                }
+
+                for (const auto &snap : iplugs->second)
+                {
+                    snapnames.insert(snap.first);
                 }
             }
 
-            plugfunc(ifaceobj);
+            pkginfos = pkgInfo(snapnames);
         }
-        catch (std::runtime_error &e)
+        else
         {
-            /* We'll check the others even if one is bad */
-            // g_debug("Malformed inteface instance: %s", e.what());
-            continue;
-        }
-    }
-}
+            /* These don't depend on each other, so get them together */
+            auto nodes = snapdJson(std::set<std::string>{"/v2/interfaces", "/v2/snaps"});
+            auto interfacesnode = nodes.find("/v2/interfaces");
+            if (interfacesnode == nodes.end())
+            {
+                throw std::runtime_error("Unable to get interfaces from snapd");
+            }
 
-/** Gets all the apps that are available for a given interface. It asks snapd
-    for the list of interfaces and then finds this one, turning it into a set
-    of AppIDs
+            index = plugIndexFromJson(interfacesnode->second);
 
-    \param in_interface Which interface to get the set of apps for
-*/
-std::set<AppID> Info::appsForInterface(const std::string &in_interface) const
-{
-    bool interfacefound = false;
-    std::set<AppID> appids;
+            std::set<std::string> snapnames;
+            for (const auto &interface : index->interfaceApps)
+            {
+                for (const auto &snap : interface.second)
+                {
+                    snapnames.insert(snap.first);
+                }
+            }
 
-    try
-    {
-        forAllPlugs([this, &interfacefound, &appids, in_interface](JsonObject *ifaceobj) {
-            std::string interfacename = json_object_get_string_member(ifaceobj, "interface");
-            if (interfacename != in_interface)
+            auto snapsnode = nodes.find("/v2/snaps");
+            if (snapsnode != nodes.end())
             {
-                return;
+                pkginfos = pkgInfoFromJson(snapsnode->second, snapnames);
             }
 
-            interfacefound = true;
+            std::lock_guard<std::mutex> lock(cache->lock);
+            cache->plugs = index;
 
-            auto cname = json_object_get_string_member(ifaceobj, "snap");
-            if (cname == nullptr)
+            if (snapsnode != nodes.end())
             {
-                return;
+                for (const auto &snapname : snapnames)
+                {
+                    auto pkginfo = pkginfos.find(snapname);
+                    cache->pkgInfo[snapname] = pkginfo != pkginfos.end() ? pkginfo->second : nullptr;
+                }
             }
-            std::string snapname(cname);
+        }
 
-            auto pkginfo = pkgInfo(AppID::Package::from_raw(snapname));
-            if (!pkginfo)
+        /* If we didn't get the snaps, try to fill them in (which respects the backoff) */
+        if (pkginfos.empty() && !index->interfaceApps.empty())
+        {
+            std::set<std::string> snapnames;
+            for (const auto &interface : interfaces)
             {
-                return;
+                auto iplugs = index->interfaceApps.find(interface);
+                if (iplugs == index->interfaceApps.end())
+                {
+                    continue;
+                }
+
+                for (const auto &snap : iplugs->second)
+                {
+                    snapnames.insert(snap.first);
+                }
             }
 
-            std::string revision = pkginfo->revision;
+            pkginfos = pkgInfo(snapnames);
+        }
 
-            auto apps = json_object_get_array_member(ifaceobj, "apps");
-            for (unsigned int k = 0; apps != nullptr && k < json_array_get_length(apps); k++)
+        for (const auto &interface : interfaces)
+        {
+            auto iplugs = index->interfaceApps.find(interface);
+            if (iplugs == index->interfaceApps.end())
             {
-                std::string appname = json_array_get_string_element(apps, k);
-
-                appids.emplace(AppID(AppID::Package::from_raw(snapname),   /* package */
-                                     AppID::AppName::from_raw(appname),    /* appname */
-                                     AppID::Version::from_raw(revision))); /* version */
+                g_debug("Unable to find information on interface '%s'", interface.c_str());
+                continue;
             }
-        });
 
-        if (!interfacefound)
-        {
-            g_debug("Unable to find information on interface '%s'", in_interface.c_str());
+            for (const auto &snap : iplugs->second)
+            {
+                auto pkginfo = pkginfos.find(snap.first);
+                if (pkginfo == pkginfos.end() || !pkginfo->second)
+                {
+                    continue;
+                }
+
+                for (const auto &appname : snap.second)
+                {
+                    AppID appid(AppID::Package::from_raw(snap.first),                 /* package */
+                                AppID::AppName::from_raw(appname),                    /* appname */
+                                AppID::Version::from_raw(pkginfo->second->revision)); /* version */
+
+                    apps.emplace_back(InterfaceApp{appid, interface, pkginfo->second});
+                }
+            }
         }
     }
+    catch (BackingOffError &e)
+    {
+        g_debug("Unable to get interface information: %s", e.what());
+    }
     catch (std::runtime_error &e)
     {
         g_warning("Unable to get interface information: %s", e.what());
     }
 
+    return apps;
+}
+
+/** Gets all the apps that are available for a given interface. It asks snapd
+    for the list of interfaces and then finds this one, turning it into a set
+    of AppIDs
+
+    \param in_interface Which interface to get the set of apps for
+*/
+std::set<AppID> Info::appsForInterface(const std::string &in_interface) const
+{
+    std::set<AppID> appids;
+
+    for (const auto &app : appsForInterfaces(std::set<std::string>{in_interface}))
+    {
+        appids.insert(app.appid);
+    }
+
     return appids;
 }
 
@@ -432,36 +1458,26 @@ std::set<AppID> Info::appsForInterface(const std::string &in_interface) const
 */
 std::set<std::string> Info::interfacesForAppId(const AppID &appid) const
 {
-
     std::set<std::string> interfaces;
 
-    try
+    if (!snapdExists)
     {
-        forAllPlugs([&interfaces, appid](JsonObject *ifaceobj) {
-            auto snapname = json_object_get_string_member(ifaceobj, "snap");
-            if (snapname != appid.package.value())
-            {
-                return;
-            }
-
-            auto cinterfacename = json_object_get_string_member(ifaceobj, "interface");
-            if (cinterfacename == nullptr)
-            {
-                return;
-            }
-
-            std::string interfacename(cinterfacename);
+        return interfaces;
+    }
 
-            auto apps = json_object_get_array_member(ifaceobj, "apps");
-            for (unsigned int k = 0; k < json_array_get_length(apps); k++)
-            {
-                std::string appname = json_array_get_string_element(apps, k);
-                if (appname == appid.appname.value())
-                {
-                    interfaces.insert(interfacename);
-                }
-            }
-        });
+    try
+    {
+        auto index = plugIndex();
+        auto appinterfaces =
+            index->appInterfaces.find(std::make_pair(appid.package.value(), appid.appname.value()));
+        if (appinterfaces != index->appInterfaces.end())
+        {
+            interfaces = appinterfaces->second;
+        }
+    }
+    catch (BackingOffError &e)
+    {
+        g_debug("Unable to get interface information: %s", e.what());
     }
     catch (std::runtime_error &e)
     {
@@ -19,13 +19,15 @@
 
 #pragma once
 
+#include <chrono>
 #include <list>
+#include <map>
 #include <memory>
 #include <set>
-
-#include <json-glib/json-glib.h>
+#include <vector>
 
 #include "appid.h"
+#include "snapd-json.h"
 
 namespace ubuntu
 {
@@ -40,7 +42,7 @@ class Info
 {
 public:
     Info();
-    virtual ~Info() = default;
+    virtual ~Info();
 
     /** Information that we can get from snapd about a package */
     struct PkgInfo
@@ -52,11 +54,36 @@ public:
         std::set<std::string> appnames; /**< List of appnames in the snap */
     };
     std::shared_ptr<PkgInfo> pkgInfo(const AppID::Package &package) const;
+    std::map<std::string, std::shared_ptr<PkgInfo>> pkgInfo(const std::set<std::string> &packages) const;
+
+    /** An app that is plugged into one of the interfaces we asked
+        about, along with the information on the snap it is in */
+    struct InterfaceApp
+    {
+        AppID appid;                      /**< ID of the application */
+        std::string interface;            /**< Interface the app is plugged into */
+        std::shared_ptr<PkgInfo> pkginfo; /**< Information on the snap of the app */
+    };
+    std::list<InterfaceApp> appsForInterfaces(const std::set<std::string> &interfaces) const;
 
     std::set<AppID> appsForInterface(const std::string &interface) const;
 
     std::set<std::string> interfacesForAppId(const AppID &appid) const;
 
+    /** Statistics on how well the cache is working and how
+        we're doing talking to snapd */
+    struct Metrics
+    {
+        unsigned long cacheHits = 0;               /**< Lookups answered from the cache */
+        unsigned long cacheMisses = 0;             /**< Lookups that needed to ask snapd */
+        unsigned long requests = 0;                /**< Requests sent to snapd */
+        unsigned long failures = 0;                /**< Requests that snapd didn't answer */
+        unsigned long backedOff = 0;               /**< Requests skipped because snapd failed recently */
+        std::chrono::microseconds totalLatency{0}; /**< Time spent waiting on all requests */
+        std::chrono::microseconds maxLatency{0};   /**< Longest time spent waiting on one request */
+    };
+    Metrics metrics() const;
+
 private:
     /** Path to the socket of snapd */
     std::string snapdSocket;
@@ -66,9 +93,56 @@ private:
     /** Result of a check at init to see if the socket is available. If
         not all functions will return null results. */
     bool snapdExists = false;
+    /** Directory where snapd keeps its state, used to notice when things
+        change. This can be overridden with UBUNTU_APP_LAUNCH_SNAPD_STATEDIR */
+    std::string snapdStatedir;
+
+    class Connection;
+    /** Shared cURL state that keeps the connection to snapd open between
+        requests instead of reconnecting for each one */
+    std::shared_ptr<Connection> snapdConnection;
+
+    /** All of the plugs from snapd, indexed the ways we look them up */
+    struct PlugIndex
+    {
+        /** Apps for each snap plugged into an interface, by interface */
+        std::map<std::string, std::map<std::string, std::set<std::string>>> interfaceApps;
+        /** Interfaces for each app, by snap and app name */
+        std::map<std::pair<std::string, std::string>, std::set<std::string>> appInterfaces;
+    };
+
+    class Cache;
+    /** Results from snapd that we've already parsed */
+    std::shared_ptr<Cache> cache;
+
+    /** A response from snapd that has been checked for errors. It keeps
+        the body so that the result can be read straight out of it. */
+    struct Response
+    {
+        std::vector<char> data;      /**< Body of the HTTP response */
+        std::size_t resultStart = 0; /**< Offset of the 'result' value in the body */
+        std::size_t resultEnd = 0;   /**< Offset of the end of the 'result' value */
+
+        /** Get a reader for the 'result' value */
+        json::Reader result() const
+        {
+            return json::Reader(data.data() + resultStart, data.data() + resultEnd);
+        }
+    };
+
+    struct SnapJson;
 
-    std::shared_ptr<JsonNode> snapdJson(const std::string &endpoint) const;
-    void forAllPlugs(std::function<void(JsonObject *plugobj)> plugfunc) const;
+    Response snapdJson(const std::string &endpoint) const;
+    std::map<std::string, Response> snapdJson(const std::set<std::string> &endpoints) const;
+    static Response parseSnapdResponse(std::vector<char> &&data);
+    static void readSnap(json::Reader &reader, SnapJson &snap);
+    std::shared_ptr<PkgInfo> pkgInfoFromSnap(const SnapJson &snap, const std::string &package) const;
+    std::shared_ptr<PkgInfo> pkgInfoFromJson(const Response &snapresponse, const std::string &package) const;
+    std::map<std::string, std::shared_ptr<PkgInfo>> pkgInfoFromJson(const Response &snaps,
+                                                                    const std::set<std::string> &packages) const;
+    std::shared_ptr<PlugIndex> plugIndexFromJson(const Response &interfaces) const;
+    std::shared_ptr<PlugIndex> cachedPlugIndex() const;
+    std::shared_ptr<PlugIndex> plugIndex() const;
 };
 
 }  // namespace snapd
@@ -0,0 +1,628 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Ted Gould <ted.gould@canonical.com>
+ */
+
+#include "snapd-json.h"
+
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+namespace ubuntu
+{
+namespace app_launch
+{
+namespace snapd
+{
+namespace json
+{
+
+namespace
+{
+
+/** Adds a unicode code point to a string as UTF-8 */
+void appendUtf8(std::string &value, unsigned int code)
+{
+    if (code < 0x80)
+    {
+        value.push_back(char(code));
+    }
+    else if (code < 0x800)
+    {
+        value.push_back(char(0xC0 | (code >> 6)));
+        value.push_back(char(0x80 | (code & 0x3F)));
+    }
+    else if (code < 0x10000)
+    {
+        value.push_back(char(0xE0 | (code >> 12)));
+        value.push_back(char(0x80 | ((code >> 6) & 0x3F)));
+        value.push_back(char(0x80 | (code & 0x3F)));
+    }
+    else
+    {
+        value.push_back(char(0xF0 | (code >> 18)));
+        value.push_back(char(0x80 | ((code >> 12) & 0x3F)));
+        value.push_back(char(0x80 | ((code >> 6) & 0x3F)));
+        value.push_back(char(0x80 | (code & 0x3F)));
+    }
+}
+
+bool isDigit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+}  // namespace
+
+/** Sets up a reader on a buffer that it doesn't own, so the buffer
+    needs to stay around as long as the reader is used.
+
+    \param begin Start of the JSON text
+    \param end One past the last character of the JSON text
+*/
+Reader::Reader(const char *begin, const char *end)
+    : first(begin)
+    , pos(begin)
+    , last(end)
+{
+}
+
+/** Looks at what type of value is next without reading it */
+Reader::Type Reader::peek()
+{
+    skipWhitespace();
+    if (pos >= last)
+    {
+        error("Unexpected end of JSON");
+    }
+
+    switch (*pos)
+    {
+        case '{':
+            return Type::OBJECT;
+        case '[':
+            return Type::ARRAY;
+        case '"':
+        case '\'':
+            return Type::STRING;
+        case 't':
+        case 'f':
+            return Type::BOOLEAN;
+        case 'n':
+            return Type::NONE;
+        default:
+            if (*pos == '-' || isDigit(*pos))
+            {
+                return Type::NUMBER;
+            }
+            error("Unexpected character '" + std::string(1, *pos) + "'");
+    }
+}
+
+/** Reads the start of an object, after which nextMember() should be
+    called until it returns false. */
+void Reader::beginObject()
+{
+    expect('{');
+    opened = true;
+}
+
+/** Moves to the next member of the object, reading its name. The value
+    of the member must be read or skipped before calling this again.
+
+    \param name Where to put the name of the member
+    \return False when we're at the end of the object
+*/
+bool Reader::nextMember(std::string &name)
+{
+    if (!nextEntry('}'))
+    {
+        return false;
+    }
+
+    auto c = nextChar();
+    if (c != '"' && c != '\'')
+    {
+        error("Expected the name of an object member");
+    }
+
+    name.clear();
+    parseString(&name);
+    expect(':');
+    return true;
+}
+
+/** Reads the start of an array, after which nextElement() should be
+    called until it returns false. */
+void Reader::beginArray()
+{
+    expect('[');
+    opened = true;
+}
+
+/** Moves to the next element of the array. The element must be read
+    or skipped before calling this again.
+
+    \return False when we're at the end of the array
+*/
+bool Reader::nextElement()
+{
+    return nextEntry(']');
+}
+
+/** Reads a string value */
+std::string Reader::readString()
+{
+    std::string value;
+    readString(value);
+    return value;
+}
+
+/** Reads a string value into an existing string, which means that
+    its memory can be reused between values.
+
+    \param value String to replace with the value
+*/
+void Reader::readString(std::string &value)
+{
+    if (peek() != Type::STRING)
+    {
+        error("Expected a string");
+    }
+
+    value.clear();
+    parseString(&value);
+}
+
+/** Reads a number value that must be an integer */
+std::int64_t Reader::readInt()
+{
+    if (peek() != Type::NUMBER)
+    {
+        error("Expected a number");
+    }
+
+    bool negative = false;
+    if (*pos == '-')
+    {
+        negative = true;
+        pos++;
+    }
+
+    if (pos >= last || !isDigit(*pos))
+    {
+        error("Invalid number");
+    }
+
+    std::uint64_t value = 0;
+    const std::uint64_t limit = std::uint64_t(std::numeric_limits<std::int64_t>::max()) + (negative ? 1 : 0);
+    while (pos < last && isDigit(*pos))
+    {
+        unsigned int digit = *pos - '0';
+        if (value > (limit - digit) / 10)
+        {
+            error("Integer is too large");
+        }
+
+        value = value * 10 + digit;
+        pos++;
+    }
+
+    if (pos < last && (*pos == '.' || *pos == 'e' || *pos == 'E'))
+    {
+        error("Expected an integer");
+    }
+
+    if (negative)
+    {
+        return value == 0 ? 0 : -std::int64_t(value - 1) - 1;
+    }
+
+    return std::int64_t(value);
+}
+
+/** Reads a true or false value */
+bool Reader::readBoolean()
+{
+    if (peek() != Type::BOOLEAN)
+    {
+        error("Expected a boolean");
+    }
+
+    if (*pos == 't')
+    {
+        skipLiteral("true");
+        return true;
+    }
+
+    skipLiteral("false");
+    return false;
+}
+
+/** Reads a null value */
+void Reader::readNull()
+{
+    if (peek() != Type::NONE)
+    {
+        error("Expected null");
+    }
+
+    skipLiteral("null");
+}
+
+/** Goes past the next value, including everything in it if it is an
+    object or array. The value is still checked to be valid JSON. */
+void Reader::skip()
+{
+    skipValue(0);
+}
+
+/** Checks that there is nothing left in the buffer after the last value */
+void Reader::end()
+{
+    skipWhitespace();
+    if (pos != last)
+    {
+        error("Unexpected data after the end of the JSON");
+    }
+}
+
+void Reader::skipWhitespace()
+{
+    while (pos < last && (*pos == ' ' || *pos == '\n' || *pos == '\r' || *pos == '\t'))
+    {
+        pos++;
+    }
+}
+
+/** Skips whitespace and returns the next character without reading it */
+char Reader::nextChar()
+{
+    skipWhitespace();
+    if (pos >= last)
+    {
+        error("Unexpected end of JSON");
+    }
+
+    return *pos;
+}
+
+/** Reads a specific character, after any whitespace */
+void Reader::expect(char c)
+{
+    if (nextChar() != c)
+    {
+        error("Expected '" + std::string(1, c) + "' but got '" + std::string(1, *pos) + "'");
+    }
+
+    pos++;
+}
+
+/** Handles the comma between entries of an object or an array, or the
+    bracket that closes it.
+
+    \param close Closing character for the object or array
+*/
+bool Reader::nextEntry(char close)
+{
+    auto c = nextChar();
+    auto justopened = opened;
+    opened = false;
+
+    if (c == close)
+    {
+        pos++;
+        return false;
+    }
+
+    if (!justopened)
+    {
+        expect(',');
+    }
+
+    return true;
+}
+
+/** Reads a string starting at the quote, putting the value into a string
+    if one is given. Double quoted strings are handled in chunks between
+    escapes so that most strings are appended in a single copy.
+
+    \param value String to append the value to, or nullptr to skip it
+*/
+void Reader::parseString(std::string *value)
+{
+    auto quote = *pos++;
+
+    if (quote == '\'')
+    {
+        auto close = static_cast<const char *>(std::memchr(pos, '\'', last - pos));
+        if (close == nullptr)
+        {
+            error("Unterminated string");
+        }
+
+        if (value != nullptr)
+        {
+            value->append(pos, close);
+        }
+        pos = close + 1;
+        return;
+    }
+
+    while (true)
+    {
+        auto start = pos;
+        while (pos < last && *pos != '"' && *pos != '\\' && static_cast<unsigned char>(*pos) >= 0x20)
+        {
+            pos++;
+        }
+
+        if (value != nullptr)
+        {
+            value->append(start, pos);
+        }
+
+        if (pos >= last)
+        {
+            error("Unterminated string");
+        }
+
+        auto c = *pos++;
+        if (c == '"')
+        {
+            return;
+        }
+
+        if (c != '\\')
+        {
+            error("Control character in string");
+        }
+
+        if (pos >= last)
+        {
+            error("Unterminated string");
+        }
+
+        char unescaped;
+        switch (*pos++)
+        {
+            case '"':
+                unescaped = '"';
+                break;
+            case '\\':
+                unescaped = '\\';
+                break;
+            case '/':
+                unescaped = '/';
+                break;
+            case 'b':
+                unescaped = '\b';
+                break;
+            case 'f':
+                unescaped = '\f';
+                break;
+            case 'n':
+                unescaped = '\n';
+                break;
+            case 'r':
+                unescaped = '\r';
+                break;
+            case 't':
+                unescaped = '\t';
+                break;
+            case 'u':
+            {
+                auto code = parseHex();
+                if (code >= 0xDC00 && code <= 0xDFFF)
+                {
+                    error("Unpaired low surrogate in string");
+                }
+
+                if (code >= 0xD800 && code <= 0xDBFF)
+                {
+                    if (last - pos < 2 || pos[0] != '\\' || pos[1] != 'u')
+                    {
+                        error("Unpaired high surrogate in string");
+                    }
+                    pos += 2;
+
+                    auto low = parseHex();
+                    if (low < 0xDC00 || low > 0xDFFF)
+                    {
+                        error("Invalid low surrogate in string");
+                    }
+
+                    code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                }
+
+                if (value != nullptr)
+                {
+                    appendUtf8(*value, code);
+                }
+                continue;
+            }
+            default:
+                error("Invalid escape in string");
+        }
+
+        if (value != nullptr)
+        {
+            value->push_back(unescaped);
+        }
+    }
+}
+
+/** Reads the four hex digits of a unicode escape */
+unsigned int Reader::parseHex()
+{
+    if (last - pos < 4)
+    {
+        error("Unterminated unicode escape");
+    }
+
+    unsigned int code = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        auto c = *pos++;
+        code <<= 4;
+
+        if (isDigit(c))
+        {
+            code |= c - '0';
+        }
+        else if (c >= 'a' && c <= 'f')
+        {
+            code |= c - 'a' + 10;
+        }
+        else if (c >= 'A' && c <= 'F')
+        {
+            code |= c - 'A' + 10;
+        }
+        else
+        {
+            error("Invalid unicode escape");
+        }
+    }
+
+    return code;
+}
+
+/** Goes past a number, checking that it follows the JSON grammar */
+void Reader::skipNumber()
+{
+    if (pos < last && *pos == '-')
+    {
+        pos++;
+    }
+
+    if (pos >= last || !isDigit(*pos))
+    {
+        error("Invalid number");
+    }
+
+    while (pos < last && isDigit(*pos))
+    {
+        pos++;
+    }
+
+    if (pos < last && *pos == '.')
+    {
+        pos++;
+        if (pos >= last || !isDigit(*pos))
+        {
+            error("Invalid number");
+        }
+
+        while (pos < last && isDigit(*pos))
+        {
+            pos++;
+        }
+    }
+
+    if (pos < last && (*pos == 'e' || *pos == 'E'))
+    {
+        pos++;
+        if (pos < last && (*pos == '+' || *pos == '-'))
+        {
+            pos++;
+        }
+
+        if (pos >= last || !isDigit(*pos))
+        {
+            error("Invalid number");
+        }
+
+        while (pos < last && isDigit(*pos))
+        {
+            pos++;
+        }
+    }
+}
+
+/** Goes past a keyword like 'true' */
+void Reader::skipLiteral(const char *literal)
+{
+    auto len = std::strlen(literal);
+    if (std::size_t(last - pos) < len || std::memcmp(pos, literal, len) != 0)
+    {
+        error("Expected '" + std::string(literal) + "'");
+    }
+
+    pos += len;
+}
+
+/** Goes past a value of any type without keeping any of it.
+
+    \param depth How many objects or arrays we're already inside
+*/
+void Reader::skipValue(unsigned int depth)
+{
+    if (depth > maxDepth)
+    {
+        error("JSON is nested too deeply");
+    }
+
+    switch (peek())
+    {
+        case Type::OBJECT:
+            beginObject();
+            while (nextEntry('}'))
+            {
+                auto c = nextChar();
+                if (c != '"' && c != '\'')
+                {
+                    error("Expected the name of an object member");
+                }
+
+                parseString(nullptr);
+                expect(':');
+                skipValue(depth + 1);
+            }
+            break;
+        case Type::ARRAY:
+            beginArray();
+            while (nextEntry(']'))
+            {
+                skipValue(depth + 1);
+            }
+            break;
+        case Type::STRING:
+            parseString(nullptr);
+            break;
+        case Type::NUMBER:
+            skipNumber();
+            break;
+        case Type::BOOLEAN:
+            skipLiteral(*pos == 't' ? "true" : "false");
+            break;
+        case Type::NONE:
+            skipLiteral("null");
+            break;
+    }
+}
+
+/** Throws an error with where in the JSON we were when it happened */
+void Reader::error(const std::string &message) const
+{
+    throw std::runtime_error(message + " at offset " + std::to_string(pos - first));
+}
+
+}  // namespace json
+}  // namespace snapd
+}  // namespace app_launch
+}  // namespace ubuntu
@@ -0,0 +1,112 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Ted Gould <ted.gould@canonical.com>
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace ubuntu
+{
+namespace app_launch
+{
+namespace snapd
+{
+namespace json
+{
+
+/** Reads JSON out of a buffer one value at a time, without building up a
+    tree of the whole document. The caller walks through the document in
+    order, pulling out the values it wants and skipping the ones it doesn't,
+    so the only allocations are for the strings that are kept.
+
+    To match what json-glib accepts, strings may also be in single quotes,
+    in which case there are no escapes in them.
+
+    All errors, both in the JSON and in asking for a value of the wrong
+    type, are thrown as std::runtime_error. After an error the position
+    of the reader is undefined. */
+class Reader
+{
+public:
+    /** Kinds of values that can be next in the document */
+    enum class Type
+    {
+        NONE,    /**< Null value */
+        BOOLEAN, /**< True or false */
+        NUMBER,  /**< Any number */
+        STRING,  /**< String in either type of quotes */
+        OBJECT,  /**< Start of an object */
+        ARRAY    /**< Start of an array */
+    };
+
+    Reader(const char *begin, const char *end);
+
+    Type peek();
+
+    void beginObject();
+    bool nextMember(std::string &name);
+    void beginArray();
+    bool nextElement();
+
+    std::string readString();
+    void readString(std::string &value);
+    std::int64_t readInt();
+    bool readBoolean();
+    void readNull();
+
+    void skip();
+    void end();
+
+    /** Current position in the buffer */
+    const char *position() const
+    {
+        return pos;
+    }
+
+private:
+    /** Start of the buffer */
+    const char *first;
+    /** Next character to read */
+    const char *pos;
+    /** End of the buffer */
+    const char *last;
+    /** Whether we just started an object or array, so a closing
+        bracket is allowed without a comma before it */
+    bool opened = false;
+
+    /** Deepest that skip() will go into nested objects and arrays */
+    static constexpr unsigned int maxDepth = 512;
+
+    void skipWhitespace();
+    char nextChar();
+    void expect(char c);
+    bool nextEntry(char close);
+    void parseString(std::string *value);
+    unsigned int parseHex();
+    void skipNumber();
+    void skipLiteral(const char *literal);
+    void skipValue(unsigned int depth);
+    [[noreturn]] void error(const std::string &message) const;
+};
+
+}  // namespace json
+}  // namespace snapd
+}  // namespace app_launch
+}  // namespace ubuntu
@@ -21,8 +21,12 @@ extern "C" {
 #include "ubuntu-app-launch.h"
 #include <upstart.h>
 #include <gio/gio.h>
-#include <gio/gunixfdlist.h>
+#include <glib-unix.h>
 #include <string.h>
+#include <stddef.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
 #include <fcntl.h>
 #include <errno.h>
 #include <zeitgeist.h>
@@ -31,7 +35,6 @@ extern "C" {
 #include "helpers.h"
 #include "ual-tracepoint.h"
 #include "recoverable-problem.h"
-#include "proxy-socket-demangler.h"
 }
 
 /* C++ Interface */
@@ -42,10 +45,7 @@ extern "C" {
 
 static void free_helper (gpointer value);
 int kill (pid_t pid, int signal) noexcept;
-static gchar * escape_dbus_string (const gchar * input);
 
-G_DEFINE_QUARK(UBUNTU_APP_LAUNCH_PROXY_PATH, proxy_path)
-G_DEFINE_QUARK(UBUNTU_APP_LAUNCH_MIR_FD, mir_fd)
 
 /* Function to take the urls and escape them so that they can be
    parsed on the other side correctly. */
@@ -1017,8 +1017,7 @@ start_helper_core (const gchar * type, const gchar * appid, const gchar * const
 	}
 
 	if (mirsocketpath != NULL) {
-		g_variant_builder_add_value(&builder, g_variant_new_take_string(g_strdup_printf("UBUNTU_APP_LAUNCH_DEMANGLE_PATH=%s", mirsocketpath)));
-		g_variant_builder_add_value(&builder, g_variant_new_take_string(g_strdup_printf("UBUNTU_APP_LAUNCH_DEMANGLE_NAME=%s", g_dbus_connection_get_unique_name(con))));
+		g_variant_builder_add_value(&builder, g_variant_new_take_string(g_strdup_printf("UBUNTU_APP_LAUNCH_DEMANGLE_NAME=%s", mirsocketpath)));
 	}
 
 	g_variant_builder_close(&builder);
@@ -1098,58 +1097,81 @@ get_mir_session_fd (MirPromptSession * session)
 	return retfd;
 }
 
-static GList * open_proxies = NULL;
+/* A Mir socket waiting for its helper to come and get it. The helper's
+   demangler connects to the abstract socket and is handed the FD. */
+typedef struct {
+	gchar * name;
+	gchar * appid;
+	int listenfd;
+	int mirfd;
+	GSource * source;
+} mir_handoff_t;
+
+/* Name -> mir_handoff_t */
+static GHashTable * open_handoffs = NULL;
 
-static gint
-remove_socket_path_find (gconstpointer a, gconstpointer b) 
+static void
+mir_handoff_free (gpointer value)
 {
-	GObject * obj = (GObject *)a;
-	const gchar * path = (const gchar *)b;
+	mir_handoff_t * handoff = (mir_handoff_t *)value;
 
-	gchar * objpath = (gchar *)g_object_get_qdata(obj, proxy_path_quark());
-	
-	return g_strcmp0(objpath, path);
+	g_source_destroy(handoff->source);
+	g_source_unref(handoff->source);
+	close(handoff->listenfd);
+	g_free(handoff->name);
+	g_free(handoff->appid);
+	g_free(handoff);
+}
+
+/* Abstract socket address for the name, returns its length */
+static socklen_t
+mir_handoff_address (const gchar * name, struct sockaddr_un * address)
+{
+	memset(address, 0, sizeof(struct sockaddr_un));
+	address->sun_family = AF_UNIX;
+
+	/* Leading NUL makes it abstract */
+	g_strlcpy(address->sun_path + 1, name, sizeof(address->sun_path) - 1);
+
+	return offsetof(struct sockaddr_un, sun_path) + 1 + strlen(address->sun_path + 1);
 }
 
 /* Cleans up if we need to early */
 static gboolean
 remove_socket_path (const gchar * path)
 {
-	GList * thisproxy = g_list_find_custom(open_proxies, path, remove_socket_path_find);
-	if (thisproxy == NULL)
+	if (open_handoffs == NULL)
 		return FALSE;
 
-	g_debug("Removing Mir Socket Proxy: %s", path);
-
-	GObject * obj = G_OBJECT(thisproxy->data);
-	open_proxies = g_list_delete_link(open_proxies, thisproxy);
+	mir_handoff_t * handoff = (mir_handoff_t *)g_hash_table_lookup(open_handoffs, path);
+	if (handoff == NULL)
+		return FALSE;
 
-	/* Remove ourselves from DBus if we weren't already */
-	g_dbus_interface_skeleton_unexport(G_DBUS_INTERFACE_SKELETON(obj));
+	g_debug("Removing Mir Socket Handoff: %s", path);
 
 	/* If we still have FD, close it */
-	int mirfd = GPOINTER_TO_INT(g_object_get_qdata(obj, mir_fd_quark()));
-	if (mirfd != 0) {
-		close(mirfd);
+	if (handoff->mirfd != 0) {
+		close(handoff->mirfd);
 
 		/* This is actually an error, we should expect not to find
 		   this here to do anything with it. */
 		const gchar * props[3] = {
-			"UbuntuAppLaunchProxyDbusPath",
+			"UbuntuAppLaunchProxySocketName",
 			NULL,
 			NULL
 		};
 		props[1] = path;
-		report_recoverable_problem("ubuntu-app-launch-mir-fd-proxy", 0, TRUE, props);
+		report_recoverable_problem("ubuntu-app-launch-mir-fd-proxy", 0, props);
+		recoverable_problem_flush();
 	}
 
-	g_object_unref(obj);
+	g_hash_table_remove(open_handoffs, path);
 
 	return TRUE;
 }
 
 /* Small timeout function that shouldn't, in most cases, ever do anything.
-   But we need it here to ensure we don't leave things on the bus */
+   But we need it here to ensure we don't leave sockets open */
 static gboolean
 proxy_timeout (gpointer user_data)
 {
@@ -1158,57 +1180,143 @@ proxy_timeout (gpointer user_data)
 	return G_SOURCE_REMOVE;
 }
 
-/* Removes the whole list of proxies if they are there */
+/* Removes the whole list of handoffs if they are there */
 static void
 proxy_cleanup_list (void)
 {
-	while (open_proxies) {
-		GObject * obj = G_OBJECT(open_proxies->data);
-		gchar * path = (gchar *)g_object_get_qdata(obj, proxy_path_quark());
-		remove_socket_path(path);
+	while (open_handoffs != NULL && g_hash_table_size(open_handoffs) > 0) {
+		GHashTableIter iter;
+		gpointer name;
+		g_hash_table_iter_init(&iter, open_handoffs);
+		g_hash_table_iter_next(&iter, &name, NULL);
+		remove_socket_path((const gchar *)name);
 	}
 }
 
+/* Gets the AppArmor label of the process on the other end, without the
+   mode. If the socket can't tell us we ask /proc, the peer is waiting
+   for the FD so its PID can't have been reused. Sets @label to NULL if
+   there isn't an LSM giving out labels. */
 static gboolean
-proxy_mir_socket (GObject * obj, GDBusMethodInvocation * invocation, gpointer user_data)
+mir_handoff_peer_label (int connection, pid_t peer, gchar ** label)
 {
-	g_debug("Called to give Mir socket");
-	int fd = GPOINTER_TO_INT(user_data);
+	gchar buffer[4096];
+	socklen_t length = sizeof(buffer) - 1;
+	gssize read_length = -1;
 
-	if (fd == 0) {
-		g_critical("No FDs to give!");
-		return FALSE;
+	if (getsockopt(connection, SOL_SOCKET, SO_PEERSEC, buffer, &length) == 0) {
+		read_length = length;
+	} else {
+		gchar * path = g_strdup_printf("/proc/%d/attr/current", (int)peer);
+		int attr = open(path, O_RDONLY | O_CLOEXEC);
+		g_free(path);
+
+		read_length = attr >= 0 ? read(attr, buffer, sizeof(buffer) - 1) : -1;
+		int readerr = errno;
+		if (attr >= 0)
+			close(attr);
+
+		/* That's what the kernel says without an LSM */
+		if (read_length < 0 && readerr == EINVAL) {
+			*label = NULL;
+			return TRUE;
+		}
+
+		if (read_length <= 0) {
+			g_warning("Unable to get the AppArmor label of '%d': %s", (int)peer,
+				read_length < 0 ? g_strerror(readerr) : "empty");
+			return FALSE;
+		}
 	}
 
-	/* Index into fds */
-	GVariant* handle = g_variant_new_handle(0);
-	GVariant* tuple = g_variant_new_tuple(&handle, 1);
+	buffer[read_length] = '\0';
+	buffer[strcspn(buffer, " \n")] = '\0';
+	*label = g_strdup(buffer);
+	return TRUE;
+}
 
-	GError* error = NULL;
-	GUnixFDList* list = g_unix_fd_list_new();
-	g_unix_fd_list_append(list, fd, &error);
+/* The demangler has connected, pass it the FD */
+static gboolean
+proxy_mir_socket (gint listenfd, GIOCondition condition, gpointer user_data)
+{
+	mir_handoff_t * handoff = (mir_handoff_t *)user_data;
 
-	if (error == NULL) {   
-		g_dbus_method_invocation_return_value_with_unix_fd_list(invocation, tuple, list);
-	} else {
-		g_variant_ref_sink(tuple);
-		g_variant_unref(tuple);
+	int connection = accept4(listenfd, NULL, NULL, SOCK_CLOEXEC);
+	if (connection < 0) {
+		if (errno != EAGAIN && errno != EINTR)
+			g_warning("Unable to accept connection for Mir socket: %s", g_strerror(errno));
+		return G_SOURCE_CONTINUE;
 	}
 
-	g_object_unref(list);
+	/* Only for our user, the same as the session bus was */
+	struct ucred cred;
+	socklen_t credsize = sizeof(cred);
+	if (getsockopt(connection, SOL_SOCKET, SO_PEERCRED, &cred, &credsize) != 0 || cred.uid != getuid()) {
+		g_warning("Refusing Mir socket to a process of another user");
+		close(connection);
+		return G_SOURCE_CONTINUE;
+	}
 
-	if (error != NULL) {   
-		g_critical("Unable to pass FD %d: %s", fd, error->message);
-		g_error_free(error);
-		return FALSE;
-	}   
+	/* The name is in /proc/net/unix for anyone to see, so the user
+	   matching isn't enough to keep a confined application from taking
+	   it. The helper runs under the profile of its application ID.
+	   Unconfined processes of our user are already able to get into
+	   ours, there's nothing to protect from them. */
+	gchar * label = NULL;
+	if (!mir_handoff_peer_label(connection, cred.pid, &label) ||
+			(label != NULL && g_strcmp0(label, handoff->appid) != 0 && g_strcmp0(label, "unconfined") != 0)) {
+		g_warning("Refusing Mir socket for '%s' to '%s'", handoff->appid, label != NULL ? label : "unknown");
+		g_free(label);
+		close(connection);
+		return G_SOURCE_CONTINUE;
+	}
+	g_free(label);
+
+	g_debug("Called to give Mir socket");
 
-	g_object_set_qdata(obj, mir_fd_quark(), GINT_TO_POINTER(0));
+	int fd = handoff->mirfd;
+	char data = '\0';
+	char control[CMSG_SPACE(sizeof(int))];
+	memset(control, 0, sizeof(control));
+
+	struct iovec iov;
+	iov.iov_base = &data;
+	iov.iov_len = 1;
+
+	struct msghdr message;
+	memset(&message, 0, sizeof(message));
+	message.msg_iov = &iov;
+	message.msg_iovlen = 1;
+	message.msg_control = control;
+	message.msg_controllen = sizeof(control);
+
+	struct cmsghdr * cmsg = CMSG_FIRSTHDR(&message);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+	memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+
+	ssize_t sent;
+	do
+		sent = sendmsg(connection, &message, MSG_NOSIGNAL);
+	while (sent < 0 && errno == EINTR);
+	close(connection);
+
+	if (sent < 0) {
+		/* Someone else can try, the timeout cleans up otherwise */
+		g_critical("Unable to pass FD %d: %s", fd, g_strerror(errno));
+		return G_SOURCE_CONTINUE;
+	}
+
+	/* It's theirs now */
+	close(fd);
+	handoff->mirfd = 0;
+	remove_socket_path(handoff->name);
 
-	return TRUE;
+	return G_SOURCE_REMOVE;
 }
 
-/* Sets up the DBus proxy to send to the demangler */
+/* Sets up the socket to hand the FD to the demangler */
 static gchar *
 build_proxy_socket_path (const gchar * appid, int mirfd)
 {
@@ -1218,38 +1326,32 @@ build_proxy_socket_path (const gchar * appid, int mirfd)
 		final_cleanup = TRUE;
 	}
 
-	GError * error = NULL;
-	GDBusConnection * session = g_bus_get_sync(G_BUS_TYPE_SESSION, NULL, &error);
-	if (error != NULL) {
-		g_warning("Unable to get session bus: %s", error->message);
-		g_error_free(error);
-		return NULL;
+	if (open_handoffs == NULL) {
+		open_handoffs = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, mir_handoff_free);
 	}
 
-	/* Export an Object on DBus */
-	proxySocketDemangler * skel = proxy_socket_demangler_skeleton_new();
-	g_signal_connect(G_OBJECT(skel), "handle-get-mir-socket", G_CALLBACK(proxy_mir_socket), GINT_TO_POINTER(mirfd));
+	int listenfd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+	if (listenfd < 0) {
+		g_critical("Unable to create socket for Mir socket: %s", g_strerror(errno));
+		return NULL;
+	}
 
-	gchar * encoded_appid = escape_dbus_string(appid);
 	gchar * socket_name = NULL;
-	/* Loop until we fine an object path that isn't taken (probably only once) */
+	/* Loop until we find a name that isn't taken (probably only once) */
 	while (socket_name == NULL) {
-		gchar* tryname = g_strdup_printf("/com/canonical/UbuntuAppLaunch/%s/%X", encoded_appid, g_random_int());
-		g_dbus_interface_skeleton_export(G_DBUS_INTERFACE_SKELETON(skel),
-			session,
-			tryname,
-			&error);
+		gchar * tryname = g_strdup_printf("ubuntu-app-launch-mir-%d-%08X", (int)getuid(), g_random_int());
+		struct sockaddr_un address;
+		socklen_t addresslen = mir_handoff_address(tryname, &address);
 
-		if (error == NULL) {
+		if (bind(listenfd, (struct sockaddr *)&address, addresslen) == 0 && listen(listenfd, 1) == 0) {
 			socket_name = tryname;
-			g_debug("Exporting Mir socket on path: %s", socket_name);
+			g_debug("Handing off Mir socket for '%s' on: %s", appid, socket_name);
 		} else {
-			/* Always print the error, but if the object path is in use let's
+			/* Always print the error, but if the name is in use let's
 			   not exit the loop. Let's just try again. */
-			bool exitnow = (error->domain != G_DBUS_ERROR || error->code != G_DBUS_ERROR_OBJECT_PATH_IN_USE);
-			g_critical("Unable to export trusted session object: %s", error->message);
+			bool exitnow = (errno != EADDRINUSE);
+			g_critical("Unable to listen for trusted session: %s", g_strerror(errno));
 
-			g_clear_error(&error);
 			g_free(tryname);
 
 			if (exitnow) {
@@ -1257,28 +1359,36 @@ build_proxy_socket_path (const gchar * appid, int mirfd)
 			}
 		}
 	}
-	g_free(encoded_appid);
 
 	/* If we didn't get a socket name, we should just exit. And
 	   make sure to clean up the socket. */
-	if (socket_name == NULL) {   
-		g_object_unref(skel);
-		g_object_unref(session);
-		g_critical("Unable to export object to any name");
+	if (socket_name == NULL) {
+		close(listenfd);
+		g_critical("Unable to listen on any name");
 		return NULL;
 	}
 
-	g_object_set_qdata_full(G_OBJECT(skel), proxy_path_quark(), g_strdup(socket_name), g_free);
-	g_object_set_qdata(G_OBJECT(skel), mir_fd_quark(), GINT_TO_POINTER(mirfd));
-	open_proxies = g_list_prepend(open_proxies, skel);
+	mir_handoff_t * handoff = g_new0(mir_handoff_t, 1);
+	handoff->name = g_strdup(socket_name);
+	handoff->appid = g_strdup(appid);
+	handoff->listenfd = listenfd;
+	handoff->mirfd = mirfd;
+
+	/* The caller's context, like the DBus export used to be dispatched
+	   on, so the handoff doesn't depend on the global default context
+	   being run */
+	GMainContext * context = g_main_context_get_thread_default();
 
-	g_timeout_add_seconds_full(G_PRIORITY_DEFAULT,
-	                           2,
-	                           proxy_timeout,
-	                           g_strdup(socket_name),
-	                           g_free);
+	handoff->source = g_unix_fd_source_new(listenfd, G_IO_IN);
+	g_source_set_callback(handoff->source, (GSourceFunc)proxy_mir_socket, handoff, NULL);
+	g_source_attach(handoff->source, context);
 
-	g_object_unref(session);
+	g_hash_table_insert(open_handoffs, handoff->name, handoff);
+
+	GSource * timeout = g_timeout_source_new_seconds(2);
+	g_source_set_callback(timeout, proxy_timeout, g_strdup(socket_name), g_free);
+	g_source_attach(timeout, context);
+	g_source_unref(timeout);
 
 	return socket_name;
 }
@@ -1765,29 +1875,3 @@ ubuntu_app_launch_helper_set_exec (const gchar * execline, const gchar * directo
 
 	return TRUE;
 }
-
-
-/* ensure that all characters are valid in the dbus output string */
-static gchar *
-escape_dbus_string (const gchar * input)
-{
-	static const gchar *xdigits = "0123456789abcdef";
-	GString *escaped;
-	gchar c;
-
-	g_return_val_if_fail (input != NULL, NULL);
-
-	escaped = g_string_new (NULL);
-	while ((c = *input++)) {
-		if (g_ascii_isalnum (c)) {
-			g_string_append_c (escaped, c);
-		} else {
-			g_string_append_c (escaped, '_');
-			g_string_append_c (escaped, xdigits[c >> 4]);
-			g_string_append_c (escaped, xdigits[c & 0xf]);
-		}
-	}
-
-	return g_string_free (escaped, FALSE);
-}
-
@@ -25,54 +25,36 @@
 #include <errno.h>
 #include <string.h>
 #include <fcntl.h>
+#include <limits.h>
 #include <sys/stat.h>
 
-int
-main (int argc, char * argv[])
+/* Sets the OOM value of a single PID, the PID and value have already
+   been checked to be in range. Returns zero on success. */
+static int
+set_oom (int procdir, int pidval, int oomval)
 {
-	if (argc != 3) {
-		fprintf(stderr, "Usage: %s <pid> <value>\n", argv[0]);
-		exit(EXIT_FAILURE);
-	}
-
-	/* Not we turn the pid into an integer and back so that we can ensure we don't
-	   get used for nefarious tasks. */
-	int pidval = atoi(argv[1]);
-	if ((pidval < 1) || (pidval >= 32768)) {
-		fprintf(stderr, "PID passed is invalid: %d\n", pidval);
-		exit(EXIT_FAILURE);
-	}
-
-	/* Not we turn the oom value into an integer and back so that we can ensure we don't
-	   get used for nefarious tasks. */
-	int oomval = atoi(argv[2]);
-	if ((oomval < -1000) || (oomval >= 1000)) {
-		fprintf(stderr, "OOM Value passed is invalid: %d\n", oomval);
-		exit(EXIT_FAILURE);
-	}
-
 	/* Open up the PID directory first, to ensure that it is actually one of
 	   ours, so that we can't be used to set a OOM value on just anything */
 	char pidpath[32];
-	snprintf(pidpath, sizeof(pidpath), "/proc/%d", pidval);
+	snprintf(pidpath, sizeof(pidpath), "%d", pidval);
 
-	int piddir = open(pidpath, O_RDONLY | O_DIRECTORY);
+	int piddir = openat(procdir, pidpath, O_RDONLY | O_DIRECTORY);
 	if (piddir < 0) {
-		fprintf(stderr, "Unable open PID directory '%s' for '%d': %s\n", pidpath, pidval, strerror(errno));
-		exit(EXIT_FAILURE);
+		fprintf(stderr, "Unable open PID directory '/proc/%s' for '%d': %s\n", pidpath, pidval, strerror(errno));
+		return -1;
 	}
 
 	struct stat piddirstat = {0};
 	if (fstat(piddir, &piddirstat) < 0) {
 		close(piddir);
-		fprintf(stderr, "Unable stat PID directory '%s' for '%d': %s\n", pidpath, pidval, strerror(errno));
-		exit(EXIT_FAILURE);
+		fprintf(stderr, "Unable stat PID directory '/proc/%s' for '%d': %s\n", pidpath, pidval, strerror(errno));
+		return -1;
 	}
 
 	if (getuid() != piddirstat.st_uid) {
 		close(piddir);
-		fprintf(stderr, "PID directory '%s' is not owned by %d but by %d\n", pidpath, getuid(), piddirstat.st_uid);
-		exit(EXIT_FAILURE);
+		fprintf(stderr, "PID directory '/proc/%s' is not owned by %d but by %d\n", pidpath, getuid(), piddirstat.st_uid);
+		return -1;
 	}
 
 	/* Looks good, let's try to get the actual oom_adj_score file to write
@@ -87,9 +69,9 @@ main (int argc, char * argv[])
 		   worth printing a warning about */
 		if (openerr != ENOENT) {
 			fprintf(stderr, "Unable to set OOM value of '%d' on '%d': %s\n", oomval, pidval, strerror(openerr));
-			exit(EXIT_FAILURE);
+			return -1;
 		} else {
-			exit(EXIT_SUCCESS);
+			return 0;
 		}
 	}
 
@@ -103,7 +85,7 @@ main (int argc, char * argv[])
 	close(piddir);
 
 	if (writesize == strlen(oomstring))
-		exit(EXIT_SUCCESS);
+		return 0;
 	
 	if (writeerr != 0)
 		fprintf(stderr, "Unable to set OOM value of '%d' on '%d': %s\n", oomval, pidval, strerror(writeerr));
@@ -111,5 +93,155 @@ main (int argc, char * argv[])
 		/* No error, but yet, wrong size. Not sure, what could cause this. */
 		fprintf(stderr, "Unable to set OOM value of '%d' on '%d': Wrote %d bytes\n", oomval, pidval, (int)writesize);
 
-	exit(EXIT_FAILURE);
+	return -1;
+}
+
+/* Not we turn the pid into an integer and back so that we can ensure we don't
+   get used for nefarious tasks. */
+static int
+valid_pid (int pidval)
+{
+	if ((pidval < 1) || (pidval >= 32768)) {
+		fprintf(stderr, "PID passed is invalid: %d\n", pidval);
+		return 0;
+	}
+
+	return 1;
+}
+
+/* Not we turn the oom value into an integer and back so that we can ensure we don't
+   get used for nefarious tasks. */
+static int
+valid_oom (int oomval)
+{
+	if ((oomval < -1000) || (oomval >= 1000)) {
+		fprintf(stderr, "OOM Value passed is invalid: %d\n", oomval);
+		return 0;
+	}
+
+	return 1;
+}
+
+/* Reads an integer from @str, leaving @end after it. Values that don't
+   fit an int are refused rather than wrapped, as are empty strings. */
+static int
+parse_int (const char * str, char ** end, int * value)
+{
+	errno = 0;
+	long longval = strtol(str, end, 10);
+
+	if (*end == str || errno != 0 || longval < INT_MIN || longval > INT_MAX) {
+		return 0;
+	}
+
+	*value = (int)longval;
+	return 1;
+}
+
+/* A line is the PID and value separated by blanks, nothing else */
+static int
+parse_line (const char * line, int * pidval, int * oomval)
+{
+	char * end = NULL;
+
+	if (!parse_int(line, &end, pidval) || (*end != ' ' && *end != '\t')) {
+		return 0;
+	}
+
+	if (!parse_int(end, &end, oomval)) {
+		return 0;
+	}
+
+	end += strspn(end, " \t\n");
+	return *end == '\0';
+}
+
+/* Reads lines of "<pid> <value>" from stdin so that all the processes
+   of an application can be set with a single exec. Every line goes
+   through the same checks as a single PID, a bad one doesn't stop the
+   rest from being set but does make us fail. */
+static int
+set_oom_batch (int procdir)
+{
+	int retval = EXIT_SUCCESS;
+	char line[64];
+
+	while (fgets(line, sizeof(line), stdin) != NULL) {
+		int pidval = 0;
+		int oomval = 0;
+
+		if (strchr(line, '\n') == NULL && !feof(stdin)) {
+			fprintf(stderr, "Line too long in PID list\n");
+			exit(EXIT_FAILURE);
+		}
+
+		if (!parse_line(line, &pidval, &oomval)) {
+			fprintf(stderr, "Invalid line in PID list: %s", line);
+			retval = EXIT_FAILURE;
+			continue;
+		}
+
+		if (!valid_pid(pidval) || !valid_oom(oomval)) {
+			retval = EXIT_FAILURE;
+			continue;
+		}
+
+		if (set_oom(procdir, pidval, oomval) != 0) {
+			retval = EXIT_FAILURE;
+		}
+	}
+
+	return retval;
+}
+
+int
+main (int argc, char * argv[])
+{
+	int batch = (argc == 2 && strcmp(argv[1], "--stdin") == 0);
+
+	if (argc != 3 && !batch) {
+		fprintf(stderr, "Usage: %s <pid> <value>\n", argv[0]);
+		fprintf(stderr, "       %s --stdin    (reads '<pid> <value>' lines)\n", argv[0]);
+		exit(EXIT_FAILURE);
+	}
+
+	int pidval = 0;
+	int oomval = 0;
+
+	if (!batch) {
+		char * end = NULL;
+
+		if (!parse_int(argv[1], &end, &pidval) || *end != '\0') {
+			fprintf(stderr, "PID passed is invalid: %s\n", argv[1]);
+			exit(EXIT_FAILURE);
+		}
+		if (!valid_pid(pidval)) {
+			exit(EXIT_FAILURE);
+		}
+
+		if (!parse_int(argv[2], &end, &oomval) || *end != '\0') {
+			fprintf(stderr, "OOM Value passed is invalid: %s\n", argv[2]);
+			exit(EXIT_FAILURE);
+		}
+		if (!valid_oom(oomval)) {
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	/* Keep proc open so each PID is a lookup in it instead of a full path */
+	int procdir = open("/proc", O_RDONLY | O_DIRECTORY);
+	if (procdir < 0) {
+		fprintf(stderr, "Unable to open '/proc': %s\n", strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+
+	int retval;
+	if (batch) {
+		retval = set_oom_batch(procdir);
+	} else {
+		retval = set_oom(procdir, pidval, oomval) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	close(procdir);
+	exit(retval);
 }
@@ -0,0 +1,143 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Ted Gould <ted.gould@canonical.com>
+ */
+
+/* Takes the recoverable problems queued up by whoever started us on
+   stdin and runs apport's reporter for each of them, one at a time, so
+   that they don't have to wait for it. Each report is its PID and size
+   on lines of their own, followed by what goes to the reporter. Our
+   stdout is closed once the queue is read, which is all whoever
+   started us waits for. */
+
+#include <gio/gio.h>
+#include <gio/gunixinputstream.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define APPORT_RECOVERABLE_PROBLEM "/usr/share/apport/recoverable_problem"
+
+/* Gets the number on the line at @cursor, moving past it */
+static gboolean
+read_number (const gchar ** cursor, const gchar * end, guint64 * number)
+{
+	const gchar * newline = memchr(*cursor, '\n', end - *cursor);
+	if (newline == NULL)
+		return FALSE;
+
+	gchar * line = g_strndup(*cursor, newline - *cursor);
+	gchar * lineend = NULL;
+	*number = g_ascii_strtoull(line, &lineend, 10);
+	gboolean valid = line[0] != '\0' && *lineend == '\0';
+	g_free(line);
+
+	*cursor = newline + 1;
+	return valid;
+}
+
+static void
+report (guint64 pid, GBytes * payload)
+{
+	GError * error = NULL;
+	gchar * pidstr = g_strdup_printf("%" G_GUINT64_FORMAT, pid);
+	const gchar * apport = g_getenv("UBUNTU_APP_LAUNCH_APPORT_RECOVERABLE_PROBLEM");
+	if (apport == NULL) {
+		apport = APPORT_RECOVERABLE_PROBLEM;
+	}
+	const gchar * argv[4] = {
+		apport,
+		NULL,
+		NULL,
+		NULL
+	};
+
+	if (pid != 0) {
+		argv[1] = "-p";
+		argv[2] = pidstr;
+	}
+
+	GSubprocess * reporter = g_subprocess_newv(argv,
+		G_SUBPROCESS_FLAGS_STDIN_PIPE | G_SUBPROCESS_FLAGS_STDOUT_SILENCE | G_SUBPROCESS_FLAGS_STDERR_SILENCE,
+		&error);
+
+	if (error == NULL) {
+		g_subprocess_communicate(reporter, payload, NULL, NULL, NULL, &error);
+	}
+
+	if (error != NULL) {
+		g_warning("Unable to report a recoverable error: %s", error->message);
+		g_error_free(error);
+	}
+
+	g_clear_object(&reporter);
+	g_free(pidstr);
+}
+
+int
+main (int argc, char * argv[])
+{
+	/* Read it all first, so whoever is writing can get on with things */
+	GError * error = NULL;
+	GInputStream * input = g_unix_input_stream_new(0, FALSE);
+	GOutputStream * contents = g_memory_output_stream_new_resizable();
+	g_output_stream_splice(contents, input, G_OUTPUT_STREAM_SPLICE_CLOSE_TARGET, NULL, &error);
+	g_object_unref(input);
+
+	if (error != NULL) {
+		g_warning("Unable to read the recoverable problems: %s", error->message);
+		g_error_free(error);
+		g_object_unref(contents);
+		return 1;
+	}
+
+	GBytes * queue = g_memory_output_stream_steal_as_bytes(G_MEMORY_OUTPUT_STREAM(contents));
+	g_object_unref(contents);
+
+	/* Let them go, the PIDs were still around when they queued them */
+	int devnull = open("/dev/null", O_WRONLY | O_CLOEXEC);
+	if (devnull >= 0) {
+		dup2(devnull, STDOUT_FILENO);
+		close(devnull);
+	} else {
+		close(STDOUT_FILENO);
+	}
+
+	gsize queuelen = 0;
+	const gchar * cursor = g_bytes_get_data(queue, &queuelen);
+	const gchar * end = cursor + queuelen;
+
+	while (cursor < end) {
+		guint64 pid = 0;
+		guint64 size = 0;
+		if (!read_number(&cursor, end, &pid) || !read_number(&cursor, end, &size) || size > (guint64)(end - cursor)) {
+			g_warning("Recoverable problem queue is corrupt");
+			break;
+		}
+
+		GBytes * payload = g_bytes_new_from_bytes(queue, cursor - (const gchar *)g_bytes_get_data(queue, NULL), size);
+		report(pid, payload);
+		g_bytes_unref(payload);
+
+		cursor += size;
+	}
+
+	g_bytes_unref(queue);
+
+	return 0;
+}
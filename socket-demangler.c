@@ -17,97 +17,95 @@
  *   Ted Gould <ted.gould@canonical.com>
  */
 
-#define _POSIX_C_SOURCE 200112L
+#define _GNU_SOURCE
 
-#include <gio/gio.h>
-#include <gio/gunixfdlist.h>
+#include <glib.h>
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
 #include <errno.h>
 #include <fcntl.h>
-
-int
-main (int argc, char * argv[])
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+/* Connects to the abstract socket the library is listening on and
+   gets the Mir FD from it, or -1 */
+static int
+receive_mir_fd (const gchar * mir_name)
 {
-	const gchar * mir_name =   g_getenv("UBUNTU_APP_LAUNCH_DEMANGLE_NAME");
-	const gchar * mir_socket = g_getenv("UBUNTU_APP_LAUNCH_DEMANGLE_PATH");
-	if (mir_socket == NULL || mir_socket[0] == '\0') {
-		g_error("Unable to find Mir path for service");
-		return -1;
-	}
-	if (mir_name == NULL || mir_name[0] == '\0') {
-		g_error("Unable to find Mir name for service");
+	int sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (sock < 0) {
+		perror("Unable to create socket");
 		return -1;
 	}
 
-	g_debug("Mir socket connection to %s:%s", mir_name, mir_socket);
+	/* Leading NUL makes it abstract */
+	struct sockaddr_un address;
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	g_strlcpy(address.sun_path + 1, mir_name, sizeof(address.sun_path) - 1);
+	socklen_t addresslen = offsetof(struct sockaddr_un, sun_path) + 1 + strlen(address.sun_path + 1);
 
-	GError * error = NULL;
-	GDBusConnection * bus = g_bus_get_sync(G_BUS_TYPE_SESSION, NULL, &error);
-
-	if (error != NULL) {
-		g_error("Unable to get session bus: %s", error->message);
-		g_error_free(error);
+	if (connect(sock, (struct sockaddr *)&address, addresslen) != 0) {
+		perror("Unable to connect to Mir socket handoff");
+		close(sock);
 		return -1;
 	}
 
-	GVariant * retval;
-	GUnixFDList * fdlist;
-
-	retval = g_dbus_connection_call_with_unix_fd_list_sync(
-		bus,
-		mir_name,
-		mir_socket,
-		"com.canonical.UbuntuAppLaunch.SocketDemangler",
-		"GetMirSocket",
-		NULL,
-		G_VARIANT_TYPE("(h)"),
-		G_DBUS_CALL_FLAGS_NO_AUTO_START,
-		-1, /* timeout */
-		NULL, /* fd list in */
-		&fdlist,
-		NULL, /* cancelable */
-		&error);
-
-	g_clear_object(&bus);
-
-	if (error != NULL) {
-		g_error("Unable to get Mir socket over dbus: %s", error->message);
-		g_error_free(error);
+	char data;
+	char control[CMSG_SPACE(sizeof(int))];
+	struct iovec iov = { .iov_base = &data, .iov_len = 1 };
+	struct msghdr message = {
+		.msg_iov = &iov,
+		.msg_iovlen = 1,
+		.msg_control = control,
+		.msg_controllen = sizeof(control)
+	};
+
+	ssize_t length;
+	do
+		length = recvmsg(sock, &message, 0);
+	while (length < 0 && errno == EINTR);
+	close(sock);
+
+	if (length <= 0) {
+		fprintf(stderr, "Unable to get Mir socket: %s\n", length < 0 ? strerror(errno) : "connection closed");
 		return -1;
 	}
 
-	GVariant * outhandle = g_variant_get_child_value(retval, 0);
-
-	if (outhandle == NULL) {
-		g_error("Unable to get data from function");
-		return -1;
+	int fd = -1;
+	struct cmsghdr * cmsg;
+	for (cmsg = CMSG_FIRSTHDR(&message); cmsg != NULL; cmsg = CMSG_NXTHDR(&message, cmsg)) {
+		if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS &&
+				cmsg->cmsg_len == CMSG_LEN(sizeof(int))) {
+			memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+		}
 	}
 
-	gint32 handle = g_variant_get_handle(outhandle);
-	g_variant_unref(outhandle);
-	g_variant_unref(retval);
-
-	if (handle >= g_unix_fd_list_get_length(fdlist)) {
-		g_error("Handle is %d but the FD list only has %d entries", handle, g_unix_fd_list_get_length(fdlist));
-		g_clear_object(&fdlist);
+	if ((message.msg_flags & MSG_CTRUNC) != 0 || fd < 0) {
+		fprintf(stderr, "Mir socket handoff didn't have a file descriptor\n");
 		return -1;
 	}
 
-	gint32 fd = g_unix_fd_list_get(fdlist, handle, &error);
-	g_clear_object(&fdlist);
+	return fd;
+}
 
-	if (error != NULL) {
-		g_error("Unable to Unix FD: %s", error->message);
-		g_error_free(error);
+int
+main (int argc, char * argv[])
+{
+	const gchar * mir_name = g_getenv("UBUNTU_APP_LAUNCH_DEMANGLE_NAME");
+	if (mir_name == NULL || mir_name[0] == '\0') {
+		g_error("Unable to find Mir name for service");
 		return -1;
 	}
 
-	errno = 0;
-	fcntl(fd, F_GETFD);
-	if (errno != 0) {
-		perror("File descriptor is invalid");
+	g_debug("Mir socket connection to %s", mir_name);
+
+	int fd = receive_mir_fd(mir_name);
+	if (fd < 0) {
 		return -1;
 	}
 
@@ -122,7 +120,6 @@ main (int argc, char * argv[])
 
 	/* Don't let people guess about these */
 	g_unsetenv("UBUNTU_APP_LAUNCH_DEMANGLE_NAME");
-	g_unsetenv("UBUNTU_APP_LAUNCH_DEMANGLE_PATH");
 
 	return execvp(argv[1], argv + 1);
 }
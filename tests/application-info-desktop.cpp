@@ -324,4 +324,20 @@ TEST_F(ApplicationInfoDesktop, XMirCases)
                      .value());
 }
 
+TEST_F(ApplicationInfoDesktop, ZygoteLibrary)
+{
+    auto unset = defaultKeyfile();
+    EXPECT_EQ("", ubuntu::app_launch::app_info::Desktop(unset, "/", {},
+                                                        ubuntu::app_launch::app_info::DesktopFlags::NONE, nullptr)
+                      .zygoteLibrary()
+                      .value());
+
+    auto set = defaultKeyfile();
+    g_key_file_set_string(set.get(), DESKTOP, "X-Ubuntu-Zygote-Library", "lib/libapp.so");
+    EXPECT_EQ("lib/libapp.so", ubuntu::app_launch::app_info::Desktop(
+                                   set, "/", {}, ubuntu::app_launch::app_info::DesktopFlags::NONE, nullptr)
+                                   .zygoteLibrary()
+                                   .value());
+}
+
 }  // anonymous namespace
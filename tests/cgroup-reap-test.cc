@@ -18,6 +18,8 @@
  */
 
 #include <gtest/gtest.h>
+#include <glib/gstdio.h>
+#include <vector>
 #include <gio/gio.h>
 #include <libdbustest/dbus-test.h>
 
@@ -50,12 +52,24 @@ class CGroupReap : public ::testing::Test
 			/* This Python code executes in dbusmock and checks to see if the sleeping
 			   process is running. If it is, it returns its PID in the list of PIDs, if
 			   not it doesn't return any PIDs. */
+			/* If a test has written a session ID to the session file, every
+			   process in that session that hasn't exited is in the list as
+			   well, like they would be in a cgroup */
+			g_unlink(CG_REAP_SESSION_FILE);
 			gchar * pythoncode = g_strdup_printf(
 				"if os.spawnlp(os.P_WAIT, 'ps', 'ps', '%d') == 0 :\n"
 				"  ret = [ %d ]\n"
 				"else:\n"
-				"  ret = [ ]",
-				sleeppid, sleeppid);
+				"  ret = [ ]\n"
+				"if os.path.exists('%s'):\n"
+				"  sid = int(open('%s').read())\n"
+				"  for entry in os.listdir('/proc'):\n"
+				"    try:\n"
+				"      if entry.isdigit() and os.getsid(int(entry)) == sid and open('/proc/' + entry + '/stat').read().rsplit(')', 1)[1].split()[0] not in ['Z', 'X']:\n"
+				"        ret.append(int(entry))\n"
+				"    except Exception:\n"
+				"      pass",
+				sleeppid, sleeppid, CG_REAP_SESSION_FILE, CG_REAP_SESSION_FILE);
 			dbus_test_dbus_mock_object_add_method(cgmock, cgobject,
 				"GetTasksRecursive",
 				G_VARIANT_TYPE("(ss)"),
@@ -64,6 +78,13 @@ class CGroupReap : public ::testing::Test
 				NULL);
 			g_free(pythoncode);
 
+			dbus_test_dbus_mock_object_add_method(cgmock, cgobject,
+				"SetValue",
+				G_VARIANT_TYPE("(ssss)"),
+				NULL,
+				"",
+				NULL);
+
 			/* Put it together */
 			dbus_test_service_add_task(service, DBUS_TEST_TASK(cgmock));
 			dbus_test_service_start_tasks(service);
@@ -91,6 +112,8 @@ class CGroupReap : public ::testing::Test
 
 			g_debug("Killing the sleeper: %d", sleeppid);
 			kill(sleeppid, SIGKILL);
+
+			g_unlink(CG_REAP_SESSION_FILE);
 		}
 
 		static gboolean pause_helper (gpointer pmainloop) {
@@ -113,6 +136,30 @@ class CGroupReap : public ::testing::Test
 			}
 		}
 
+		/* Processes in a session that haven't exited */
+		std::vector<pid_t> sessionTasks (pid_t sid) {
+			std::vector<pid_t> found;
+			GDir * proc = g_dir_open("/proc", 0, NULL);
+			const gchar * entry;
+			while ((entry = g_dir_read_name(proc)) != NULL) {
+				pid_t pid = atoi(entry);
+				if (pid <= 0 || getsid(pid) != sid)
+					continue;
+
+				gchar * statpath = g_strdup_printf("/proc/%d/stat", pid);
+				gchar * stat = NULL;
+				if (g_file_get_contents(statpath, &stat, NULL, NULL)) {
+					const gchar * state = strrchr(stat, ')');
+					if (state != NULL && state[1] != '\0' && state[2] != 'Z' && state[2] != 'X')
+						found.push_back(pid);
+				}
+				g_free(stat);
+				g_free(statpath);
+			}
+			g_dir_close(proc);
+			return found;
+		}
+
 		bool sleepRunning (void) {
 			gint status = 1;
 			gchar * cmdline = g_strdup_printf("ps %d", sleeppid);
@@ -143,3 +190,68 @@ TEST_F(CGroupReap, KillSleep)
 	ASSERT_TRUE(dbus_test_dbus_mock_object_clear_method_calls(cgmock, cgobject, NULL));
 }
 
+TEST_F(CGroupReap, ThawFirst)
+{
+	g_setenv("UPSTART_JOB", "foo", TRUE);
+	g_setenv("UPSTART_INSTANCE", "bar", TRUE);
+
+	/* Like it would be if the application was paused */
+	kill(sleeppid, SIGSTOP);
+
+	ASSERT_TRUE(g_spawn_command_line_sync(CG_REAP_TOOL, NULL, NULL, NULL, NULL));
+	EXPECT_FALSE(sleepRunning());
+
+	/* The group is thawed before reaping */
+	DbusTestDbusMockObject * cgobject = dbus_test_dbus_mock_get_object(cgmock, "/org/linuxcontainers/cgmanager", "org.linuxcontainers.cgmanager0_0", NULL);
+	const DbusTestDbusMockCall * calls = NULL;
+	guint len = 0;
+
+	calls = dbus_test_dbus_mock_object_get_method_calls(cgmock, cgobject, "SetValue", &len, NULL);
+	ASSERT_EQ(1, len);
+	EXPECT_TRUE(g_variant_equal(calls->params, g_variant_new("(ssss)", "freezer", "", "freezer.state", "THAWED")));
+
+	ASSERT_TRUE(dbus_test_dbus_mock_object_clear_method_calls(cgmock, cgobject, NULL));
+}
+
+TEST_F(CGroupReap, KillForkBomb)
+{
+	g_setenv("UPSTART_JOB", "foo", TRUE);
+	g_setenv("UPSTART_INSTANCE", "bar", TRUE);
+
+	/* A tree of shells in their own session where every one of them is
+	   forking all the time, so there are always new processes coming */
+	const gchar * argv[] = { "setsid", "sh", "-c",
+		"bomb() { if [ $1 -gt 0 ] ; then bomb $(($1 - 1)) & bomb $(($1 - 1)) & fi ; while true ; do sleep 0.1 & sleep 0.01 ; done ; } ; bomb 4",
+		NULL };
+	GPid bombpid = 0;
+	ASSERT_TRUE(g_spawn_async(NULL, (gchar **)argv, NULL, G_SPAWN_SEARCH_PATH, NULL, NULL, &bombpid, NULL));
+
+	/* Let it get going */
+	unsigned int starttry = 0;
+	while (sessionTasks(bombpid).size() < 31 && starttry < 100) {
+		pause(50);
+		starttry++;
+	}
+	ASSERT_GE(sessionTasks(bombpid).size(), 31u);
+
+	gchar * sid = g_strdup_printf("%d", bombpid);
+	ASSERT_TRUE(g_file_set_contents(CG_REAP_SESSION_FILE, sid, -1, NULL));
+	g_free(sid);
+
+	ASSERT_TRUE(g_spawn_command_line_sync(CG_REAP_TOOL, NULL, NULL, NULL, NULL));
+
+	/* Nothing is left, and nothing new started after it was done */
+	EXPECT_EQ(0u, sessionTasks(bombpid).size());
+	pause(100);
+	EXPECT_EQ(0u, sessionTasks(bombpid).size());
+
+	/* It only asks again until it has stopped everything */
+	DbusTestDbusMockObject * cgobject = dbus_test_dbus_mock_get_object(cgmock, "/org/linuxcontainers/cgmanager", "org.linuxcontainers.cgmanager0_0", NULL);
+	guint len = 0;
+	dbus_test_dbus_mock_object_get_method_calls(cgmock, cgobject, "GetTasksRecursive", &len, NULL);
+	EXPECT_LT(len, 10u);
+	ASSERT_TRUE(dbus_test_dbus_mock_object_clear_method_calls(cgmock, cgobject, NULL));
+
+	/* In case it got away */
+	kill(-bombpid, SIGKILL);
+}
@@ -0,0 +1,91 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Ted Gould <ted.gould@canonical.com>
+ */
+
+#include "desktop-file-index.h"
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gtest/gtest.h>
+
+using namespace ubuntu::app_launch;
+
+#define CONTAINER_APPS \
+    CMAKE_SOURCE_DIR "/libertine-data/libertine-container/container-name/rootfs/usr/share/applications"
+#define INDEX_TEMP_DIR CMAKE_BINARY_DIR "/desktop-file-index-temp"
+
+TEST(DesktopFileIndex, FindsTopLevelFile)
+{
+    DesktopFileIndex index(CONTAINER_APPS);
+    EXPECT_EQ(CONTAINER_APPS "/test.desktop", index.find("test.desktop"));
+}
+
+TEST(DesktopFileIndex, FindsNestedFile)
+{
+    DesktopFileIndex index(CONTAINER_APPS);
+    EXPECT_EQ(CONTAINER_APPS "/nested/test-nested.desktop", index.find("test-nested.desktop"));
+}
+
+TEST(DesktopFileIndex, ReturnsEmptyWhenNotFound)
+{
+    DesktopFileIndex index(CONTAINER_APPS);
+    EXPECT_TRUE(index.find("not-there.desktop").empty());
+    EXPECT_TRUE(index.find("nested").empty());
+
+    DesktopFileIndex missing("/tmp/please/dont/put/stuff/here");
+    EXPECT_TRUE(missing.find("test.desktop").empty());
+}
+
+TEST(DesktopFileIndex, NoticesChanges)
+{
+    g_spawn_command_line_sync("rm -rf " INDEX_TEMP_DIR, NULL, NULL, NULL, NULL);
+    ASSERT_EQ(0, g_mkdir_with_parents(INDEX_TEMP_DIR, 0700));
+
+    DesktopFileIndex index(INDEX_TEMP_DIR);
+    EXPECT_TRUE(index.find("new.desktop").empty());
+
+    /* Adding a file in a new directory */
+    ASSERT_EQ(0, g_mkdir(INDEX_TEMP_DIR "/subdir", 0700));
+    ASSERT_TRUE(g_file_set_contents(INDEX_TEMP_DIR "/subdir/new.desktop", "[Desktop Entry]\n", -1, nullptr));
+    EXPECT_EQ(INDEX_TEMP_DIR "/subdir/new.desktop", index.find("new.desktop"));
+
+    /* The same name higher up wins */
+    ASSERT_TRUE(g_file_set_contents(INDEX_TEMP_DIR "/new.desktop", "[Desktop Entry]\n", -1, nullptr));
+    EXPECT_EQ(INDEX_TEMP_DIR "/new.desktop", index.find("new.desktop"));
+
+    /* Removing them */
+    ASSERT_EQ(0, g_unlink(INDEX_TEMP_DIR "/new.desktop"));
+    EXPECT_EQ(INDEX_TEMP_DIR "/subdir/new.desktop", index.find("new.desktop"));
+    ASSERT_EQ(0, g_unlink(INDEX_TEMP_DIR "/subdir/new.desktop"));
+    EXPECT_TRUE(index.find("new.desktop").empty());
+
+    g_spawn_command_line_sync("rm -rf " INDEX_TEMP_DIR, NULL, NULL, NULL, NULL);
+}
+
+TEST(DesktopFileIndex, NoticesDirectoryCreated)
+{
+    g_spawn_command_line_sync("rm -rf " INDEX_TEMP_DIR, NULL, NULL, NULL, NULL);
+
+    DesktopFileIndex index(INDEX_TEMP_DIR);
+    EXPECT_TRUE(index.find("new.desktop").empty());
+
+    ASSERT_EQ(0, g_mkdir_with_parents(INDEX_TEMP_DIR, 0700));
+    ASSERT_TRUE(g_file_set_contents(INDEX_TEMP_DIR "/new.desktop", "[Desktop Entry]\n", -1, nullptr));
+    EXPECT_EQ(INDEX_TEMP_DIR "/new.desktop", index.find("new.desktop"));
+
+    g_spawn_command_line_sync("rm -rf " INDEX_TEMP_DIR, NULL, NULL, NULL, NULL);
+}
@@ -0,0 +1,239 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Ted Gould <ted.gould@canonical.com>
+ */
+
+#include "env-builder.h"
+#include <chrono>
+#include <functional>
+#include <glib.h>
+#include <gtest/gtest.h>
+#include <iostream>
+#include <list>
+#include <numeric>
+
+using namespace ubuntu::app_launch;
+
+class EnvBuilderTest : public ::testing::Test
+{
+protected:
+    typedef std::list<std::pair<std::string, std::string>> EnvList;
+
+    /* The way the environment was sent before, for comparing */
+    GVariant* withBuilder(const EnvList& env)
+    {
+        GVariantBuilder builder;
+        g_variant_builder_init(&builder, G_VARIANT_TYPE_STRING_ARRAY);
+
+        for (const auto& envvar : env)
+        {
+            g_variant_builder_add_value(&builder, g_variant_new_take_string(g_strdup_printf(
+                                                      "%s=%s", envvar.first.c_str(), envvar.second.c_str())));
+        }
+
+        return g_variant_ref_sink(g_variant_builder_end(&builder));
+    }
+
+    GVariant* withEnvBuilder(const EnvList& env)
+    {
+        EnvBuilder builder;
+        for (const auto& envvar : env)
+        {
+            builder.add(envvar.first, envvar.second);
+        }
+
+        return g_variant_ref_sink(builder.toVariant());
+    }
+
+    /* Checks that both ways give the same array */
+    void expectSame(const EnvList& env)
+    {
+        auto expected = withBuilder(env);
+        auto actual = withEnvBuilder(env);
+
+        EXPECT_TRUE(g_variant_is_normal_form(actual));
+        EXPECT_TRUE(g_variant_equal(expected, actual));
+        EXPECT_EQ(g_variant_get_size(expected), g_variant_get_size(actual));
+        EXPECT_EQ(g_variant_n_children(expected), g_variant_n_children(actual));
+
+        g_variant_unref(expected);
+        g_variant_unref(actual);
+    }
+
+    /* The environment of a Click application opened with a few URLs */
+    EnvList clickEnv(const std::vector<Application::URL>& urls)
+    {
+        EnvList env{
+            {"UBUNTU_APPLICATION_ISOLATION", "1"},
+            {"XDG_CACHE_HOME", "/home/phablet/.cache"},
+            {"XDG_CONFIG_HOME", "/home/phablet/.config"},
+            {"XDG_DATA_HOME", "/home/phablet/.local/share"},
+            {"XDG_RUNTIME_DIR", "/run/user/32011"},
+            {"XDG_DATA_DIRS", "/opt/click.ubuntu.com/com.ubuntu.music/2.4.1050:/usr/share/ubuntu:/usr/share/"
+                              "gnome:/usr/local/share/:/usr/share/:/custom/usr/share/"},
+            {"TMPDIR", "/run/user/32011/confined/com.ubuntu.music"},
+            {"__GL_SHADER_DISK_CACHE_PATH", "/home/phablet/.cache/com.ubuntu.music"},
+            {"APP_DIR", "/opt/click.ubuntu.com/com.ubuntu.music/2.4.1050"},
+            {"APP_DESKTOP_FILE_PATH", "/opt/click.ubuntu.com/com.ubuntu.music/2.4.1050/music-app.desktop"},
+            {"APP_XMIR_ENABLE", "0"},
+            {"APP_EXEC", "qmlscene $@ ${CLICK_DIR}/app/music-app.qml"},
+            {"APP_ID", "com.ubuntu.music_music_2.4.1050"},
+            {"APP_LAUNCHER_PID", "2112"},
+        };
+
+        auto accumfunc = [](const std::string& prev, Application::URL thisurl) -> std::string {
+            gchar* gescaped = g_shell_quote(thisurl.value().c_str());
+            std::string escaped(gescaped);
+            g_free(gescaped);
+            return prev.empty() ? escaped : prev + " " + escaped;
+        };
+        env.emplace_back("APP_URIS", std::accumulate(urls.begin(), urls.end(), std::string{}, accumfunc));
+
+        return env;
+    }
+
+    /* Runs a function a number of times and returns the average time */
+    std::chrono::nanoseconds timeIt(unsigned int iterations, std::function<void()> func)
+    {
+        auto start = std::chrono::steady_clock::now();
+        for (unsigned int i = 0; i < iterations; i++)
+        {
+            func();
+        }
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start) /
+               iterations;
+    }
+};
+
+TEST_F(EnvBuilderTest, MatchesBuilder)
+{
+    expectSame({{"APP_ID", "com.test.good_application_1.2.3"}});
+    expectSame({{"APP_ID", "foo"}, {"EMPTY", ""}, {"APP_EXEC", "foo %U"}, {"UNICODE", "ünïcødé"}});
+}
+
+TEST_F(EnvBuilderTest, Empty)
+{
+    EnvBuilder builder;
+    EXPECT_EQ(0u, builder.size());
+
+    auto variant = g_variant_ref_sink(builder.toVariant());
+    EXPECT_TRUE(g_variant_is_of_type(variant, G_VARIANT_TYPE_STRING_ARRAY));
+    EXPECT_EQ(0u, g_variant_n_children(variant));
+    g_variant_unref(variant);
+}
+
+TEST_F(EnvBuilderTest, OffsetWidths)
+{
+    /* Just under and over what one and two byte offsets can handle */
+    for (auto length : {200, 250, 260, 65000, 65530, 65540, 70000})
+    {
+        expectSame({{"A", std::string(length / 2, 'a')}, {"B", std::string(length - length / 2, 'b')}});
+    }
+
+    EnvList many;
+    for (int i = 0; i < 5000; i++)
+    {
+        many.emplace_back("VAR_" + std::to_string(i), std::to_string(i));
+    }
+    expectSame(many);
+}
+
+TEST_F(EnvBuilderTest, ShellQuoted)
+{
+    std::vector<Application::URL> urls{
+        Application::URL::from_raw("http://ubuntu.com/"), Application::URL::from_raw("file:///home/it's here"),
+        Application::URL::from_raw("''"), Application::URL::from_raw("scope://simple?q=a b")};
+
+    EnvBuilder builder;
+    builder.addShellQuoted("APP_URIS", urls);
+
+    EXPECT_EQ("'http://ubuntu.com/' 'file:///home/it'\\''s here' ''\\'''\\''' 'scope://simple?q=a b'",
+              builder.value("APP_URIS"));
+
+    /* It has to agree with the shell */
+    gchar** argv = nullptr;
+    ASSERT_TRUE(g_shell_parse_argv(builder.value("APP_URIS").c_str(), nullptr, &argv, nullptr));
+    ASSERT_EQ(urls.size(), g_strv_length(argv));
+    for (size_t i = 0; i < urls.size(); i++)
+    {
+        EXPECT_EQ(urls[i].value(), argv[i]);
+    }
+    g_strfreev(argv);
+}
+
+TEST_F(EnvBuilderTest, Value)
+{
+    EnvBuilder builder;
+    builder.add("APP", "short");
+    builder.add("APP_ID", "first");
+    builder.add("APP_EXEC", "");
+    builder.add("APP_ID", "second");
+
+    EXPECT_EQ(4u, builder.size());
+    EXPECT_EQ("short", builder.value("APP"));
+    EXPECT_EQ("second", builder.value("APP_ID"));
+    EXPECT_EQ("", builder.value("APP_EXEC"));
+    EXPECT_EQ("", builder.value("APP_DIR"));
+    EXPECT_EQ("", builder.value("AP"));
+}
+
+TEST_F(EnvBuilderTest, InvalidUtf8)
+{
+    EnvBuilder builder;
+    builder.add("GOOD", "value");
+    builder.add("BAD", "\xff\xfe");
+    builder.add("NUL", std::string("a\0b", 3));
+
+    EXPECT_EQ(1u, builder.size());
+    EXPECT_EQ("", builder.value("BAD"));
+
+    auto variant = g_variant_ref_sink(builder.toVariant());
+    EXPECT_TRUE(g_variant_is_normal_form(variant));
+    EXPECT_EQ(1u, g_variant_n_children(variant));
+    g_variant_unref(variant);
+}
+
+TEST_F(EnvBuilderTest, BenchmarkClickLaunch)
+{
+    std::vector<Application::URL> urls{Application::URL::from_raw("http://ubuntu.com/"),
+                                       Application::URL::from_raw("file:///home/phablet/Music/It's a song.mp3"),
+                                       Application::URL::from_raw("scope://com.ubuntu.music?q=album")};
+    auto env = clickEnv(urls);
+    expectSame(env);
+
+    auto listtime = timeIt(10000, [this, &urls]() {
+        auto variant = withBuilder(clickEnv(urls));
+        g_variant_unref(variant);
+    });
+
+    auto buildertime = timeIt(10000, [&env, &urls]() {
+        EnvBuilder builder;
+        for (const auto& envvar : env)
+        {
+            if (envvar.first != "APP_URIS")
+            {
+                builder.add(envvar.first, envvar.second);
+            }
+        }
+        builder.addShellQuoted("APP_URIS", urls);
+        auto variant = g_variant_ref_sink(builder.toVariant());
+        g_variant_unref(variant);
+    });
+
+    std::cout << "Click launch environment of " << env.size() << " variables: list and GVariantBuilder "
+              << listtime.count() << "ns, EnvBuilder " << buildertime.count() << "ns" << std::endl;
+}
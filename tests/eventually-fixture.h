@@ -105,12 +105,30 @@ protected:
     _EVENTUALLY_HELPER(STRNE);
 
 #undef _EVENTUALLY_HELPER
+
+    /* Same as the helpers above, but calls a function to get the
+       value each time around instead of comparing a variable */
+    template <typename Expected, typename Func>
+    testing::AssertionResult eventuallyFuncHelperEQ(const char *expectedstr,
+                                                    const char *funcstr,
+                                                    const Expected &expected,
+                                                    Func func)
+    {
+        std::function<testing::AssertionResult(void)> loopfunc = [&]() {
+            auto value = func();
+            return testing::internal::CmpHelperEQ(expectedstr, funcstr, expected, value);
+        };
+        return eventuallyLoop(loopfunc);
+    }
 };
 
 /* Helpers */
 #define EXPECT_EVENTUALLY_EQ(expected, actual) \
     EXPECT_PRED_FORMAT2(EventuallyFixture::eventuallyHelperEQ, expected, actual)
 
+#define EXPECT_EVENTUALLY_FUNC_EQ(expected, func) \
+    EXPECT_PRED_FORMAT2(EventuallyFixture::eventuallyFuncHelperEQ, expected, func)
+
 #define EXPECT_EVENTUALLY_NE(expected, actual) \
     EXPECT_PRED_FORMAT2(EventuallyFixture::eventuallyHelperNE, expected, actual)
 
@@ -0,0 +1,220 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Ted Gould <ted.gould@canonical.com>
+ */
+
+#include <chrono>
+#include <functional>
+#include <glib.h>
+#include <gtest/gtest.h>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include "../helpers.h"
+
+GArray* reference_exec_parse(const gchar* execline, const gchar* urilist);
+GArray* reference_exec_parse_list(const gchar* execline, gchar** urilist);
+}
+
+class ExecParseFuzz : public ::testing::Test
+{
+protected:
+    /* Both parsers warn about the lines we feed them a lot */
+    virtual void SetUp()
+    {
+        g_log_set_default_handler([](const gchar*, GLogLevelFlags, const gchar*, gpointer) {}, nullptr);
+    }
+
+    virtual void TearDown()
+    {
+        g_log_set_default_handler(g_log_default_handler, nullptr);
+    }
+
+    /* Made of the characters that mean something to either the quoting
+       or the field codes, so most lines hit the corner cases */
+    std::string randomLine(std::mt19937& random, size_t maxlength)
+    {
+        static const std::vector<std::string> pieces{
+            " ", " ", "\t", "\n", "'", "\"", "\\", "#", "`", "$", "%", "%", "%%", "%u", "%U", "%f", "%F", "%d",
+            "%k", "%x", "a", "b", "foo", "ü", "file:///tmp/", "http://ubuntu.com/"};
+
+        std::uniform_int_distribution<size_t> length(0, maxlength);
+        std::uniform_int_distribution<size_t> piece(0, pieces.size() - 1);
+
+        std::string line;
+        for (auto i = length(random); i > 0; i--)
+        {
+            line += pieces[piece(random)];
+        }
+        return line;
+    }
+
+    std::vector<std::string> fromArray(GArray* array)
+    {
+        std::vector<std::string> strings;
+        for (guint i = 0; i < array->len; i++)
+        {
+            strings.emplace_back(g_array_index(array, gchar*, i));
+        }
+        g_strfreev((gchar**)g_array_free(array, FALSE));
+        return strings;
+    }
+
+    std::vector<std::string> fromStrv(gchar** strv)
+    {
+        std::vector<std::string> strings;
+        for (gchar** str = strv; *str != nullptr; str++)
+        {
+            strings.emplace_back(*str);
+        }
+        return strings;
+    }
+
+    /* Runs a function a number of times and returns the average time */
+    std::chrono::nanoseconds timeIt(unsigned int iterations, std::function<void()> func)
+    {
+        auto start = std::chrono::steady_clock::now();
+        for (unsigned int i = 0; i < iterations; i++)
+        {
+            func();
+        }
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start) /
+               iterations;
+    }
+};
+
+TEST_F(ExecParseFuzz, SplitMatchesGLib)
+{
+    std::mt19937 random(1701);
+
+    for (int i = 0; i < 100000; i++)
+    {
+        auto line = randomLine(random, 12);
+
+        gchar** expected = nullptr;
+        gboolean parsed = g_shell_parse_argv(line.c_str(), nullptr, &expected, nullptr);
+        gchar** actual = desktop_exec_split(line.c_str());
+
+        ASSERT_EQ(parsed, actual != nullptr) << "Line: '" << line << "'";
+        if (parsed)
+        {
+            ASSERT_EQ(fromStrv(expected), fromStrv(actual)) << "Line: '" << line << "'";
+        }
+
+        g_strfreev(expected);
+        g_free(actual);
+    }
+}
+
+TEST_F(ExecParseFuzz, ArgvMatchesReference)
+{
+    std::mt19937 random(1138);
+
+    for (int i = 0; i < 100000; i++)
+    {
+        auto line = randomLine(random, 12);
+        auto uris = randomLine(random, 6);
+
+        GArray* expected = reference_exec_parse(line.c_str(), uris.c_str());
+        GArray* actual = desktop_exec_parse(line.c_str(), uris.c_str());
+
+        ASSERT_EQ(expected != nullptr, actual != nullptr) << "Line: '" << line << "' URIs: '" << uris << "'";
+        if (expected != nullptr)
+        {
+            ASSERT_EQ(fromArray(expected), fromArray(actual)) << "Line: '" << line << "' URIs: '" << uris << "'";
+        }
+    }
+}
+
+TEST_F(ExecParseFuzz, ArgvListMatchesReference)
+{
+    std::mt19937 random(42);
+    std::uniform_int_distribution<int> count(0, 4);
+
+    for (int i = 0; i < 50000; i++)
+    {
+        auto line = randomLine(random, 10);
+
+        /* Lists can have things in them that no quoting would */
+        std::vector<std::string> uris;
+        for (auto j = count(random); j > 0; j--)
+        {
+            uris.emplace_back(randomLine(random, 4));
+        }
+        std::vector<gchar*> urisv;
+        for (auto& uri : uris)
+        {
+            urisv.push_back(&uri[0]);
+        }
+        urisv.push_back(nullptr);
+
+        GArray* expected = reference_exec_parse_list(line.c_str(), urisv.data());
+        gchar** actual = desktop_exec_argv(line.c_str(), urisv.data());
+
+        ASSERT_EQ(expected != nullptr, actual != nullptr) << "Line: '" << line << "'";
+        if (expected != nullptr)
+        {
+            ASSERT_EQ(fromArray(expected), fromStrv(actual)) << "Line: '" << line << "'";
+        }
+
+        g_free(actual);
+    }
+}
+
+TEST_F(ExecParseFuzz, LongLines)
+{
+    /* Past the stack scratch space */
+    std::string line = "foo";
+    for (int i = 0; i < 200; i++)
+    {
+        line += " 'arg " + std::to_string(i) + "' %u";
+    }
+    std::string uris = "'http://ubuntu.com/' 'file:///home/it'\\''s here'";
+
+    auto expected = fromArray(reference_exec_parse(line.c_str(), uris.c_str()));
+    auto actual = fromArray(desktop_exec_parse(line.c_str(), uris.c_str()));
+
+    EXPECT_EQ(401u, actual.size());
+    EXPECT_EQ(expected, actual);
+}
+
+TEST_F(ExecParseFuzz, Benchmark)
+{
+    std::string line = "qmlscene $@ --desktop_file_hint=/usr/share/applications/music-app.desktop %U "
+                       "\"${CLICK_DIR}/app/music-app.qml\"";
+    std::string uris = "'http://ubuntu.com/' 'file:///home/phablet/Music/It'\\''s a song.mp3'";
+    gchar* urisv[] = {(gchar*)"http://ubuntu.com/", (gchar*)"file:///home/phablet/Music/It's a song.mp3", nullptr};
+
+    auto reftime = timeIt(100000, [&line, &uris]() {
+        GArray* array = reference_exec_parse(line.c_str(), uris.c_str());
+        g_strfreev((gchar**)g_array_free(array, FALSE));
+    });
+
+    auto newtime = timeIt(100000, [&line, &urisv]() { g_free(desktop_exec_argv(line.c_str(), urisv)); });
+
+    auto splittime = timeIt(100000, [&line, &uris]() {
+        gchar** split = desktop_exec_split(uris.c_str());
+        g_free(desktop_exec_argv(line.c_str(), split));
+        g_free(split);
+    });
+
+    std::cout << "Exec line parse: g_shell_parse_argv and g_strsplit " << reftime.count() << "ns, single pass "
+              << newtime.count() << "ns, single pass with the URIs split " << splittime.count() << "ns" << std::endl;
+}
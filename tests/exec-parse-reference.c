@@ -0,0 +1,244 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Ted Gould <ted.gould@canonical.com>
+ */
+
+/* The Exec line parser as it was before helpers.c got its single pass
+   one, built on g_shell_parse_argv() and g_strsplit(). The differential
+   tests check that the new one gives the same answers as this does. */
+
+#include <glib.h>
+
+GArray * reference_exec_parse (const gchar * execline, const gchar * urilist);
+GArray * reference_exec_parse_list (const gchar * execline, gchar ** urilist);
+
+/* Convert a URI into a file */
+static gchar *
+reference_uri2file (const gchar * uri)
+{
+	GError * error = NULL;
+	gchar * retval = g_filename_from_uri(uri, NULL, &error);
+
+	if (error != NULL) {
+		g_warning("Unable to resolve '%s' to a filename: %s", uri, error->message);
+		g_error_free(error);
+	}
+
+	if (retval == NULL) {
+		retval = g_strdup("");
+	}
+
+	g_debug("Converting URI '%s' to file '%s'", uri, retval);
+	return retval;
+}
+
+/* Put the list of files into the argument array */
+static inline void
+reference_file_list_handling (GArray * outarray, gchar ** list, gchar * (*dup_func) (const gchar * in))
+{
+	/* No URLs, cool, this is a noop */
+	if (list == NULL || list[0] == NULL) {
+		return;
+	}
+
+	int i;
+	for (i = 0; list[i] != NULL; i++) {
+		gchar * entry = dup_func(list[i]);
+
+		/* No NULLs */
+		if (entry != NULL && entry[0] != '\0') {
+			g_array_append_val(outarray, entry);
+		} else {
+			g_free(entry);
+		}
+	}
+}
+
+/* Parse a desktop exec line and return the next string */
+static void
+reference_exec_segment_parse (GArray * finalarray, const gchar * execsegment, gchar ** uri_list)
+{
+	/* No NULL strings */
+	if (execsegment == NULL || execsegment[0] == '\0')
+		return;
+
+	/* Handle %F and %U as an argument on their own as per the spec */
+	if (g_strcmp0(execsegment, "%U") == 0) {
+		reference_file_list_handling(finalarray, uri_list, g_strdup);
+		return;
+	}
+	if (g_strcmp0(execsegment, "%F") == 0) {
+		reference_file_list_handling(finalarray, uri_list, reference_uri2file);
+		return;
+	}
+
+	/* Start looking at individual codes */
+	gchar ** execsplit = g_strsplit(execsegment, "%", 0);
+
+	/* If we didn't have any codes, just exit here */
+	if (execsplit[1] == NULL) {
+		g_strfreev(execsplit);
+		gchar * dup = g_strdup(execsegment);
+		g_array_append_val(finalarray, dup);
+		return;
+	}
+
+	int i;
+
+	gboolean previous_percent = FALSE;
+	GArray * outarray = g_array_new(TRUE, FALSE, sizeof(const gchar *));
+	g_array_append_val(outarray, execsplit[0]);
+	gchar * single_file = NULL;
+
+	/* The variables allowed in an exec line from the Freedesktop.org Desktop
+	   File specification: http://standards.freedesktop.org/desktop-entry-spec/desktop-entry-spec-latest.html#exec-variables */
+	for (i = 1; execsplit[i] != NULL; i++) {
+		const gchar * skipchar = &(execsplit[i][1]);
+
+		/* Handle the case of %%F printing "%F" */
+		if (previous_percent) {
+			g_array_append_val(outarray, execsplit[i]);
+			previous_percent = FALSE;
+			continue;
+		}
+
+		switch (execsplit[i][0]) {
+		case '\0': {
+			const gchar * percent = "%";
+			g_array_append_val(outarray, percent); /* %% is the literal */
+			previous_percent = TRUE;
+			break;
+		}
+		case 'd':
+		case 'D':
+		case 'n':
+		case 'N':
+		case 'v':
+		case 'm':
+			/* Deprecated */
+			g_array_append_val(outarray, skipchar);
+			break;
+		case 'f':
+			if (uri_list != NULL && uri_list[0] != NULL) {
+				if (single_file == NULL)
+					single_file = reference_uri2file(uri_list[0]);
+				g_array_append_val(outarray, single_file);
+			}
+
+			g_array_append_val(outarray, skipchar);
+			break;
+		case 'F':
+			g_warning("Exec line segment has a '%%F' that isn't its own argument '%s', ignoring.", execsegment);
+			g_array_append_val(outarray, skipchar);
+			break;
+		case 'i':
+		case 'c':
+		case 'k':
+			/* Perhaps?  Not sure anyone uses these */
+			g_array_append_val(outarray, skipchar);
+			break;
+		case 'U':
+			g_warning("Exec line segment has a '%%U' that isn't its own argument '%s', ignoring.", execsegment);
+			g_array_append_val(outarray, skipchar);
+			break;
+		case 'u':
+			if (uri_list != NULL && uri_list[0] != NULL) {
+				g_array_append_val(outarray, uri_list[0]);
+			}
+
+			g_array_append_val(outarray, skipchar);
+			break;
+		default:
+			g_warning("Desktop Exec line code '%%%c' unknown, skipping.", execsplit[i][0]);
+			g_array_append_val(outarray, skipchar);
+			break;
+		}
+	}
+
+	gchar * output = g_strjoinv(NULL, (gchar **)outarray->data);
+	g_array_free(outarray, TRUE);
+
+	if (output != NULL && output[0] != '\0') {
+		g_array_append_val(finalarray, output);
+	} else {
+		g_free(output);
+	}
+
+	g_free(single_file);
+	g_strfreev(execsplit);
+}
+
+/* Take a full exec line, split it out, parse the segments and return
+   it to the caller */
+GArray *
+reference_exec_parse (const gchar * execline, const gchar * urilist)
+{
+	GError * error = NULL;
+	gchar ** splituris = NULL;
+
+	if (urilist != NULL && urilist[0] != '\0') {
+		g_shell_parse_argv(urilist, NULL, &splituris, &error);
+
+		if (error != NULL) {
+			g_warning("Unable to parse URIs '%s': %s", urilist, error->message);
+			g_error_free(error);
+			/* Continuing without URIs */
+			splituris = NULL;
+		}
+	}
+
+	GArray * newargv = reference_exec_parse_list(execline, splituris);
+
+	if (splituris != NULL) {
+		g_strfreev(splituris);
+	}
+
+	return newargv;
+}
+
+/* Same as reference_exec_parse() but with the URIs already split out, like
+   when they come from a URI file */
+GArray *
+reference_exec_parse_list (const gchar * execline, gchar ** urilist)
+{
+	GError * error = NULL;
+	gchar ** splitexec = NULL;
+	gint execitems = 0;
+
+	/* This returns from desktop file style quoting to straight strings with
+	   the appropriate characters split by the spaces that were meant for
+	   splitting.  Trickier than it sounds.  But now we should be able to assume
+	   that each string in the array is expected to be its own parameter. */
+	g_shell_parse_argv(execline, &execitems, &splitexec, &error);
+
+	if (error != NULL) {
+		g_warning("Unable to parse exec line '%s': %s", execline, error->message);
+		g_error_free(error);
+		return NULL;
+	}
+
+	GArray * newargv = g_array_new(TRUE, FALSE, sizeof(gchar *));
+	int i;
+	for (i = 0; i < execitems; i++) {
+		reference_exec_segment_parse(newargv, splitexec[i], urilist);
+	}
+	g_strfreev(splitexec);
+
+	/* Each string here should be its own param */
+
+	return newargv;
+}
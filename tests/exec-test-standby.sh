@@ -0,0 +1,23 @@
+#!/bin/bash -e
+
+if [ "$UBUNTU_APP_LAUNCH_STANDBY" != "" ] ; then
+	echo "Standby flag passed on to the application"
+	exit 1
+fi
+
+if [ "`cat /proc/$$/oom_score_adj`" != "1000" ] ; then
+	echo "Bad OOM score: `cat /proc/$$/oom_score_adj`"
+	exit 1
+fi
+
+if ! chrt -p $$ | grep -q "SCHED_BATCH" ; then
+	echo "Bad scheduling policy: `chrt -p $$`"
+	exit 1
+fi
+
+if ! ionice -p $$ | grep -q "^idle" ; then
+	echo "Bad IO priority: `ionice -p $$`"
+	exit 1
+fi
+
+exit 0
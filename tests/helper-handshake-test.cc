@@ -20,6 +20,8 @@
 #include <gtest/gtest.h>
 #include <glib/gstdio.h>
 #include <gio/gio.h>
+#include <string>
+#include <vector>
 
 extern "C" {
 #include "../helpers.h"
@@ -121,3 +123,58 @@ TEST_F(HelperHandshakeTest, HandshakeTimeout)
 
 	return;
 }
+
+struct notify_data_t {
+	GMainLoop * mainloop;
+	std::vector<std::string> * done;
+	const char * appid;
+};
+
+static void
+handshake_done (gpointer user_data)
+{
+	notify_data_t * data = static_cast<notify_data_t *>(user_data);
+	data->done->push_back(data->appid);
+	if (data->done->size() == 2)
+		g_main_loop_quit(data->mainloop);
+}
+
+TEST_F(HelperHandshakeTest, NotifyHandshakes)
+{
+	GDBusConnection * con = g_bus_get_sync(G_BUS_TYPE_SESSION, NULL, NULL);
+	std::vector<std::string> done;
+
+	/* Two handshakes waiting at once, one gets answered and the other
+	   times out, without either of them blocking */
+	notify_data_t slowdata = {mainloop, &done, "slowapp"};
+	starting_handshake_notify(starting_handshake_start("slowapp", 1), handshake_done, &slowdata);
+
+	notify_data_t foodata = {mainloop, &done, "fooapp"};
+	starting_handshake_notify(starting_handshake_start("fooapp", 1), handshake_done, &foodata);
+
+	EXPECT_TRUE(done.empty());
+
+	g_dbus_connection_emit_signal(con,
+		g_dbus_connection_get_unique_name(con), /* destination */
+		"/", /* path */
+		"com.canonical.UbuntuAppLaunch", /* interface */
+		"UnityStartingSignal", /* signal */
+		g_variant_new("(s)", "fooapp"), /* params, the same */
+		NULL);
+
+	guint outertimeout = g_timeout_add_seconds(2, [](gpointer user_data) -> gboolean {
+		g_main_loop_quit(static_cast<GMainLoop *>(user_data));
+		return G_SOURCE_REMOVE;
+	}, mainloop);
+
+	g_main_loop_run(mainloop);
+
+	ASSERT_EQ(2u, done.size());
+	EXPECT_EQ("fooapp", done[0]);
+	EXPECT_EQ("slowapp", done[1]);
+
+	g_source_remove(outertimeout);
+	g_object_unref(con);
+
+	return;
+}
@@ -235,6 +235,70 @@ TEST_F(HelperTest, DesktopExecParse)
 	return;
 }
 
+TEST_F(HelperTest, DesktopExecParseList)
+{
+	GArray * output;
+
+	/* No URLs */
+	output = desktop_exec_parse_list("foo %U", NULL);
+	ASSERT_EQ(output->len, 1);
+	ASSERT_STREQ(g_array_index(output, gchar *, 0), "foo");
+	g_array_free(output, TRUE);
+
+	/* URLs that would need quoting, they're passed as they are */
+	const gchar * urls[] = { "http://ubuntu.com", "file:///home/it's a \"file\"", "", NULL };
+	output = desktop_exec_parse_list("foo %U", (gchar **)urls);
+	ASSERT_EQ(output->len, 4);
+	ASSERT_STREQ(g_array_index(output, gchar *, 0), "foo");
+	ASSERT_STREQ(g_array_index(output, gchar *, 1), "http://ubuntu.com");
+	ASSERT_STREQ(g_array_index(output, gchar *, 2), "file:///home/it's a \"file\"");
+	ASSERT_STREQ(g_array_index(output, gchar *, 3), "");
+	g_array_free(output, TRUE);
+
+	return;
+}
+
+TEST_F(HelperTest, UriFile)
+{
+	const gchar * urls[] = { "http://ubuntu.com", "file:///home/it's a \"file\"", "", "scope://ünïcødé", NULL };
+
+	gchar * path = uri_file_write(CMAKE_BINARY_DIR, (gchar **)urls);
+	ASSERT_NE(nullptr, path);
+
+	/* Only for us */
+	GStatBuf info;
+	ASSERT_EQ(0, g_stat(path, &info));
+	EXPECT_EQ(0600, info.st_mode & 0777);
+
+	gchar ** read = uri_file_read(path);
+	ASSERT_NE(nullptr, read);
+	ASSERT_EQ(4, g_strv_length(read));
+	for (int i = 0; urls[i] != NULL; i++) {
+		EXPECT_STREQ(urls[i], read[i]);
+	}
+	g_strfreev(read);
+
+	/* Cut off in the middle of the last one */
+	gchar * contents = NULL;
+	gsize length = 0;
+	ASSERT_TRUE(g_file_get_contents(path, &contents, &length, NULL));
+	ASSERT_TRUE(g_file_set_contents(path, contents, length - 2, NULL));
+	g_free(contents);
+
+	read = uri_file_read(path);
+	ASSERT_NE(nullptr, read);
+	EXPECT_EQ(3, g_strv_length(read));
+	g_strfreev(read);
+
+	g_unlink(path);
+	g_free(path);
+
+	/* Gone */
+	EXPECT_EQ(nullptr, uri_file_read(CMAKE_BINARY_DIR "/uris-not-there"));
+
+	return;
+}
+
 TEST_F(HelperTest, KeyfileForAppid)
 {
 	GKeyFile * keyfile = NULL;
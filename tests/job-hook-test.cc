@@ -0,0 +1,197 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Ted Gould <ted.gould@canonical.com>
+ */
+
+#include <gio/gio.h>
+#include <glib/gstdio.h>
+#include <gtest/gtest.h>
+#include <libdbustest/dbus-test.h>
+#include <string>
+
+#include "eventually-fixture.h"
+
+class JobHook : public EventuallyFixture
+{
+protected:
+    DbusTestService* service = nullptr;
+    DbusTestDbusMock* zgmock = nullptr;
+    DbusTestDbusMockObject* zgobj = nullptr;
+    DbusTestDbusMock* propmock = nullptr;
+    DbusTestDbusMockObject* propobj = nullptr;
+    GDBusConnection* bus = nullptr;
+    gchar* tmpdir = nullptr;
+
+    virtual void SetUp()
+    {
+        tmpdir = g_dir_make_tmp("job-hook-test-XXXXXX", nullptr);
+        ASSERT_NE(nullptr, tmpdir);
+
+        gchar* runtimedir = g_build_filename(tmpdir, "runtime", nullptr);
+        gchar* logdir = g_build_filename(tmpdir, "cache", "upstart", nullptr);
+        g_mkdir_with_parents(runtimedir, 0700);
+        g_mkdir_with_parents(logdir, 0700);
+        g_free(logdir);
+
+        g_setenv("XDG_RUNTIME_DIR", runtimedir, TRUE);
+        g_free(runtimedir);
+        gchar* cachedir = g_build_filename(tmpdir, "cache", nullptr);
+        g_setenv("XDG_CACHE_HOME", cachedir, TRUE);
+        g_free(cachedir);
+
+        g_setenv("APP_ID", "com.test.good_application_1.2.3", TRUE);
+        g_setenv("UPSTART_JOB", "application-click", TRUE);
+        g_setenv("UPSTART_INSTANCE", "com.test.good_application_1.2.3", TRUE);
+        g_unsetenv("APP_URIS_FILE");
+        g_unsetenv("APP_EXEC_PLAN");
+
+        service = dbus_test_service_new(nullptr);
+
+        zgmock = dbus_test_dbus_mock_new("org.gnome.zeitgeist.Engine");
+        zgobj = dbus_test_dbus_mock_get_object(zgmock, "/org/gnome/zeitgeist/log/activity", "org.gnome.zeitgeist.Log",
+                                               nullptr);
+        dbus_test_dbus_mock_object_add_method(zgmock, zgobj, "InsertEvents", G_VARIANT_TYPE("a(asaasay)"),
+                                              G_VARIANT_TYPE("au"), "ret = [ 0 ]", nullptr);
+        dbus_test_service_add_task(service, DBUS_TEST_TASK(zgmock));
+
+        /* Nothing in the cgroup, that's tested with cgroup-reap-all */
+        auto cgmock = dbus_test_dbus_mock_new("org.test.cgmock");
+        auto cgobj = dbus_test_dbus_mock_get_object(cgmock, "/org/linuxcontainers/cgmanager",
+                                                    "org.linuxcontainers.cgmanager0_0", nullptr);
+        dbus_test_dbus_mock_object_add_method(cgmock, cgobj, "GetTasksRecursive", G_VARIANT_TYPE("(ss)"),
+                                              G_VARIANT_TYPE("ai"), "ret = [ ]", nullptr);
+        dbus_test_service_add_task(service, DBUS_TEST_TASK(cgmock));
+        g_object_unref(cgmock);
+        g_setenv("UBUNTU_APP_LAUNCH_CG_MANAGER_NAME", "org.test.cgmock", TRUE);
+        g_setenv("UBUNTU_APP_LAUNCH_CG_MANAGER_SESSION_BUS", "YES", TRUE);
+
+        propmock = dbus_test_dbus_mock_new("com.canonical.PropertyService");
+        propobj = dbus_test_dbus_mock_get_object(propmock, "/com/canonical/PropertyService",
+                                                 "com.canonical.PropertyService", nullptr);
+        dbus_test_dbus_mock_object_add_method(propmock, propobj, "GetProperty", G_VARIANT_TYPE_STRING,
+                                              G_VARIANT_TYPE_BOOLEAN, "ret = False", nullptr);
+        dbus_test_service_add_task(service, DBUS_TEST_TASK(propmock));
+        g_setenv("UBUNTU_APP_LAUNCH_PROPERTY_SERVICE_SESSION_BUS", "YES", TRUE);
+
+        dbus_test_service_start_tasks(service);
+
+        bus = g_bus_get_sync(G_BUS_TYPE_SESSION, nullptr, nullptr);
+        g_dbus_connection_set_exit_on_close(bus, FALSE);
+        g_object_add_weak_pointer(G_OBJECT(bus), (gpointer*)&bus);
+    }
+
+    virtual void TearDown()
+    {
+        g_clear_object(&zgmock);
+        g_clear_object(&propmock);
+        g_clear_object(&service);
+
+        g_object_unref(bus);
+        ASSERT_EVENTUALLY_EQ(nullptr, bus);
+
+        gchar* rm = g_strdup_printf("rm -rf '%s'", tmpdir);
+        ASSERT_TRUE(g_spawn_command_line_sync(rm, nullptr, nullptr, nullptr, nullptr));
+        g_free(rm);
+        g_free(tmpdir);
+    }
+
+    /* Runs the hook and waits for it to finish */
+    void runHook(const char* hook)
+    {
+        const gchar* argv[] = {JOB_HOOK_TOOL, hook, nullptr};
+        gint status = -1;
+        ASSERT_TRUE(g_spawn_sync(nullptr, (gchar**)argv, nullptr, G_SPAWN_DEFAULT, nullptr, nullptr, nullptr,
+                                 nullptr, &status, nullptr));
+        EXPECT_TRUE(g_spawn_check_exit_status(status, nullptr));
+    }
+
+    std::string inTmp(const std::string& path)
+    {
+        return std::string{tmpdir} + "/" + path;
+    }
+
+    void touch(const std::string& path)
+    {
+        ASSERT_TRUE(g_file_set_contents(path.c_str(), "", 0, nullptr));
+    }
+
+    guint calls(DbusTestDbusMock* mock, DbusTestDbusMockObject* obj, const char* method)
+    {
+        guint numcalls = 0;
+        dbus_test_dbus_mock_object_get_method_calls(mock, obj, method, &numcalls, nullptr);
+        return numcalls;
+    }
+};
+
+TEST_F(JobHook, PostStart)
+{
+    runHook("post-start");
+
+    EXPECT_EQ(1u, calls(zgmock, zgobj, "InsertEvents"));
+    EXPECT_EQ(0u, calls(propmock, propobj, "GetProperty"));
+}
+
+TEST_F(JobHook, PostStop)
+{
+    auto log = inTmp("cache/upstart/application-click-com.test.good_application_1.2.3.log");
+    auto rotated = log + ".1.gz";
+    auto otherlog = inTmp("cache/upstart/application-click-com.test.other_application_1.2.3.log");
+    auto urifile = inTmp("uris-test");
+    auto planfile = inTmp("plan-test");
+    touch(log);
+    touch(rotated);
+    touch(otherlog);
+    touch(urifile);
+    touch(planfile);
+    g_setenv("APP_URIS_FILE", urifile.c_str(), TRUE);
+    g_setenv("APP_EXEC_PLAN", planfile.c_str(), TRUE);
+
+    runHook("post-stop");
+
+    EXPECT_EQ(1u, calls(zgmock, zgobj, "InsertEvents"));
+    EXPECT_EQ(1u, calls(propmock, propobj, "GetProperty"));
+
+    EXPECT_FALSE(g_file_test(log.c_str(), G_FILE_TEST_EXISTS));
+    EXPECT_FALSE(g_file_test(rotated.c_str(), G_FILE_TEST_EXISTS));
+    EXPECT_TRUE(g_file_test(otherlog.c_str(), G_FILE_TEST_EXISTS));
+    EXPECT_FALSE(g_file_test(urifile.c_str(), G_FILE_TEST_EXISTS));
+    EXPECT_FALSE(g_file_test(planfile.c_str(), G_FILE_TEST_EXISTS));
+}
+
+TEST_F(JobHook, DeveloperModeCached)
+{
+    auto log = inTmp("cache/upstart/application-click-com.test.good_application_1.2.3.log");
+
+    /* The first one asks and remembers */
+    touch(log);
+    runHook("post-stop");
+    EXPECT_EQ(1u, calls(propmock, propobj, "GetProperty"));
+    EXPECT_FALSE(g_file_test(log.c_str(), G_FILE_TEST_EXISTS));
+
+    gchar* cached = nullptr;
+    ASSERT_TRUE(
+        g_file_get_contents(inTmp("runtime/ubuntu-app-launch/developer-mode").c_str(), &cached, nullptr, nullptr));
+    EXPECT_STREQ("false", cached);
+    g_free(cached);
+
+    /* The next one believes the cache */
+    ASSERT_TRUE(g_file_set_contents(inTmp("runtime/ubuntu-app-launch/developer-mode").c_str(), "true", -1, nullptr));
+    touch(log);
+    runHook("post-stop");
+    EXPECT_EQ(1u, calls(propmock, propobj, "GetProperty"));
+    EXPECT_TRUE(g_file_test(log.c_str(), G_FILE_TEST_EXISTS));
+}
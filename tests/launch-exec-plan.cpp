@@ -0,0 +1,196 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Ted Gould <ted.gould@canonical.com>
+ */
+
+#include "launch-exec-plan.h"
+#include <chrono>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gtest/gtest.h>
+#include <iostream>
+
+extern "C" {
+#include "exec-plan.h"
+#include "helpers.h"
+}
+
+using namespace ubuntu::app_launch;
+
+#define PLAN_TEMP_DIR CMAKE_BINARY_DIR "/launch-exec-plan-temp"
+
+class LaunchExecPlan : public ::testing::Test
+{
+protected:
+    virtual void SetUp()
+    {
+        g_spawn_command_line_sync("rm -rf " PLAN_TEMP_DIR, NULL, NULL, NULL, NULL);
+        ASSERT_EQ(0, g_mkdir_with_parents(PLAN_TEMP_DIR "/lib/test-arch/bin", 0700));
+        ASSERT_EQ(0, g_mkdir_with_parents(PLAN_TEMP_DIR "/bin", 0700));
+
+        makeExecutable(PLAN_TEMP_DIR "/app");
+        makeExecutable(PLAN_TEMP_DIR "/bin/subapp");
+        makeExecutable(PLAN_TEMP_DIR "/lib/test-arch/bin/archapp");
+        ASSERT_TRUE(g_file_set_contents(PLAN_TEMP_DIR "/notexec", "data", -1, nullptr));
+    }
+
+    virtual void TearDown()
+    {
+        g_spawn_command_line_sync("rm -rf " PLAN_TEMP_DIR, NULL, NULL, NULL, NULL);
+    }
+
+    void makeExecutable(const gchar* path)
+    {
+        ASSERT_TRUE(g_file_set_contents(path, "#!/bin/sh\n", -1, nullptr));
+        ASSERT_EQ(0, g_chmod(path, 0755));
+    }
+
+    /* What exec-line-exec gets without a plan */
+    std::vector<std::string> parsed(const std::string& exec, const std::string& uris)
+    {
+        GArray* array = desktop_exec_parse(exec.c_str(), uris.c_str());
+        std::vector<std::string> args;
+        for (guint i = 0; i < array->len; i++)
+        {
+            args.emplace_back(g_array_index(array, gchar*, i));
+        }
+        g_strfreev((gchar**)g_array_free(array, FALSE));
+        return args;
+    }
+};
+
+TEST_F(LaunchExecPlan, ArgumentsMatchParse)
+{
+    std::vector<Application::URL> urls{Application::URL::from_raw("http://ubuntu.com/"),
+                                       Application::URL::from_raw("file:///home/it's here")};
+    auto uris = "'http://ubuntu.com/' 'file:///home/it'\\''s here'";
+
+    for (auto exec : {"app", "app %u", "app %U --flag", "app %F", "app --file=%f", "'quoted app' %%u", "app %d %k"})
+    {
+        EXPECT_EQ(parsed(exec, uris), exec_plan::arguments(exec, urls)) << exec;
+        EXPECT_EQ(parsed(exec, ""), exec_plan::arguments(exec, {})) << exec;
+    }
+
+    /* Bad quoting */
+    EXPECT_TRUE(exec_plan::arguments("app 'unterminated", urls).empty());
+}
+
+TEST_F(LaunchExecPlan, Binary)
+{
+    EXPECT_EQ(PLAN_TEMP_DIR "/lib/test-arch/bin/archapp", exec_plan::binary("archapp", PLAN_TEMP_DIR, "test-arch"));
+    EXPECT_EQ(PLAN_TEMP_DIR "/app", exec_plan::binary("app", PLAN_TEMP_DIR, "test-arch"));
+    EXPECT_EQ(PLAN_TEMP_DIR "/bin/subapp", exec_plan::binary("bin/subapp", PLAN_TEMP_DIR, "test-arch"));
+
+    /* Left for the PATH */
+    EXPECT_EQ("archapp", exec_plan::binary("archapp", PLAN_TEMP_DIR, ""));
+    EXPECT_EQ("notexec", exec_plan::binary("notexec", PLAN_TEMP_DIR, "test-arch"));
+    EXPECT_EQ("sh", exec_plan::binary("sh", PLAN_TEMP_DIR, "test-arch"));
+    EXPECT_EQ("app", exec_plan::binary("app", "", "test-arch"));
+    EXPECT_EQ("app", exec_plan::binary("app", PLAN_TEMP_DIR ":bad", "test-arch"));
+    EXPECT_EQ("/bin/sh", exec_plan::binary("/bin/sh", PLAN_TEMP_DIR, "test-arch"));
+}
+
+TEST_F(LaunchExecPlan, RoundTrip)
+{
+    std::vector<Application::URL> urls{Application::URL::from_raw("http://ubuntu.com/")};
+    auto plan = exec_plan::build("archapp --flag %u", PLAN_TEMP_DIR, "test-arch", urls);
+    ASSERT_FALSE(plan.empty());
+
+    auto path = exec_plan::write(PLAN_TEMP_DIR, plan);
+    ASSERT_FALSE(path.empty());
+
+    exec_plan_t mapped;
+    ASSERT_EQ(0, exec_plan_map(path.c_str(), &mapped));
+    EXPECT_STREQ(PLAN_TEMP_DIR "/lib/test-arch/bin/archapp", mapped.binary);
+    EXPECT_STREQ(PLAN_TEMP_DIR "/lib/test-arch/bin:" PLAN_TEMP_DIR, mapped.path_prefix);
+    EXPECT_STREQ(PLAN_TEMP_DIR "/lib/test-arch:" PLAN_TEMP_DIR "/lib", mapped.lib_prefix);
+    EXPECT_STREQ(PLAN_TEMP_DIR "/lib/test-arch", mapped.import_suffix);
+    ASSERT_EQ(3u, mapped.argc);
+    EXPECT_STREQ("archapp", mapped.argv[0]);
+    EXPECT_STREQ("--flag", mapped.argv[1]);
+    EXPECT_STREQ("http://ubuntu.com/", mapped.argv[2]);
+    EXPECT_EQ(nullptr, mapped.argv[3]);
+    exec_plan_unmap(&mapped);
+
+    /* No application directory, nothing to put in the paths */
+    plan = exec_plan::build("sh -c true", "", "test-arch", {});
+    path = exec_plan::write(PLAN_TEMP_DIR, plan);
+    ASSERT_EQ(0, exec_plan_map(path.c_str(), &mapped));
+    EXPECT_STREQ("sh", mapped.binary);
+    EXPECT_STREQ("", mapped.path_prefix);
+    EXPECT_STREQ("", mapped.lib_prefix);
+    EXPECT_STREQ("", mapped.import_suffix);
+    EXPECT_EQ(3u, mapped.argc);
+    exec_plan_unmap(&mapped);
+
+    EXPECT_TRUE(exec_plan::build("", PLAN_TEMP_DIR, "test-arch", {}).empty());
+}
+
+TEST_F(LaunchExecPlan, Invalid)
+{
+    exec_plan_t mapped;
+    EXPECT_EQ(-1, exec_plan_map(PLAN_TEMP_DIR "/not-there", &mapped));
+
+    auto plan = exec_plan::build("app --flag", PLAN_TEMP_DIR, "test-arch", {});
+
+    /* Cut off in the middle of the arguments */
+    auto path = exec_plan::write(PLAN_TEMP_DIR, plan.substr(0, plan.size() - 3));
+    EXPECT_EQ(-1, exec_plan_map(path.c_str(), &mapped));
+    EXPECT_EQ(nullptr, mapped.map);
+
+    /* Not a plan */
+    path = exec_plan::write(PLAN_TEMP_DIR, std::string("XXXX") + plan.substr(4));
+    EXPECT_EQ(-1, exec_plan_map(path.c_str(), &mapped));
+
+    path = exec_plan::write(PLAN_TEMP_DIR, "");
+    EXPECT_EQ(-1, exec_plan_map(path.c_str(), &mapped));
+}
+
+TEST_F(LaunchExecPlan, BenchmarkExecLineWork)
+{
+    std::string exec = "qmlscene $@ --flag %U ${CLICK_DIR}/app/music-app.qml";
+    std::string uris = "'http://ubuntu.com/' 'file:///home/phablet/Music/It'\\''s a song.mp3'";
+    auto plan = exec_plan::build(exec, PLAN_TEMP_DIR, "test-arch",
+                                 {Application::URL::from_raw("http://ubuntu.com/"),
+                                  Application::URL::from_raw("file:///home/phablet/Music/It's a song.mp3")});
+    auto path = exec_plan::write(PLAN_TEMP_DIR, plan);
+
+    const int iterations = 10000;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++)
+    {
+        GArray* array = desktop_exec_parse(exec.c_str(), uris.c_str());
+        g_strfreev((gchar**)g_array_free(array, FALSE));
+    }
+    auto parsetime = std::chrono::steady_clock::now() - start;
+
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++)
+    {
+        exec_plan_t mapped;
+        ASSERT_EQ(0, exec_plan_map(path.c_str(), &mapped));
+        exec_plan_unmap(&mapped);
+    }
+    auto maptime = std::chrono::steady_clock::now() - start;
+
+    std::cout << "Exec line parse "
+              << std::chrono::duration_cast<std::chrono::nanoseconds>(parsetime).count() / iterations
+              << "ns, exec plan map "
+              << std::chrono::duration_cast<std::chrono::nanoseconds>(maptime).count() / iterations << "ns"
+              << std::endl;
+}
@@ -0,0 +1,134 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Ted Gould <ted.gould@canonical.com>
+ */
+
+#include "launch-exec-plan.h"
+#include "launch-readahead.h"
+#include <algorithm>
+#include <cstring>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gtest/gtest.h>
+
+using namespace ubuntu::app_launch;
+
+#define READAHEAD_TEMP_DIR CMAKE_BINARY_DIR "/launch-readahead-temp"
+
+class LaunchReadahead : public ::testing::Test
+{
+protected:
+    virtual void SetUp()
+    {
+        g_spawn_command_line_sync("rm -rf " READAHEAD_TEMP_DIR, NULL, NULL, NULL, NULL);
+        ASSERT_EQ(0, g_mkdir_with_parents(READAHEAD_TEMP_DIR "/lib/test-arch/bin", 0700));
+        ASSERT_EQ(0, g_mkdir_with_parents(READAHEAD_TEMP_DIR "/lib/test-arch/qml/Plugin", 0700));
+
+        ASSERT_TRUE(g_file_set_contents(READAHEAD_TEMP_DIR "/app", "binary", -1, nullptr));
+        ASSERT_EQ(0, g_chmod(READAHEAD_TEMP_DIR "/app", 0700));
+        ASSERT_TRUE(g_file_set_contents(READAHEAD_TEMP_DIR "/lib/test-arch/bin/archapp", "binary", -1, nullptr));
+        ASSERT_EQ(0, g_chmod(READAHEAD_TEMP_DIR "/lib/test-arch/bin/archapp", 0700));
+        ASSERT_TRUE(g_file_set_contents(READAHEAD_TEMP_DIR "/notexec", "binary", -1, nullptr));
+        ASSERT_TRUE(g_file_set_contents(READAHEAD_TEMP_DIR "/lib/libfoo.so", "library", -1, nullptr));
+        ASSERT_TRUE(g_file_set_contents(READAHEAD_TEMP_DIR "/lib/test-arch/libbar.so.1", "library", -1, nullptr));
+        ASSERT_TRUE(
+            g_file_set_contents(READAHEAD_TEMP_DIR "/lib/test-arch/qml/Plugin/libplugin.so", "library", -1, nullptr));
+        ASSERT_TRUE(g_file_set_contents(READAHEAD_TEMP_DIR "/lib/test-arch/qml/Plugin/qmldir", "text", -1, nullptr));
+    }
+
+    virtual void TearDown()
+    {
+        g_spawn_command_line_sync("rm -rf " READAHEAD_TEMP_DIR, NULL, NULL, NULL, NULL);
+    }
+
+    bool contains(const std::list<std::string>& files, const std::string& file)
+    {
+        return std::find(files.begin(), files.end(), file) != files.end();
+    }
+};
+
+TEST_F(LaunchReadahead, FindsProgramAndLibraries)
+{
+    auto files = readahead::files("app --flag %u", READAHEAD_TEMP_DIR, "test-arch");
+
+    ASSERT_EQ(4u, files.size());
+    EXPECT_EQ(READAHEAD_TEMP_DIR "/app", files.front());
+    EXPECT_TRUE(contains(files, READAHEAD_TEMP_DIR "/lib/libfoo.so"));
+    EXPECT_TRUE(contains(files, READAHEAD_TEMP_DIR "/lib/test-arch/libbar.so.1"));
+    EXPECT_TRUE(contains(files, READAHEAD_TEMP_DIR "/lib/test-arch/qml/Plugin/libplugin.so"));
+}
+
+TEST_F(LaunchReadahead, ArchDirectoryFirst)
+{
+    auto files = readahead::files("archapp", READAHEAD_TEMP_DIR, "test-arch");
+    ASSERT_FALSE(files.empty());
+    EXPECT_EQ(READAHEAD_TEMP_DIR "/lib/test-arch/bin/archapp", files.front());
+
+    /* Not found without the arch */
+    files = readahead::files("archapp", READAHEAD_TEMP_DIR, "");
+    EXPECT_FALSE(contains(files, READAHEAD_TEMP_DIR "/lib/test-arch/bin/archapp"));
+}
+
+TEST_F(LaunchReadahead, SameProgramAsExecPlan)
+{
+    /* exec-line-exec can't run it, so it isn't the one that's started */
+    auto files = readahead::files("notexec", READAHEAD_TEMP_DIR, "test-arch");
+    EXPECT_FALSE(contains(files, READAHEAD_TEMP_DIR "/notexec"));
+
+    for (auto exec : {"app --flag %u", "archapp", "\"app\" %F", "sh -c true"})
+    {
+        auto args = exec_plan::arguments(exec, {});
+        ASSERT_FALSE(args.empty());
+
+        auto binary = exec_plan::binary(args[0], READAHEAD_TEMP_DIR, "test-arch");
+        files = readahead::files(exec, READAHEAD_TEMP_DIR, "test-arch");
+        ASSERT_FALSE(files.empty());
+
+        if (g_path_is_absolute(binary.c_str()))
+        {
+            EXPECT_EQ(binary, files.front());
+        }
+        else
+        {
+            EXPECT_TRUE(g_str_has_suffix(files.front().c_str(), ("/" + binary).c_str()));
+        }
+    }
+}
+
+TEST_F(LaunchReadahead, AbsoluteAndPathPrograms)
+{
+    auto files = readahead::files("'" READAHEAD_TEMP_DIR "/app' %U", "", "");
+    ASSERT_EQ(1u, files.size());
+    EXPECT_EQ(READAHEAD_TEMP_DIR "/app", files.front());
+
+    files = readahead::files("sh -c true", "", "");
+    ASSERT_EQ(1u, files.size());
+    EXPECT_TRUE(g_str_has_suffix(files.front().c_str(), "/sh"));
+
+    EXPECT_TRUE(readahead::files("not-a-program-anywhere", "", "").empty());
+    EXPECT_TRUE(readahead::files("", "", "").empty());
+}
+
+TEST_F(LaunchReadahead, WillNeed)
+{
+    int count = -1;
+    auto bytes = readahead::willNeed(
+        {READAHEAD_TEMP_DIR "/app", READAHEAD_TEMP_DIR "/not-there", READAHEAD_TEMP_DIR "/lib/libfoo.so"}, count);
+
+    EXPECT_EQ(2, count);
+    EXPECT_EQ(std::int64_t(strlen("binary") + strlen("library")), bytes);
+}
@@ -18,12 +18,15 @@
  */
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <fcntl.h>
 #include <functional>
 #include <future>
 #include <gio/gio.h>
 #include <glib/gstdio.h>
 #include <gtest/gtest.h>
+#include <iostream>
 #include <libdbustest/dbus-test.h>
 #include <numeric>
 #include <thread>
@@ -356,6 +359,15 @@ protected:
 
         return found;
     }
+
+    /* Start is sent once the handshake with Unity is done, which is after
+       the launch returns, so tests need to wait for it */
+    guint startCalls(DbusTestDbusMockObject* obj)
+    {
+        guint len = 0;
+        dbus_test_dbus_mock_object_get_method_calls(mock, obj, "Start", &len, NULL);
+        return len;
+    }
 };
 
 TEST_F(LibUAL, StartClickApplication)
@@ -368,12 +380,13 @@ TEST_F(LibUAL, StartClickApplication)
     auto app = ubuntu::app_launch::Application::create(appid, registry);
     app->launch();
 
-    EXPECT_EQ(1, dbus_test_dbus_mock_object_check_method_call(mock, obj, "Start", NULL, NULL));
+    EXPECT_EVENTUALLY_FUNC_EQ(guint(1), [&]() { return startCalls(obj); });
 
     ASSERT_TRUE(dbus_test_dbus_mock_object_clear_method_calls(mock, obj, NULL));
 
     /* Now look at the details of the call */
     app->launch();
+    EXPECT_EVENTUALLY_FUNC_EQ(guint(1), [&]() { return startCalls(obj); });
 
     guint len = 0;
     const DbusTestDbusMockCall* calls = dbus_test_dbus_mock_object_get_method_calls(mock, obj, "Start", &len, NULL);
@@ -400,6 +413,7 @@ TEST_F(LibUAL, StartClickApplication)
         ubuntu::app_launch::Application::URL::from_raw("file:///home/phablet/test.txt")};
 
     app->launch(urls);
+    EXPECT_EVENTUALLY_FUNC_EQ(guint(1), [&]() { return startCalls(obj); });
 
     len = 0;
     calls = dbus_test_dbus_mock_object_get_method_calls(mock, obj, "Start", &len, NULL);
@@ -415,6 +429,23 @@ TEST_F(LibUAL, StartClickApplication)
     return;
 }
 
+TEST_F(LibUAL, StartWhenRegistryGoes)
+{
+    DbusTestDbusMockObject* obj =
+        dbus_test_dbus_mock_get_object(mock, "/com/test/application_click", "com.ubuntu.Upstart0_6.Job", NULL);
+
+    /* Nothing answers the handshake, so the launch is still waiting on
+       it when the registry goes */
+    auto appid = ubuntu::app_launch::AppID::parse("com.test.multiple_first_1.2.3");
+    auto app = ubuntu::app_launch::Application::create(appid, registry);
+    app->launch();
+
+    app.reset();
+    registry.reset();
+
+    EXPECT_EQ(guint(1), startCalls(obj));
+}
+
 TEST_F(LibUAL, StartClickApplicationTest)
 {
     DbusTestDbusMockObject* obj =
@@ -424,6 +455,7 @@ TEST_F(LibUAL, StartClickApplicationTest)
     auto appid = ubuntu::app_launch::AppID::parse("com.test.multiple_first_1.2.3");
     auto app = ubuntu::app_launch::Application::create(appid, registry);
     app->launchTest();
+    EXPECT_EVENTUALLY_FUNC_EQ(guint(1), [&]() { return startCalls(obj); });
 
     guint len = 0;
     const DbusTestDbusMockCall* calls = dbus_test_dbus_mock_object_get_method_calls(mock, obj, "Start", &len, NULL);
@@ -503,12 +535,13 @@ TEST_F(LibUAL, StartSnapApplication)
     auto app = ubuntu::app_launch::Application::create(appid, registry);
     app->launch();
 
-    EXPECT_EQ(1, dbus_test_dbus_mock_object_check_method_call(mock, obj, "Start", NULL, NULL));
+    EXPECT_EVENTUALLY_FUNC_EQ(guint(1), [&]() { return startCalls(obj); });
 
     ASSERT_TRUE(dbus_test_dbus_mock_object_clear_method_calls(mock, obj, NULL));
 
     /* Now look at the details of the call */
     app->launch();
+    EXPECT_EVENTUALLY_FUNC_EQ(guint(1), [&]() { return startCalls(obj); });
 
     guint len = 0;
     const DbusTestDbusMockCall* calls = dbus_test_dbus_mock_object_get_method_calls(mock, obj, "Start", &len, NULL);
@@ -535,6 +568,7 @@ TEST_F(LibUAL, StartSnapApplication)
         ubuntu::app_launch::Application::URL::from_raw("file:///home/phablet/test.txt")};
 
     app->launch(urls);
+    EXPECT_EVENTUALLY_FUNC_EQ(guint(1), [&]() { return startCalls(obj); });
 
     len = 0;
     calls = dbus_test_dbus_mock_object_get_method_calls(mock, obj, "Start", &len, NULL);
@@ -561,6 +595,7 @@ TEST_F(LibUAL, StartSnapApplicationTest)
     auto appid = ubuntu::app_launch::AppID::parse("unity8-package_single_x123");
     auto app = ubuntu::app_launch::Application::create(appid, registry);
     app->launchTest();
+    EXPECT_EVENTUALLY_FUNC_EQ(guint(1), [&]() { return startCalls(obj); });
 
     guint len = 0;
     auto calls = dbus_test_dbus_mock_object_get_method_calls(mock, obj, "Start", &len, NULL);
@@ -1006,6 +1041,124 @@ TEST_F(LibUAL, UrlSendTest)
     g_object_unref(session);
 }
 
+/* Written by the filter on the GDBus worker thread */
+typedef struct
+{
+    std::atomic<guint> opens;
+    std::atomic<guint> listnames;
+    std::atomic<guint> pidqueries;
+} url_send_counts_t;
+
+static void url_send_counts_reset(url_send_counts_t& counts)
+{
+    counts.opens = 0;
+    counts.listnames = 0;
+    counts.pidqueries = 0;
+}
+
+GDBusMessage* filter_func_count(GDBusConnection* conn, GDBusMessage* message, gboolean incomming, gpointer user_data)
+{
+    auto counts = static_cast<url_send_counts_t*>(user_data);
+
+    if (!incomming)
+    {
+        if (g_strcmp0(g_dbus_message_get_member(message), "ListNames") == 0)
+        {
+            counts->listnames++;
+        }
+        if (g_strcmp0(g_dbus_message_get_member(message), "GetConnectionUnixProcessID") == 0)
+        {
+            counts->pidqueries++;
+        }
+        if (g_strcmp0(g_dbus_message_get_member(message), "UnityResumeRequest") == 0)
+        {
+            /* Answer right away like Unity would, so that we're timing
+               the lookup and not the wait for Unity */
+            g_dbus_connection_emit_signal(conn, NULL,                                 /* destination */
+                                          "/",                                        /* path */
+                                          "com.canonical.UbuntuAppLaunch",            /* interface */
+                                          "UnityResumeResponse",                      /* signal */
+                                          g_dbus_message_get_body(message), NULL); /* params, the same */
+        }
+        return message;
+    }
+
+    if (g_strcmp0(g_dbus_message_get_path(message), "/com_2etest_2egood_5fapplication_5f1_2e2_2e3") == 0)
+    {
+        counts->opens++;
+        GDBusMessage* reply = g_dbus_message_new_method_reply(message);
+        g_dbus_connection_send_message(conn, reply, G_DBUS_SEND_MESSAGE_FLAGS_NONE, NULL, NULL);
+        g_object_unref(reply);
+        g_object_unref(message);
+        return NULL;
+    }
+
+    return message;
+}
+
+TEST_F(LibUAL, UrlSendNamesTracked)
+{
+    /* Lots of other clients on the bus */
+    std::vector<GDBusConnection*> others;
+    gchar* address = g_dbus_address_get_for_bus_sync(G_BUS_TYPE_SESSION, NULL, NULL);
+    for (int i = 0; i < 50; i++)
+    {
+        others.push_back(g_dbus_connection_new_for_address_sync(
+            address,
+            (GDBusConnectionFlags)(G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT |
+                                   G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION),
+            NULL, NULL, NULL));
+    }
+    g_free(address);
+
+    url_send_counts_t counts;
+    url_send_counts_reset(counts);
+    GDBusConnection* session = g_bus_get_sync(G_BUS_TYPE_SESSION, NULL, NULL);
+    guint filter = g_dbus_connection_add_filter(session, filter_func_count, &counts, NULL);
+
+    auto appid = ubuntu::app_launch::AppID::parse("com.test.good_application_1.2.3");
+    auto app = ubuntu::app_launch::Application::create(appid, registry);
+    std::vector<ubuntu::app_launch::Application::URL> uris = {
+        ubuntu::app_launch::Application::URL::from_raw("http://www.test.com")};
+
+    /* The first one learns who is on the bus */
+    app->launch(uris);
+    EXPECT_EVENTUALLY_EQ("com.test.good_application_1.2.3", this->last_focus_appid);
+    EXPECT_EVENTUALLY_FUNC_EQ(1u, [&counts]() { return counts.opens.load(); });
+    EXPECT_EQ(1u, counts.listnames.load());
+    EXPECT_LT(50u, counts.pidqueries.load());
+
+    /* After that the app's connections are already known */
+    url_send_counts_reset(counts);
+    this->last_focus_appid.clear();
+
+    auto start = std::chrono::steady_clock::now();
+    app->launch(uris);
+    EXPECT_EVENTUALLY_EQ("com.test.good_application_1.2.3", this->last_focus_appid);
+    auto latency = std::chrono::steady_clock::now() - start;
+
+    EXPECT_EQ(1u, counts.opens.load());
+    EXPECT_EQ(0u, counts.listnames.load());
+    EXPECT_EQ(0u, counts.pidqueries.load());
+
+    /* Unity answered, so we shouldn't have sat out its 500ms timeout */
+    EXPECT_GT(std::chrono::milliseconds(500), latency);
+
+    std::cout << "URL delivery with " << others.size() << " other clients: "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(latency).count() << "ms" << std::endl;
+
+    g_dbus_connection_remove_filter(session, filter);
+    g_object_unref(session);
+
+    for (auto other : others)
+    {
+        g_clear_object(&other);
+    }
+
+    /* Let the queries for the ones that left finish */
+    pause(100);
+}
+
 TEST_F(LibUAL, UrlSendNoObjectTest)
 {
     auto appid = ubuntu::app_launch::AppID::parse("com.test.good_application_1.2.3");
@@ -1094,6 +1247,7 @@ TEST_F(LibUAL, LegacySingleInstance)
     auto singleapp = ubuntu::app_launch::Application::create(singleappid, registry);
 
     singleapp->launch();
+    EXPECT_EVENTUALLY_FUNC_EQ(guint(1), [&]() { return startCalls(obj); });
 
     guint len = 0;
     const DbusTestDbusMockCall* calls = dbus_test_dbus_mock_object_get_method_calls(mock, obj, "Start", &len, NULL);
@@ -1119,6 +1273,7 @@ TEST_F(LibUAL, LegacySingleInstance)
     auto multipleapp = ubuntu::app_launch::Application::create(multipleappid, registry);
 
     multipleapp->launch();
+    EXPECT_EVENTUALLY_FUNC_EQ(guint(1), [&]() { return startCalls(obj); });
 
     len = 0;
     calls = dbus_test_dbus_mock_object_get_method_calls(mock, obj, "Start", &len, NULL);
@@ -1138,6 +1293,46 @@ TEST_F(LibUAL, LegacySingleInstance)
     g_variant_unref(env);
 }
 
+TEST_F(LibUAL, LaunchMany)
+{
+    DbusTestDbusMockObject* clickobj =
+        dbus_test_dbus_mock_get_object(mock, "/com/test/application_click", "com.ubuntu.Upstart0_6.Job", NULL);
+    DbusTestDbusMockObject* legacyobj =
+        dbus_test_dbus_mock_get_object(mock, "/com/test/application_legacy", "com.ubuntu.Upstart0_6.Job", NULL);
+
+    std::vector<std::pair<ubuntu::app_launch::AppID, std::vector<ubuntu::app_launch::Application::URL>>> apps{
+        {ubuntu::app_launch::AppID::parse("com.test.multiple_first_1.2.3"),
+         {ubuntu::app_launch::Application::URL::from_raw("http://ubuntu.com/")}},
+        {ubuntu::app_launch::AppID{}, {}},
+        {ubuntu::app_launch::AppID::find(registry, "single"), {}}};
+
+    auto instances = ubuntu::app_launch::Registry::launchMany(apps, registry);
+
+    ASSERT_EQ(3u, instances.size());
+    EXPECT_NE(nullptr, instances[0]);
+    EXPECT_EQ(nullptr, instances[1]);
+    EXPECT_NE(nullptr, instances[2]);
+
+    EXPECT_EVENTUALLY_FUNC_EQ(guint(1), [&]() { return startCalls(clickobj); });
+    EXPECT_EVENTUALLY_FUNC_EQ(guint(1), [&]() { return startCalls(legacyobj); });
+
+    guint len = 0;
+    auto calls = dbus_test_dbus_mock_object_get_method_calls(mock, clickobj, "Start", &len, NULL);
+    ASSERT_EQ(1, len);
+
+    GVariant* env = g_variant_get_child_value(calls->params, 0);
+    EXPECT_TRUE(check_env(env, "APP_ID", "com.test.multiple_first_1.2.3"));
+    EXPECT_TRUE(check_env(env, "APP_URIS", "'http://ubuntu.com/'"));
+    g_variant_unref(env);
+
+    calls = dbus_test_dbus_mock_object_get_method_calls(mock, legacyobj, "Start", &len, NULL);
+    ASSERT_EQ(1, len);
+
+    env = g_variant_get_child_value(calls->params, 0);
+    EXPECT_TRUE(check_env(env, "APP_ID", "single"));
+    g_variant_unref(env);
+}
+
 static void failed_observer(const gchar* appid, UbuntuAppLaunchAppFailed reason, gpointer user_data)
 {
     if (reason == UBUNTU_APP_LAUNCH_APP_FAILED_CRASH)
@@ -1597,13 +1792,15 @@ TEST_F(LibUAL, DISABLED_PauseResume)
     EXPECT_EVENTUALLY_EQ(1, paused_count);
     EXPECT_EQ(0, spew.dataCnt());
 
-    /* Check to make sure we sent the event to ZG */
-    guint numcalls = 0;
-    const DbusTestDbusMockCall* calls =
+    /* Check to make sure we sent the event to ZG, which waits a bit for
+       others to go with it */
+    auto zgcalls = [zgmock, zgobj]() {
+        guint numcalls = 0;
         dbus_test_dbus_mock_object_get_method_calls(zgmock, zgobj, "InsertEvents", &numcalls, NULL);
+        return numcalls;
+    };
 
-    EXPECT_NE(nullptr, calls);
-    EXPECT_EQ(1, numcalls);
+    EXPECT_EVENTUALLY_FUNC_EQ(1u, zgcalls);
 
     dbus_test_dbus_mock_object_clear_method_calls(zgmock, zgobj, NULL);
 
@@ -1619,11 +1816,7 @@ TEST_F(LibUAL, DISABLED_PauseResume)
     EXPECT_NE(0, spew.dataCnt());
 
     /* Check to make sure we sent the event to ZG */
-    numcalls = 0;
-    calls = dbus_test_dbus_mock_object_get_method_calls(zgmock, zgobj, "InsertEvents", &numcalls, NULL);
-
-    EXPECT_NE(nullptr, calls);
-    EXPECT_EQ(1, numcalls);
+    EXPECT_EVENTUALLY_FUNC_EQ(1u, zgcalls);
 
     /* Check to ensure we set the OOM score */
     EXPECT_EQ("100", spew.oomScore());
@@ -1750,6 +1943,575 @@ TEST_F(LibUAL, MultiPause)
     ASSERT_TRUE(ubuntu_app_launch_observer_delete_app_resumed(signal_increment, &resumed_count));
 }
 
+TEST_F(LibUAL, FreezerPause)
+{
+    g_setenv("UBUNTU_APP_LAUNCH_OOM_PROC_PATH", CMAKE_BINARY_DIR "/libual-proc", 1);
+
+    /* Setup some spew */
+    std::array<SpewMaster, 5> spews;
+
+    /* Setup the cgroup, with a manager that can set values */
+    g_setenv("UBUNTU_APP_LAUNCH_CG_MANAGER_NAME", "org.test.cgmock2", TRUE);
+    DbusTestDbusMock* cgmock2 = dbus_test_dbus_mock_new("org.test.cgmock2");
+    DbusTestDbusMockObject* cgobject = dbus_test_dbus_mock_get_object(cgmock2, "/org/linuxcontainers/cgmanager",
+                                                                      "org.linuxcontainers.cgmanager0_0", NULL);
+
+    std::string pypids = "ret = [ " + std::accumulate(spews.begin(), spews.end(), std::string{},
+                                                      [](const std::string& accum, SpewMaster& spew) {
+                                                          return accum.empty() ?
+                                                                     std::to_string(spew.pid()) :
+                                                                     accum + ", " + std::to_string(spew.pid());
+                                                      }) +
+                         "]";
+    dbus_test_dbus_mock_object_add_method(cgmock2, cgobject, "GetTasksRecursive", G_VARIANT_TYPE("(ss)"),
+                                          G_VARIANT_TYPE("ai"), pypids.c_str(), NULL);
+    dbus_test_dbus_mock_object_add_method(cgmock2, cgobject, "SetValue", G_VARIANT_TYPE("(ssss)"), NULL, "", NULL);
+
+    dbus_test_service_add_task(service, DBUS_TEST_TASK(cgmock2));
+    dbus_test_task_run(DBUS_TEST_TASK(cgmock2));
+
+    /* Setup ZG Mock */
+    DbusTestDbusMock* zgmock = dbus_test_dbus_mock_new("org.gnome.zeitgeist.Engine");
+    DbusTestDbusMockObject* zgobj =
+        dbus_test_dbus_mock_get_object(zgmock, "/org/gnome/zeitgeist/log/activity", "org.gnome.zeitgeist.Log", NULL);
+
+    dbus_test_dbus_mock_object_add_method(zgmock, zgobj, "InsertEvents", G_VARIANT_TYPE("a(asaasay)"),
+                                          G_VARIANT_TYPE("au"), "ret = [ 0 ]", NULL);
+
+    dbus_test_service_add_task(service, DBUS_TEST_TASK(zgmock));
+    dbus_test_task_run(DBUS_TEST_TASK(zgmock));
+    g_object_unref(G_OBJECT(zgmock));
+
+    /* Give things a chance to start */
+    EXPECT_EVENTUALLY_EQ(DBUS_TEST_TASK_STATE_RUNNING, dbus_test_task_get_state(DBUS_TEST_TASK(cgmock2)));
+    EXPECT_EVENTUALLY_EQ(DBUS_TEST_TASK_STATE_RUNNING, dbus_test_task_get_state(DBUS_TEST_TASK(zgmock)));
+
+    /* Setup signal handling */
+    guint paused_count = 0;
+    guint resumed_count = 0;
+
+    ASSERT_TRUE(ubuntu_app_launch_observer_add_app_paused(signal_increment, &paused_count));
+    ASSERT_TRUE(ubuntu_app_launch_observer_add_app_resumed(signal_increment, &resumed_count));
+
+    /* Get our app object */
+    auto appid = ubuntu::app_launch::AppID::find(registry, "com.test.good_application_1.2.3");
+    auto app = ubuntu::app_launch::Application::create(appid, registry);
+
+    ASSERT_EQ(1, app->instances().size());
+
+    auto instance = app->instances()[0];
+
+    /* Pause the app */
+    instance->pause();
+
+    EXPECT_EVENTUALLY_EQ(1, paused_count);
+
+    /* The whole group is frozen at once, and as nothing can fork while
+       it's frozen the PIDs only need to be listed once */
+    const DbusTestDbusMockCall* calls = NULL;
+    guint len = 0;
+
+    calls = dbus_test_dbus_mock_object_get_method_calls(cgmock2, cgobject, "SetValue", &len, NULL);
+    ASSERT_EQ(1, len);
+    EXPECT_TRUE(g_variant_equal(
+        calls->params, g_variant_new("(ssss)", "freezer", "upstart/application-click-com.test.good_application_1.2.3",
+                                     "freezer.state", "FROZEN")));
+
+    calls = dbus_test_dbus_mock_object_get_method_calls(cgmock2, cgobject, "GetTasksRecursive", &len, NULL);
+    EXPECT_EQ(1, len);
+
+    ASSERT_TRUE(dbus_test_dbus_mock_object_clear_method_calls(cgmock2, cgobject, NULL));
+
+    /* The OOM scores are still set on each process */
+    for (auto& spew : spews)
+    {
+        EXPECT_EQ("900", spew.oomScore());
+    }
+
+    /* Now Resume the App */
+    instance->resume();
+
+    EXPECT_EVENTUALLY_EQ(1, resumed_count);
+
+    calls = dbus_test_dbus_mock_object_get_method_calls(cgmock2, cgobject, "SetValue", &len, NULL);
+    ASSERT_EQ(1, len);
+    EXPECT_TRUE(g_variant_equal(
+        calls->params, g_variant_new("(ssss)", "freezer", "upstart/application-click-com.test.good_application_1.2.3",
+                                     "freezer.state", "THAWED")));
+
+    calls = dbus_test_dbus_mock_object_get_method_calls(cgmock2, cgobject, "GetTasksRecursive", &len, NULL);
+    EXPECT_EQ(1, len);
+
+    for (auto& spew : spews)
+    {
+        EXPECT_EQ("100", spew.oomScore());
+    }
+
+    g_object_unref(G_OBJECT(cgmock2));
+
+    g_spawn_command_line_sync("rm -rf " CMAKE_BINARY_DIR "/libual-proc", NULL, NULL, NULL, NULL);
+
+    ASSERT_TRUE(ubuntu_app_launch_observer_delete_app_paused(signal_increment, &paused_count));
+    ASSERT_TRUE(ubuntu_app_launch_observer_delete_app_resumed(signal_increment, &resumed_count));
+}
+
+TEST_F(LibUAL, PauseStop)
+{
+    DbusTestDbusMockObject* obj =
+        dbus_test_dbus_mock_get_object(mock, "/com/test/application_click", "com.ubuntu.Upstart0_6.Job", NULL);
+
+    /* Setup the cgroup, with a manager that can set values */
+    g_setenv("UBUNTU_APP_LAUNCH_CG_MANAGER_NAME", "org.test.cgmock2", TRUE);
+    DbusTestDbusMock* cgmock2 = dbus_test_dbus_mock_new("org.test.cgmock2");
+    DbusTestDbusMockObject* cgobject = dbus_test_dbus_mock_get_object(cgmock2, "/org/linuxcontainers/cgmanager",
+                                                                      "org.linuxcontainers.cgmanager0_0", NULL);
+
+    dbus_test_dbus_mock_object_add_method(cgmock2, cgobject, "GetTasksRecursive", G_VARIANT_TYPE("(ss)"),
+                                          G_VARIANT_TYPE("ai"), "ret = [ ]", NULL);
+    dbus_test_dbus_mock_object_add_method(cgmock2, cgobject, "SetValue", G_VARIANT_TYPE("(ssss)"), NULL, "", NULL);
+
+    dbus_test_service_add_task(service, DBUS_TEST_TASK(cgmock2));
+    dbus_test_task_run(DBUS_TEST_TASK(cgmock2));
+
+    EXPECT_EVENTUALLY_EQ(DBUS_TEST_TASK_STATE_RUNNING, dbus_test_task_get_state(DBUS_TEST_TASK(cgmock2)));
+
+    auto appid = ubuntu::app_launch::AppID::find(registry, "com.test.good_application_1.2.3");
+    auto app = ubuntu::app_launch::Application::create(appid, registry);
+
+    ASSERT_EQ(1, app->instances().size());
+    auto instance = app->instances()[0];
+
+    instance->pause();
+
+    guint len = 0;
+    dbus_test_dbus_mock_object_get_method_calls(cgmock2, cgobject, "SetValue", &len, NULL);
+    ASSERT_EQ(1, len);
+    ASSERT_TRUE(dbus_test_dbus_mock_object_clear_method_calls(cgmock2, cgobject, NULL));
+
+    /* Stopping it thaws the group so that Upstart's signals get through */
+    instance->stop();
+
+    const DbusTestDbusMockCall* calls =
+        dbus_test_dbus_mock_object_get_method_calls(cgmock2, cgobject, "SetValue", &len, NULL);
+    ASSERT_EQ(1, len);
+    EXPECT_TRUE(g_variant_equal(
+        calls->params, g_variant_new("(ssss)", "freezer", "upstart/application-click-com.test.good_application_1.2.3",
+                                     "freezer.state", "THAWED")));
+
+    EXPECT_EQ(1, dbus_test_dbus_mock_object_check_method_call(mock, obj, "Stop", NULL, NULL));
+
+    g_object_unref(G_OBJECT(cgmock2));
+}
+
+TEST_F(LibUAL, StandbyResume)
+{
+    g_setenv("UBUNTU_APP_LAUNCH_OOM_PROC_PATH", CMAKE_BINARY_DIR "/libual-proc", 1);
+
+    DbusTestDbusMockObject* obj =
+        dbus_test_dbus_mock_get_object(mock, "/com/test/application_click", "com.ubuntu.Upstart0_6.Job", NULL);
+
+    /* Setup some spew */
+    std::array<SpewMaster, 2> spews;
+
+    /* Setup the cgroup, with a manager that can set values */
+    g_setenv("UBUNTU_APP_LAUNCH_CG_MANAGER_NAME", "org.test.cgmock2", TRUE);
+    DbusTestDbusMock* cgmock2 = dbus_test_dbus_mock_new("org.test.cgmock2");
+    DbusTestDbusMockObject* cgobject = dbus_test_dbus_mock_get_object(cgmock2, "/org/linuxcontainers/cgmanager",
+                                                                      "org.linuxcontainers.cgmanager0_0", NULL);
+
+    std::string pypids = "ret = [ " + std::to_string(spews[0].pid()) + ", " + std::to_string(spews[1].pid()) + "]";
+    dbus_test_dbus_mock_object_add_method(cgmock2, cgobject, "GetTasksRecursive", G_VARIANT_TYPE("(ss)"),
+                                          G_VARIANT_TYPE("ai"), pypids.c_str(), NULL);
+    dbus_test_dbus_mock_object_add_method(cgmock2, cgobject, "SetValue", G_VARIANT_TYPE("(ssss)"), NULL, "", NULL);
+
+    dbus_test_service_add_task(service, DBUS_TEST_TASK(cgmock2));
+    dbus_test_task_run(DBUS_TEST_TASK(cgmock2));
+
+    /* Setup ZG Mock */
+    DbusTestDbusMock* zgmock = dbus_test_dbus_mock_new("org.gnome.zeitgeist.Engine");
+    DbusTestDbusMockObject* zgobj =
+        dbus_test_dbus_mock_get_object(zgmock, "/org/gnome/zeitgeist/log/activity", "org.gnome.zeitgeist.Log", NULL);
+
+    dbus_test_dbus_mock_object_add_method(zgmock, zgobj, "InsertEvents", G_VARIANT_TYPE("a(asaasay)"),
+                                          G_VARIANT_TYPE("au"), "ret = [ 0 ]", NULL);
+
+    dbus_test_service_add_task(service, DBUS_TEST_TASK(zgmock));
+    dbus_test_task_run(DBUS_TEST_TASK(zgmock));
+    g_object_unref(G_OBJECT(zgmock));
+
+    /* Give things a chance to start */
+    EXPECT_EVENTUALLY_EQ(DBUS_TEST_TASK_STATE_RUNNING, dbus_test_task_get_state(DBUS_TEST_TASK(cgmock2)));
+    EXPECT_EVENTUALLY_EQ(DBUS_TEST_TASK_STATE_RUNNING, dbus_test_task_get_state(DBUS_TEST_TASK(zgmock)));
+
+    guint resumed_count = 0;
+    ASSERT_TRUE(ubuntu_app_launch_observer_add_app_resumed(signal_increment, &resumed_count));
+
+    /* Put the running app in standby */
+    gchar* standbydir = g_build_filename(g_get_user_runtime_dir(), "ubuntu-app-launch", "standby", nullptr);
+    ASSERT_EQ(0, g_mkdir_with_parents(standbydir, 0700));
+    gchar* standbyfile = g_build_filename(standbydir, "com.test.good_application_1.2.3", nullptr);
+    ASSERT_TRUE(g_file_set_contents(standbyfile, "", -1, NULL));
+
+    /* Launching it brings it back instead of starting it */
+    auto appid = ubuntu::app_launch::AppID::find(registry, "com.test.good_application_1.2.3");
+    auto app = ubuntu::app_launch::Application::create(appid, registry);
+    auto instance = app->launch();
+
+    ASSERT_NE(nullptr, instance);
+    EXPECT_EVENTUALLY_EQ(1, resumed_count);
+    EXPECT_FALSE(g_file_test(standbyfile, G_FILE_TEST_EXISTS));
+    EXPECT_EQ(0, startCalls(obj));
+
+    guint len = 0;
+    const DbusTestDbusMockCall* calls =
+        dbus_test_dbus_mock_object_get_method_calls(cgmock2, cgobject, "SetValue", &len, NULL);
+    ASSERT_EQ(1, len);
+    EXPECT_TRUE(g_variant_equal(
+        calls->params, g_variant_new("(ssss)", "freezer", "upstart/application-click-com.test.good_application_1.2.3",
+                                     "freezer.state", "THAWED")));
+
+    for (auto& spew : spews)
+    {
+        EXPECT_EQ("100", spew.oomScore());
+    }
+
+    /* Without the standby file it is a normal launch */
+    app->launch();
+    EXPECT_EVENTUALLY_FUNC_EQ(guint(1), [&]() { return startCalls(obj); });
+
+    g_free(standbyfile);
+    g_free(standbydir);
+    g_object_unref(G_OBJECT(cgmock2));
+
+    g_spawn_command_line_sync("rm -rf " CMAKE_BINARY_DIR "/libual-proc", NULL, NULL, NULL, NULL);
+
+    ASSERT_TRUE(ubuntu_app_launch_observer_delete_app_resumed(signal_increment, &resumed_count));
+}
+
+/* A Zeitgeist event in the form FindEvents returns them, for the
+   application:// URI that zgSendEvent() uses */
+static std::string zgPopularEvent(const std::string& name)
+{
+    return "(['1', '0', '', '', 'application://ubuntu-app-launch.desktop', ''], [['application://" + name +
+           ".desktop', '', '', '', '', '', '', '', '']], [])";
+}
+
+/* Sets up a CGroup manager that can freeze things, with the PIDs of the
+   spews in it, and Zeitgeist with @popular as the most used applications */
+static DbusTestDbusMock* standbyMocks(DbusTestService* service,
+                                      const std::vector<GPid>& pids,
+                                      const std::vector<std::string>& popular,
+                                      DbusTestDbusMock** zgmockout)
+{
+    g_setenv("UBUNTU_APP_LAUNCH_CG_MANAGER_NAME", "org.test.cgmock2", TRUE);
+    DbusTestDbusMock* cgmock2 = dbus_test_dbus_mock_new("org.test.cgmock2");
+    DbusTestDbusMockObject* cgobject = dbus_test_dbus_mock_get_object(cgmock2, "/org/linuxcontainers/cgmanager",
+                                                                      "org.linuxcontainers.cgmanager0_0", NULL);
+
+    std::string pypids = "ret = [ ";
+    for (auto pid : pids)
+    {
+        pypids += std::to_string(pid) + ", ";
+    }
+    pypids += "]";
+    dbus_test_dbus_mock_object_add_method(cgmock2, cgobject, "GetTasksRecursive", G_VARIANT_TYPE("(ss)"),
+                                          G_VARIANT_TYPE("ai"), pypids.c_str(), NULL);
+    dbus_test_dbus_mock_object_add_method(cgmock2, cgobject, "SetValue", G_VARIANT_TYPE("(ssss)"), NULL, "", NULL);
+
+    dbus_test_service_add_task(service, DBUS_TEST_TASK(cgmock2));
+    dbus_test_task_run(DBUS_TEST_TASK(cgmock2));
+
+    DbusTestDbusMock* zgmock = dbus_test_dbus_mock_new("org.gnome.zeitgeist.Engine");
+    DbusTestDbusMockObject* zgobj =
+        dbus_test_dbus_mock_get_object(zgmock, "/org/gnome/zeitgeist/log/activity", "org.gnome.zeitgeist.Log", NULL);
+
+    dbus_test_dbus_mock_object_add_method(zgmock, zgobj, "InsertEvents", G_VARIANT_TYPE("a(asaasay)"),
+                                          G_VARIANT_TYPE("au"), "ret = [ 0 ]", NULL);
+
+    std::string pyevents = "ret = [ ";
+    for (const auto& name : popular)
+    {
+        pyevents += zgPopularEvent(name) + ", ";
+    }
+    pyevents += "]";
+    dbus_test_dbus_mock_object_add_method(zgmock, zgobj, "FindEvents", G_VARIANT_TYPE("((xx)a(asaasay)uuu)"),
+                                          G_VARIANT_TYPE("a(asaasay)"), pyevents.c_str(), NULL);
+
+    dbus_test_service_add_task(service, DBUS_TEST_TASK(zgmock));
+    dbus_test_task_run(DBUS_TEST_TASK(zgmock));
+
+    *zgmockout = zgmock;
+    return cgmock2;
+}
+
+/* How many times the freezer was set to @state */
+static guint freezerCalls(DbusTestDbusMock* cgmock2, const gchar* state)
+{
+    DbusTestDbusMockObject* cgobject = dbus_test_dbus_mock_get_object(cgmock2, "/org/linuxcontainers/cgmanager",
+                                                                      "org.linuxcontainers.cgmanager0_0", NULL);
+    guint len = 0;
+    auto calls = dbus_test_dbus_mock_object_get_method_calls(cgmock2, cgobject, "SetValue", &len, NULL);
+
+    guint count = 0;
+    for (guint i = 0; i < len; i++)
+    {
+        if (g_variant_equal(calls[i].params, g_variant_new("(ssss)", "freezer",
+                                                            "upstart/application-click-com.test.multiple_first_1.2.3",
+                                                            "freezer.state", state)))
+        {
+            count++;
+        }
+    }
+    return count;
+}
+
+TEST_F(LibUAL, Prelaunch)
+{
+    DbusTestDbusMockObject* obj =
+        dbus_test_dbus_mock_get_object(mock, "/com/test/application_click", "com.ubuntu.Upstart0_6.Job", NULL);
+
+    /* The first is already running and the second isn't installed, so
+       the third is the one that gets launched */
+    DbusTestDbusMock* zgmock = nullptr;
+    DbusTestDbusMock* cgmock2 =
+        standbyMocks(service, {}, {"com.test.good_application", "not-installed", "com.test.multiple_first"}, &zgmock);
+    DbusTestDbusMockObject* zgobj =
+        dbus_test_dbus_mock_get_object(zgmock, "/org/gnome/zeitgeist/log/activity", "org.gnome.zeitgeist.Log", NULL);
+
+    EXPECT_EVENTUALLY_EQ(DBUS_TEST_TASK_STATE_RUNNING, dbus_test_task_get_state(DBUS_TEST_TASK(cgmock2)));
+    EXPECT_EVENTUALLY_EQ(DBUS_TEST_TASK_STATE_RUNNING, dbus_test_task_get_state(DBUS_TEST_TASK(zgmock)));
+
+    auto instances = ubuntu::app_launch::Registry::prelaunch(1, registry);
+    EXPECT_EQ(1, instances.size());
+
+    /* Asks for extra to skip the ones that won't launch */
+    guint len = 0;
+    const DbusTestDbusMockCall* calls =
+        dbus_test_dbus_mock_object_get_method_calls(zgmock, zgobj, "FindEvents", &len, NULL);
+    ASSERT_EQ(1, len);
+    GVariant* numevents = g_variant_get_child_value(calls->params, 3);
+    EXPECT_EQ(2u, g_variant_get_uint32(numevents));
+    g_variant_unref(numevents);
+
+    /* Started without waiting on Unity, marked as standby */
+    EXPECT_EVENTUALLY_FUNC_EQ(guint(1), [&]() { return startCalls(obj); });
+    calls = dbus_test_dbus_mock_object_get_method_calls(mock, obj, "Start", &len, NULL);
+    ASSERT_EQ(1, len);
+
+    GVariant* env = g_variant_get_child_value(calls->params, 0);
+    EXPECT_TRUE(check_env(env, "APP_ID", "com.test.multiple_first_1.2.3"));
+    EXPECT_TRUE(check_env(env, "UBUNTU_APP_LAUNCH_STANDBY", "1"));
+    g_variant_unref(env);
+
+    /* Nothing to do */
+    EXPECT_EQ(0, ubuntu::app_launch::Registry::prelaunch(0, registry).size());
+
+    g_object_unref(G_OBJECT(zgmock));
+    g_object_unref(G_OBJECT(cgmock2));
+}
+
+TEST_F(LibUAL, StandbySettle)
+{
+    g_setenv("UBUNTU_APP_LAUNCH_OOM_PROC_PATH", CMAKE_BINARY_DIR "/libual-proc", 1);
+
+    std::array<SpewMaster, 2> spews;
+
+    DbusTestDbusMock* zgmock = nullptr;
+    DbusTestDbusMock* cgmock2 =
+        standbyMocks(service, {spews[0].pid(), spews[1].pid()}, {"com.test.multiple_first"}, &zgmock);
+
+    EXPECT_EVENTUALLY_EQ(DBUS_TEST_TASK_STATE_RUNNING, dbus_test_task_get_state(DBUS_TEST_TASK(cgmock2)));
+    EXPECT_EVENTUALLY_EQ(DBUS_TEST_TASK_STATE_RUNNING, dbus_test_task_get_state(DBUS_TEST_TASK(zgmock)));
+
+    gchar* standbyfile = g_build_filename(g_get_user_runtime_dir(), "ubuntu-app-launch", "standby",
+                                          "com.test.multiple_first_1.2.3", nullptr);
+    g_unlink(standbyfile);
+
+    ASSERT_EQ(1, ubuntu::app_launch::Registry::prelaunch(1, registry).size());
+
+    /* It gets a chance to start before it is frozen */
+    pause(1000);
+    EXPECT_EQ(0, freezerCalls(cgmock2, "FROZEN"));
+    EXPECT_FALSE(g_file_test(standbyfile, G_FILE_TEST_EXISTS));
+
+    /* Then it goes into standby, the first to go if memory runs out */
+    EXPECT_EVENTUALLY_FUNC_EQ(guint(1), [&]() { return freezerCalls(cgmock2, "FROZEN"); });
+    EXPECT_EVENTUALLY_FUNC_EQ(true, [&]() { return bool(g_file_test(standbyfile, G_FILE_TEST_EXISTS)); });
+
+    for (auto& spew : spews)
+    {
+        EXPECT_EQ("1000", spew.oomScore());
+    }
+
+    g_unlink(standbyfile);
+    g_free(standbyfile);
+    g_object_unref(G_OBJECT(zgmock));
+    g_object_unref(G_OBJECT(cgmock2));
+
+    g_spawn_command_line_sync("rm -rf " CMAKE_BINARY_DIR "/libual-proc", NULL, NULL, NULL, NULL);
+}
+
+TEST_F(LibUAL, StandbyLaunchWhileSettling)
+{
+    DbusTestDbusMockObject* obj =
+        dbus_test_dbus_mock_get_object(mock, "/com/test/application_click", "com.ubuntu.Upstart0_6.Job", NULL);
+
+    DbusTestDbusMock* zgmock = nullptr;
+    DbusTestDbusMock* cgmock2 = standbyMocks(service, {}, {"com.test.multiple_first"}, &zgmock);
+
+    EXPECT_EVENTUALLY_EQ(DBUS_TEST_TASK_STATE_RUNNING, dbus_test_task_get_state(DBUS_TEST_TASK(cgmock2)));
+    EXPECT_EVENTUALLY_EQ(DBUS_TEST_TASK_STATE_RUNNING, dbus_test_task_get_state(DBUS_TEST_TASK(zgmock)));
+
+    gchar* standbyfile = g_build_filename(g_get_user_runtime_dir(), "ubuntu-app-launch", "standby",
+                                          "com.test.multiple_first_1.2.3", nullptr);
+    g_unlink(standbyfile);
+
+    ASSERT_EQ(1, ubuntu::app_launch::Registry::prelaunch(1, registry).size());
+
+    /* The user asks for it before it has settled */
+    auto appid = ubuntu::app_launch::AppID::parse("com.test.multiple_first_1.2.3");
+    auto app = ubuntu::app_launch::Application::create(appid, registry);
+    app->launch();
+
+    EXPECT_EVENTUALLY_FUNC_EQ(guint(2), [&]() { return startCalls(obj); });
+
+    /* Past when it would have been frozen, it is left running */
+    pause(4000);
+    EXPECT_EQ(0, freezerCalls(cgmock2, "FROZEN"));
+    EXPECT_FALSE(g_file_test(standbyfile, G_FILE_TEST_EXISTS));
+
+    g_free(standbyfile);
+    g_object_unref(G_OBJECT(zgmock));
+    g_object_unref(G_OBJECT(cgmock2));
+}
+
+/* The interpretations of the events in each InsertEvents call */
+static std::vector<std::vector<std::string>> zgInserted(DbusTestDbusMock* zgmock)
+{
+    DbusTestDbusMockObject* zgobj =
+        dbus_test_dbus_mock_get_object(zgmock, "/org/gnome/zeitgeist/log/activity", "org.gnome.zeitgeist.Log", NULL);
+    guint len = 0;
+    auto calls = dbus_test_dbus_mock_object_get_method_calls(zgmock, zgobj, "InsertEvents", &len, NULL);
+
+    std::vector<std::vector<std::string>> batches;
+    for (guint i = 0; i < len; i++)
+    {
+        std::vector<std::string> batch;
+        GVariant* events = g_variant_get_child_value(calls[i].params, 0);
+        for (gsize j = 0; j < g_variant_n_children(events); j++)
+        {
+            GVariant* event = g_variant_get_child_value(events, j);
+            GVariant* data = g_variant_get_child_value(event, 0);
+            GVariant* interpretation = g_variant_get_child_value(data, 2);
+            batch.emplace_back(g_variant_get_string(interpretation, nullptr));
+            g_variant_unref(interpretation);
+            g_variant_unref(data);
+            g_variant_unref(event);
+        }
+        g_variant_unref(events);
+        batches.push_back(batch);
+    }
+    return batches;
+}
+
+class LibUALZgBatch : public LibUAL
+{
+protected:
+    DbusTestDbusMock* zgmock = nullptr;
+    DbusTestDbusMock* cgmock2 = nullptr;
+    std::shared_ptr<ubuntu::app_launch::Application::Instance> instance;
+
+    /* A registry that batches the way we ask it to, and a running
+       application to pause and resume to make events */
+    void setupBatching(const gchar* window, const gchar* max)
+    {
+        cgmock2 = standbyMocks(service, {}, {}, &zgmock);
+        EXPECT_EVENTUALLY_EQ(DBUS_TEST_TASK_STATE_RUNNING, dbus_test_task_get_state(DBUS_TEST_TASK(cgmock2)));
+        EXPECT_EVENTUALLY_EQ(DBUS_TEST_TASK_STATE_RUNNING, dbus_test_task_get_state(DBUS_TEST_TASK(zgmock)));
+
+        g_setenv("UBUNTU_APP_LAUNCH_ZG_BATCH_MS", window, TRUE);
+        g_setenv("UBUNTU_APP_LAUNCH_ZG_BATCH_MAX", max, TRUE);
+        registry = std::make_shared<ubuntu::app_launch::Registry>();
+
+        auto appid = ubuntu::app_launch::AppID::find(registry, "com.test.good_application_1.2.3");
+        auto app = ubuntu::app_launch::Application::create(appid, registry);
+        ASSERT_EQ(1, app->instances().size());
+        instance = app->instances()[0];
+    }
+
+    virtual void TearDown()
+    {
+        instance.reset();
+        registry.reset();
+        g_clear_object(&zgmock);
+        g_clear_object(&cgmock2);
+        g_unsetenv("UBUNTU_APP_LAUNCH_ZG_BATCH_MS");
+        g_unsetenv("UBUNTU_APP_LAUNCH_ZG_BATCH_MAX");
+
+        LibUAL::TearDown();
+    }
+};
+
+TEST_F(LibUALZgBatch, OneCallForTheBatch)
+{
+    setupBatching("200", "100");
+
+    instance->pause();
+    instance->resume();
+    instance->pause();
+
+    /* Nothing until the window closes, then all of them together */
+    EXPECT_EQ(0u, zgInserted(zgmock).size());
+    EXPECT_EVENTUALLY_FUNC_EQ(std::size_t(1), [this]() { return zgInserted(zgmock).size(); });
+
+    EXPECT_EQ((std::vector<std::string>{ZEITGEIST_ZG_LEAVE_EVENT, ZEITGEIST_ZG_ACCESS_EVENT, ZEITGEIST_ZG_LEAVE_EVENT}),
+              zgInserted(zgmock)[0]);
+}
+
+TEST_F(LibUALZgBatch, MergeLeaveAccess)
+{
+    setupBatching("200", "100");
+
+    /* Leave, access, leave, access is the same as leave, access */
+    instance->pause();
+    instance->resume();
+    instance->pause();
+    instance->resume();
+
+    EXPECT_EVENTUALLY_FUNC_EQ(std::size_t(1), [this]() { return zgInserted(zgmock).size(); });
+
+    EXPECT_EQ((std::vector<std::string>{ZEITGEIST_ZG_LEAVE_EVENT, ZEITGEIST_ZG_ACCESS_EVENT}), zgInserted(zgmock)[0]);
+}
+
+TEST_F(LibUALZgBatch, FlushAtMax)
+{
+    /* The window is long enough that only hitting the max sends them */
+    setupBatching("600000", "3");
+
+    instance->pause();
+    instance->resume();
+    EXPECT_EQ(0u, zgInserted(zgmock).size());
+
+    instance->pause();
+    EXPECT_EVENTUALLY_FUNC_EQ(std::size_t(1), [this]() { return zgInserted(zgmock).size(); });
+    EXPECT_EQ(3u, zgInserted(zgmock)[0].size());
+}
+
+TEST_F(LibUALZgBatch, FlushOnDestroy)
+{
+    setupBatching("600000", "100");
+
+    instance->pause();
+    EXPECT_EQ(0u, zgInserted(zgmock).size());
+
+    /* The last of the events go out with the registry */
+    instance.reset();
+    registry.reset();
+
+    EXPECT_EVENTUALLY_FUNC_EQ(std::size_t(1), [this]() { return zgInserted(zgmock).size(); });
+    EXPECT_EQ((std::vector<std::string>{ZEITGEIST_ZG_LEAVE_EVENT}), zgInserted(zgmock)[0]);
+}
+
 TEST_F(LibUAL, OOMSet)
 {
     g_setenv("UBUNTU_APP_LAUNCH_OOM_PROC_PATH", CMAKE_BINARY_DIR "/libual-proc", 1);
@@ -1870,10 +2632,9 @@ TEST_F(LibUAL, StartSessionHelper)
 
     GVariant* mnamev = find_env(env, "UBUNTU_APP_LAUNCH_DEMANGLE_NAME");
     ASSERT_NE(nullptr, mnamev); /* Have to assert because, eh, GVariant */
-    EXPECT_STREQ(g_dbus_connection_get_unique_name(bus),
-                 g_variant_get_string(mnamev, nullptr) + strlen("UBUNTU_APP_LAUNCH_DEMANGLE_NAME="));
-    GVariant* mpathv = find_env(env, "UBUNTU_APP_LAUNCH_DEMANGLE_PATH");
-    ASSERT_NE(nullptr, mpathv); /* Have to assert because, eh, GVariant */
+    EXPECT_TRUE(g_str_has_prefix(g_variant_get_string(mnamev, nullptr),
+                                 "UBUNTU_APP_LAUNCH_DEMANGLE_NAME=ubuntu-app-launch-mir-"));
+    EXPECT_EQ(nullptr, find_env(env, "UBUNTU_APP_LAUNCH_DEMANGLE_PATH"));
 
     g_variant_unref(env);
 
@@ -1883,19 +2644,18 @@ TEST_F(LibUAL, StartSessionHelper)
     g_setenv("UBUNTU_APP_LAUNCH_DEMANGLE_NAME", mname, TRUE);
     g_variant_unref(mnamev);
 
-    const gchar* mpath = g_variant_get_string(mpathv, nullptr);
-    mpath += strlen("UBUNTU_APP_LAUNCH_DEMANGLE_PATH=");
-    g_setenv("UBUNTU_APP_LAUNCH_DEMANGLE_PATH", mpath, TRUE);
-    g_variant_unref(mpathv);
-
     /* Exec our tool */
     std::promise<std::string> outputpromise;
-    std::thread t([&outputpromise]() {
+    std::promise<std::chrono::steady_clock::duration> handoffpromise;
+    std::thread t([&outputpromise, &handoffpromise]() {
         gchar* socketstdout = nullptr;
         GError* error = nullptr;
         g_unsetenv("G_MESSAGES_DEBUG");
 
+        /* The demangler execs the tool once it has the socket */
+        auto start = std::chrono::steady_clock::now();
         g_spawn_command_line_sync(SOCKET_DEMANGLER " " SOCKET_TOOL, &socketstdout, nullptr, nullptr, &error);
+        handoffpromise.set_value(std::chrono::steady_clock::now() - start);
 
         if (error != nullptr)
         {
@@ -1919,6 +2679,10 @@ TEST_F(LibUAL, StartSessionHelper)
 
     ASSERT_STREQ(filedata, outputfuture.get().c_str());
 
+    std::cout << "Session helper Mir socket handoff: "
+              << std::chrono::duration_cast<std::chrono::microseconds>(handoffpromise.get_future().get()).count()
+              << "us" << std::endl;
+
     ASSERT_TRUE(dbus_test_dbus_mock_object_clear_method_calls(mock, obj, NULL));
 
     return;
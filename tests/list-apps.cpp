@@ -180,6 +180,38 @@ TEST_F(ListApps, ListLibertine)
     EXPECT_TRUE(findApp(apps, "container-name_user-app_0.0"));
 }
 
+TEST_F(ListApps, LibertineLookups)
+{
+    auto registry = std::make_shared<ubuntu::app_launch::Registry>();
+
+    EXPECT_TRUE(ubuntu::app_launch::app_impls::Libertine::verifyPackage(
+        ubuntu::app_launch::AppID::Package::from_raw("container-name"), registry));
+    EXPECT_FALSE(ubuntu::app_launch::app_impls::Libertine::verifyPackage(
+        ubuntu::app_launch::AppID::Package::from_raw("not-a-container"), registry));
+
+    EXPECT_TRUE(ubuntu::app_launch::app_impls::Libertine::verifyAppname(
+        ubuntu::app_launch::AppID::Package::from_raw("container-name"),
+        ubuntu::app_launch::AppID::AppName::from_raw("test"), registry));
+    EXPECT_TRUE(ubuntu::app_launch::app_impls::Libertine::verifyAppname(
+        ubuntu::app_launch::AppID::Package::from_raw("container-name"),
+        ubuntu::app_launch::AppID::AppName::from_raw("user-app"), registry));
+    EXPECT_FALSE(ubuntu::app_launch::app_impls::Libertine::verifyAppname(
+        ubuntu::app_launch::AppID::Package::from_raw("container-name"),
+        ubuntu::app_launch::AppID::AppName::from_raw("not-an-app"), registry));
+    EXPECT_FALSE(ubuntu::app_launch::app_impls::Libertine::verifyAppname(
+        ubuntu::app_launch::AppID::Package::from_raw("not-a-container"),
+        ubuntu::app_launch::AppID::AppName::from_raw("test"), registry));
+
+    EXPECT_TRUE(ubuntu::app_launch::app_impls::Libertine::hasAppId(
+        ubuntu::app_launch::AppID::parse("container-name_test_0.0"), registry));
+    EXPECT_FALSE(ubuntu::app_launch::app_impls::Libertine::hasAppId(
+        ubuntu::app_launch::AppID::parse("container-name_test_1.0"), registry));
+
+    /* Listing after the lookups uses the same catalog */
+    auto apps = ubuntu::app_launch::app_impls::Libertine::list(registry);
+    EXPECT_EQ(3, apps.size());
+}
+
 #ifdef ENABLE_SNAPPY
 static std::pair<std::string, std::string> interfaces{
     "GET /v2/interfaces HTTP/1.1\r\nHost: snapd\r\nAccept: */*\r\n\r\n",
@@ -189,25 +221,16 @@ static std::pair<std::string, std::string> interfaces{
                                                         {"x11", "x11-package", {"multiple", "hidden"}}
 
         })))};
-static std::pair<std::string, std::string> u8Package{
-    "GET /v2/snaps/unity8-package HTTP/1.1\r\nHost: snapd\r\nAccept: */*\r\n\r\n",
-    SnapdMock::httpJsonResponse(SnapdMock::snapdOkay(
-        SnapdMock::packageJson("unity8-package", "active", "app", "1.2.3.4", "x123", {"foo", "bar"})))};
-static std::pair<std::string, std::string> u7Package{
-    "GET /v2/snaps/unity7-package HTTP/1.1\r\nHost: snapd\r\nAccept: */*\r\n\r\n",
-    SnapdMock::httpJsonResponse(SnapdMock::snapdOkay(SnapdMock::packageJson(
-        "unity7-package", "active", "app", "1.2.3.4", "x123", {"scope", "single", "multiple"})))};
-static std::pair<std::string, std::string> x11Package{
-    "GET /v2/snaps/x11-package HTTP/1.1\r\nHost: snapd\r\nAccept: */*\r\n\r\n",
-    SnapdMock::httpJsonResponse(SnapdMock::snapdOkay(
-        SnapdMock::packageJson("x11-package", "active", "app", "1.2.3.4", "x123", {"multiple", "hidden"})))};
+static std::pair<std::string, std::string> snaps{
+    "GET /v2/snaps HTTP/1.1\r\nHost: snapd\r\nAccept: */*\r\n\r\n",
+    SnapdMock::httpJsonResponse(SnapdMock::snapdOkay(SnapdMock::snapsJson(
+        {SnapdMock::packageJson("unity8-package", "active", "app", "1.2.3.4", "x123", {"foo", "bar"}),
+         SnapdMock::packageJson("unity7-package", "active", "app", "1.2.3.4", "x123", {"scope", "single", "multiple"}),
+         SnapdMock::packageJson("x11-package", "active", "app", "1.2.3.4", "x123", {"multiple", "hidden"})})))};
 
 TEST_F(ListApps, ListSnap)
 {
-    SnapdMock mock{SNAPD_LIST_APPS_SOCKET,
-                   {interfaces, u7Package, u7Package, u7Package,      /* unity7 check */
-                    interfaces, u8Package, u8Package, u8Package,      /* unity8 check */
-                    interfaces, x11Package, x11Package, x11Package}}; /* x11 check */
+    SnapdMock mock{SNAPD_LIST_APPS_SOCKET, {interfaces, snaps}};
     auto registry = std::make_shared<ubuntu::app_launch::Registry>();
 
     auto apps = ubuntu::app_launch::app_impls::Snap::list(registry);
@@ -231,10 +254,7 @@ TEST_F(ListApps, ListSnap)
 TEST_F(ListApps, ListAll)
 {
 #ifdef ENABLE_SNAPPY
-    SnapdMock mock{SNAPD_LIST_APPS_SOCKET,
-                   {interfaces, u7Package, u7Package, u7Package,      /* unity7 check */
-                    interfaces, u8Package, u8Package, u8Package,      /* unity8 check */
-                    interfaces, x11Package, x11Package, x11Package}}; /* x11 check */
+    SnapdMock mock{SNAPD_LIST_APPS_SOCKET, {interfaces, snaps}};
 #endif
     auto registry = std::make_shared<ubuntu::app_launch::Registry>();
 
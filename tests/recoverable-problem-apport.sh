@@ -0,0 +1,9 @@
+#!/bin/bash -e
+
+# Stands in for apport's recoverable_problem, keeping the arguments and
+# report of each run in the order they were made. The report is moved
+# into place once it's all there so the test never sees half of it.
+COUNT=`ls "${RECOVERABLE_PROBLEM_RECORD_DIR}" | grep -c "\.args$" || true`
+echo -n "$*" > "${RECOVERABLE_PROBLEM_RECORD_DIR}/report-${COUNT}.args"
+cat > "${RECOVERABLE_PROBLEM_RECORD_DIR}/.report-${COUNT}.data"
+mv "${RECOVERABLE_PROBLEM_RECORD_DIR}/.report-${COUNT}.data" "${RECOVERABLE_PROBLEM_RECORD_DIR}/report-${COUNT}.data"
@@ -0,0 +1,7 @@
+#!/bin/bash -e
+
+# Stands in for recoverable-problem-reporter, keeping the queue it was
+# given. Moved into place once it's all there so the test never sees
+# half of it.
+cat > "${RECOVERABLE_PROBLEM_RECORD_DIR}/.reporter-$$"
+mv "${RECOVERABLE_PROBLEM_RECORD_DIR}/.reporter-$$" "${RECOVERABLE_PROBLEM_RECORD_DIR}/reporter-$$"
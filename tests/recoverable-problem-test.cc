@@ -0,0 +1,244 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Ted Gould <ted.gould@canonical.com>
+ */
+
+#include <gtest/gtest.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+#include <algorithm>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+extern "C" {
+#include "recoverable-problem.h"
+}
+
+class RecoverableProblemTest : public ::testing::Test
+{
+	protected:
+		gchar * recorddir = NULL;
+
+		virtual void SetUp() {
+			recorddir = g_dir_make_tmp("recoverable-problem-test-XXXXXX", NULL);
+			ASSERT_NE(nullptr, recorddir);
+
+			g_setenv("RECOVERABLE_PROBLEM_RECORD_DIR", recorddir, TRUE);
+			g_setenv("UBUNTU_APP_LAUNCH_RECOVERABLE_PROBLEM_REPORTER", CMAKE_SOURCE_DIR "/recoverable-problem-record.sh", TRUE);
+			g_setenv("UBUNTU_APP_LAUNCH_APPORT_RECOVERABLE_PROBLEM", CMAKE_SOURCE_DIR "/recoverable-problem-apport.sh", TRUE);
+		}
+
+		virtual void TearDown() {
+			for (auto file : records("")) {
+				g_unlink((std::string(recorddir) + "/" + file).c_str());
+			}
+			g_rmdir(recorddir);
+			g_free(recorddir);
+
+			g_unsetenv("RECOVERABLE_PROBLEM_RECORD_DIR");
+			g_unsetenv("UBUNTU_APP_LAUNCH_RECOVERABLE_PROBLEM_REPORTER");
+			g_unsetenv("UBUNTU_APP_LAUNCH_APPORT_RECOVERABLE_PROBLEM");
+		}
+
+		/* Files the stubs have left, in order */
+		std::vector<std::string> records (const std::string & prefix, const std::string & suffix = "") {
+			std::vector<std::string> retval;
+			GDir * dir = g_dir_open(recorddir, 0, NULL);
+			const gchar * name = NULL;
+
+			while ((name = g_dir_read_name(dir)) != NULL) {
+				if (g_str_has_prefix(name, prefix.c_str()) && g_str_has_suffix(name, suffix.c_str())) {
+					retval.push_back(name);
+				}
+			}
+
+			g_dir_close(dir);
+			std::sort(retval.begin(), retval.end());
+			return retval;
+		}
+
+		/* The reporter runs in the background, give it a bit */
+		std::vector<std::string> waitForRecords (const std::string & prefix, const std::string & suffix, size_t count) {
+			for (int i = 0; i < 500 && records(prefix, suffix).size() < count; i++) {
+				g_usleep(10 * 1000);
+			}
+			return records(prefix, suffix);
+		}
+
+		std::string readRecord (const std::string & name) {
+			gchar * contents = NULL;
+			gsize length = 0;
+			gchar * path = g_build_filename(recorddir, name.c_str(), NULL);
+			g_file_get_contents(path, &contents, &length, NULL);
+			g_free(path);
+
+			std::string retval(contents == NULL ? "" : contents, length);
+			g_free(contents);
+			return retval;
+		}
+
+		/* Runs the real reporter with @input on its stdin */
+		gint runReporter (const std::string & input) {
+			GError * error = NULL;
+			GSubprocessLauncher * launcher = g_subprocess_launcher_new(G_SUBPROCESS_FLAGS_STDIN_PIPE);
+			GSubprocess * reporter = g_subprocess_launcher_spawn(launcher, &error, RECOVERABLE_PROBLEM_TOOL, NULL);
+			g_object_unref(launcher);
+			EXPECT_EQ(nullptr, error);
+
+			GBytes * bytes = g_bytes_new(input.data(), input.size());
+			g_subprocess_communicate(reporter, bytes, NULL, NULL, NULL, &error);
+			g_bytes_unref(bytes);
+			EXPECT_EQ(nullptr, error);
+
+			gint status = g_subprocess_get_exit_status(reporter);
+			g_object_unref(reporter);
+			return status;
+		}
+};
+
+/* What recoverable_problem gets, NUL separated */
+static std::string
+payload (const std::vector<std::string> & items)
+{
+	std::string retval;
+	for (auto item : items) {
+		if (!retval.empty()) {
+			retval.push_back('\0');
+		}
+		retval += item;
+	}
+	return retval;
+}
+
+/* How a report is queued for the reporter */
+static std::string
+frame (int pid, const std::string & payload)
+{
+	return std::to_string(pid) + "\n" + std::to_string(payload.size()) + "\n" + payload;
+}
+
+TEST_F(RecoverableProblemTest, DuplicatesDropped)
+{
+	const gchar * first[] = {"Key", "first", NULL};
+	const gchar * second[] = {"Key", "second", NULL};
+
+	report_recoverable_problem("test-duplicate", 1234, first);
+	report_recoverable_problem("test-duplicate", 1234, second);
+	report_recoverable_problem("test-other", 0, NULL);
+	recoverable_problem_flush();
+
+	auto reporters = waitForRecords("reporter-", "", 1);
+	ASSERT_EQ(1u, reporters.size());
+
+	EXPECT_EQ(frame(1234, payload({"DuplicateSignature", "test-duplicate", "Key", "first"})) +
+		frame(getpid(), payload({"DuplicateSignature", "test-other"})),
+		readRecord(reporters[0]));
+
+	/* Still the same problem after it's been sent */
+	report_recoverable_problem("test-duplicate", 1234, second);
+	recoverable_problem_flush();
+
+	g_usleep(200 * 1000);
+	EXPECT_EQ(1u, records("reporter-").size());
+}
+
+TEST_F(RecoverableProblemTest, OneReporterPerFlush)
+{
+	const gchar * properties[] = {"Key", "value", NULL};
+
+	report_recoverable_problem("test-one-reporter-1", 0, properties);
+	report_recoverable_problem("test-one-reporter-2", 0, properties);
+	report_recoverable_problem("test-one-reporter-3", 0, properties);
+	report_recoverable_problem(NULL, 0, properties);
+	recoverable_problem_flush();
+
+	/* The flush waits for it to have the whole queue */
+	auto reporters = records("reporter-");
+	ASSERT_EQ(1u, reporters.size());
+
+	/* PID zero is the one reporting */
+	EXPECT_EQ(frame(getpid(), payload({"DuplicateSignature", "test-one-reporter-1", "Key", "value"})) +
+		frame(getpid(), payload({"DuplicateSignature", "test-one-reporter-2", "Key", "value"})) +
+		frame(getpid(), payload({"DuplicateSignature", "test-one-reporter-3", "Key", "value"})) +
+		frame(getpid(), payload({"Key", "value"})),
+		readRecord(reporters[0]));
+
+	/* Nothing queued, nothing run */
+	recoverable_problem_flush();
+
+	g_usleep(200 * 1000);
+	EXPECT_EQ(1u, records("reporter-").size());
+}
+
+TEST_F(RecoverableProblemTest, ReporterSplits)
+{
+	std::string first = payload({"DuplicateSignature", "test-split", "Key", "line\nbreak"});
+	std::string second = payload({"Key", "value"});
+
+	EXPECT_EQ(0, runReporter(frame(1234, first) + frame(0, second) + frame(0, "")));
+
+	auto args = records("report-", ".args");
+	ASSERT_EQ(3u, args.size());
+
+	EXPECT_EQ("-p 1234", readRecord("report-0.args"));
+	EXPECT_EQ(first, readRecord("report-0.data"));
+	EXPECT_EQ("", readRecord("report-1.args"));
+	EXPECT_EQ(second, readRecord("report-1.data"));
+	EXPECT_EQ("", readRecord("report-2.args"));
+	EXPECT_EQ("", readRecord("report-2.data"));
+}
+
+TEST_F(RecoverableProblemTest, ReporterCorruptSize)
+{
+	/* Size past the end, the ones before it still go */
+	EXPECT_EQ(0, runReporter(frame(1, "abc") + "2\n99\nshort"));
+	EXPECT_EQ(1u, records("report-", ".args").size());
+	EXPECT_EQ("abc", readRecord("report-0.data"));
+
+	/* Not numbers */
+	EXPECT_EQ(0, runReporter("1\n3x\nabc"));
+	EXPECT_EQ(0, runReporter("1\n\nabc"));
+	EXPECT_EQ(0, runReporter("pid\n3\nabc"));
+	EXPECT_EQ(0, runReporter("1\n-3\nabc"));
+
+	/* Cut off before the size is done */
+	EXPECT_EQ(0, runReporter("1\n3"));
+	EXPECT_EQ(0, runReporter("1"));
+
+	/* Doesn't overflow into something small */
+	EXPECT_EQ(0, runReporter("1\n18446744073709551618\nabc"));
+
+	EXPECT_EQ(1u, records("report-", ".args").size());
+}
+
+TEST_F(RecoverableProblemTest, ThroughReporter)
+{
+	g_setenv("UBUNTU_APP_LAUNCH_RECOVERABLE_PROBLEM_REPORTER", RECOVERABLE_PROBLEM_TOOL, TRUE);
+
+	const gchar * properties[] = {"Key", "value", NULL};
+	report_recoverable_problem("test-through-1", 1234, properties);
+	report_recoverable_problem("test-through-2", 0, NULL);
+	recoverable_problem_flush();
+
+	ASSERT_EQ(2u, waitForRecords("report-", ".data", 2).size());
+
+	EXPECT_EQ("-p 1234", readRecord("report-0.args"));
+	EXPECT_EQ(payload({"DuplicateSignature", "test-through-1", "Key", "value"}), readRecord("report-0.data"));
+	EXPECT_EQ("-p " + std::to_string(getpid()), readRecord("report-1.args"));
+	EXPECT_EQ(payload({"DuplicateSignature", "test-through-2"}), readRecord("report-1.data"));
+}
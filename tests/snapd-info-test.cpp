@@ -19,6 +19,7 @@
 
 #include "snapd-info.h"
 #include "snapd-mock.h"
+#include <chrono>
 #include <gio/gio.h>
 #include <glib/gstdio.h>
 #include <gtest/gtest.h>
@@ -34,6 +35,9 @@ protected:
     virtual void TearDown()
     {
         g_unlink(SNAPD_TEST_SOCKET);
+        g_unsetenv("UBUNTU_APP_LAUNCH_DISABLE_SNAPD_TIMEOUT");
+        g_unsetenv("UBUNTU_APP_LAUNCH_SNAP_BASEDIR");
+        g_unsetenv("UBUNTU_APP_LAUNCH_SNAPD_STATEDIR");
     }
 };
 
@@ -65,15 +69,240 @@ TEST_F(SnapdInfo, PackageInfo)
     EXPECT_NE(pkginfo->appnames.end(), pkginfo->appnames.find("bar"));
 }
 
+TEST_F(SnapdInfo, KeepAlive)
+{
+    SnapdMock mock{SNAPD_TEST_SOCKET,
+                   {{"GET /v2/snaps/test-package HTTP/1.1\r\nHost: snapd\r\nAccept: */*\r\n\r\n",
+                     SnapdMock::httpJsonResponse(SnapdMock::snapdOkay(SnapdMock::packageJson(
+                         "test-package", "active", "app", "1.2.3.4", "x123", {"foo", "bar"})))},
+                    {"GET /v2/snaps/other-package HTTP/1.1\r\nHost: snapd\r\nAccept: */*\r\n\r\n",
+                     SnapdMock::httpJsonResponse(SnapdMock::snapdOkay(
+                         SnapdMock::packageJson("other-package", "active", "app", "2", "x2", {"other"})))},
+                    {"GET /v2/snaps/third-package HTTP/1.1\r\nHost: snapd\r\nAccept: */*\r\n\r\n",
+                     SnapdMock::httpJsonResponse(SnapdMock::snapdOkay(
+                         SnapdMock::packageJson("third-package", "active", "app", "3", "x3", {"third"})))}}};
+    auto info = std::make_shared<ubuntu::app_launch::snapd::Info>();
+
+    auto first = info->pkgInfo(ubuntu::app_launch::AppID::Package::from_raw("test-package"));
+    auto second = info->pkgInfo(ubuntu::app_launch::AppID::Package::from_raw("other-package"));
+    auto third = info->pkgInfo(ubuntu::app_launch::AppID::Package::from_raw("third-package"));
+
+    mock.result();
+
+    EXPECT_NE(nullptr, first);
+    EXPECT_NE(nullptr, second);
+    EXPECT_NE(nullptr, third);
+
+    /* All of them went over the one connection, which is still open */
+    EXPECT_EQ(1u, mock.connectionCount());
+    EXPECT_EQ(std::vector<unsigned int>{3u}, mock.requestsPerConnection());
+}
+
+TEST_F(SnapdInfo, PackageInfoCached)
+{
+    SnapdMock mock{SNAPD_TEST_SOCKET,
+                   {{"GET /v2/snaps/test-package HTTP/1.1\r\nHost: snapd\r\nAccept: */*\r\n\r\n",
+                     SnapdMock::httpJsonResponse(SnapdMock::snapdOkay(SnapdMock::packageJson(
+                         "test-package", "active", "app", "1.2.3.4", "x123", {"foo", "bar"})))}}};
+    auto info = std::make_shared<ubuntu::app_launch::snapd::Info>();
+
+    auto first = info->pkgInfo(ubuntu::app_launch::AppID::Package::from_raw("test-package"));
+    auto second = info->pkgInfo(ubuntu::app_launch::AppID::Package::from_raw("test-package"));
+
+    /* Only one request should have been made */
+    mock.result();
+
+    ASSERT_NE(nullptr, first);
+    EXPECT_EQ(first, second);
+
+    auto metrics = info->metrics();
+    EXPECT_EQ(1u, metrics.cacheHits);
+    EXPECT_EQ(1u, metrics.cacheMisses);
+    EXPECT_EQ(1u, metrics.requests);
+    EXPECT_EQ(0u, metrics.failures);
+}
+
+TEST_F(SnapdInfo, PackageInfoNegativeCache)
+{
+    SnapdMock mock{SNAPD_TEST_SOCKET,
+                   {{"GET /v2/snaps/test-package HTTP/1.1\r\nHost: snapd\r\nAccept: */*\r\n\r\n",
+                     SnapdMock::httpJsonResponse(
+                         "{ 'status': 'FAIL', 'status-code': 404, 'type': 'sync', 'result': { } }")}}};
+    auto info = std::make_shared<ubuntu::app_launch::snapd::Info>();
+
+    auto first = info->pkgInfo(ubuntu::app_launch::AppID::Package::from_raw("test-package"));
+    auto second = info->pkgInfo(ubuntu::app_launch::AppID::Package::from_raw("test-package"));
+
+    /* The missing package is remembered, so only one request */
+    mock.result();
+
+    EXPECT_EQ(nullptr, first);
+    EXPECT_EQ(nullptr, second);
+    EXPECT_EQ(1u, info->metrics().cacheHits);
+}
+
+TEST_F(SnapdInfo, CacheInvalidation)
+{
+    auto basedir = CMAKE_BINARY_DIR "/snapd-info-basedir";
+    g_spawn_command_line_sync("rm -rf " CMAKE_BINARY_DIR "/snapd-info-basedir", NULL, NULL, NULL, NULL);
+    ASSERT_EQ(0, g_mkdir_with_parents(basedir, 0700));
+    g_setenv("UBUNTU_APP_LAUNCH_SNAP_BASEDIR", basedir, TRUE);
+    g_setenv("UBUNTU_APP_LAUNCH_SNAPD_STATEDIR", basedir, TRUE);
+
+    SnapdMock mock{SNAPD_TEST_SOCKET,
+                   {{"GET /v2/snaps/test-package HTTP/1.1\r\nHost: snapd\r\nAccept: */*\r\n\r\n",
+                     SnapdMock::httpJsonResponse(SnapdMock::snapdOkay(SnapdMock::packageJson(
+                         "test-package", "active", "app", "1.2.3.4", "x123", {"foo", "bar"})))},
+                    {"GET /v2/snaps/test-package HTTP/1.1\r\nHost: snapd\r\nAccept: */*\r\n\r\n",
+                     SnapdMock::httpJsonResponse(SnapdMock::snapdOkay(SnapdMock::packageJson(
+                         "test-package", "active", "app", "1.2.3.5", "x124", {"foo", "bar"})))}}};
+    auto info = std::make_shared<ubuntu::app_launch::snapd::Info>();
+
+    auto first = info->pkgInfo(ubuntu::app_launch::AppID::Package::from_raw("test-package"));
+
+    /* Installing a new revision adds to the snap directory */
+    ASSERT_EQ(0, g_mkdir(CMAKE_BINARY_DIR "/snapd-info-basedir/x124", 0700));
+
+    auto second = info->pkgInfo(ubuntu::app_launch::AppID::Package::from_raw("test-package"));
+
+    mock.result();
+
+    ASSERT_NE(nullptr, first);
+    ASSERT_NE(nullptr, second);
+    EXPECT_EQ("x123", first->revision);
+    EXPECT_EQ("x124", second->revision);
+    EXPECT_EQ(0u, info->metrics().cacheHits);
+
+    g_spawn_command_line_sync("rm -rf " CMAKE_BINARY_DIR "/snapd-info-basedir", NULL, NULL, NULL, NULL);
+}
+
+TEST_F(SnapdInfo, Backoff)
+{
+    /* Slower than the timeout so the first request fails */
+    SnapdMock mock{SNAPD_TEST_SOCKET,
+                   {{"GET /v2/snaps/test-package HTTP/1.1\r\nHost: snapd\r\nAccept: */*\r\n\r\n",
+                     SnapdMock::httpJsonResponse(SnapdMock::snapdOkay(SnapdMock::packageJson(
+                         "test-package", "active", "app", "1.2.3.4", "x123", {"foo", "bar"})))}},
+                   std::chrono::milliseconds{200}};
+    auto info = std::make_shared<ubuntu::app_launch::snapd::Info>();
+
+    auto first = info->pkgInfo(ubuntu::app_launch::AppID::Package::from_raw("test-package"));
+    auto second = info->pkgInfo(ubuntu::app_launch::AppID::Package::from_raw("test-package"));
+
+    EXPECT_EQ(nullptr, first);
+    EXPECT_EQ(nullptr, second);
+
+    auto metrics = info->metrics();
+    EXPECT_EQ(1u, metrics.requests);
+    EXPECT_EQ(1u, metrics.failures);
+    EXPECT_EQ(1u, metrics.backedOff);
+}
+
+TEST_F(SnapdInfo, BackoffRacyDirectory)
+{
+    /* Just made, so its time is too recent to be trusted and the cache is
+       checked again on each call, which shouldn't end the backoff */
+    auto basedir = CMAKE_BINARY_DIR "/snapd-info-basedir";
+    g_spawn_command_line_sync("rm -rf " CMAKE_BINARY_DIR "/snapd-info-basedir", NULL, NULL, NULL, NULL);
+    ASSERT_EQ(0, g_mkdir_with_parents(basedir, 0700));
+    g_setenv("UBUNTU_APP_LAUNCH_SNAP_BASEDIR", basedir, TRUE);
+    g_setenv("UBUNTU_APP_LAUNCH_SNAPD_STATEDIR", basedir, TRUE);
+
+    /* Slower than the timeout so the first request fails */
+    SnapdMock mock{SNAPD_TEST_SOCKET,
+                   {{"GET /v2/snaps/test-package HTTP/1.1\r\nHost: snapd\r\nAccept: */*\r\n\r\n",
+                     SnapdMock::httpJsonResponse(SnapdMock::snapdOkay(SnapdMock::packageJson(
+                         "test-package", "active", "app", "1.2.3.4", "x123", {"foo", "bar"})))}},
+                   std::chrono::milliseconds{200}};
+    auto info = std::make_shared<ubuntu::app_launch::snapd::Info>();
+
+    auto first = info->pkgInfo(ubuntu::app_launch::AppID::Package::from_raw("test-package"));
+    auto second = info->pkgInfo(ubuntu::app_launch::AppID::Package::from_raw("test-package"));
+    auto third = info->pkgInfo(ubuntu::app_launch::AppID::Package::from_raw("test-package"));
+
+    EXPECT_EQ(nullptr, first);
+    EXPECT_EQ(nullptr, second);
+    EXPECT_EQ(nullptr, third);
+
+    auto metrics = info->metrics();
+    EXPECT_EQ(1u, metrics.requests);
+    EXPECT_EQ(1u, metrics.failures);
+    EXPECT_EQ(2u, metrics.backedOff);
+
+    g_spawn_command_line_sync("rm -rf " CMAKE_BINARY_DIR "/snapd-info-basedir", NULL, NULL, NULL, NULL);
+}
+
+TEST_F(SnapdInfo, PackageInfoBulk)
+{
+    SnapdMock mock{SNAPD_TEST_SOCKET,
+                   {{"GET /v2/snaps HTTP/1.1\r\nHost: snapd\r\nAccept: */*\r\n\r\n",
+                     SnapdMock::httpJsonResponse(SnapdMock::snapdOkay(SnapdMock::snapsJson(
+                         {SnapdMock::packageJson("test-package", "active", "app", "1.2.3.4", "x123", {"foo", "bar"}),
+                          SnapdMock::packageJson("other-package", "active", "app", "2", "x2", {"other"}),
+                          SnapdMock::packageJson("core", "active", "os", "16", "x16", {}),
+                          SnapdMock::packageJson("unasked-package", "active", "app", "3", "x3", {"unasked"})})))}}};
+    auto info = std::make_shared<ubuntu::app_launch::snapd::Info>();
+
+    auto pkginfos = info->pkgInfo(std::set<std::string>{"test-package", "other-package", "core"});
+
+    mock.result();
+
+    EXPECT_EQ(2u, pkginfos.size());
+    ASSERT_NE(nullptr, pkginfos["test-package"]);
+    EXPECT_EQ("x123", pkginfos["test-package"]->revision);
+    EXPECT_EQ("/snap/test-package/x123", pkginfos["test-package"]->directory);
+    ASSERT_NE(nullptr, pkginfos["other-package"]);
+    EXPECT_EQ("x2", pkginfos["other-package"]->revision);
+    EXPECT_EQ(pkginfos.end(), pkginfos.find("core"));
+    EXPECT_EQ(pkginfos.end(), pkginfos.find("unasked-package"));
+}
+
+TEST_F(SnapdInfo, AppsForInterfacesParallel)
+{
+    /* Each response is delayed so we can see that they're not done in series */
+    auto latency = std::chrono::milliseconds{50};
+    g_setenv("UBUNTU_APP_LAUNCH_DISABLE_SNAPD_TIMEOUT", "1", TRUE);
+
+    SnapdMock mock{SNAPD_TEST_SOCKET,
+                   {{"GET /v2/interfaces HTTP/1.1\r\nHost: snapd\r\nAccept: */*\r\n\r\n",
+                     SnapdMock::httpJsonResponse(SnapdMock::snapdOkay(
+                         SnapdMock::interfacesJson({{"unity8", "test-package", {"foo"}},
+                                                    {"unity7", "other-package", {"other"}},
+                                                    {"noniface", "test-package", {"bar"}}})))},
+                    {"GET /v2/snaps HTTP/1.1\r\nHost: snapd\r\nAccept: */*\r\n\r\n",
+                     SnapdMock::httpJsonResponse(SnapdMock::snapdOkay(SnapdMock::snapsJson(
+                         {SnapdMock::packageJson("test-package", "active", "app", "1.2.3.4", "x123", {"foo", "bar"}),
+                          SnapdMock::packageJson("other-package", "active", "app", "2", "x2", {"other"})})))}},
+                   latency};
+    auto info = std::make_shared<ubuntu::app_launch::snapd::Info>();
+
+    auto start = std::chrono::steady_clock::now();
+    auto apps = info->appsForInterfaces(std::set<std::string>{"unity7", "unity8"});
+    auto elapsed = std::chrono::steady_clock::now() - start;
+
+    mock.result();
+
+    ASSERT_EQ(2u, apps.size());
+    EXPECT_EQ(ubuntu::app_launch::AppID::parse("other-package_other_x2"), apps.front().appid);
+    EXPECT_EQ("unity7", apps.front().interface);
+    EXPECT_EQ(ubuntu::app_launch::AppID::parse("test-package_foo_x123"), apps.back().appid);
+    EXPECT_EQ("unity8", apps.back().interface);
+    ASSERT_NE(nullptr, apps.back().pkginfo);
+    EXPECT_EQ("/snap/test-package/x123", apps.back().pkginfo->directory);
+
+    /* In series this would take at least twice the latency */
+    EXPECT_LT(elapsed, latency * 2);
+}
+
 TEST_F(SnapdInfo, AppsForInterface)
 {
     SnapdMock mock{SNAPD_TEST_SOCKET,
                    {{"GET /v2/interfaces HTTP/1.1\r\nHost: snapd\r\nAccept: */*\r\n\r\n",
                      SnapdMock::httpJsonResponse(SnapdMock::snapdOkay(
                          SnapdMock::interfacesJson({{"unity8", "test-package", {"foo", "bar"}}})))},
-                    {"GET /v2/snaps/test-package HTTP/1.1\r\nHost: snapd\r\nAccept: */*\r\n\r\n",
-                     SnapdMock::httpJsonResponse(SnapdMock::snapdOkay(SnapdMock::packageJson(
-                         "test-package", "active", "app", "1.2.3.4", "x123", {"foo", "bar"})))}}};
+                    {"GET /v2/snaps HTTP/1.1\r\nHost: snapd\r\nAccept: */*\r\n\r\n",
+                     SnapdMock::httpJsonResponse(SnapdMock::snapdOkay(SnapdMock::snapsJson({SnapdMock::packageJson(
+                         "test-package", "active", "app", "1.2.3.4", "x123", {"foo", "bar"})})))}}};
 
     auto info = std::make_shared<ubuntu::app_launch::snapd::Info>();
 
@@ -122,17 +351,20 @@ TEST_F(SnapdInfo, BadJson)
              SnapdMock::httpJsonResponse(SnapdMock::snapdOkay("'«This is not an object»'"))},
 
         }};
-    auto info = std::make_shared<ubuntu::app_launch::snapd::Info>();
 
-    auto badjson = info->pkgInfo(ubuntu::app_launch::AppID::Package::from_raw("test-package"));
+    /* Failures are cached, so each one needs a new object */
+    auto badjson = std::make_shared<ubuntu::app_launch::snapd::Info>()->pkgInfo(
+        ubuntu::app_launch::AppID::Package::from_raw("test-package"));
 
     EXPECT_EQ(nullptr, badjson);
 
-    auto err404 = info->pkgInfo(ubuntu::app_launch::AppID::Package::from_raw("test-package"));
+    auto err404 = std::make_shared<ubuntu::app_launch::snapd::Info>()->pkgInfo(
+        ubuntu::app_launch::AppID::Package::from_raw("test-package"));
 
     EXPECT_EQ(nullptr, err404);
 
-    auto noobj = info->pkgInfo(ubuntu::app_launch::AppID::Package::from_raw("test-package"));
+    auto noobj = std::make_shared<ubuntu::app_launch::snapd::Info>()->pkgInfo(
+        ubuntu::app_launch::AppID::Package::from_raw("test-package"));
 
     EXPECT_EQ(nullptr, noobj);
 
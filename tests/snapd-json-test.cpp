@@ -0,0 +1,513 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Ted Gould <ted.gould@canonical.com>
+ */
+
+#include "snapd-json.h"
+#include <chrono>
+#include <functional>
+#include <gtest/gtest.h>
+#include <iostream>
+#include <json-glib/json-glib.h>
+#include <map>
+#include <memory>
+#include <set>
+#include <vector>
+
+using Reader = ubuntu::app_launch::snapd::json::Reader;
+
+/* Interface -> snap -> apps, which is what we pull out of the interfaces */
+typedef std::map<std::string, std::map<std::string, std::set<std::string>>> PlugMap;
+/* Snap name -> revision and apps, which is what we pull out of the snaps */
+typedef std::map<std::string, std::pair<std::string, std::set<std::string>>> SnapMap;
+
+class SnapdJson : public ::testing::Test
+{
+protected:
+    Reader reader(const std::string &json)
+    {
+        return Reader(json.data(), json.data() + json.size());
+    }
+
+    /* Builds a response like snapd gives for /v2/snaps on a device with a
+       lot of snaps, with all the members that we don't care about */
+    std::string snapsPayload(unsigned int count)
+    {
+        std::string json = "{\"type\":\"sync\",\"status-code\":200,\"status\":\"OK\",\"result\":[";
+
+        for (unsigned int i = 0; i < count; i++)
+        {
+            auto name = "snap-" + std::to_string(i);
+            if (i != 0)
+            {
+                json += ",";
+            }
+
+            json += "{\"id\":\"ZvL8dIzrFgWOKLSBdgsTvk3vPLCt2w" + std::to_string(i) + "\",";
+            json += "\"title\":\"" + name + "\",";
+            json += "\"summary\":\"A snap that is used for \\\"testing\\\" the parser\",";
+            json += "\"description\":\"This is a long description of the snap, which goes on and on.\\n\\n";
+            json += "It has a few paragraphs in it, like the ones that are in the store \\u2014 and some ";
+            json += "unicode.\",";
+            json += "\"icon\":\"/v2/icons/" + name + "/icon\",";
+            json += "\"installed-size\":" + std::to_string(12345678 + i) + ",";
+            json += "\"install-date\":\"2016-11-21T14:52:03.000000000Z\",";
+            json += "\"name\":\"" + name + "\",";
+            json += "\"developer\":\"canonical\",";
+            json += "\"status\":\"active\",";
+            json += "\"type\":\"" + std::string(i % 10 == 0 ? "os" : "app") + "\",";
+            json += "\"version\":\"1." + std::to_string(i) + "\",";
+            json += "\"channel\":\"stable\",";
+            json += "\"ignore-validation\":false,";
+            json += "\"revision\":\"x" + std::to_string(i) + "\",";
+            json += "\"confinement\":\"strict\",";
+            json += "\"private\":false,";
+            json += "\"devmode\":false,";
+            json += "\"jailmode\":false,";
+            json += "\"trymode\":false,";
+            json += "\"apps\":[";
+            for (unsigned int j = 0; j < 3; j++)
+            {
+                if (j != 0)
+                {
+                    json += ",";
+                }
+                json += "{\"snap\":\"" + name + "\",\"name\":\"app" + std::to_string(j) + "\",";
+                json += "\"desktop-file\":\"/var/lib/snapd/desktop/applications/" + name + "_app" +
+                        std::to_string(j) + ".desktop\"}";
+            }
+            json += "],";
+            json += "\"broken\":\"\",";
+            json += "\"contact\":\"mailto:snaps@example.com\",";
+            json += "\"mounted-from\":\"/var/lib/snapd/snaps/" + name + "_x" + std::to_string(i) + ".snap\"}";
+        }
+
+        return json + "],\"sources\":[\"local\"]}";
+    }
+
+    /* Builds a response like snapd gives for /v2/interfaces on a device
+       with a lot of snaps, with slots and connections */
+    std::string interfacesPayload(unsigned int count)
+    {
+        const std::vector<std::string> interfaces{"unity7", "unity8", "x11", "home", "network", "opengl", "pulseaudio"};
+        std::string json = "{\"type\":\"sync\",\"status-code\":200,\"status\":\"OK\",\"result\":{\"plugs\":[";
+
+        for (unsigned int i = 0; i < count; i++)
+        {
+            auto name = "snap-" + std::to_string(i);
+
+            for (unsigned int j = 0; j < interfaces.size(); j++)
+            {
+                if (i != 0 || j != 0)
+                {
+                    json += ",";
+                }
+
+                json += "{\"snap\":\"" + name + "\",\"plug\":\"" + interfaces[j] + "\",";
+                json += "\"interface\":\"" + interfaces[j] + "\",";
+                json += "\"attrs\":{\"content\":\"" + interfaces[j] + "\",\"default-provider\":\"core\"},";
+                json += "\"apps\":[\"app0\",\"app1\",\"app2\"],";
+                json += "\"label\":\"Plug for " + interfaces[j] + "\",";
+                json += "\"connections\":[{\"snap\":\"core\",\"slot\":\"" + interfaces[j] + "\"}]}";
+            }
+        }
+
+        json += "],\"slots\":[";
+
+        for (unsigned int j = 0; j < interfaces.size(); j++)
+        {
+            if (j != 0)
+            {
+                json += ",";
+            }
+
+            json += "{\"snap\":\"core\",\"slot\":\"" + interfaces[j] + "\",\"interface\":\"" + interfaces[j] + "\",";
+            json += "\"label\":\"Slot for " + interfaces[j] + "\",\"connections\":[";
+            for (unsigned int i = 0; i < count; i++)
+            {
+                if (i != 0)
+                {
+                    json += ",";
+                }
+                json += "{\"snap\":\"snap-" + std::to_string(i) + "\",\"plug\":\"" + interfaces[j] + "\"}";
+            }
+            json += "]}";
+        }
+
+        return json + "]}}";
+    }
+
+    /* Gets the 'result' member out of a snapd response */
+    Reader resultReader(const std::string &json)
+    {
+        std::string member;
+        auto resultreader = reader(json);
+
+        resultreader.beginObject();
+        while (resultreader.nextMember(member))
+        {
+            if (member == "result")
+            {
+                return resultreader;
+            }
+            resultreader.skip();
+        }
+
+        throw std::runtime_error("No result");
+    }
+
+    /* How we used to do it, building up the tree and then going through it */
+    PlugMap plugsWithDom(const std::string &json)
+    {
+        PlugMap plugs;
+
+        auto parser =
+            std::shared_ptr<JsonParser>(json_parser_new(), [](JsonParser *parser) { g_clear_object(&parser); });
+        EXPECT_TRUE(json_parser_load_from_data(parser.get(), json.data(), json.size(), nullptr));
+
+        auto root = json_node_get_object(json_parser_get_root(parser.get()));
+        auto result = json_object_get_object_member(root, "result");
+        auto plugarray = json_object_get_array_member(result, "plugs");
+        for (unsigned int i = 0; i < json_array_get_length(plugarray); i++)
+        {
+            auto plug = json_array_get_object_element(plugarray, i);
+            auto &apps = plugs[json_object_get_string_member(plug, "interface")]
+                              [json_object_get_string_member(plug, "snap")];
+
+            auto appsarray = json_object_get_array_member(plug, "apps");
+            for (unsigned int j = 0; j < json_array_get_length(appsarray); j++)
+            {
+                apps.insert(json_array_get_string_element(appsarray, j));
+            }
+        }
+
+        return plugs;
+    }
+
+    /* Reading the plugs without building up a tree */
+    PlugMap plugsWithReader(const std::string &json)
+    {
+        PlugMap plugs;
+        std::string member, snap, interface;
+        std::set<std::string> apps;
+
+        auto result = resultReader(json);
+        result.beginObject();
+        while (result.nextMember(member))
+        {
+            if (member != "plugs")
+            {
+                result.skip();
+                continue;
+            }
+
+            result.beginArray();
+            while (result.nextElement())
+            {
+                apps.clear();
+                result.beginObject();
+                while (result.nextMember(member))
+                {
+                    if (member == "snap")
+                    {
+                        result.readString(snap);
+                    }
+                    else if (member == "interface")
+                    {
+                        result.readString(interface);
+                    }
+                    else if (member == "apps")
+                    {
+                        result.beginArray();
+                        while (result.nextElement())
+                        {
+                            apps.insert(result.readString());
+                        }
+                    }
+                    else
+                    {
+                        result.skip();
+                    }
+                }
+
+                plugs[interface][snap].insert(apps.begin(), apps.end());
+            }
+        }
+
+        return plugs;
+    }
+
+    SnapMap snapsWithDom(const std::string &json)
+    {
+        SnapMap snaps;
+
+        auto parser =
+            std::shared_ptr<JsonParser>(json_parser_new(), [](JsonParser *parser) { g_clear_object(&parser); });
+        EXPECT_TRUE(json_parser_load_from_data(parser.get(), json.data(), json.size(), nullptr));
+
+        auto root = json_node_get_object(json_parser_get_root(parser.get()));
+        auto result = json_object_get_array_member(root, "result");
+        for (unsigned int i = 0; i < json_array_get_length(result); i++)
+        {
+            auto snap = json_array_get_object_element(result, i);
+            if (std::string{json_object_get_string_member(snap, "type")} != "app")
+            {
+                continue;
+            }
+
+            auto &info = snaps[json_object_get_string_member(snap, "name")];
+            info.first = json_object_get_string_member(snap, "revision");
+
+            auto appsarray = json_object_get_array_member(snap, "apps");
+            for (unsigned int j = 0; j < json_array_get_length(appsarray); j++)
+            {
+                info.second.insert(
+                    json_object_get_string_member(json_array_get_object_element(appsarray, j), "name"));
+            }
+        }
+
+        return snaps;
+    }
+
+    SnapMap snapsWithReader(const std::string &json)
+    {
+        SnapMap snaps;
+        std::string member, appmember, name, type, revision;
+        std::set<std::string> apps;
+
+        auto result = resultReader(json);
+        result.beginArray();
+        while (result.nextElement())
+        {
+            apps.clear();
+            result.beginObject();
+            while (result.nextMember(member))
+            {
+                if (member == "name")
+                {
+                    result.readString(name);
+                }
+                else if (member == "type")
+                {
+                    result.readString(type);
+                }
+                else if (member == "revision")
+                {
+                    result.readString(revision);
+                }
+                else if (member == "apps")
+                {
+                    result.beginArray();
+                    while (result.nextElement())
+                    {
+                        result.beginObject();
+                        while (result.nextMember(appmember))
+                        {
+                            if (appmember == "name")
+                            {
+                                apps.insert(result.readString());
+                            }
+                            else
+                            {
+                                result.skip();
+                            }
+                        }
+                    }
+                }
+                else
+                {
+                    result.skip();
+                }
+            }
+
+            if (type == "app")
+            {
+                snaps[name] = std::make_pair(revision, apps);
+            }
+        }
+
+        return snaps;
+    }
+
+    /* Runs a function a number of times and returns the average time */
+    template <typename T>
+    std::chrono::microseconds timeIt(unsigned int iterations, std::function<T()> func, T &result)
+    {
+        auto start = std::chrono::steady_clock::now();
+        for (unsigned int i = 0; i < iterations; i++)
+        {
+            result = func();
+        }
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start) /
+               iterations;
+    }
+};
+
+TEST_F(SnapdJson, ReadObject)
+{
+    std::string json{"{ \"name\": \"foo\", \"count\": 42, \"neg\": -7, \"ok\": true, \"none\": null, "
+                     "\"list\": [ \"a\", \"b\" ], \"empty\": {} }"};
+    auto json_reader = reader(json);
+    std::string member;
+    std::set<std::string> members;
+
+    ASSERT_EQ(Reader::Type::OBJECT, json_reader.peek());
+    json_reader.beginObject();
+    while (json_reader.nextMember(member))
+    {
+        members.insert(member);
+
+        if (member == "name")
+        {
+            EXPECT_EQ("foo", json_reader.readString());
+        }
+        else if (member == "count")
+        {
+            EXPECT_EQ(42, json_reader.readInt());
+        }
+        else if (member == "neg")
+        {
+            EXPECT_EQ(-7, json_reader.readInt());
+        }
+        else if (member == "ok")
+        {
+            EXPECT_TRUE(json_reader.readBoolean());
+        }
+        else if (member == "none")
+        {
+            EXPECT_EQ(Reader::Type::NONE, json_reader.peek());
+            json_reader.readNull();
+        }
+        else if (member == "list")
+        {
+            std::vector<std::string> list;
+            json_reader.beginArray();
+            while (json_reader.nextElement())
+            {
+                list.push_back(json_reader.readString());
+            }
+            EXPECT_EQ((std::vector<std::string>{"a", "b"}), list);
+        }
+        else if (member == "empty")
+        {
+            std::string emptymember;
+            json_reader.beginObject();
+            EXPECT_FALSE(json_reader.nextMember(emptymember));
+        }
+    }
+    json_reader.end();
+
+    EXPECT_EQ(7u, members.size());
+}
+
+TEST_F(SnapdJson, Strings)
+{
+    std::string json{"[ \"quote \\\" slash \\\\ \\/ \\b\\f\\n\\r\\t\", \"\\u00e9\\u2014\\ud83d\\ude00\", "
+                     "'single \"quotes\" \\n', \"\" ]"};
+    auto json_reader = reader(json);
+
+    json_reader.beginArray();
+    ASSERT_TRUE(json_reader.nextElement());
+    EXPECT_EQ("quote \" slash \\ / \b\f\n\r\t", json_reader.readString());
+    ASSERT_TRUE(json_reader.nextElement());
+    EXPECT_EQ("\xc3\xa9\xe2\x80\x94\xf0\x9f\x98\x80", json_reader.readString());
+    ASSERT_TRUE(json_reader.nextElement());
+    /* Like json-glib there are no escapes in single quotes */
+    EXPECT_EQ("single \"quotes\" \\n", json_reader.readString());
+    ASSERT_TRUE(json_reader.nextElement());
+    EXPECT_EQ("", json_reader.readString());
+    EXPECT_FALSE(json_reader.nextElement());
+    json_reader.end();
+}
+
+TEST_F(SnapdJson, Skip)
+{
+    std::string json{"[ { \"a\": [ 1, 2.5, -3e10, { \"b\": [ [], {} ] } ], \"c\": \"]}\" }, \"after\" ]"};
+    auto json_reader = reader(json);
+
+    json_reader.beginArray();
+    ASSERT_TRUE(json_reader.nextElement());
+    json_reader.skip();
+    ASSERT_TRUE(json_reader.nextElement());
+    EXPECT_EQ("after", json_reader.readString());
+    EXPECT_FALSE(json_reader.nextElement());
+    json_reader.end();
+}
+
+TEST_F(SnapdJson, Errors)
+{
+    std::vector<std::string> badjson{"«This is not valid JSON»", "[ 1, ]", "[ 1 2 ]", "{ \"a\" 1 }", "{ \"a\": 1 } x",
+                                     "\"unterminated", "\"\\ud800\"", "\"\\q\"", "[ -, 1 ]", "[ 1.e5 ]", "{ a: 1 }",
+                                     "[ tru ]", "\"control \x01\"", "[[[[[", ""};
+
+    for (const auto &json : badjson)
+    {
+        EXPECT_THROW(
+            {
+                auto json_reader = reader(json);
+                json_reader.skip();
+                json_reader.end();
+            },
+            std::runtime_error)
+            << "JSON: " << json;
+    }
+
+    /* Asking for the wrong type */
+    EXPECT_THROW(reader("42").readString(), std::runtime_error);
+    EXPECT_THROW(reader("\"42\"").readInt(), std::runtime_error);
+    EXPECT_THROW(reader("4.2").readInt(), std::runtime_error);
+    EXPECT_THROW(reader("9223372036854775808").readInt(), std::runtime_error);
+    EXPECT_THROW(reader("[]").beginObject(), std::runtime_error);
+
+    /* Too deep to skip */
+    std::string deep(1000, '[');
+    deep += std::string(1000, ']');
+    EXPECT_THROW(reader(deep).skip(), std::runtime_error);
+}
+
+TEST_F(SnapdJson, BenchmarkInterfaces)
+{
+    auto json = interfacesPayload(200);
+    PlugMap dom, streaming;
+
+    auto domtime = timeIt<PlugMap>(20, [this, &json]() { return plugsWithDom(json); }, dom);
+    auto streamtime = timeIt<PlugMap>(20, [this, &json]() { return plugsWithReader(json); }, streaming);
+
+    std::cout << "Interfaces payload of " << json.size() << " bytes: json-glib " << domtime.count()
+              << "us, streaming " << streamtime.count() << "us" << std::endl;
+
+    EXPECT_EQ(7u, streaming.size());
+    EXPECT_EQ(200u, streaming["unity8"].size());
+    EXPECT_EQ(dom, streaming);
+}
+
+TEST_F(SnapdJson, BenchmarkSnaps)
+{
+    auto json = snapsPayload(200);
+    SnapMap dom, streaming;
+
+    auto domtime = timeIt<SnapMap>(20, [this, &json]() { return snapsWithDom(json); }, dom);
+    auto streamtime = timeIt<SnapMap>(20, [this, &json]() { return snapsWithReader(json); }, streaming);
+
+    std::cout << "Snaps payload of " << json.size() << " bytes: json-glib " << domtime.count() << "us, streaming "
+              << streamtime.count() << "us" << std::endl;
+
+    EXPECT_EQ(180u, streaming.size());
+    EXPECT_EQ("x1", streaming["snap-1"].first);
+    EXPECT_EQ(3u, streaming["snap-1"].second.size());
+    EXPECT_EQ(dom, streaming);
+}
@@ -18,24 +18,34 @@
  */
 
 #include "glib-thread.h"
+#include <chrono>
 #include <future>
 #include <gio/gio.h>
 #include <gio/gunixsocketaddress.h>
 #include <gtest/gtest.h>
 #include <list>
 #include <numeric>
+#include <vector>
 
 class SnapdMock
 {
 public:
     /** Initialize the mock with a list of files to use as
-        input and output. Each will be sent in order. */
-    SnapdMock(const std::string &socketPath, std::list<std::pair<std::string, std::string>> interactions)
+        input and output. Each request is matched to the first unused
+        test case with the same input, falling back to the first unused
+        test case, so requests that come in parallel can be in any order.
+        Connections are kept alive so that several requests can come
+        over the same one. A latency can be added before each response
+        is sent. */
+    SnapdMock(const std::string &socketPath,
+              std::list<std::pair<std::string, std::string>> interactions,
+              std::chrono::milliseconds latency = std::chrono::milliseconds{0})
         : thread()
+        , latency(latency)
     {
         for (auto interaction : interactions)
         {
-            TestCase testcase{interaction.first, interaction.second, {}, {}};
+            TestCase testcase{interaction.first, interaction.second, {}, false};
             testCases.push_back(testcase);
         }
 
@@ -105,10 +115,7 @@ public:
     ~SnapdMock()
     {
         thread.executeOnThread<bool>([this]() {
-            for (auto testcase : testCases)
-            {
-                testcase.connection.reset(); /* ensure these get dropped on teh thread */
-            }
+            connections.clear(); /* ensure these get dropped, and reads cancelled, on the thread */
             socketService.reset();
 
             return true;
@@ -137,6 +144,26 @@ public:
         }
     }
 
+    /** Number of socket connections that were made to the mock */
+    inline unsigned int connectionCount()
+    {
+        return thread.executeOnThread<unsigned int>([this]() { return connectionsMade; });
+    }
+
+    /** Number of requests that came over each of the connections, in
+        the order they were made */
+    inline std::vector<unsigned int> requestsPerConnection()
+    {
+        return thread.executeOnThread<std::vector<unsigned int>>([this]() {
+            std::vector<unsigned int> counts;
+            for (const auto &conn : connections)
+            {
+                counts.push_back(conn->requests);
+            }
+            return counts;
+        });
+    }
+
 private:
     GLib::ContextThread thread;
     std::shared_ptr<GSocketService> socketService;
@@ -146,11 +173,23 @@ private:
         std::string input;
         std::string output;
         std::string result;
+        bool used;
+    };
+
+    struct Connection
+    {
+        SnapdMock *mock;
         std::shared_ptr<GSocketConnection> connection;
+        std::shared_ptr<GCancellable> cancel;
+        std::string buffer;
+        unsigned int requests;
     };
 
+    std::chrono::milliseconds latency;
     std::list<TestCase> testCases;
     std::list<TestCase> extraCases;
+    std::list<std::shared_ptr<Connection>> connections;
+    unsigned int connectionsMade = 0;
 
     static gboolean serviceConnectedStatic(GSocketService *service,
                                            GSocketConnection *connection,
@@ -165,78 +204,42 @@ private:
 
     bool serviceConnected(std::shared_ptr<GSocketConnection> connection)
     {
-        for (auto &testcase : testCases)
-        {
-            if (testcase.connection)
-            {
-                /* We don't want ones that already have a connection */
-                continue;
-            }
-
-            testcase.connection = connection;
+        auto cancel = std::shared_ptr<GCancellable>(g_cancellable_new(), [](GCancellable *cancel) {
+            g_cancellable_cancel(cancel);
+            g_object_unref(cancel);
+        });
+        auto conn = std::make_shared<Connection>(Connection{this, connection, cancel, {}, 0});
+        connections.push_back(conn);
+        connectionsMade++;
 
-            auto input = g_io_stream_get_input_stream(G_IO_STREAM(connection.get()));  // transfer: none
-            g_input_stream_read_bytes_async(input,                                     /* stream */
-                                            1024,                                      /* 1K at a time */
-                                            G_PRIORITY_DEFAULT,                        /* default priority */
-                                            thread.getCancellable().get(),             /* cancel */
-                                            caseInputStatic,                           /* callback */
-                                            &testcase);
+        readConnection(conn.get());
 
-            auto output = g_io_stream_get_output_stream(G_IO_STREAM(connection.get()));  // transfer: none
-            if (output == nullptr)
-            {
-                g_warning("No output stream avilable with connection!");
-            }
-
-            g_output_stream_write_all_async(
-                output,                        /* output stream */
-                testcase.output.c_str(),       /* data */
-                testcase.output.size(),        /* size */
-                G_PRIORITY_DEFAULT,            /* priority */
-                thread.getCancellable().get(), /* cancel */
-                [](GObject *obj, GAsyncResult *res, gpointer userdata) -> void {
-                    auto testcase = reinterpret_cast<TestCase *>(userdata);
-                    gsize bytesout = 0;
-                    GError *error = nullptr;
-
-                    g_output_stream_write_all_finish(G_OUTPUT_STREAM(obj), res, &bytesout, &error);
-
-                    if (error != nullptr)
-                    {
-                        g_warning("Unable to write out snapd connection: %s", error->message);
-                        g_error_free(error);
-                        return;
-                    }
-
-                    if (bytesout != testcase->output.size())
-                    {
-                        g_warning("Wrote out %d bytes in snapd socket but expected to write out %d", int(bytesout),
-                                  int(testcase->output.size()));
-                    }
-
-                    g_output_stream_close(G_OUTPUT_STREAM(obj), nullptr, nullptr);
-                    checkConnection(testcase);
-                },          /* callback */
-                &testcase); /* expected size */
-
-            /* We got this one */
-            return true;
-        }
+        return true;
+    }
 
-        g_warning("Couldn't find a test case to use for the connection");
-        return false;
+    void readConnection(Connection *conn)
+    {
+        auto input = g_io_stream_get_input_stream(G_IO_STREAM(conn->connection.get()));  // transfer: none
+        g_input_stream_read_bytes_async(input,                                           /* stream */
+                                        1024,                                            /* 1K at a time */
+                                        G_PRIORITY_DEFAULT,                              /* default priority */
+                                        conn->cancel.get(),                              /* cancel */
+                                        connectionInputStatic,                           /* callback */
+                                        conn);
     }
 
-    static void caseInputStatic(GObject *obj, GAsyncResult *res, gpointer userdata) noexcept
+    static void connectionInputStatic(GObject *obj, GAsyncResult *res, gpointer userdata) noexcept
     {
-        auto testcase = reinterpret_cast<TestCase *>(userdata);
+        auto conn = reinterpret_cast<Connection *>(userdata);
         GError *error = nullptr;
         auto bytes = g_input_stream_read_bytes_finish(G_INPUT_STREAM(obj), res, &error);
 
         if (error != nullptr)
         {
-            g_warning("Error reading input socket: %s", error->message);
+            if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+            {
+                g_warning("Error reading input socket: %s", error->message);
+            }
             g_error_free(error);
             return;
         }
@@ -245,38 +248,121 @@ private:
         if (bytessize > 0)  // zero means closed
         {
             auto data = reinterpret_cast<const char *>(g_bytes_get_data(bytes, nullptr));
+            conn->buffer.append(data, bytessize);
 
-            for (unsigned int i = 0; i < bytessize; i++)
+            /* We only get GET requests, so the end of the headers is the end of the request */
+            auto end = conn->buffer.find("\r\n\r\n");
+            while (end != std::string::npos)
             {
-                testcase->result.push_back(data[i]);
+                auto request = conn->buffer.substr(0, end + 4);
+                conn->buffer.erase(0, end + 4);
+                conn->mock->handleRequest(conn, request);
+                end = conn->buffer.find("\r\n\r\n");
             }
 
-            g_input_stream_read_bytes_async(G_INPUT_STREAM(obj), /* stream */
-                                            1024,                /* 1K at a time */
-                                            G_PRIORITY_DEFAULT,  /* default priority */
-                                            nullptr,             /* TODO? cancel */
-                                            caseInputStatic,     /* callback */
-                                            userdata);
+            conn->mock->readConnection(conn);
         }
         else
         {
-            // g_debug("Request: %s", testcase->result.c_str());
-            g_input_stream_close(G_INPUT_STREAM(obj), nullptr, nullptr);
-            checkConnection(testcase);
+            // g_debug("Connection closed");
+            g_io_stream_close(G_IO_STREAM(conn->connection.get()), nullptr, nullptr);
         }
 
         g_bytes_unref(bytes);
     }
 
-    static void checkConnection(TestCase *testcase)
+    void handleRequest(Connection *conn, const std::string &request)
     {
-        auto input = g_io_stream_get_input_stream(G_IO_STREAM(testcase->connection.get()));    // transfer: none
-        auto output = g_io_stream_get_output_stream(G_IO_STREAM(testcase->connection.get()));  // transfer: none
+        conn->requests++;
+
+        TestCase *testcase = nullptr;
+
+        for (auto &candidate : testCases)
+        {
+            if (!candidate.used && candidate.input == request)
+            {
+                testcase = &candidate;
+                break;
+            }
+        }
+
+        if (testcase == nullptr)
+        {
+            for (auto &candidate : testCases)
+            {
+                if (!candidate.used)
+                {
+                    testcase = &candidate;
+                    break;
+                }
+            }
+        }
+
+        if (testcase == nullptr)
+        {
+            g_warning("Couldn't find a test case to use for the request");
+            extraCases.push_back(TestCase{{}, {}, request, true});
+            return;
+        }
+
+        testcase->used = true;
+        testcase->result = request;
 
-        if (g_input_stream_is_closed(input) && g_output_stream_is_closed(output))
+        if (latency.count() == 0)
         {
-            g_io_stream_close(G_IO_STREAM(testcase->connection.get()), nullptr, nullptr);
+            writeResponse(conn, testcase);
+            return;
         }
+
+        /* Find our shared pointer so the connection lives through the delay */
+        std::shared_ptr<Connection> sconn;
+        for (const auto &candidate : connections)
+        {
+            if (candidate.get() == conn)
+            {
+                sconn = candidate;
+            }
+        }
+
+        thread.timeout(latency, [this, sconn, testcase]() { writeResponse(sconn.get(), testcase); });
+    }
+
+    void writeResponse(Connection *conn, TestCase *testcase)
+    {
+        auto output = g_io_stream_get_output_stream(G_IO_STREAM(conn->connection.get()));  // transfer: none
+        if (output == nullptr)
+        {
+            g_warning("No output stream avilable with connection!");
+            return;
+        }
+
+        g_output_stream_write_all_async(
+            output,                        /* output stream */
+            testcase->output.c_str(),      /* data */
+            testcase->output.size(),       /* size */
+            G_PRIORITY_DEFAULT,            /* priority */
+            thread.getCancellable().get(), /* cancel */
+            [](GObject *obj, GAsyncResult *res, gpointer userdata) -> void {
+                auto testcase = reinterpret_cast<TestCase *>(userdata);
+                gsize bytesout = 0;
+                GError *error = nullptr;
+
+                g_output_stream_write_all_finish(G_OUTPUT_STREAM(obj), res, &bytesout, &error);
+
+                if (error != nullptr)
+                {
+                    g_warning("Unable to write out snapd connection: %s", error->message);
+                    g_error_free(error);
+                    return;
+                }
+
+                if (bytesout != testcase->output.size())
+                {
+                    g_warning("Wrote out %d bytes in snapd socket but expected to write out %d", int(bytesout),
+                              int(testcase->output.size()));
+                }
+            },         /* callback */
+            testcase); /* test case being responded to */
     }
 
 public:
@@ -330,6 +416,22 @@ public:
         return response + "}";
     }
 
+    static std::string snapsJson(const std::list<std::string> &packages)
+    {
+        return "[ " + std::accumulate(packages.begin(), packages.end(), std::string{},
+                                      [](const std::string &builder, std::string entry) {
+                                          if (builder.empty())
+                                          {
+                                              return entry;
+                                          }
+                                          else
+                                          {
+                                              return builder + ",\n" + entry;
+                                          }
+                                      }) +
+               " ]";
+    }
+
     struct SnapdPlug
     {
         std::string interface;
@@ -0,0 +1,50 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Ted Gould <ted.gould@canonical.com>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* Run by the zygote, checks that it got the arguments and environment
+   that exec-line-exec had and exits with the code it was given */
+int
+main (int argc, char * argv[])
+{
+	if (argc != 3 || strcmp(argv[1], "--exit") != 0) {
+		fprintf(stderr, "Bad arguments\n");
+		return 100;
+	}
+
+	const char * appdir = getenv("APP_DIR");
+	const char * path = getenv("PATH");
+	if (appdir == NULL || path == NULL || strncmp(path, appdir, strlen(appdir)) != 0) {
+		fprintf(stderr, "Bad PATH: %s\n", path);
+		return 101;
+	}
+
+	char * cwd = getcwd(NULL, 0);
+	if (cwd == NULL || strcmp(cwd, appdir) != 0) {
+		fprintf(stderr, "Bad working directory: %s\n", cwd);
+		return 102;
+	}
+	free(cwd);
+
+	return atoi(argv[2]);
+}
@@ -0,0 +1,96 @@
+/*
+ * Copyright 2013 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Ted Gould <ted.gould@canonical.com>
+ */
+
+#include <zeitgeist.h>
+#include "zg-report.h"
+#include "libubuntu-app-launch/ubuntu-app-launch.h"
+
+static void
+insert_complete (GObject * obj, GAsyncResult * res, gpointer user_data)
+{
+	GError * error = NULL;
+	GArray * result = NULL;
+
+	result = zeitgeist_log_insert_event_finish(ZEITGEIST_LOG(obj), res, &error);
+
+	if (error != NULL) {
+		g_warning("Unable to submit Zeitgeist Event: %s", error->message);
+		g_error_free(error);
+	}
+
+	if (result != NULL)
+		g_array_free(result, TRUE);
+	g_main_loop_quit((GMainLoop *)user_data);
+	return;
+}
+
+/* Sends Zeitgeist the event for @appid being opened or closed. Returns
+   TRUE if there is an event on its way, in which case @loop is quit once
+   Zeitgeist has it. Nothing happens until @loop is run. */
+gboolean
+zg_report_app (const gchar * appid, gboolean opened, GMainLoop * loop)
+{
+	g_return_val_if_fail(appid != NULL, FALSE);
+	g_return_val_if_fail(loop != NULL, FALSE);
+
+	/* Pre-launching isn't the user opening the application, that gets
+	   reported when it is brought out of standby. Otherwise the apps
+	   we pre-launch would get more popular each time we did it. */
+	if (opened && g_strcmp0(g_getenv("UBUNTU_APP_LAUNCH_STANDBY"), "1") == 0) {
+		return FALSE;
+	}
+
+	gchar * uri = NULL;
+	gchar * pkg = NULL;
+	gchar * app = NULL;
+
+	if (ubuntu_app_launch_app_id_parse(appid, &pkg, &app, NULL)) {
+		/* If it's parseable, use the short form */
+		uri = g_strdup_printf("application://%s_%s.desktop", pkg, app);
+		g_free(pkg);
+		g_free(app);
+	} else {
+		uri = g_strdup_printf("application://%s.desktop", appid);
+	}
+
+	ZeitgeistLog * log = zeitgeist_log_get_default();
+
+	ZeitgeistEvent * event = zeitgeist_event_new();
+	zeitgeist_event_set_actor(event, "application://ubuntu-app-launch.desktop");
+	if (opened) {
+		zeitgeist_event_set_interpretation(event, ZEITGEIST_ZG_ACCESS_EVENT);
+	} else {
+		zeitgeist_event_set_interpretation(event, ZEITGEIST_ZG_LEAVE_EVENT);
+	}
+	zeitgeist_event_set_manifestation(event, ZEITGEIST_ZG_USER_ACTIVITY);
+
+	ZeitgeistSubject * subject = zeitgeist_subject_new();
+	zeitgeist_subject_set_interpretation(subject, ZEITGEIST_NFO_SOFTWARE);
+	zeitgeist_subject_set_manifestation(subject, ZEITGEIST_NFO_SOFTWARE_ITEM);
+	zeitgeist_subject_set_mimetype(subject, "application/x-desktop");
+	zeitgeist_subject_set_uri(subject, uri);
+
+	zeitgeist_event_add_subject(event, subject);
+
+	zeitgeist_log_insert_event(log, event, NULL, insert_complete, loop);
+
+	g_free(uri);
+
+	return TRUE;
+}
@@ -0,0 +1,31 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Ted Gould <ted.gould@canonical.com>
+ */
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* How long we'll wait on Zeitgeist before giving up on it */
+#define ZG_REPORT_TIMEOUT_S 2
+
+gboolean  zg_report_app          (const gchar *   appid,
+                                  gboolean        opened,
+                                  GMainLoop *     loop);
+
+G_END_DECLS
@@ -0,0 +1,608 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Ted Gould <ted.gould@canonical.com>
+ */
+
+/* The zygote loads the toolkit libraries once and then forks a copy of
+   itself for each application that asks for it. The copy takes on the
+   environment, cgroups and AppArmor profile of the exec-line-exec that
+   asked, loads the library of the application and calls main() in it.
+   As the toolkit libraries are already loaded and relocated, that part
+   of the start up is skipped. This is kept to plain C without GLib so
+   that there is nothing in the zygote that isn't safe to fork. */
+
+#define _GNU_SOURCE
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "zygote.h"
+
+/* Applications that can be running at once */
+#define MAX_CHILDREN 64
+
+typedef struct {
+	pid_t pid;
+	int connection;
+} child_t;
+
+static child_t children[MAX_CHILDREN];
+
+/* Connections that we're waiting on a request from */
+#define MAX_PENDING 16
+
+/* How long a connection has to send its request */
+#define REQUEST_TIMEOUT_MS 5000
+
+typedef struct {
+	int connection; /* -1 if the slot is free */
+	struct ucred cred;
+	long long deadline;
+} pending_t;
+
+static pending_t pending[MAX_PENDING];
+
+/* A request that has been read off of the socket */
+typedef struct {
+	char * buffer;
+	int fds[3];
+	const char * library;
+	const char * directory;
+	char ** argv;
+	char ** envp;
+} request_t;
+
+static void
+request_free (request_t * request)
+{
+	int i;
+	for (i = 0; i < 3; i++) {
+		if (request->fds[i] >= 0)
+			close(request->fds[i]);
+	}
+	free(request->argv);
+	free(request->envp);
+	free(request->buffer);
+}
+
+/* Pull the next string out of the request, NULL if it runs off the end */
+static const char *
+next_string (const char ** position, const char * end)
+{
+	const char * string = *position;
+	const char * nul = memchr(string, '\0', end - string);
+	if (nul == NULL)
+		return NULL;
+
+	*position = nul + 1;
+	return string;
+}
+
+/* Reads the request and the file descriptors that came with it,
+   returns zero on success */
+static int
+request_read (int connection, request_t * request)
+{
+	memset(request, 0, sizeof(request_t));
+	request->fds[0] = request->fds[1] = request->fds[2] = -1;
+
+	request->buffer = malloc(ZYGOTE_MAX_REQUEST);
+	if (request->buffer == NULL)
+		return -1;
+
+	char control[CMSG_SPACE(sizeof(int) * 3)];
+	struct iovec iov = { .iov_base = request->buffer, .iov_len = ZYGOTE_MAX_REQUEST };
+	struct msghdr message = {
+		.msg_iov = &iov,
+		.msg_iovlen = 1,
+		.msg_control = control,
+		.msg_controllen = sizeof(control)
+	};
+
+	/* We only get here once poll() says it's there, and as it's a
+	   SOCK_SEQPACKET it's all there */
+	ssize_t length = recvmsg(connection, &message, MSG_CMSG_CLOEXEC | MSG_DONTWAIT);
+	if (length < (ssize_t)sizeof(zygote_request_t)) {
+		fprintf(stderr, "Unable to read request: %s\n", length < 0 ? strerror(errno) : "too short");
+		return -1;
+	}
+
+	struct cmsghdr * cmsg;
+	for (cmsg = CMSG_FIRSTHDR(&message); cmsg != NULL; cmsg = CMSG_NXTHDR(&message, cmsg)) {
+		if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS &&
+				cmsg->cmsg_len == CMSG_LEN(sizeof(int) * 3)) {
+			memcpy(request->fds, CMSG_DATA(cmsg), sizeof(int) * 3);
+		}
+	}
+
+	if ((message.msg_flags & (MSG_TRUNC | MSG_CTRUNC)) != 0 || request->fds[0] < 0) {
+		fprintf(stderr, "Request was truncated or didn't have file descriptors\n");
+		return -1;
+	}
+
+	zygote_request_t header;
+	memcpy(&header, request->buffer, sizeof(header));
+	if (header.argc == 0 || header.argc > ZYGOTE_MAX_REQUEST / 2 || header.envc > ZYGOTE_MAX_REQUEST / 2) {
+		fprintf(stderr, "Request has %u arguments and %u environment variables\n", header.argc, header.envc);
+		return -1;
+	}
+
+	request->argv = calloc(header.argc + 1, sizeof(char *));
+	request->envp = calloc(header.envc + 1, sizeof(char *));
+	if (request->argv == NULL || request->envp == NULL)
+		return -1;
+
+	const char * position = request->buffer + sizeof(header);
+	const char * end = request->buffer + length;
+
+	request->library = next_string(&position, end);
+	request->directory = next_string(&position, end);
+
+	uint32_t i;
+	for (i = 0; i < header.argc && request->directory != NULL; i++) {
+		if ((request->argv[i] = (char *)next_string(&position, end)) == NULL)
+			break;
+	}
+	if (i != header.argc) {
+		fprintf(stderr, "Request is missing arguments\n");
+		return -1;
+	}
+
+	for (i = 0; i < header.envc; i++) {
+		if ((request->envp[i] = (char *)next_string(&position, end)) == NULL)
+			break;
+	}
+	if (i != header.envc) {
+		fprintf(stderr, "Request is missing environment variables\n");
+		return -1;
+	}
+
+	if (request->library[0] == '\0') {
+		fprintf(stderr, "Request doesn't have a library\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+static void
+reply (int connection, zygote_reply_type_t type, int value)
+{
+	zygote_reply_t message = { .type = type, .value = value };
+	if (send(connection, &message, sizeof(message), MSG_NOSIGNAL) != sizeof(message))
+		fprintf(stderr, "Unable to send reply %d: %s\n", type, strerror(errno));
+}
+
+/* Path to the hierarchy a line from /proc/PID/cgroup is in */
+static int
+cgroup_procs_path (char * path, size_t size, const char * controllers, const char * cgroup)
+{
+	if (controllers[0] == '\0') {
+		/* The unified hierarchy, either on its own or next to the others */
+		struct stat info;
+		if (stat("/sys/fs/cgroup/cgroup.procs", &info) == 0)
+			return snprintf(path, size, "/sys/fs/cgroup%s/cgroup.procs", cgroup);
+		return snprintf(path, size, "/sys/fs/cgroup/unified%s/cgroup.procs", cgroup);
+	}
+
+	if (strncmp(controllers, "name=", strlen("name=")) == 0)
+		controllers += strlen("name=");
+
+	return snprintf(path, size, "/sys/fs/cgroup/%s%s/cgroup.procs", controllers, cgroup);
+}
+
+/* Moves us into each cgroup that the requester is in and we're not.
+   Not being able to join the freezer is an error as we couldn't be
+   paused, the others just get a warning. Returns zero on success. */
+static int
+cgroups_join (pid_t requester)
+{
+	char path[PATH_MAX];
+	snprintf(path, sizeof(path), "/proc/%d/cgroup", (int)requester);
+
+	FILE * theirs = fopen(path, "r");
+	if (theirs == NULL) {
+		fprintf(stderr, "Unable to read cgroups of '%d': %s\n", (int)requester, strerror(errno));
+		return -1;
+	}
+
+	int retval = 0;
+	char * line = NULL;
+	size_t linesize = 0;
+	while (getline(&line, &linesize, theirs) > 0) {
+		line[strcspn(line, "\n")] = '\0';
+
+		/* Small, and reading it again for each line is simpler than
+		   keeping it around */
+		int same = 0;
+		FILE * ours = fopen("/proc/self/cgroup", "r");
+		if (ours != NULL) {
+			char * ourline = NULL;
+			size_t oursize = 0;
+			while (!same && getline(&ourline, &oursize, ours) > 0) {
+				ourline[strcspn(ourline, "\n")] = '\0';
+				same = strcmp(line, ourline) == 0;
+			}
+			free(ourline);
+			fclose(ours);
+		}
+
+		if (same)
+			continue;
+
+		/* id:controllers:path */
+		char * controllers = strchr(line, ':');
+		char * cgroup = controllers != NULL ? strchr(controllers + 1, ':') : NULL;
+		if (cgroup == NULL)
+			continue;
+		*controllers++ = '\0';
+		*cgroup++ = '\0';
+
+		int freezer = strstr(controllers, "freezer") != NULL;
+
+		char procspath[PATH_MAX];
+		cgroup_procs_path(procspath, sizeof(procspath), controllers, cgroup);
+
+		int procs = open(procspath, O_WRONLY | O_CLOEXEC);
+		char pidstr[32];
+		int pidlen = snprintf(pidstr, sizeof(pidstr), "%d", (int)getpid());
+		if (procs < 0 || write(procs, pidstr, pidlen) != pidlen) {
+			fprintf(stderr, "Unable to join cgroup '%s': %s\n", procspath, strerror(errno));
+			if (freezer)
+				retval = -1;
+		}
+		if (procs >= 0)
+			close(procs);
+	}
+
+	free(line);
+	fclose(theirs);
+
+	return retval;
+}
+
+/* Same thing as aa_change_profile() without needing libapparmor */
+static int
+change_profile (const char * label)
+{
+	/* The child only has the one thread so it doesn't need the task */
+	int attr = open("/proc/self/attr/current", O_WRONLY | O_CLOEXEC);
+	if (attr < 0)
+		return -1;
+
+	char command[4096 + 32];
+	int length = snprintf(command, sizeof(command), "changeprofile %s", label);
+	int written = write(attr, command, length);
+	int writeerr = errno;
+	close(attr);
+
+	errno = writeerr;
+	return written == length ? 0 : -1;
+}
+
+/* In the child, turns us into the application. Only returns if
+   something went wrong, with errno set. */
+static void
+become_application (int connection, request_t * request, pid_t requester, const char * label)
+{
+	int i;
+	for (i = 0; i < 3; i++) {
+		if (dup2(request->fds[i], i) < 0)
+			return;
+	}
+	for (i = 0; i < 3; i++) {
+		if (request->fds[i] > 2)
+			close(request->fds[i]);
+	}
+
+	if (cgroups_join(requester) != 0) {
+		errno = EPERM;
+		return;
+	}
+
+	clearenv();
+	for (i = 0; request->envp[i] != NULL; i++) {
+		if (putenv(request->envp[i]) != 0)
+			return;
+	}
+
+	if (request->directory[0] != '\0' && chdir(request->directory) != 0)
+		fprintf(stderr, "Unable to change directory to '%s': %s\n", request->directory, strerror(errno));
+
+	/* Confine ourselves before loading anything of the application's */
+	if (label != NULL && strcmp(label, "unconfined") != 0 && change_profile(label) != 0) {
+		fprintf(stderr, "Unable to change to AppArmor profile '%s': %s\n", label, strerror(errno));
+		return;
+	}
+
+	void * library = dlopen(request->library, RTLD_NOW | RTLD_GLOBAL);
+	if (library == NULL) {
+		fprintf(stderr, "Unable to load '%s': %s\n", request->library, dlerror());
+		errno = ENOEXEC;
+		return;
+	}
+
+	int (*appmain) (int, char **) = (int (*)(int, char **))dlsym(library, "main");
+	if (appmain == NULL) {
+		fprintf(stderr, "No main() in '%s'\n", request->library);
+		errno = ENOEXEC;
+		return;
+	}
+
+	reply(connection, ZYGOTE_STARTED, getpid());
+	close(connection);
+
+	int argc = 0;
+	while (request->argv[argc] != NULL)
+		argc++;
+
+	exit(appmain(argc, request->argv));
+}
+
+static long long
+now_ms (void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (long long)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+/* Checks who is on the other end and puts the connection with the
+   ones waiting on a request. We don't read it here, as a client that
+   connects and then doesn't send anything would hold up everyone. */
+static void
+accept_connection (int connection)
+{
+	struct ucred cred;
+	socklen_t credsize = sizeof(cred);
+	if (getsockopt(connection, SOL_SOCKET, SO_PEERCRED, &cred, &credsize) != 0 || cred.uid != getuid()) {
+		fprintf(stderr, "Refusing connection from another user\n");
+		close(connection);
+		return;
+	}
+
+	int slot;
+	for (slot = 0; slot < MAX_PENDING && pending[slot].connection >= 0; slot++);
+	if (slot == MAX_PENDING) {
+		reply(connection, ZYGOTE_FAILED, EAGAIN);
+		close(connection);
+		return;
+	}
+
+	pending[slot].connection = connection;
+	pending[slot].cred = cred;
+	pending[slot].deadline = now_ms() + REQUEST_TIMEOUT_MS;
+}
+
+/* Drops the connections that didn't send a request in time, returns
+   how long until the next one runs out or -1 if there aren't any */
+static int
+expire_pending (void)
+{
+	long long now = now_ms();
+	long long next = -1;
+
+	int i;
+	for (i = 0; i < MAX_PENDING; i++) {
+		if (pending[i].connection < 0)
+			continue;
+
+		if (pending[i].deadline <= now) {
+			fprintf(stderr, "Request from '%d' timed out\n", (int)pending[i].cred.pid);
+			reply(pending[i].connection, ZYGOTE_FAILED, ETIMEDOUT);
+			close(pending[i].connection);
+			pending[i].connection = -1;
+			continue;
+		}
+
+		if (next < 0 || pending[i].deadline - now < next)
+			next = pending[i].deadline - now;
+	}
+
+	return (int)next;
+}
+
+static void
+handle_request (int listener, int sigfd, int connection, struct ucred cred)
+{
+	int slot;
+	for (slot = 0; slot < MAX_CHILDREN && children[slot].pid != 0; slot++);
+	if (slot == MAX_CHILDREN) {
+		reply(connection, ZYGOTE_FAILED, EAGAIN);
+		close(connection);
+		return;
+	}
+
+	request_t request;
+	if (request_read(connection, &request) != 0) {
+		reply(connection, ZYGOTE_FAILED, EINVAL);
+		request_free(&request);
+		close(connection);
+		return;
+	}
+
+	char * label = NULL;
+	if (zygote_peer_label(connection, cred.pid, &label) != 0) {
+		reply(connection, ZYGOTE_FAILED, EACCES);
+		request_free(&request);
+		close(connection);
+		return;
+	}
+
+	pid_t pid = fork();
+	if (pid == 0) {
+		close(listener);
+		close(sigfd);
+		int i;
+		for (i = 0; i < MAX_CHILDREN; i++) {
+			if (children[i].pid != 0)
+				close(children[i].connection);
+		}
+		for (i = 0; i < MAX_PENDING; i++) {
+			if (pending[i].connection >= 0)
+				close(pending[i].connection);
+		}
+
+		sigset_t sigchld;
+		sigemptyset(&sigchld);
+		sigaddset(&sigchld, SIGCHLD);
+		sigprocmask(SIG_UNBLOCK, &sigchld, NULL);
+
+		become_application(connection, &request, cred.pid, label);
+
+		reply(connection, ZYGOTE_FAILED, errno);
+		_exit(127);
+	}
+
+	free(label);
+	request_free(&request);
+
+	if (pid < 0) {
+		reply(connection, ZYGOTE_FAILED, errno);
+		close(connection);
+		return;
+	}
+
+	children[slot].pid = pid;
+	children[slot].connection = connection;
+}
+
+/* Tells each requester how their application exited */
+static void
+reap_children (int sigfd)
+{
+	struct signalfd_siginfo info;
+	while (read(sigfd, &info, sizeof(info)) == sizeof(info));
+
+	int status;
+	pid_t pid;
+	while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+		int i;
+		for (i = 0; i < MAX_CHILDREN; i++) {
+			if (children[i].pid == pid) {
+				reply(children[i].connection, ZYGOTE_EXITED, status);
+				close(children[i].connection);
+				children[i].pid = 0;
+				break;
+			}
+		}
+	}
+}
+
+/* Loads each of the libraries in the colon separated list */
+static void
+preload (const char * libraries)
+{
+	if (libraries == NULL)
+		return;
+
+	char * list = strdup(libraries);
+	char * saveptr = NULL;
+	char * library;
+	for (library = strtok_r(list, ":", &saveptr); library != NULL; library = strtok_r(NULL, ":", &saveptr)) {
+		if (dlopen(library, RTLD_NOW | RTLD_GLOBAL) == NULL)
+			fprintf(stderr, "Unable to preload '%s': %s\n", library, dlerror());
+	}
+	free(list);
+}
+
+int
+main (int argc, char * argv[])
+{
+	preload(getenv("UBUNTU_APP_LAUNCH_ZYGOTE_PRELOAD"));
+
+	int listener = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+	struct sockaddr_un address;
+	socklen_t addresslen = zygote_address(&address);
+	if (listener < 0 || bind(listener, (struct sockaddr *)&address, addresslen) != 0 || listen(listener, 16) != 0) {
+		fprintf(stderr, "Unable to listen on zygote socket: %s\n", strerror(errno));
+		return 1;
+	}
+
+	sigset_t sigchld;
+	sigemptyset(&sigchld);
+	sigaddset(&sigchld, SIGCHLD);
+	sigprocmask(SIG_BLOCK, &sigchld, NULL);
+	int sigfd = signalfd(-1, &sigchld, SFD_NONBLOCK | SFD_CLOEXEC);
+	if (sigfd < 0) {
+		fprintf(stderr, "Unable to watch for children: %s\n", strerror(errno));
+		return 1;
+	}
+
+	int i;
+	for (i = 0; i < MAX_PENDING; i++)
+		pending[i].connection = -1;
+
+	while (1) {
+		/* The listener, the signals and then the pending connections */
+		struct pollfd fds[2 + MAX_PENDING];
+		int slots[MAX_PENDING];
+		nfds_t nfds = 2;
+		fds[0] = (struct pollfd){ .fd = listener, .events = POLLIN };
+		fds[1] = (struct pollfd){ .fd = sigfd, .events = POLLIN };
+
+		int timeout = expire_pending();
+		for (i = 0; i < MAX_PENDING; i++) {
+			if (pending[i].connection < 0)
+				continue;
+			slots[nfds - 2] = i;
+			fds[nfds++] = (struct pollfd){ .fd = pending[i].connection, .events = POLLIN };
+		}
+
+		if (poll(fds, nfds, timeout) < 0) {
+			if (errno == EINTR)
+				continue;
+			fprintf(stderr, "Unable to poll: %s\n", strerror(errno));
+			return 1;
+		}
+
+		if (fds[1].revents & POLLIN)
+			reap_children(sigfd);
+
+		nfds_t fd;
+		for (fd = 2; fd < nfds; fd++) {
+			if (fds[fd].revents == 0)
+				continue;
+
+			pending_t * ready = &pending[slots[fd - 2]];
+			int connection = ready->connection;
+			ready->connection = -1;
+			handle_request(listener, sigfd, connection, ready->cred);
+		}
+
+		if (fds[0].revents & POLLIN) {
+			int connection = accept4(listener, NULL, NULL, SOCK_CLOEXEC);
+			if (connection >= 0)
+				accept_connection(connection);
+		}
+	}
+
+	return 0;
+}
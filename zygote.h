@@ -0,0 +1,131 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Ted Gould <ted.gould@canonical.com>
+ */
+
+#ifndef ZYGOTE_H
+#define ZYGOTE_H
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/* The protocol between exec-line-exec and the zygote. Each request is
+   a single SOCK_SEQPACKET message with the stdin, stdout and stderr of
+   the requester attached. It is a zygote_request_t followed by NUL
+   terminated strings: the library, the working directory, argc
+   arguments and then envc environment variables. The zygote answers
+   with ZYGOTE_STARTED or ZYGOTE_FAILED, and then ZYGOTE_EXITED when the
+   application is done. */
+
+/* Largest request we'll accept */
+#define ZYGOTE_MAX_REQUEST (256 * 1024)
+
+typedef struct {
+	uint32_t argc;
+	uint32_t envc;
+} zygote_request_t;
+
+typedef enum {
+	ZYGOTE_STARTED = 1, /* value is the PID of the application */
+	ZYGOTE_FAILED  = 2, /* value is the errno of what failed */
+	ZYGOTE_EXITED  = 3  /* value is the wait status of the application */
+} zygote_reply_type_t;
+
+typedef struct {
+	int32_t type;
+	int32_t value;
+} zygote_reply_t;
+
+/* Abstract socket that the zygote listens on, the environment variable
+   is there for testing. Returns the length of the address. */
+static inline socklen_t
+zygote_address (struct sockaddr_un * address)
+{
+	memset(address, 0, sizeof(struct sockaddr_un));
+	address->sun_family = AF_UNIX;
+
+	/* Leading NUL makes it abstract */
+	const char * name = getenv("UBUNTU_APP_LAUNCH_ZYGOTE_SOCKET");
+	if (name != NULL && name[0] != '\0') {
+		snprintf(address->sun_path + 1, sizeof(address->sun_path) - 1, "%s", name);
+	} else {
+		snprintf(address->sun_path + 1, sizeof(address->sun_path) - 1, "ubuntu-app-launch-zygote-%d", (int)getuid());
+	}
+
+	return offsetof(struct sockaddr_un, sun_path) + 1 + strlen(address->sun_path + 1);
+}
+
+/* Cuts "label (mode)" as the kernel gives it to us down to the label */
+static inline char *
+zygote_label_strip (char * label, size_t length)
+{
+	label[length] = '\0';
+	label[strcspn(label, " \n")] = '\0';
+	return strdup(label);
+}
+
+/* Gets the AppArmor label of the other end of the connection. If the
+   socket can't tell us we ask /proc, the peer is waiting on the other
+   side of the connection so the PID can't have been reused. Sets @label
+   to NULL when there isn't an LSM giving us labels. Returns zero on
+   success, the zygote can't know how to confine the application and
+   exec-line-exec can't know whether to trust the zygote otherwise. */
+static inline int
+zygote_peer_label (int connection, pid_t peer, char ** label)
+{
+	char buffer[4096];
+	socklen_t length = sizeof(buffer) - 1;
+	if (getsockopt(connection, SOL_SOCKET, SO_PEERSEC, buffer, &length) == 0) {
+		*label = zygote_label_strip(buffer, length);
+		return 0;
+	}
+
+	char path[PATH_MAX];
+	snprintf(path, sizeof(path), "/proc/%d/attr/current", (int)peer);
+
+	int attr = open(path, O_RDONLY | O_CLOEXEC);
+	ssize_t read_length = attr >= 0 ? read(attr, buffer, sizeof(buffer) - 1) : -1;
+	int readerr = errno;
+	if (attr >= 0)
+		close(attr);
+
+	if (read_length > 0) {
+		*label = zygote_label_strip(buffer, read_length);
+		return 0;
+	}
+
+	/* That's what the kernel says without an LSM */
+	if (read_length < 0 && readerr == EINVAL) {
+		*label = NULL;
+		return 0;
+	}
+
+	fprintf(stderr, "Unable to get the AppArmor label of '%d': %s\n", (int)peer,
+		read_length < 0 ? strerror(readerr) : "empty");
+	return -1;
+}
+
+#endif /* ZYGOTE_H */